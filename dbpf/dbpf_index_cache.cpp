@@ -0,0 +1,187 @@
+#include "dbpf_index_cache.h"
+#include "../fast_hash.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace DBPF {
+
+namespace {
+
+// File layout: CacheHeader, PackageRecord[packageCount], IndexEntry[entryCount], path strings (UTF-8, not terminated)
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t packageCount;
+    uint32_t reserved;
+    uint64_t entryCount;
+    uint64_t stringBytes;
+    uint64_t contentHash; // FastHash of everything after the header
+};
+
+struct PackageRecord {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t firstEntry;
+    uint32_t entryCount;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+constexpr uint32_t CACHE_MAGIC = 0x43494244; // "DBIC"
+constexpr uint32_t CACHE_VERSION = 1;
+
+static_assert(sizeof(CacheHeader) == 40 && sizeof(PackageRecord) == 40, "On-disk layout changed, bump CACHE_VERSION");
+static_assert(sizeof(IndexEntry) == 32, "IndexEntry is written as-is, bump CACHE_VERSION if it changes");
+
+} // namespace
+
+std::string IndexCache::Key(const std::filesystem::path& path) {
+    auto key = path.lexically_normal().generic_u8string();
+    return std::string(key.begin(), key.end());
+}
+
+bool IndexCache::Load(const std::filesystem::path& cachePath) {
+    std::ifstream in(cachePath, std::ios::binary);
+    if (!in) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    CacheHeader header;
+    if (data.size() < sizeof(header)) return false;
+    memcpy(&header, data.data(), sizeof(header));
+
+    const uint64_t recordBytes = static_cast<uint64_t>(header.packageCount) * sizeof(PackageRecord);
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.entryCount > data.size() / sizeof(IndexEntry)) return false;
+    const uint64_t entryBytes = header.entryCount * sizeof(IndexEntry);
+    if (sizeof(header) + recordBytes + entryBytes + header.stringBytes != data.size()) return false;
+    if (FastHash::Hash64(data.data() + sizeof(header), data.size() - sizeof(header)) != header.contentHash) return false;
+
+    const uint8_t* records = data.data() + sizeof(header);
+    const uint8_t* entries = records + recordBytes;
+    const char* strings = reinterpret_cast<const char*>(entries + entryBytes);
+
+    std::unordered_map<std::string, CachedPackage> loaded;
+    loaded.reserve(header.packageCount);
+    for (uint32_t i = 0; i < header.packageCount; i++) {
+        PackageRecord record;
+        memcpy(&record, records + i * sizeof(PackageRecord), sizeof(record));
+        if (static_cast<uint64_t>(record.pathOffset) + record.pathLength > header.stringBytes || record.firstEntry + record.entryCount > header.entryCount) return false;
+
+        CachedPackage& package = loaded[std::string(strings + record.pathOffset, record.pathLength)];
+        package.size = record.size;
+        package.mtime = record.mtime;
+        package.entries.resize(record.entryCount);
+        memcpy(package.entries.data(), entries + record.firstEntry * sizeof(IndexEntry), record.entryCount * sizeof(IndexEntry));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    packages = std::move(loaded);
+    dirty = false;
+    stats = {};
+    return true;
+}
+
+bool IndexCache::Save(const std::filesystem::path& cachePath, bool pruneUnused) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<PackageRecord> records;
+    std::vector<uint8_t> entryBytes;
+    std::string strings;
+    uint64_t entryCount = 0;
+    for (const auto& [path, package] : packages) {
+        if (pruneUnused && !package.used) continue;
+        records.push_back({package.size, package.mtime, entryCount, static_cast<uint32_t>(package.entries.size()), static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(path.size()), 0});
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(package.entries.data());
+        entryBytes.insert(entryBytes.end(), raw, raw + package.entries.size() * sizeof(IndexEntry));
+        entryCount += package.entries.size();
+        strings += path;
+    }
+
+    std::vector<uint8_t> body;
+    body.reserve(records.size() * sizeof(PackageRecord) + entryBytes.size() + strings.size());
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(records.data());
+    body.insert(body.end(), raw, raw + records.size() * sizeof(PackageRecord));
+    body.insert(body.end(), entryBytes.begin(), entryBytes.end());
+    body.insert(body.end(), strings.begin(), strings.end());
+
+    CacheHeader header{CACHE_MAGIC, CACHE_VERSION, static_cast<uint32_t>(records.size()), 0, entryCount, strings.size(), FastHash::Hash64(body.data(), body.size())};
+
+    // Temp + rename so a crash mid-write leaves the old cache intact
+    std::filesystem::path tempPath = std::filesystem::path(cachePath).concat(".tmp");
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(body.data()), body.size());
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) return false;
+    dirty = false;
+    return true;
+}
+
+bool IndexCache::GetEntries(const std::filesystem::path& packagePath, std::vector<IndexEntry>& out, bool* fromCache) {
+    if (fromCache) *fromCache = false;
+
+    uint64_t size;
+    int64_t mtime;
+    if (!StatFile(packagePath, size, mtime)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.failed++;
+        return false;
+    }
+
+    std::string key = Key(packagePath);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = packages.find(key);
+        if (it != packages.end()) {
+            if (it->second.size == size && it->second.mtime == mtime) {
+                it->second.used = true;
+                out = it->second.entries;
+                stats.hits++;
+                if (fromCache) *fromCache = true;
+                return true;
+            }
+            stats.stale++;
+        } else {
+            stats.misses++;
+        }
+    }
+
+    // Parse outside the lock, other threads can keep hitting the cache meanwhile
+    Package package;
+    if (!package.Open(packagePath)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.failed++;
+        return false;
+    }
+    out = package.Entries();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    CachedPackage& cached = packages[key];
+    cached.size = size;
+    cached.mtime = mtime;
+    cached.entries = out;
+    cached.used = true;
+    dirty = true;
+    return true;
+}
+
+bool IndexCache::IsDirty() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dirty;
+}
+
+IndexCache::Stats IndexCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.packages = packages.size();
+    for (const auto& [path, package] : packages) result.entries += package.entries.size();
+    return result;
+}
+
+} // namespace DBPF
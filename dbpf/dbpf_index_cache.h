@@ -0,0 +1,55 @@
+#pragma once
+#include "dbpf_reader.h"
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Every package's index serialized to one compact file, keyed by path + size + mtime
+// An unchanged package costs one stat on the next run instead of a map + parse. Tooling only (tools/dbpf_bench): TS3.exe opens packages and
+// parses their indexes inside its own resource manager, S3SS has no hook there to hand it a cached index, so in the .asi this would have no
+// caller. Hooking that path (finding it in all three exe versions, matching the engine's index structures) is the prerequisite
+namespace DBPF {
+
+class IndexCache {
+  public:
+    struct Stats {
+        uint64_t hits = 0;    // Served from the cache after a stat
+        uint64_t misses = 0;  // Not cached, parsed
+        uint64_t stale = 0;   // Cached but size/mtime changed, parsed again
+        uint64_t failed = 0;  // Couldn't stat or parse
+        size_t packages = 0;
+        size_t entries = 0;
+    };
+
+    // Reads a cache file, anything missing/corrupt/from another version just starts empty
+    bool Load(const std::filesystem::path& cachePath);
+
+    // Writes every package known to the cache. pruneUnused drops the ones nobody asked for since Load (deleted/moved packages)
+    bool Save(const std::filesystem::path& cachePath, bool pruneUnused = true);
+
+    // Index entries for a package, from the cache if its size + mtime still match, otherwise parsed (and the cache updated)
+    bool GetEntries(const std::filesystem::path& packagePath, std::vector<IndexEntry>& out, bool* fromCache = nullptr);
+
+    bool IsDirty() const;
+    Stats GetStats() const;
+
+  private:
+    struct CachedPackage {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        std::vector<IndexEntry> entries;
+        bool used = false;
+    };
+
+    static std::string Key(const std::filesystem::path& path);
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, CachedPackage> packages;
+    bool dirty = false;
+    Stats stats;
+};
+
+} // namespace DBPF
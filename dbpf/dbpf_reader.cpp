@@ -0,0 +1,177 @@
+#include "dbpf_reader.h"
+#include <cstring>
+
+namespace DBPF {
+
+namespace {
+
+// Header layout (96 bytes), only the fields DBPF 2.0 actually uses
+constexpr size_t HEADER_SIZE = 96;
+constexpr size_t OFFSET_MAJOR = 0x04;
+constexpr size_t OFFSET_MINOR = 0x08;
+constexpr size_t OFFSET_INDEX_COUNT = 0x24;
+constexpr size_t OFFSET_INDEX_SIZE = 0x2C;
+constexpr size_t OFFSET_INDEX_MINOR = 0x3C;
+constexpr size_t OFFSET_INDEX_OFFSET = 0x40;
+
+// Index flags, a set bit means that field is stored once up front instead of per entry
+constexpr uint32_t INDEX_CONSTANT_TYPE = 0x1;
+constexpr uint32_t INDEX_CONSTANT_GROUP = 0x2;
+constexpr uint32_t INDEX_CONSTANT_INSTANCE_HIGH = 0x4;
+
+constexpr uint32_t FILE_SIZE_EXTENDED = 0x80000000; // Entry carries the compression + committed u16s
+
+inline uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint16_t Read16(const uint8_t* p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return v;
+}
+
+} // namespace
+
+bool Package::Fail(const std::string& message) {
+    error = message;
+    entries.clear();
+    slots.clear();
+    return false;
+}
+
+bool Package::Open(const std::filesystem::path& path) {
+    Close();
+    if (!file.Open(path)) return Fail("could not map file");
+    return Parse(file.Data(), file.Size());
+}
+
+void Package::Close() {
+    file.Close();
+    data = nullptr;
+    size = 0;
+    header = {};
+    entries.clear();
+    slots.clear();
+    error.clear();
+}
+
+void Package::AdoptEntries(std::vector<IndexEntry> cachedEntries) {
+    Close();
+    entries = std::move(cachedEntries);
+    header.majorVersion = 2;
+    header.indexCount = static_cast<uint32_t>(entries.size());
+    BuildHashTable();
+}
+
+bool Package::Parse(const uint8_t* packageData, size_t packageSize) {
+    data = packageData;
+    size = packageSize;
+    error.clear();
+
+    if (size < HEADER_SIZE || memcmp(data, "DBPF", 4) != 0) return Fail("not a DBPF file");
+
+    header.majorVersion = Read32(data + OFFSET_MAJOR);
+    header.minorVersion = Read32(data + OFFSET_MINOR);
+    header.indexCount = Read32(data + OFFSET_INDEX_COUNT);
+    header.indexSize = Read32(data + OFFSET_INDEX_SIZE);
+    header.indexMinorVersion = Read32(data + OFFSET_INDEX_MINOR);
+    header.indexOffset = Read32(data + OFFSET_INDEX_OFFSET);
+
+    if (header.majorVersion != 2) return Fail("unsupported DBPF version " + std::to_string(header.majorVersion) + "." + std::to_string(header.minorVersion));
+    if (static_cast<uint64_t>(header.indexOffset) + header.indexSize > size) return Fail("index runs past end of file");
+
+    if (!ParseIndex()) return false;
+    BuildHashTable();
+    return true;
+}
+
+bool Package::ParseIndex() {
+    entries.clear();
+    if (header.indexCount == 0) return true;
+
+    const uint8_t* p = data + header.indexOffset;
+    const uint8_t* end = p + header.indexSize;
+    if (end - p < 4) return Fail("index too small for its flags");
+
+    auto next = [&p]() {
+        uint32_t v = Read32(p);
+        p += 4;
+        return v;
+    };
+
+    uint32_t flags = next();
+
+    // Constant fields come first, in type, group, instance-high order
+    uint32_t constantType = 0, constantGroup = 0, constantInstanceHigh = 0;
+    uint32_t constantCount = ((flags & INDEX_CONSTANT_TYPE) ? 1 : 0) + ((flags & INDEX_CONSTANT_GROUP) ? 1 : 0) + ((flags & INDEX_CONSTANT_INSTANCE_HIGH) ? 1 : 0);
+    if (static_cast<size_t>(end - p) < constantCount * 4) return Fail("index too small for its constant fields");
+    if (flags & INDEX_CONSTANT_TYPE) constantType = next();
+    if (flags & INDEX_CONSTANT_GROUP) constantGroup = next();
+    if (flags & INDEX_CONSTANT_INSTANCE_HIGH) constantInstanceHigh = next();
+
+    // Per entry: the non-constant key fields, instance-low, offset, file size, mem size, then 2x u16 when extended
+    // baseEntrySize leaves the extended u16s out, so it's the smallest an entry can be and count * baseEntrySize is a lower bound on
+    // what the index needs. This only rejects counts that can't fit, entries that turn out bigger are caught by the checks in the loop
+    const size_t baseEntrySize = (3 - constantCount) * 4 + 16;
+    if (static_cast<size_t>(end - p) / baseEntrySize < header.indexCount) return Fail("index too small for its entry count");
+
+    entries.resize(header.indexCount);
+    for (uint32_t i = 0; i < header.indexCount; i++) {
+        if (static_cast<size_t>(end - p) < baseEntrySize) return Fail("index truncated at entry " + std::to_string(i));
+
+        IndexEntry& e = entries[i];
+        e.key.type = (flags & INDEX_CONSTANT_TYPE) ? constantType : next();
+        e.key.group = (flags & INDEX_CONSTANT_GROUP) ? constantGroup : next();
+        uint32_t instanceHigh = (flags & INDEX_CONSTANT_INSTANCE_HIGH) ? constantInstanceHigh : next();
+        e.key.instance = (static_cast<uint64_t>(instanceHigh) << 32) | next();
+        e.offset = next();
+        uint32_t fileSize = next();
+        e.memSize = next();
+
+        e.compressedSize = fileSize & ~FILE_SIZE_EXTENDED;
+        if (fileSize & FILE_SIZE_EXTENDED) {
+            if (end - p < 4) return Fail("index truncated at entry " + std::to_string(i));
+            e.compression = Read16(p);
+            e.committed = Read16(p + 2);
+            p += 4;
+        } else {
+            e.compression = e.compressedSize != e.memSize ? COMPRESSION_REFPACK : COMPRESSION_NONE;
+        }
+    }
+    return true;
+}
+
+void Package::BuildHashTable() {
+    size_t capacity = 16;
+    while (capacity < entries.size() * 2) capacity <<= 1;
+    slots.assign(capacity, 0);
+
+    const size_t mask = capacity - 1;
+    ResourceKeyHasher hasher;
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        size_t slot = hasher(entries[i].key) & mask;
+        // Duplicate keys reuse their slot so the later entry wins
+        while (slots[slot] && !(entries[slots[slot] - 1].key == entries[i].key)) slot = (slot + 1) & mask;
+        slots[slot] = i + 1;
+    }
+}
+
+const IndexEntry* Package::Find(const ResourceKey& key) const {
+    if (slots.empty()) return nullptr;
+    const size_t mask = slots.size() - 1;
+    for (size_t slot = ResourceKeyHasher()(key) & mask; slots[slot]; slot = (slot + 1) & mask) {
+        const IndexEntry& e = entries[slots[slot] - 1];
+        if (e.key == key) return &e;
+    }
+    return nullptr;
+}
+
+const uint8_t* Package::ResourceData(const IndexEntry& entry) const {
+    if (!data || static_cast<uint64_t>(entry.offset) + entry.compressedSize > size) return nullptr;
+    return data + entry.offset;
+}
+
+} // namespace DBPF
@@ -0,0 +1,94 @@
+#pragma once
+#include "../mapped_file.h"
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// DBPF 2.0 (.package) index reader. Maps the file, parses the header + index table and builds a flat open-addressed
+// hash from type/group/instance to entry, two allocations per package regardless of entry count
+// Platform-neutral so the offline tools can use it, the DLL side should mind that every open Package maps its whole file
+namespace DBPF {
+
+struct ResourceKey {
+    uint32_t type = 0;
+    uint32_t group = 0;
+    uint64_t instance = 0;
+
+    bool operator==(const ResourceKey& other) const { return type == other.type && group == other.group && instance == other.instance; }
+};
+
+struct ResourceKeyHasher {
+    size_t operator()(const ResourceKey& key) const {
+        uint64_t h = (key.instance ^ (static_cast<uint64_t>(key.type) << 32 | key.group)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
+
+// Compression field values, Sims 3 only ever writes the first two for live resources
+constexpr uint16_t COMPRESSION_NONE = 0x0000;
+constexpr uint16_t COMPRESSION_REFPACK = 0xFFFF;
+constexpr uint16_t COMPRESSION_DELETED = 0xFFE0;
+
+struct IndexEntry {
+    ResourceKey key;
+    uint32_t offset = 0;
+    uint32_t compressedSize = 0; // Size on disk (the index's file size with the extended-fields bit masked off)
+    uint32_t memSize = 0;        // Size once decompressed
+    uint16_t compression = COMPRESSION_NONE;
+    uint16_t committed = 1;
+
+    bool IsCompressed() const { return compression == COMPRESSION_REFPACK; }
+    bool IsDeleted() const { return compression == COMPRESSION_DELETED; }
+};
+
+struct Header {
+    uint32_t majorVersion = 0;
+    uint32_t minorVersion = 0;
+    uint32_t indexCount = 0;
+    uint32_t indexSize = 0;
+    uint32_t indexOffset = 0;
+    uint32_t indexMinorVersion = 0;
+};
+
+class Package {
+  public:
+    // Map + parse a file, false with GetError() set on failure
+    bool Open(const std::filesystem::path& path);
+
+    // Parse a package already in memory, data has to outlive the Package
+    bool Parse(const uint8_t* data, size_t size);
+
+    // Index-only package from entries cached elsewhere (IndexCache), nothing is mapped so ResourceData returns nullptr
+    void AdoptEntries(std::vector<IndexEntry> cachedEntries);
+
+    void Close();
+
+    const Header& GetHeader() const { return header; }
+    const std::vector<IndexEntry>& Entries() const { return entries; }
+    const std::string& GetError() const { return error; }
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+    // Last entry with this key (later index entries override earlier ones), nullptr if absent
+    const IndexEntry* Find(const ResourceKey& key) const;
+
+    // Raw (possibly RefPack compressed) bytes of an entry, nullptr if its range is outside the file
+    const uint8_t* ResourceData(const IndexEntry& entry) const;
+
+  private:
+    bool Fail(const std::string& message);
+    bool ParseIndex();
+    void BuildHashTable();
+
+    MappedFile file;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    Header header;
+    std::vector<IndexEntry> entries;
+    std::vector<uint32_t> slots; // Entry index + 1, 0 = empty. Power of two, at most half full
+    std::string error;
+};
+
+} // namespace DBPF
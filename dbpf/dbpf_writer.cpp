@@ -0,0 +1,136 @@
+#include "dbpf_writer.h"
+#include <cstring>
+#include <fstream>
+
+namespace DBPF {
+
+namespace {
+
+constexpr size_t HEADER_SIZE = 96;
+
+inline void Put32(std::vector<uint8_t>& out, uint32_t v) {
+    uint8_t bytes[4];
+    memcpy(bytes, &v, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+inline void Put16(std::vector<uint8_t>& out, uint16_t v) {
+    uint8_t bytes[2];
+    memcpy(bytes, &v, 2);
+    out.insert(out.end(), bytes, bytes + 2);
+}
+
+inline void Set32(std::vector<uint8_t>& out, size_t offset, uint32_t v) {
+    memcpy(out.data() + offset, &v, 4);
+}
+
+} // namespace
+
+void PackageWriter::Add(const ResourceKey& key, const uint8_t* data, uint32_t size, uint32_t memSize, uint16_t compression) {
+    auto owned = std::make_shared<std::vector<uint8_t>>(data, data + size);
+    AddView(key, owned->data(), size, memSize, compression);
+    resources.back().owned = std::move(owned);
+}
+
+void PackageWriter::AddView(const ResourceKey& key, const uint8_t* data, uint32_t size, uint32_t memSize, uint16_t compression) {
+    Resource resource;
+    resource.entry.key = key;
+    resource.entry.compressedSize = size;
+    resource.entry.memSize = memSize;
+    resource.entry.compression = compression;
+    resource.entry.committed = 1;
+    resource.data = data;
+    resources.push_back(std::move(resource));
+}
+
+std::vector<IndexEntry> PackageWriter::Layout() const {
+    std::vector<IndexEntry> layout;
+    layout.reserve(resources.size());
+    uint32_t offset = HEADER_SIZE;
+    for (const auto& resource : resources) {
+        layout.push_back(resource.entry);
+        layout.back().offset = offset;
+        offset += resource.entry.compressedSize;
+    }
+    return layout;
+}
+
+std::vector<uint8_t> PackageWriter::BuildHeader(uint32_t indexOffset, uint32_t indexSize) const {
+    std::vector<uint8_t> header(HEADER_SIZE, 0);
+    memcpy(header.data(), "DBPF", 4);
+    Set32(header, 0x04, 2); // Major
+    Set32(header, 0x08, 0); // Minor
+    Set32(header, 0x24, static_cast<uint32_t>(resources.size()));
+    Set32(header, 0x2C, indexSize);
+    Set32(header, 0x3C, 3); // Index minor version, what TS3 writes
+    Set32(header, 0x40, indexOffset);
+    return header;
+}
+
+std::vector<uint8_t> PackageWriter::BuildIndex(const std::vector<IndexEntry>& layout) const {
+    // Fold any field that's the same for every entry into the index header, like the game does
+    uint32_t flags = 0;
+    if (!layout.empty()) {
+        flags = 0x7;
+        for (const auto& e : layout) {
+            if (e.key.type != layout[0].key.type) flags &= ~0x1u;
+            if (e.key.group != layout[0].key.group) flags &= ~0x2u;
+            if ((e.key.instance >> 32) != (layout[0].key.instance >> 32)) flags &= ~0x4u;
+        }
+    }
+
+    std::vector<uint8_t> index;
+    index.reserve(16 + layout.size() * 32);
+    Put32(index, flags);
+    if (!layout.empty()) {
+        if (flags & 0x1) Put32(index, layout[0].key.type);
+        if (flags & 0x2) Put32(index, layout[0].key.group);
+        if (flags & 0x4) Put32(index, static_cast<uint32_t>(layout[0].key.instance >> 32));
+    }
+
+    for (const auto& e : layout) {
+        if (!(flags & 0x1)) Put32(index, e.key.type);
+        if (!(flags & 0x2)) Put32(index, e.key.group);
+        if (!(flags & 0x4)) Put32(index, static_cast<uint32_t>(e.key.instance >> 32));
+        Put32(index, static_cast<uint32_t>(e.key.instance));
+        Put32(index, e.offset);
+        Put32(index, e.compressedSize | 0x80000000);
+        Put32(index, e.memSize);
+        Put16(index, e.compression);
+        Put16(index, e.committed);
+    }
+    return index;
+}
+
+std::vector<uint8_t> PackageWriter::Build() const {
+    std::vector<IndexEntry> layout = Layout();
+    uint32_t indexOffset = layout.empty() ? HEADER_SIZE : layout.back().offset + layout.back().compressedSize;
+    std::vector<uint8_t> index = BuildIndex(layout);
+
+    std::vector<uint8_t> out = BuildHeader(indexOffset, static_cast<uint32_t>(index.size()));
+    out.reserve(indexOffset + index.size());
+    for (const auto& resource : resources) out.insert(out.end(), resource.data, resource.data + resource.entry.compressedSize);
+    out.insert(out.end(), index.begin(), index.end());
+    return out;
+}
+
+bool PackageWriter::Write(const std::filesystem::path& path) const {
+    // Streamed rather than Build() so merging gigabytes of CC doesn't need it all in memory twice
+    uint64_t indexOffset = HEADER_SIZE;
+    for (const auto& resource : resources) indexOffset += resource.entry.compressedSize;
+    if (indexOffset > UINT32_MAX) return false; // DBPF 2.0 offsets are 32-bit
+
+    std::vector<IndexEntry> layout = Layout();
+
+    std::vector<uint8_t> index = BuildIndex(layout);
+    std::vector<uint8_t> header = BuildHeader(static_cast<uint32_t>(indexOffset), static_cast<uint32_t>(index.size()));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+    for (const auto& resource : resources) out.write(reinterpret_cast<const char*>(resource.data), resource.entry.compressedSize);
+    out.write(reinterpret_cast<const char*>(index.data()), index.size());
+    return static_cast<bool>(out);
+}
+
+} // namespace DBPF
@@ -0,0 +1,41 @@
+#pragma once
+#include "dbpf_reader.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// DBPF 2.0 writer, the inverse of Package. Used by the offline tools (merging, synthetic benchmark packages),
+// writes the same layout the game does: 96 byte header, resource data, index last with constant fields folded up front
+namespace DBPF {
+
+class PackageWriter {
+  public:
+    // Copies data. compression is one of the COMPRESSION_ values, for REFPACK data is a stream that decompresses to memSize bytes
+    void Add(const ResourceKey& key, const uint8_t* data, uint32_t size, uint32_t memSize, uint16_t compression);
+
+    // Same as Add but keeps a pointer instead of a copy, data has to outlive Write/Build (e.g. a mapped source Package)
+    void AddView(const ResourceKey& key, const uint8_t* data, uint32_t size, uint32_t memSize, uint16_t compression);
+
+    size_t Count() const { return resources.size(); }
+
+    // Entries as they'll appear in the index, offsets filled in
+    std::vector<IndexEntry> Layout() const;
+
+    std::vector<uint8_t> Build() const;
+    bool Write(const std::filesystem::path& path) const;
+
+  private:
+    struct Resource {
+        IndexEntry entry;
+        const uint8_t* data;
+        std::shared_ptr<std::vector<uint8_t>> owned; // Set for Add, keeps data alive
+    };
+
+    std::vector<uint8_t> BuildHeader(uint32_t indexOffset, uint32_t indexSize) const;
+    std::vector<uint8_t> BuildIndex(const std::vector<IndexEntry>& layout) const;
+
+    std::vector<Resource> resources;
+};
+
+} // namespace DBPF
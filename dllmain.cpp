@@ -365,10 +365,10 @@ class ConfigRetrievalHook : public SettingsHook {
     }
 
   public:
-    ConfigRetrievalHook() : SettingsHook(nullptr, "Config Retrieval") {
-        // Pattern for the config function
-        const char* pattern = "83 EC 2C 8B 44 24 ?? 53 55 56 57 33 DB 8B F1 BF ?? ?? ?? ?? 50 8D 4C 24 ?? 89 5C 24 ?? 89 5C 24 ?? 89 5C 24 ?? 89 7C 24 ??";
+    // Pattern for the config function
+    static constexpr Signature::PatternLiteral pattern = "83 EC 2C 8B 44 24 ?? 53 55 56 57 33 DB 8B F1 BF ?? ?? ?? ?? 50 8D 4C 24 ?? 89 5C 24 ?? 89 5C 24 ?? 89 5C 24 ?? 89 7C 24 ??";
 
+    ConfigRetrievalHook() : SettingsHook(nullptr, "Config Retrieval") {
         // Find the function
         uintptr_t addr = Pattern::Scan(pattern);
         if (!addr) { throw std::runtime_error("Failed to find config function pattern"); }
@@ -591,6 +591,13 @@ DWORD WINAPI HookThread(LPVOID lpParameter) {
             LOG_INFO("Patches registered successfully");
         } catch (const std::exception& e) { LOG_ERROR("Failed to initialize patch system: " + std::string(e.what())); }
 
+        // 5b. Find every signature the patches and hooks below will want in one pass instead of one image walk each
+        {
+            std::vector<const Signature::PatternLiteral*> hookPatterns = VTableManager::Patterns();
+            hookPatterns.push_back(&ConfigRetrievalHook::pattern);
+            AddressInfo::PrefetchAll(hookPatterns);
+        }
+
         // 6. Load all settings from TOML (settings, config values, QoL, patches)
         {
             std::string error;
@@ -715,10 +722,10 @@ namespace { //yuck
 
 // :))))
 struct TopologyPatch {
-    const char* pattern;       // signature to locate the patch site
-    size_t offset;             // bytes from match start to the byte to patch
-    std::vector<BYTE> expect;  // sanity-check byte(s) expected at the site
-    std::vector<BYTE> replace; // byte(s) to write
+    Signature::PatternLiteral pattern; // signature to locate the patch site, compiled at build time so DllMain doesn't parse it
+    size_t offset;                     // bytes from match start to the byte to patch
+    std::vector<BYTE> expect;          // sanity-check byte(s) expected at the site
+    std::vector<BYTE> replace;         // byte(s) to write
     const char* desc;
 };
 
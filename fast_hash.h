@@ -0,0 +1,162 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// XXH32 and XXH64, used to key caches on resource contents. Header-only and Windows-free so the offline tools can share it
+// The DLL is 32-bit, where every 64-bit multiply is several instructions, so anything hashed per call in the game uses Hash32.
+// Hash64 is for file-sized inputs hashed once (caches on disk, tools)
+// Not cryptographic, collisions are handled by also keying on sizes wherever it matters
+namespace FastHash {
+
+namespace Detail {
+constexpr uint32_t PRIME32_1 = 0x9E3779B1u;
+constexpr uint32_t PRIME32_2 = 0x85EBCA77u;
+constexpr uint32_t PRIME32_3 = 0xC2B2AE3Du;
+constexpr uint32_t PRIME32_4 = 0x27D4EB2Fu;
+constexpr uint32_t PRIME32_5 = 0x165667B1u;
+
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t Rotl(uint64_t v, int r) {
+    return (v << r) | (v >> (64 - r));
+}
+
+inline uint32_t Rotl32(uint32_t v, int r) {
+    return (v << r) | (v >> (32 - r));
+}
+
+inline uint64_t Read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = Rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+inline uint32_t Round32(uint32_t acc, uint32_t input) {
+    acc += input * PRIME32_2;
+    acc = Rotl32(acc, 13);
+    return acc * PRIME32_1;
+}
+
+inline uint64_t MergeRound(uint64_t acc, uint64_t val) {
+    acc ^= Round(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+} // namespace Detail
+
+inline uint32_t Hash32(const void* data, size_t size, uint32_t seed = 0) {
+    using namespace Detail;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    uint32_t h;
+
+    if (size >= 16) {
+        uint32_t v1 = seed + PRIME32_1 + PRIME32_2;
+        uint32_t v2 = seed + PRIME32_2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - PRIME32_1;
+        const uint8_t* limit = end - 16;
+        do {
+            v1 = Round32(v1, Read32(p));
+            v2 = Round32(v2, Read32(p + 4));
+            v3 = Round32(v3, Read32(p + 8));
+            v4 = Round32(v4, Read32(p + 12));
+            p += 16;
+        } while (p <= limit);
+
+        h = Rotl32(v1, 1) + Rotl32(v2, 7) + Rotl32(v3, 12) + Rotl32(v4, 18);
+    } else {
+        h = seed + PRIME32_5;
+    }
+
+    h += static_cast<uint32_t>(size);
+
+    while (p + 4 <= end) {
+        h += Read32(p) * PRIME32_3;
+        h = Rotl32(h, 17) * PRIME32_4;
+        p += 4;
+    }
+    while (p < end) {
+        h += (*p++) * PRIME32_5;
+        h = Rotl32(h, 11) * PRIME32_1;
+    }
+
+    h ^= h >> 15;
+    h *= PRIME32_2;
+    h ^= h >> 13;
+    h *= PRIME32_3;
+    h ^= h >> 16;
+    return h;
+}
+
+inline uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0) {
+    using namespace Detail;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        const uint8_t* limit = end - 32;
+        do {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+
+    h += static_cast<uint64_t>(size);
+
+    while (p + 8 <= end) {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(Read32(p)) * PRIME1;
+        h = Rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p++) * PRIME5;
+        h = Rotl(h, 11) * PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+} // namespace FastHash
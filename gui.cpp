@@ -608,6 +608,11 @@ void RenderUI() {
                     ImGui::ProgressBar(progress, ImVec2(-1, 0), std::to_string(currentUsage).substr(0, 4).c_str());
 
                     if (progress > 0.9f) { ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Warning: Memory usage is very high!"); }
+
+                    // Whatever S3SS patches are holding themselves, part of the total above
+                    for (const auto& [component, bytes] : memoryMonitor.GetReportedUsage()) {
+                        ImGui::BulletText("%s: %.1f MB", component.c_str(), bytes / (1024.0 * 1024.0));
+                    }
                 }
 
                 ImGui::Separator();
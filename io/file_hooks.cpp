@@ -0,0 +1,429 @@
+#include "file_hooks.h"
+#include "../logger.h"
+#include <detours/detours.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace FileHooks {
+
+namespace {
+// Registration is serialized on g_installMutex, the hooked functions only ever take the shared side of the others
+std::mutex g_installMutex;
+std::shared_mutex g_registryMutex;
+std::shared_mutex g_filesMutex;
+// Filters do blocking I/O of their own, so they don't hold up g_registryMutex: a read holds this one shared while its filters run and
+// (un)registering a filter takes it exclusive, which waits for any still running. std::shared_mutex is an SRW lock, so that's a real wait
+std::shared_mutex g_filterMutex;
+bool g_installed = false;
+
+template <typename THook> struct HookEntry {
+    std::string name;
+    THook hook;
+    Priority priority;
+
+    bool operator<(const HookEntry& other) const { return static_cast<int>(priority) < static_cast<int>(other.priority); }
+};
+
+std::vector<HookEntry<OpenHook>> g_openHooks;
+std::vector<HookEntry<OpenedHook>> g_openedHooks;
+std::vector<HookEntry<ReadHook>> g_readHooks;
+std::vector<HookEntry<CloseHook>> g_closeHooks;
+std::vector<HookEntry<ReadFilter>> g_readFilters; // Under g_filterMutex
+std::atomic<bool> g_hasReadFilters{false};      // So reads with nothing to filter skip the lock
+std::vector<HookEntry<WriteHook>> g_writeHooks;
+
+// shared_ptr so a read racing a close on another thread keeps its FileInfo alive
+std::unordered_map<HANDLE, std::shared_ptr<FileInfo>> g_files;
+std::atomic<uint32_t> g_nextFileId{1};
+
+typedef HANDLE(WINAPI* CreateFileW_t)(LPCWSTR, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD, DWORD, HANDLE);
+typedef BOOL(WINAPI* ReadFile_t)(HANDLE, LPVOID, DWORD, LPDWORD, LPOVERLAPPED);
+typedef BOOL(WINAPI* WriteFile_t)(HANDLE, LPCVOID, DWORD, LPDWORD, LPOVERLAPPED);
+typedef DWORD(WINAPI* SetFilePointer_t)(HANDLE, LONG, PLONG, DWORD);
+typedef BOOL(WINAPI* SetFilePointerEx_t)(HANDLE, LARGE_INTEGER, PLARGE_INTEGER, DWORD);
+typedef LONG(NTAPI* NtClose_t)(HANDLE);
+typedef BOOL(WINAPI* DuplicateHandle_t)(HANDLE, HANDLE, HANDLE, LPHANDLE, DWORD, BOOL, DWORD);
+
+CreateFileW_t Original_CreateFileW = nullptr;
+ReadFile_t Original_ReadFile = nullptr;
+WriteFile_t Original_WriteFile = nullptr;
+SetFilePointer_t Original_SetFilePointer = nullptr;
+SetFilePointerEx_t Original_SetFilePointerEx = nullptr;
+NtClose_t Original_NtClose = nullptr;
+DuplicateHandle_t Original_DuplicateHandle = nullptr;
+
+std::shared_ptr<FileInfo> FindFile(HANDLE handle) {
+    std::shared_lock lock(g_filesMutex);
+    auto it = g_files.find(handle);
+    return it != g_files.end() ? it->second : nullptr;
+}
+
+// Drops a handle's entry (if it's still that entry) and tells the close hooks, as if it had been closed
+void Forget(HANDLE handle, const std::shared_ptr<FileInfo>& info) {
+    {
+        std::unique_lock lock(g_filesMutex);
+        auto it = g_files.find(handle);
+        if (it == g_files.end() || it->second != info) return;
+        g_files.erase(it);
+    }
+    std::shared_lock lock(g_registryMutex);
+    for (auto& entry : g_closeHooks) entry.hook(*info);
+}
+
+// Regular files only, devices/pipes and directory handles (the watcher threads open those) aren't worth tracking
+bool ShouldTrack(LPCWSTR path, DWORD flagsAndAttributes) {
+    if (!path || (flagsAndAttributes & FILE_FLAG_BACKUP_SEMANTICS)) return false;
+    return wcsncmp(path, L"\\\\.\\", 4) != 0;
+}
+
+// Filtered reads and ReadAt leave the real file pointer behind, anything that reads or moves relative to it has to catch it up first
+void SyncPointer(const FileInfo& info) {
+    if (!info.pointerDirty.exchange(false, std::memory_order_relaxed)) return;
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(info.position.load(std::memory_order_relaxed));
+    Original_SetFilePointerEx(info.handle, position, nullptr, FILE_BEGIN);
+}
+
+bool IsPackagePath(const std::wstring& path) {
+    static constexpr wchar_t EXTENSION[] = L".package";
+    constexpr size_t length = std::size(EXTENSION) - 1;
+    return path.size() >= length && _wcsicmp(path.c_str() + path.size() - length, EXTENSION) == 0;
+}
+
+HANDLE WINAPI Hooked_CreateFileW(LPCWSTR path, DWORD access, DWORD shareMode, LPSECURITY_ATTRIBUTES security, DWORD creationDisposition, DWORD flagsAndAttributes, HANDLE templateFile) {
+    OpenContext ctx{path, access, shareMode, creationDisposition, flagsAndAttributes};
+    {
+        std::shared_lock lock(g_registryMutex);
+        for (auto& entry : g_openHooks) entry.hook(ctx);
+    }
+
+    HANDLE handle = Original_CreateFileW(path, ctx.access, ctx.shareMode, security, ctx.creationDisposition, ctx.flagsAndAttributes, templateFile);
+    if (handle == INVALID_HANDLE_VALUE || !ShouldTrack(path, ctx.flagsAndAttributes)) return handle;
+
+    DWORD error = GetLastError(); // CREATE_ALWAYS/OPEN_ALWAYS report ERROR_ALREADY_EXISTS on success
+    auto info = std::make_shared<FileInfo>();
+    info->handle = handle;
+    info->id = g_nextFileId.fetch_add(1, std::memory_order_relaxed);
+    info->path = path;
+    info->access = ctx.access;
+    info->flagsAndAttributes = ctx.flagsAndAttributes;
+    info->isPackage = IsPackagePath(info->path);
+    // The kernel only hands a value out again once it's closed, so anything still tracked under it died somewhere we don't see
+    // (NtDuplicateObject, say). Forget it now, before a filter could serve the new file from what it cached for the old one
+    if (std::shared_ptr<FileInfo> stale = FindFile(handle)) Forget(handle, stale);
+    {
+        std::unique_lock lock(g_filesMutex);
+        g_files[handle] = info;
+    }
+    {
+        std::shared_lock lock(g_registryMutex);
+        for (auto& entry : g_openedHooks) entry.hook(*info);
+    }
+    SetLastError(error);
+    return handle;
+}
+
+BOOL WINAPI Hooked_ReadFile(HANDLE handle, LPVOID buffer, DWORD bytesToRead, LPDWORD bytesRead, LPOVERLAPPED overlapped) {
+    auto info = FindFile(handle);
+    if (!info) return Original_ReadFile(handle, buffer, bytesToRead, bytesRead, overlapped);
+
+    bool synchronous = !(info->flagsAndAttributes & FILE_FLAG_OVERLAPPED);
+    uint64_t offset = overlapped ? (static_cast<uint64_t>(overlapped->OffsetHigh) << 32 | overlapped->Offset) : info->position.load(std::memory_order_relaxed);
+    DWORD error = GetLastError();
+
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+
+    // Only plain synchronous reads go through filters, their whole effect (buffer, byte count, file pointer) is something a filter can reproduce
+    bool filtered = false;
+    DWORD transferred = 0;
+    if (synchronous && !overlapped && bytesRead && g_hasReadFilters.load(std::memory_order_acquire)) {
+        std::shared_lock lock(g_filterMutex);
+        ReadRequest request{*info, offset, buffer, bytesToRead, 0};
+        for (auto& entry : g_readFilters) {
+            if (entry.hook(request)) {
+                filtered = true;
+                transferred = request.transferred;
+                break;
+            }
+        }
+    }
+
+    BOOL ok = TRUE;
+    if (filtered) {
+        *bytesRead = transferred;
+        info->position.store(offset + transferred, std::memory_order_relaxed);
+        info->pointerDirty.store(true, std::memory_order_relaxed);
+    } else {
+        if (synchronous && !overlapped) SyncPointer(*info);
+        ok = Original_ReadFile(handle, buffer, bytesToRead, bytesRead, overlapped);
+        error = GetLastError();
+        if (ok) transferred = bytesRead ? *bytesRead : static_cast<DWORD>(overlapped->InternalHigh);
+
+        // Synchronous handles move the file pointer even when an OVERLAPPED supplies the offset
+        if (synchronous) {
+            info->position.store(offset + transferred, std::memory_order_relaxed);
+            info->pointerDirty.store(false, std::memory_order_relaxed);
+        }
+    }
+    QueryPerformanceCounter(&end);
+    bool pending = !ok && error == ERROR_IO_PENDING;
+
+    ReadContext ctx{*info, offset, bytesToRead, transferred, ok != FALSE, overlapped != nullptr, pending, start.QuadPart, end.QuadPart, filtered};
+    {
+        std::shared_lock lock(g_registryMutex);
+        for (auto& entry : g_readHooks) entry.hook(ctx);
+    }
+
+    SetLastError(error);
+    return ok;
+}
+
+BOOL WINAPI Hooked_WriteFile(HANDLE handle, LPCVOID buffer, DWORD bytesToWrite, LPDWORD bytesWritten, LPOVERLAPPED overlapped) {
+    auto info = FindFile(handle);
+    if (!info) return Original_WriteFile(handle, buffer, bytesToWrite, bytesWritten, overlapped);
+
+    bool synchronous = !(info->flagsAndAttributes & FILE_FLAG_OVERLAPPED);
+    uint64_t offset = overlapped ? (static_cast<uint64_t>(overlapped->OffsetHigh) << 32 | overlapped->Offset) : info->position.load(std::memory_order_relaxed);
+    if (synchronous && !overlapped) SyncPointer(*info);
+
+    BOOL ok = Original_WriteFile(handle, buffer, bytesToWrite, bytesWritten, overlapped);
+    DWORD error = GetLastError();
+
+    DWORD transferred = 0;
+    if (ok) transferred = bytesWritten ? *bytesWritten : static_cast<DWORD>(overlapped->InternalHigh);
+    if (synchronous) {
+        info->position.store(offset + transferred, std::memory_order_relaxed);
+        info->pointerDirty.store(false, std::memory_order_relaxed);
+    }
+
+    // Pending writes are reported too, with transferred 0, a hook invalidating cached data can't wait for them to land
+    WriteContext ctx{*info, offset, bytesToWrite, transferred, ok != FALSE || error == ERROR_IO_PENDING};
+    {
+        std::shared_lock lock(g_registryMutex);
+        for (auto& entry : g_writeHooks) entry.hook(ctx);
+    }
+
+    SetLastError(error);
+    return ok;
+}
+
+DWORD WINAPI Hooked_SetFilePointer(HANDLE handle, LONG distance, PLONG distanceHigh, DWORD moveMethod) {
+    auto info = FindFile(handle);
+    if (info && moveMethod == FILE_CURRENT) SyncPointer(*info);
+
+    DWORD result = Original_SetFilePointer(handle, distance, distanceHigh, moveMethod);
+    DWORD error = GetLastError();
+    if (info && (result != INVALID_SET_FILE_POINTER || error == NO_ERROR)) {
+        info->position.store((distanceHigh ? static_cast<uint64_t>(static_cast<DWORD>(*distanceHigh)) << 32 : 0) | result, std::memory_order_relaxed);
+        info->pointerDirty.store(false, std::memory_order_relaxed);
+    }
+    SetLastError(error);
+    return result;
+}
+
+BOOL WINAPI Hooked_SetFilePointerEx(HANDLE handle, LARGE_INTEGER distance, PLARGE_INTEGER newPosition, DWORD moveMethod) {
+    auto info = FindFile(handle);
+    if (info && moveMethod == FILE_CURRENT) SyncPointer(*info);
+
+    LARGE_INTEGER position;
+    BOOL ok = Original_SetFilePointerEx(handle, distance, &position, moveMethod);
+    DWORD error = GetLastError();
+    if (ok) {
+        if (newPosition) *newPosition = position;
+        if (info) {
+            info->position.store(static_cast<uint64_t>(position.QuadPart), std::memory_order_relaxed);
+            info->pointerDirty.store(false, std::memory_order_relaxed);
+        }
+    }
+    SetLastError(error);
+    return ok;
+}
+
+// NtClose rather than CloseHandle, kernelbase and ntdll callers close handles without going through kernel32
+LONG NTAPI Hooked_NtClose(HANDLE handle) {
+    // Every event/thread/mutex handle in the process comes through here too, so only take the exclusive lock for handles we know
+    std::shared_ptr<FileInfo> info = FindFile(handle);
+    if (info) Forget(handle, info);
+    return Original_NtClose(handle);
+}
+
+// DUPLICATE_CLOSE_SOURCE closes the source in the kernel without an NtClose
+BOOL WINAPI Hooked_DuplicateHandle(HANDLE sourceProcess, HANDLE source, HANDLE targetProcess, LPHANDLE target, DWORD access, BOOL inherit, DWORD options) {
+    BOOL ok = Original_DuplicateHandle(sourceProcess, source, targetProcess, target, access, inherit, options);
+    DWORD error = GetLastError();
+    if ((options & DUPLICATE_CLOSE_SOURCE) && GetProcessId(sourceProcess) == GetCurrentProcessId()) {
+        if (std::shared_ptr<FileInfo> info = FindFile(source)) Forget(source, info);
+    }
+    SetLastError(error);
+    return ok;
+}
+
+bool InstallDetours() {
+    HMODULE kernel32 = GetModuleHandleW(L"kernel32.dll");
+    Original_CreateFileW = reinterpret_cast<CreateFileW_t>(GetProcAddress(kernel32, "CreateFileW"));
+    Original_ReadFile = reinterpret_cast<ReadFile_t>(GetProcAddress(kernel32, "ReadFile"));
+    Original_WriteFile = reinterpret_cast<WriteFile_t>(GetProcAddress(kernel32, "WriteFile"));
+    Original_SetFilePointer = reinterpret_cast<SetFilePointer_t>(GetProcAddress(kernel32, "SetFilePointer"));
+    Original_SetFilePointerEx = reinterpret_cast<SetFilePointerEx_t>(GetProcAddress(kernel32, "SetFilePointerEx"));
+    Original_NtClose = reinterpret_cast<NtClose_t>(GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtClose"));
+    Original_DuplicateHandle = reinterpret_cast<DuplicateHandle_t>(GetProcAddress(kernel32, "DuplicateHandle"));
+
+    if (!Original_CreateFileW || !Original_ReadFile || !Original_WriteFile || !Original_SetFilePointer || !Original_SetFilePointerEx || !Original_NtClose || !Original_DuplicateHandle) {
+        LOG_ERROR("[FileHooks] Missing kernel32/ntdll exports");
+        return false;
+    }
+
+    DetourTransactionBegin();
+    DetourUpdateThread(GetCurrentThread());
+    if (DetourAttach(&(PVOID&)Original_CreateFileW, Hooked_CreateFileW) != NO_ERROR || DetourAttach(&(PVOID&)Original_ReadFile, Hooked_ReadFile) != NO_ERROR ||
+        DetourAttach(&(PVOID&)Original_SetFilePointer, Hooked_SetFilePointer) != NO_ERROR || DetourAttach(&(PVOID&)Original_SetFilePointerEx, Hooked_SetFilePointerEx) != NO_ERROR ||
+        DetourAttach(&(PVOID&)Original_WriteFile, Hooked_WriteFile) != NO_ERROR || DetourAttach(&(PVOID&)Original_NtClose, Hooked_NtClose) != NO_ERROR ||
+        DetourAttach(&(PVOID&)Original_DuplicateHandle, Hooked_DuplicateHandle) != NO_ERROR) {
+        DetourTransactionAbort();
+        LOG_ERROR("[FileHooks] Failed to attach file I/O hooks");
+        return false;
+    }
+
+    LONG result = DetourTransactionCommit();
+    if (result != NO_ERROR) {
+        LOG_ERROR("[FileHooks] Failed to commit file I/O hooks: " + std::to_string(result));
+        return false;
+    }
+
+    g_installed = true;
+    LOG_INFO("[FileHooks] File I/O hooks installed");
+    return true;
+}
+
+void UninstallDetours() {
+    DetourTransactionBegin();
+    DetourUpdateThread(GetCurrentThread());
+    DetourDetach(&(PVOID&)Original_CreateFileW, Hooked_CreateFileW);
+    DetourDetach(&(PVOID&)Original_ReadFile, Hooked_ReadFile);
+    DetourDetach(&(PVOID&)Original_WriteFile, Hooked_WriteFile);
+    DetourDetach(&(PVOID&)Original_SetFilePointer, Hooked_SetFilePointer);
+    DetourDetach(&(PVOID&)Original_SetFilePointerEx, Hooked_SetFilePointerEx);
+    DetourDetach(&(PVOID&)Original_NtClose, Hooked_NtClose);
+    DetourDetach(&(PVOID&)Original_DuplicateHandle, Hooked_DuplicateHandle);
+    DetourTransactionCommit();
+
+    // Handles opened from here on aren't seen, so anything still tracked would go stale
+    std::unique_lock lock(g_filesMutex);
+    g_files.clear();
+    g_installed = false;
+    LOG_INFO("[FileHooks] File I/O hooks removed");
+}
+
+template <typename THook> bool Register(std::vector<HookEntry<THook>>& hooks, const char* kind, const std::string& name, THook hook, Priority priority) {
+    std::lock_guard<std::mutex> installLock(g_installMutex);
+    if (!g_installed && !InstallDetours()) return false;
+
+    std::unique_lock lock(g_registryMutex);
+    hooks.push_back({name, std::move(hook), priority});
+    std::stable_sort(hooks.begin(), hooks.end());
+    LOG_DEBUG(std::string("[FileHooks] Registered ") + kind + " hook: " + name);
+    return true;
+}
+} // namespace
+
+bool RegisterOpen(const std::string& name, OpenHook hook, Priority priority) {
+    return Register(g_openHooks, "Open", name, std::move(hook), priority);
+}
+
+bool RegisterOpened(const std::string& name, OpenedHook hook, Priority priority) {
+    return Register(g_openedHooks, "Opened", name, std::move(hook), priority);
+}
+
+bool RegisterRead(const std::string& name, ReadHook hook, Priority priority) {
+    return Register(g_readHooks, "Read", name, std::move(hook), priority);
+}
+
+bool RegisterClose(const std::string& name, CloseHook hook, Priority priority) {
+    return Register(g_closeHooks, "Close", name, std::move(hook), priority);
+}
+
+bool RegisterReadFilter(const std::string& name, ReadFilter filter, Priority priority) {
+    std::lock_guard<std::mutex> installLock(g_installMutex);
+    if (!g_installed && !InstallDetours()) return false;
+
+    std::unique_lock lock(g_filterMutex);
+    g_readFilters.push_back({name, std::move(filter), priority});
+    std::stable_sort(g_readFilters.begin(), g_readFilters.end());
+    g_hasReadFilters.store(true, std::memory_order_release);
+    LOG_DEBUG("[FileHooks] Registered ReadFilter hook: " + name);
+    return true;
+}
+
+bool RegisterWrite(const std::string& name, WriteHook hook, Priority priority) {
+    return Register(g_writeHooks, "Write", name, std::move(hook), priority);
+}
+
+void UnregisterAll(const std::string& name) {
+    std::lock_guard<std::mutex> installLock(g_installMutex);
+    auto removeByName = [&name](auto& container) { container.erase(std::remove_if(container.begin(), container.end(), [&name](const auto& entry) { return entry.name == name; }), container.end()); };
+    bool empty;
+    {
+        // Exclusive waits out any read still inside one of these filters, the caller is about to free what they use
+        std::unique_lock lock(g_filterMutex);
+        removeByName(g_readFilters);
+        g_hasReadFilters.store(!g_readFilters.empty(), std::memory_order_release);
+        empty = g_readFilters.empty();
+    }
+    {
+        std::unique_lock lock(g_registryMutex);
+        removeByName(g_openHooks);
+        removeByName(g_openedHooks);
+        removeByName(g_readHooks);
+        removeByName(g_closeHooks);
+        removeByName(g_writeHooks);
+        empty = empty && g_openHooks.empty() && g_openedHooks.empty() && g_readHooks.empty() && g_closeHooks.empty() && g_writeHooks.empty();
+    }
+    LOG_DEBUG("[FileHooks] Unregistered all hooks for: " + name);
+
+    if (empty && g_installed) UninstallDetours();
+}
+
+bool IsInstalled() {
+    std::lock_guard<std::mutex> installLock(g_installMutex);
+    return g_installed;
+}
+
+size_t TrackedFileCount() {
+    std::shared_lock lock(g_filesMutex);
+    return g_files.size();
+}
+
+void ForEachTrackedFile(const std::function<void(const FileInfo& file)>& visit) {
+    std::vector<std::shared_ptr<FileInfo>> files;
+    {
+        std::shared_lock lock(g_filesMutex);
+        files.reserve(g_files.size());
+        for (const auto& [handle, info] : g_files) files.push_back(info);
+    }
+    for (const auto& info : files) visit(*info);
+}
+
+bool ReadAt(const FileInfo& file, uint64_t offset, void* buffer, DWORD size, DWORD& transferred) {
+    transferred = 0;
+    if (!Original_ReadFile || (file.flagsAndAttributes & FILE_FLAG_OVERLAPPED)) return false;
+
+    // An OVERLAPPED on a synchronous handle is a positional read that still blocks, it does move the real pointer though
+    OVERLAPPED overlapped{};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    BOOL ok = Original_ReadFile(file.handle, buffer, size, &transferred, &overlapped);
+    file.pointerDirty.store(true, std::memory_order_relaxed);
+    if (!ok && GetLastError() == ERROR_HANDLE_EOF) {
+        transferred = 0;
+        return true;
+    }
+    return ok != FALSE;
+}
+
+} // namespace FileHooks
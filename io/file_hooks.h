@@ -0,0 +1,111 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// File I/O Hook Registry
+// Shared Detours on CreateFileW / ReadFile / WriteFile / SetFilePointer(Ex) / NtClose / DuplicateHandle so several patches can watch or steer the game's
+// file access without stacking their own detours. Every file opened while hooks are installed is tracked by handle along with
+// its logical file pointer, so reads on synchronous handles (which is how the game reads .package files) get a real offset
+// The detours go in when the first hook registers and come out again when the last one unregisters
+namespace FileHooks {
+
+// Hook priorities control execution order (lower numbers run first)
+enum class Priority {
+    First = 0,
+    Early = 25,
+    Normal = 50,
+    Late = 75,
+    Last = 100,
+};
+
+struct FileInfo {
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    uint32_t id = 0; // Sequential per open, never reused within a session
+    std::wstring path;
+    DWORD access = 0;
+    DWORD flagsAndAttributes = 0; // What the file was actually opened with, after any OpenHook edits
+    bool isPackage = false;       // .package extension, what most hooks care about
+    std::atomic<uint64_t> position{0};
+    mutable std::atomic<bool> pointerDirty{false}; // Real file pointer lags position after a filtered read or ReadAt, synced before anything that depends on it
+};
+
+// Before the real CreateFileW, hooks can change how the file gets opened
+struct OpenContext {
+    const wchar_t* path;
+    DWORD access;
+    DWORD shareMode;
+    DWORD creationDisposition;
+    DWORD flagsAndAttributes;
+};
+
+// After a ReadFile on a tracked handle. offset is where the read started, for overlapped reads that went async
+// transferred is 0 and pending is set (the result comes back through GetOverlappedResult, which isn't hooked)
+struct ReadContext {
+    const FileInfo& file;
+    uint64_t offset;
+    DWORD requested;
+    DWORD transferred;
+    bool succeeded;
+    bool overlapped;
+    bool pending;
+    int64_t startTicks; // QueryPerformanceCounter around the real call
+    int64_t endTicks;
+    bool filtered; // Satisfied by a ReadFilter, the real ReadFile may not have been called at all
+};
+
+// Before the real ReadFile, for plain synchronous reads only (handle not opened FILE_FLAG_OVERLAPPED, no OVERLAPPED passed)
+// A filter that fills buffer itself sets transferred and returns true, the real call is skipped and the file pointer moves as if it had run
+struct ReadRequest {
+    const FileInfo& file;
+    uint64_t offset;
+    void* buffer;
+    DWORD requested;
+    DWORD transferred;
+};
+
+// After a WriteFile on a tracked handle, offset as for reads
+struct WriteContext {
+    const FileInfo& file;
+    uint64_t offset;
+    DWORD requested;
+    DWORD transferred;
+    bool succeeded;
+};
+
+// Hooks run on whichever game thread is doing the I/O and must not register/unregister hooks or close tracked handles
+// Read filters have a lock of their own so they can block on their own I/O without holding up the other hooks. They mustn't read through
+// the hooked ReadFile (use ReadAt), and UnregisterAll waits for any still running
+using OpenHook = std::function<void(OpenContext& ctx)>;
+using OpenedHook = std::function<void(const FileInfo& file)>;
+using ReadHook = std::function<void(const ReadContext& ctx)>;
+using CloseHook = std::function<void(const FileInfo& file)>;
+using ReadFilter = std::function<bool(ReadRequest& request)>;
+using WriteHook = std::function<void(const WriteContext& ctx)>;
+
+// Register hooks with name and priority, name should be unique per patch (use patch name)
+// Returns false if the detours couldn't be installed
+bool RegisterOpen(const std::string& name, OpenHook hook, Priority priority = Priority::Normal);
+bool RegisterOpened(const std::string& name, OpenedHook hook, Priority priority = Priority::Normal);
+bool RegisterRead(const std::string& name, ReadHook hook, Priority priority = Priority::Normal);
+bool RegisterClose(const std::string& name, CloseHook hook, Priority priority = Priority::Normal);
+bool RegisterReadFilter(const std::string& name, ReadFilter filter, Priority priority = Priority::Normal);
+bool RegisterWrite(const std::string& name, WriteHook hook, Priority priority = Priority::Normal);
+
+// Unregister all hooks registered with a specific name
+void UnregisterAll(const std::string& name);
+
+bool IsInstalled();
+
+// Files currently open and tracked
+size_t TrackedFileCount();
+
+// Calls visit for every tracked file, on the calling thread. The list is copied first so visit can take its time (or open files)
+void ForEachTrackedFile(const std::function<void(const FileInfo& file)>& visit);
+
+// Positional read straight to the real ReadFile, no hooks run and the game's file pointer is left where it was. For filters fetching their data
+bool ReadAt(const FileInfo& file, uint64_t offset, void* buffer, DWORD size, DWORD& transferred);
+
+} // namespace FileHooks
@@ -0,0 +1,141 @@
+#include "io_trace.h"
+#include <cstring>
+
+namespace IOTrace {
+
+RecordRing::RecordRing(uint32_t capacityLog2) : cells(std::make_unique<Cell[]>(size_t(1) << capacityLog2)), mask((1u << capacityLog2) - 1) {
+    for (uint32_t i = 0; i <= mask; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool RecordRing::Push(const Record& record) {
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &cells[pos & mask];
+        uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // Consumer hasn't caught up to this lap yet
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->record = record;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t RecordRing::Drain(std::vector<Record>& out) {
+    size_t count = 0;
+    for (;;) {
+        Cell& cell = cells[tail & mask];
+        if (cell.sequence.load(std::memory_order_acquire) != tail + 1) break;
+        out.push_back(cell.record);
+        cell.sequence.store(tail + mask + 1, std::memory_order_release);
+        tail++;
+        count++;
+    }
+    return count;
+}
+
+bool TraceWriter::Open(const std::filesystem::path& path, uint64_t qpcFrequency, uint64_t startTimestamp) {
+    Close();
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    FileHeader header;
+    header.qpcFrequency = qpcFrequency;
+    header.startTimestamp = startTimestamp;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytesWritten = sizeof(header);
+    return static_cast<bool>(out);
+}
+
+void TraceWriter::Close() {
+    if (out.is_open()) out.close();
+    bytesWritten = 0;
+}
+
+void TraceWriter::WriteBlock(uint32_t type, const void* payload, uint32_t size, const void* extra, uint32_t extraSize) {
+    BlockHeader block{type, size + extraSize};
+    out.write(reinterpret_cast<const char*>(&block), sizeof(block));
+    out.write(static_cast<const char*>(payload), size);
+    if (extraSize) out.write(static_cast<const char*>(extra), extraSize);
+    bytesWritten += sizeof(block) + size + extraSize;
+}
+
+void TraceWriter::WriteFile(uint32_t fileId, uint64_t fileSize, const std::string& utf8Path) {
+    FileBlock file{fileId, static_cast<uint32_t>(utf8Path.size()), fileSize};
+    WriteBlock(BLOCK_FILE, &file, sizeof(file), utf8Path.data(), file.pathBytes);
+}
+
+void TraceWriter::WriteRecords(const Record* records, size_t count) {
+    // Keep blocks well under the 32-bit size field
+    constexpr size_t MAX_PER_BLOCK = 1 << 16;
+    while (count) {
+        size_t n = count < MAX_PER_BLOCK ? count : MAX_PER_BLOCK;
+        WriteBlock(BLOCK_RECORDS, records, static_cast<uint32_t>(n * sizeof(Record)));
+        records += n;
+        count -= n;
+    }
+}
+
+void TraceWriter::WriteDropped(uint64_t totalDropped) {
+    WriteBlock(BLOCK_DROPPED, &totalDropped, sizeof(totalDropped));
+}
+
+bool ReadTrace(const std::filesystem::path& path, Trace& trace, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "can't open file";
+        return false;
+    }
+
+    if (!in.read(reinterpret_cast<char*>(&trace.header), sizeof(trace.header)) || trace.header.magic != MAGIC) {
+        error = "not an I/O trace";
+        return false;
+    }
+    if (trace.header.version != VERSION) {
+        error = "unsupported trace version " + std::to_string(trace.header.version);
+        return false;
+    }
+
+    std::vector<uint8_t> payload;
+    BlockHeader block;
+    while (in.read(reinterpret_cast<char*>(&block), sizeof(block))) {
+        // Writers never emit anything near this, a bigger size means the file is damaged from here on
+        if (block.size > (64u << 20)) {
+            trace.truncated = true;
+            break;
+        }
+        payload.resize(block.size);
+        if (!in.read(reinterpret_cast<char*>(payload.data()), block.size)) {
+            trace.truncated = true;
+            break;
+        }
+
+        if (block.type == BLOCK_RECORDS) {
+            size_t count = block.size / sizeof(Record);
+            size_t first = trace.records.size();
+            trace.records.resize(first + count);
+            memcpy(trace.records.data() + first, payload.data(), count * sizeof(Record));
+        } else if (block.type == BLOCK_FILE && block.size >= sizeof(FileBlock)) {
+            FileBlock file;
+            memcpy(&file, payload.data(), sizeof(file));
+            if (sizeof(FileBlock) + file.pathBytes > block.size) continue;
+            trace.files[file.fileId] = {std::string(reinterpret_cast<const char*>(payload.data()) + sizeof(FileBlock), file.pathBytes), file.fileSize};
+        } else if (block.type == BLOCK_DROPPED && block.size >= sizeof(uint64_t)) {
+            memcpy(&trace.dropped, payload.data(), sizeof(uint64_t));
+        }
+        // Unknown block types are skipped so newer recorders stay readable
+    }
+    if (in.gcount() != 0) trace.truncated = true; // Partial block header
+    return true;
+}
+
+} // namespace IOTrace
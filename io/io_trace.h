@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// I/O trace format + the lock-free ring the recorder fills. Platform-neutral so tools/io_trace_analyze can read traces on Linux
+//
+// File layout: FileHeader, then blocks of {BlockHeader, payload} appended as the trace runs. A crash only loses the last partial block
+//   BLOCK_RECORDS  Record[]
+//   BLOCK_FILE     FileBlock + UTF-8 path, can land a flush after the records that use its id so resolve ids against the whole file
+//   BLOCK_DROPPED  uint64_t total records dropped so far because the ring was full
+namespace IOTrace {
+
+constexpr uint32_t MAGIC = 0x4F493353; // "S3IO"
+constexpr uint32_t VERSION = 1;
+
+enum class Kind : uint8_t {
+    Open = 1, // offset = file size at open
+    Read = 2,
+    Close = 3,
+};
+
+enum RecordFlags : uint8_t {
+    RECORD_FAILED = 1 << 0,
+    RECORD_OVERLAPPED = 1 << 1,
+    RECORD_PENDING = 1 << 2, // Went async, transferred isn't known
+};
+
+struct Record {
+    uint64_t timestamp = 0; // QPC ticks at the start of the call
+    uint64_t offset = 0;
+    uint32_t duration = 0; // QPC ticks spent in the call, saturates
+    uint32_t requested = 0;
+    uint32_t transferred = 0;
+    uint32_t fileId = 0;
+    uint32_t threadId = 0;
+    Kind kind = Kind::Read;
+    uint8_t flags = 0;
+    uint16_t reserved = 0;
+};
+static_assert(sizeof(Record) == 40, "Record is part of the file format");
+
+struct FileHeader {
+    uint32_t magic = MAGIC;
+    uint32_t version = VERSION;
+    uint64_t qpcFrequency = 0;
+    uint64_t startTimestamp = 0; // QPC when the trace started
+    uint64_t reserved = 0;
+};
+static_assert(sizeof(FileHeader) == 32, "FileHeader is part of the file format");
+
+enum BlockType : uint32_t {
+    BLOCK_RECORDS = 1,
+    BLOCK_FILE = 2,
+    BLOCK_DROPPED = 3,
+};
+
+struct BlockHeader {
+    uint32_t type = 0;
+    uint32_t size = 0; // Payload bytes after this header
+};
+
+struct FileBlock {
+    uint32_t fileId = 0;
+    uint32_t pathBytes = 0;
+    uint64_t fileSize = 0;
+};
+
+// Bounded multi-producer single-consumer ring (per-cell sequence numbers, Vyukov style). Push never blocks, a full ring drops
+class RecordRing {
+  public:
+    explicit RecordRing(uint32_t capacityLog2);
+
+    bool Push(const Record& record);
+
+    // Consumer side, appends everything published so far to out
+    size_t Drain(std::vector<Record>& out);
+
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+    uint32_t Capacity() const { return mask + 1; }
+
+  private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        Record record;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    uint32_t mask;
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) uint64_t tail = 0;
+    alignas(64) std::atomic<uint64_t> dropped{0};
+};
+
+// Appends blocks to a trace file, single-threaded (the recorder's flush thread)
+class TraceWriter {
+  public:
+    bool Open(const std::filesystem::path& path, uint64_t qpcFrequency, uint64_t startTimestamp);
+    void Close();
+    bool IsOpen() const { return out.is_open(); }
+
+    void WriteFile(uint32_t fileId, uint64_t fileSize, const std::string& utf8Path);
+    void WriteRecords(const Record* records, size_t count);
+    void WriteDropped(uint64_t totalDropped);
+    void Flush() { out.flush(); }
+
+    uint64_t BytesWritten() const { return bytesWritten; }
+
+  private:
+    void WriteBlock(uint32_t type, const void* payload, uint32_t size, const void* extra = nullptr, uint32_t extraSize = 0);
+
+    std::ofstream out;
+    uint64_t bytesWritten = 0;
+};
+
+struct TraceFile {
+    std::string path;
+    uint64_t size = 0;
+};
+
+struct Trace {
+    FileHeader header;
+    std::vector<Record> records;
+    std::unordered_map<uint32_t, TraceFile> files;
+    uint64_t dropped = 0;
+    bool truncated = false; // Last block was cut off (game crashed or trace still being written)
+};
+
+// Whole trace into memory, false with error set if it isn't a trace at all
+bool ReadTrace(const std::filesystem::path& path, Trace& trace, std::string& error);
+
+} // namespace IOTrace
@@ -0,0 +1,194 @@
+#include "mapped_view_reader.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace MappedViews {
+
+bool Source::Copy(void* destination, const uint8_t* view, uint32_t size) {
+    memcpy(destination, view, size);
+    return true;
+}
+
+ViewPool::ViewPool(const Config& newConfig) : config(newConfig), limit(newConfig.maxWindows) {
+    // A read that passes the size check spans at most two windows, and each piece is copied with only its own window pinned
+    config.granularity = std::max<uint32_t>(config.granularity, 1);
+    config.windowSize = std::max(config.windowSize - config.windowSize % config.granularity, config.granularity);
+    config.maxReadSize = std::min(config.maxReadSize, config.windowSize);
+    config.windowsPerSource = std::max<uint32_t>(config.windowsPerSource, 1);
+    windows.reserve(config.maxWindows);
+}
+
+ViewPool::~ViewPool() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = windows.size(); i-- > 0;) Unmap(i);
+}
+
+void ViewPool::Unmap(size_t index) {
+    Window& window = *windows[index];
+    window.source->Unmap(window.data, window.size);
+    mappedBytes.fetch_sub(window.size, std::memory_order_relaxed);
+    stats.unmaps++;
+    windows.erase(windows.begin() + index);
+}
+
+// Least recently used window nobody is copying from
+bool ViewPool::EvictOne() {
+    size_t victim = windows.size();
+    for (size_t i = 0; i < windows.size(); i++) {
+        if (windows[i]->pins == 0 && (victim == windows.size() || windows[i]->lastUse < windows[victim]->lastUse)) victim = i;
+    }
+    if (victim == windows.size()) return false;
+    Unmap(victim);
+    return true;
+}
+
+ViewPool::Window* ViewPool::Acquire(Source& source, uint64_t offset, uint64_t fileSize, bool& mapped) {
+    uint64_t start = offset - offset % config.windowSize;
+    size_t own = 0, oldestOwn = windows.size();
+    for (size_t i = 0; i < windows.size(); i++) {
+        Window& window = *windows[i];
+        if (window.source != &source) continue;
+        if (window.offset == start) {
+            window.lastUse = ++tick;
+            return &window;
+        }
+        own++;
+        if (window.pins == 0 && (oldestOwn == windows.size() || window.lastUse < windows[oldestOwn]->lastUse)) oldestOwn = i;
+    }
+
+    // Slide this source's own oldest window first, only take someone else's when the whole pool is in use
+    uint32_t windowLimit = limit.load(std::memory_order_relaxed);
+    if (own >= config.windowsPerSource && oldestOwn != windows.size()) Unmap(oldestOwn);
+    while (windows.size() >= windowLimit) {
+        if (!EvictOne()) return nullptr;
+    }
+
+    uint32_t size = static_cast<uint32_t>(std::min<uint64_t>(config.windowSize, fileSize - start));
+    const uint8_t* data = source.Map(start, size);
+    if (!data) return nullptr;
+    windows.push_back(std::make_unique<Window>(Window{&source, start, size, data, ++tick, 0}));
+    mappedBytes.fetch_add(size, std::memory_order_relaxed);
+    stats.maps++;
+    mapped = true;
+    return windows.back().get();
+}
+
+bool ViewPool::Read(Source& source, uint64_t offset, void* buffer, uint32_t size, uint32_t& transferred, uint32_t* windowsMapped) {
+    if (size == 0 || size > config.maxReadSize) return false;
+    uint64_t fileSize = 0;
+    if (!source.Size(fileSize)) return false;
+
+    // At or past the end is a successful empty read, no window needed
+    uint32_t length = offset < fileSize ? static_cast<uint32_t>(std::min<uint64_t>(size, fileSize - offset)) : 0;
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    uint32_t mappedCount = 0;
+    if (windowsMapped) *windowsMapped = 0;
+    for (uint32_t done = 0; done < length;) {
+        uint64_t position = offset + done;
+        Window* window;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bool mapped = false;
+            window = Acquire(source, position, fileSize, mapped);
+            if (mapped && windowsMapped) *windowsMapped = ++mappedCount;
+            if (!window) return false;
+            window->pins++;
+        }
+
+        // The copy runs unlocked, the pin keeps other threads from unmapping the window under it
+        uint32_t chunk = static_cast<uint32_t>(std::min<uint64_t>(length - done, window->offset + window->size - position));
+        bool copied = source.Copy(out + done, window->data + (position - window->offset), chunk);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            window->pins--;
+            // SetLimit may have wanted this one gone while it was pinned
+            while (windows.size() > limit.load(std::memory_order_relaxed) && EvictOne()) {}
+        }
+        if (!copied) return false;
+        done += chunk;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.readsServed++;
+    stats.bytesServed += length;
+    transferred = length;
+    return true;
+}
+
+void ViewPool::Release(Source& source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = windows.size(); i-- > 0;) {
+        if (windows[i]->source == &source) Unmap(i);
+    }
+}
+
+void ViewPool::SetLimit(uint32_t windowCount) {
+    windowCount = std::min(windowCount, config.maxWindows);
+    limit.store(windowCount, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex);
+    while (windows.size() > windowCount && EvictOne()) {}
+}
+
+Stats ViewPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.windows = static_cast<uint32_t>(windows.size());
+    result.mappedBytes = mappedBytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+// "Close" is a sixteenth of a window either way, far enough for the skips between DBPF resources, near enough that a run of reads
+// stays inside one window for a while
+AccessPattern::AccessPattern(const Config& config)
+    : nearby(std::max<uint32_t>(config.windowSize / 16, 1)), mask(config.history >= 32 ? UINT32_MAX : (1u << std::clamp<uint32_t>(config.history, 1, 31)) - 1),
+      threshold(std::clamp<uint32_t>(config.localToMap, 1, std::popcount(mask))), mapCost(static_cast<int32_t>(std::max<uint32_t>(config.mapCost, 1))),
+      backoff(static_cast<uint32_t>(std::popcount(mask))) {}
+
+bool AccessPattern::Record(uint64_t offset, uint32_t size) {
+    bool local = haveLast && (offset >= lastEnd ? offset - lastEnd : lastEnd - offset) < nearby;
+    history = ((history << 1) | (local ? 1u : 0u)) & mask;
+    haveLast = true;
+    lastEnd = offset + size;
+
+    if (cooldown) {
+        cooldown--;
+        return false;
+    }
+    uint32_t count = static_cast<uint32_t>(std::popcount(history));
+    if (!mapping && count >= threshold) {
+        mapping = true;
+        credit = 0;
+    } else if (mapping && count * 2 < threshold) {
+        Stop(credit >= 0);
+    }
+    return mapping;
+}
+
+void AccessPattern::Served(uint32_t windowsMapped) {
+    // Capped so a long good stretch can't hide a bad one for long
+    credit = std::min(credit + 1 - static_cast<int32_t>(windowsMapped) * mapCost, mapCost * 4);
+    if (credit < -2 * mapCost) Stop(false);
+}
+
+void AccessPattern::Stop(bool paidOff) {
+    uint32_t base = static_cast<uint32_t>(std::popcount(mask));
+    mapping = false;
+    if (paidOff) {
+        backoff = base;
+    } else {
+        cooldown = backoff;
+        backoff = std::min(backoff * 2, base * 128);
+    }
+}
+
+void AccessPattern::Reset() {
+    history = 0;
+    haveLast = false;
+    mapping = false;
+    credit = 0;
+    cooldown = 0;
+    backoff = static_cast<uint32_t>(std::popcount(mask));
+}
+
+} // namespace MappedViews
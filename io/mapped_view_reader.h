@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Mapped-view reads for read-only files. While a handle's reads stay close together they're copied straight out of a few mapped
+// windows of the file instead of each being a ReadFile, the windows slide along as the reads move on. Every handle shares one pool
+// of windows so the address space they take is fixed however many packages are open, which matters in a 32-bit process
+// Platform-neutral, the patch backs it with file mapping views and tools/mapped_read_sim with fake in-memory files
+namespace MappedViews {
+
+struct Config {
+    uint32_t windowSize = 1 << 20;    // Bytes per view, a multiple of granularity
+    uint32_t granularity = 64 << 10;  // Views start on this boundary (allocation granularity on Windows)
+    uint32_t maxWindows = 32;         // Across every file, so views never take more than maxWindows * windowSize of address space
+    uint32_t windowsPerSource = 2;    // A handle reading on slides its own oldest window along rather than taking another handle's
+    uint32_t maxReadSize = 256 << 10; // Bigger reads go straight through, ReadFile into the game's buffer costs no more than the copy would
+    uint32_t history = 8;             // Reads per handle the access heuristic looks back over, at most 32
+    uint32_t localToMap = 6;          // Of those, how many have to land near the previous one before views are used
+    uint32_t mapCost = 12;            // What mapping a window costs counted in plain reads (map, unmap, faulting its pages in)
+};
+
+// One open file the pool can map views of
+class Source {
+  public:
+    virtual ~Source() = default;
+
+    // Size of the file, views are never mapped past it. false if it can't be had, the read goes through
+    virtual bool Size(uint64_t& size) = 0;
+    // Read-only view of [offset, offset + size), offset on a granularity boundary. nullptr on failure
+    virtual const uint8_t* Map(uint64_t offset, uint32_t size) = 0;
+    virtual void Unmap(const uint8_t* view, uint32_t size) = 0;
+    // Touching a view is where an I/O error shows up, the Win32 side catches the in-page error. false means do a real read instead
+    virtual bool Copy(void* destination, const uint8_t* view, uint32_t size);
+};
+
+struct Stats {
+    uint64_t maps = 0;
+    uint64_t unmaps = 0;
+    uint64_t readsServed = 0;
+    uint64_t bytesServed = 0;
+    uint32_t windows = 0;
+    uint64_t mappedBytes = 0;
+};
+
+// The windows of every source. Thread-safe, but Read and Release for any one source have to be serialized by the caller
+class ViewPool {
+  public:
+    explicit ViewPool(const Config& config);
+    ~ViewPool();
+    ViewPool(const ViewPool&) = delete;
+    ViewPool& operator=(const ViewPool&) = delete;
+
+    // Copies [offset, offset + size) out of the source's windows, mapping or sliding them as needed. Short exactly where the file
+    // ends, like the real call. false leaves the read to the caller (too big, no window free, map or copy failed)
+    // windowsMapped counts the windows this read had to map, for AccessPattern::Served
+    bool Read(Source& source, uint64_t offset, void* buffer, uint32_t size, uint32_t& transferred, uint32_t* windowsMapped = nullptr);
+
+    // Unmaps every window of the source, before it's destroyed or whenever its views have to go
+    void Release(Source& source);
+
+    // Lowers or restores the window count, for when address space runs short. Windows over the limit are unmapped straight away
+    void SetLimit(uint32_t windows);
+    uint32_t Limit() const { return limit.load(std::memory_order_relaxed); }
+
+    uint64_t MappedBytes() const { return mappedBytes.load(std::memory_order_relaxed); }
+    Stats GetStats() const;
+
+    const Config& GetConfig() const { return config; }
+
+  private:
+    struct Window {
+        Source* source;
+        uint64_t offset;
+        uint32_t size;
+        const uint8_t* data;
+        uint64_t lastUse;
+        uint32_t pins; // Threads copying out of it right now, never unmapped while non-zero
+    };
+
+    Window* Acquire(Source& source, uint64_t offset, uint64_t fileSize, bool& mapped);
+    bool EvictOne();
+    void Unmap(size_t index);
+
+    Config config;
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Window>> windows;
+    std::atomic<uint32_t> limit;
+    std::atomic<uint64_t> mappedBytes{0};
+    uint64_t tick = 0;
+    Stats stats;
+};
+
+// Whether one handle's reads are local enough for views to pay off. A window costs a map call and a page fault per page touched on
+// top of the copy, which only wins once enough reads land in it. Reads scattered across a big package are cheaper as plain
+// ReadFile, so a handle only switches to views once most recent reads started close to where the previous one ended, and back once
+// fewer than half that many do. While on views it keeps score: each served read earns one, each window mapped costs mapCost. A
+// handle whose windows don't earn their keep goes back to plain reads and waits longer each time before trying again
+// Not thread-safe, one per handle
+class AccessPattern {
+  public:
+    explicit AccessPattern(const Config& config);
+
+    // Records the read, true if it should come out of views
+    bool Record(uint64_t offset, uint32_t size);
+    // After a read that came out of views, with the windows it had to map
+    void Served(uint32_t windowsMapped);
+    bool Mapping() const { return mapping; }
+    void Reset();
+
+  private:
+    void Stop(bool paidOff);
+
+    uint32_t nearby;
+    uint32_t mask;
+    uint32_t threshold;
+    int32_t mapCost;
+    uint32_t history = 0;
+    uint64_t lastEnd = 0;
+    bool haveLast = false;
+    bool mapping = false;
+    int32_t credit = 0;
+    uint32_t cooldown = 0; // Reads left before views are considered again
+    uint32_t backoff = 0;  // Next cooldown, doubles every time views didn't pay
+};
+
+} // namespace MappedViews
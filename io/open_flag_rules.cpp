@@ -0,0 +1,252 @@
+#include "open_flag_rules.h"
+#include <algorithm>
+#include <fstream>
+
+namespace OpenFlagRules {
+
+namespace {
+
+constexpr const char* HISTORY_HEADER = "S3SS open pattern history 1";
+
+bool EndsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool StartsWith(const std::string& text, const std::string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+} // namespace
+
+const char* HintName(Hint hint) {
+    switch (hint) {
+    case Hint::None: return "none";
+    case Hint::Random: return "random";
+    case Hint::Sequential: return "sequential";
+    default: return "keep";
+    }
+}
+
+const char* AccessName(Access access) {
+    switch (access) {
+    case Access::Read: return "read";
+    case Access::Write: return "write";
+    default: return "any";
+    }
+}
+
+const char* PatternName(Pattern pattern) {
+    switch (pattern) {
+    case Pattern::Unknown: return "unknown";
+    case Pattern::Sequential: return "sequential";
+    case Pattern::Random: return "random";
+    default: return "any";
+    }
+}
+
+bool ParseHint(std::string_view text, Hint& hint) {
+    for (Hint candidate : {Hint::Keep, Hint::None, Hint::Random, Hint::Sequential}) {
+        if (text == HintName(candidate)) {
+            hint = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseAccess(std::string_view text, Access& access) {
+    for (Access candidate : {Access::Any, Access::Read, Access::Write}) {
+        if (text == AccessName(candidate)) {
+            access = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParsePattern(std::string_view text, Pattern& pattern) {
+    for (Pattern candidate : {Pattern::Any, Pattern::Unknown, Pattern::Sequential, Pattern::Random}) {
+        if (text == PatternName(candidate)) {
+            pattern = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t ApplyHint(uint32_t flags, Hint hint) {
+    if (hint == Hint::Keep) return flags;
+    flags &= ~(FLAG_RANDOM_ACCESS | FLAG_SEQUENTIAL_SCAN);
+    if (hint == Hint::Random) flags |= FLAG_RANDOM_ACCESS;
+    if (hint == Hint::Sequential) flags |= FLAG_SEQUENTIAL_SCAN;
+    return flags;
+}
+
+std::string NormalizePath(std::string_view path) {
+    std::string result(path);
+    for (char& c : result) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c == '/') c = '\\';
+    }
+    return result;
+}
+
+std::vector<Rule> DefaultRules() {
+    std::vector<Rule> rules(4);
+    // Read-ahead doesn't do anything for a write, and RANDOM_ACCESS on a save being written only costs
+    rules[0].name = "Writes";
+    rules[0].access = Access::Write;
+    rules[0].hint = Hint::None;
+
+    // Whatever was read front to back last time, small packages the startup scan reads whole included
+    rules[1].name = "Read sequentially last time";
+    rules[1].pattern = Pattern::Sequential;
+    rules[1].hint = Hint::Sequential;
+
+    // DBPF containers: index at the end, resources wherever
+    rules[2].name = "Packages";
+    rules[2].extensions = {".package", ".dbc", ".nhd", ".world"};
+    rules[2].hint = Hint::Random;
+
+    rules[3].name = "Text and logs";
+    rules[3].extensions = {".txt", ".log", ".xml", ".ini", ".cfg", ".toml", ".csv"};
+    rules[3].hint = Hint::Sequential;
+    return rules;
+}
+
+RuleSet::RuleSet(std::vector<Rule> newRules) : rules(std::move(newRules)), hits(rules.size()) {
+    for (Rule& rule : rules) {
+        for (std::string& extension : rule.extensions) {
+            extension = NormalizePath(extension);
+            if (!extension.empty() && extension[0] != '.') extension.insert(extension.begin(), '.');
+        }
+        for (std::string& prefix : rule.pathPrefixes) prefix = NormalizePath(prefix);
+        if (rule.pattern != Pattern::Any) usesPattern = true;
+    }
+}
+
+static bool MatchesFile(const Rule& rule, const OpenInfo& file) {
+    if (rule.access != Access::Any && rule.access != file.access) return false;
+    if (!rule.extensions.empty() && std::none_of(rule.extensions.begin(), rule.extensions.end(), [&](const std::string& e) { return EndsWith(file.path, e); })) return false;
+    if (!rule.pathPrefixes.empty() && std::none_of(rule.pathPrefixes.begin(), rule.pathPrefixes.end(), [&](const std::string& p) { return StartsWith(file.path, p); })) return false;
+    return true;
+}
+
+int RuleSet::Match(const OpenInfo& file) const {
+    for (size_t i = 0; i < rules.size(); i++) {
+        const Rule& rule = rules[i];
+        if (rule.pattern != Pattern::Any && rule.pattern != file.observed) continue;
+        if (!MatchesFile(rule, file)) continue;
+        return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool RuleSet::DependsOnPattern(const OpenInfo& file) const {
+    if (!usesPattern) return false;
+    // The first rule that matches without a pattern wins whatever was observed, nothing after it matters
+    for (const Rule& rule : rules) {
+        if (MatchesFile(rule, file)) return rule.pattern != Pattern::Any;
+    }
+    return false;
+}
+
+Hint RuleSet::Choose(const OpenInfo& file, int* ruleIndex) {
+    int index = Match(file);
+    if (ruleIndex) *ruleIndex = index;
+    if (index < 0) {
+        unmatched.fetch_add(1, std::memory_order_relaxed);
+        return Hint::Keep;
+    }
+    hits[index].fetch_add(1, std::memory_order_relaxed);
+    return rules[index].hint;
+}
+
+void RuleSet::ResetHits() {
+    for (auto& count : hits) count.store(0, std::memory_order_relaxed);
+    unmatched.store(0, std::memory_order_relaxed);
+}
+
+void ReadObserver::OnRead(uint64_t offset, uint32_t size) {
+    if (offset == lastEnd) sequential++;
+    reads++;
+    lastEnd = offset + size;
+}
+
+Pattern ReadObserver::Classify(uint32_t minReads) const {
+    if (reads < std::max<uint32_t>(minReads, 1)) return Pattern::Unknown;
+    if (sequential * 4 >= reads * 3) return Pattern::Sequential;
+    if (sequential * 4 <= reads) return Pattern::Random;
+    return Pattern::Unknown;
+}
+
+void PatternHistory::Record(const std::string& path, Pattern pattern) {
+    if (pattern != Pattern::Sequential && pattern != Pattern::Random) return;
+    auto it = entries.find(path);
+    if (it != entries.end()) {
+        // Save writes oldest first and Load takes age from that order, so a fresher lastUse is a change to save too
+        it->second.lastUse = ++tick;
+        it->second.pattern = pattern;
+        dirty = true;
+        return;
+    }
+
+    // Full: the least recently seen eighth goes in one pass rather than a scan per insert
+    if (entries.size() >= maxEntries && maxEntries) {
+        std::vector<uint64_t> uses;
+        uses.reserve(entries.size());
+        for (const auto& [key, entry] : entries) uses.push_back(entry.lastUse);
+        size_t drop = std::max<size_t>(entries.size() / 8, 1);
+        std::nth_element(uses.begin(), uses.begin() + (drop - 1), uses.end());
+        uint64_t cutoff = uses[drop - 1];
+        for (auto entry = entries.begin(); entry != entries.end();) entry = entry->second.lastUse <= cutoff ? entries.erase(entry) : std::next(entry);
+    }
+    entries.emplace(path, Entry{pattern, ++tick});
+    dirty = true;
+}
+
+Pattern PatternHistory::Lookup(const std::string& path) const {
+    auto it = entries.find(path);
+    return it != entries.end() ? it->second.pattern : Pattern::Unknown;
+}
+
+bool PatternHistory::Load(const std::filesystem::path& path) {
+    entries.clear();
+    tick = 0;
+    dirty = false;
+
+    std::ifstream in(path, std::ios::binary);
+    std::string line;
+    if (!std::getline(in, line) || line != HISTORY_HEADER) return false;
+    while (std::getline(in, line)) {
+        if (line.size() < 3 || line[1] != '\t' || (line[0] != 's' && line[0] != 'r')) continue;
+        // Oldest first on disk, so the order they're read in is their age
+        entries[line.substr(2)] = Entry{line[0] == 's' ? Pattern::Sequential : Pattern::Random, ++tick};
+        if (entries.size() >= maxEntries) break;
+    }
+    return true;
+}
+
+bool PatternHistory::Save(const std::filesystem::path& path) {
+    std::vector<std::pair<uint64_t, const std::string*>> order;
+    order.reserve(entries.size());
+    for (const auto& [key, entry] : entries) order.emplace_back(entry.lastUse, &key);
+    std::sort(order.begin(), order.end());
+
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out << HISTORY_HEADER << '\n';
+        for (const auto& [lastUse, key] : order) out << (entries.at(*key).pattern == Pattern::Sequential ? 's' : 'r') << '\t' << *key << '\n';
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) return false;
+    dirty = false;
+    return true;
+}
+
+} // namespace OpenFlagRules
@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Which cache hint a file gets when it's opened. FILE_FLAG_RANDOM_ACCESS on everything suits the game's package reads (index,
+// then resources all over the file) but takes read-ahead away from files that are read front to back: saves, logs, small packages
+// read whole during the startup scan. Rules match on extension, path prefix, access mode and how the same file was read the last
+// time it was open, and the first match picks RANDOM_ACCESS, SEQUENTIAL_SCAN, neither, or leaves the game's flags alone
+// Platform-neutral, the patch loads rules from TOML and applies them in a FileHooks open hook, tools/open_rules_check runs them
+// against an I/O trace
+namespace OpenFlagRules {
+
+// Same values as the Win32 FILE_FLAG_ constants
+constexpr uint32_t FLAG_RANDOM_ACCESS = 0x10000000;
+constexpr uint32_t FLAG_SEQUENTIAL_SCAN = 0x08000000;
+
+enum class Hint : uint8_t {
+    Keep,       // Whatever the game asked for
+    None,       // Neither flag, the cache manager's default read-ahead
+    Random,     // FILE_FLAG_RANDOM_ACCESS
+    Sequential, // FILE_FLAG_SEQUENTIAL_SCAN
+};
+
+enum class Access : uint8_t {
+    Any,
+    Read,  // Read-only
+    Write, // Any write access, with or without read
+};
+
+enum class Pattern : uint8_t {
+    Any,        // Rules only, matches whatever was seen
+    Unknown,    // Not seen yet, too few reads, or a mix
+    Sequential, // Most reads started where the previous one ended
+    Random,     // Most reads didn't
+};
+
+// Lowercase names as used in the rules file, Parse* return false for anything else
+const char* HintName(Hint hint);
+const char* AccessName(Access access);
+const char* PatternName(Pattern pattern);
+bool ParseHint(std::string_view text, Hint& hint);
+bool ParseAccess(std::string_view text, Access& access);
+bool ParsePattern(std::string_view text, Pattern& pattern);
+
+// dwFlagsAndAttributes with the hint applied, the other flag of the pair always cleared
+uint32_t ApplyHint(uint32_t flags, Hint hint);
+
+// ASCII lowercase with forward slashes turned back, how paths and prefixes are compared. Non-ASCII characters compare exactly
+std::string NormalizePath(std::string_view path);
+
+struct Rule {
+    std::string name;
+    std::vector<std::string> extensions;   // ".package", any of them, empty matches every extension
+    std::vector<std::string> pathPrefixes; // Any of them, empty matches every path
+    Access access = Access::Any;
+    Pattern pattern = Pattern::Any;
+    Hint hint = Hint::Keep;
+};
+
+// What a rule is matched against
+struct OpenInfo {
+    std::string path; // NormalizePath'd
+    Access access = Access::Read;
+    Pattern observed = Pattern::Unknown;
+};
+
+// The shipped rules, what the patch falls back to without a rules file
+std::vector<Rule> DefaultRules();
+
+// First match wins. Hit counters are per rule and safe to bump from any thread, the rules themselves don't change once built
+class RuleSet {
+  public:
+    explicit RuleSet(std::vector<Rule> rules);
+
+    // Index of the first rule that matches, -1 if none do
+    int Match(const OpenInfo& file) const;
+    // Match plus hit counting, the hint of the matching rule or Keep
+    Hint Choose(const OpenInfo& file, int* ruleIndex = nullptr);
+
+    const std::vector<Rule>& Rules() const { return rules; }
+    uint64_t Hits(size_t index) const { return hits[index].load(std::memory_order_relaxed); }
+    uint64_t Unmatched() const { return unmatched.load(std::memory_order_relaxed); }
+    void ResetHits();
+
+    // Whether any rule looks at the observed pattern, if not nobody needs to watch reads
+    bool UsesPattern() const { return usesPattern; }
+    // Whether the observed pattern can change which rule this file matches, i.e. the first rule its path and access match has a
+    // pattern. Files where it can't don't need their history looked up or their reads watched
+    bool DependsOnPattern(const OpenInfo& file) const;
+
+  private:
+    std::vector<Rule> rules;
+    std::vector<std::atomic<uint64_t>> hits;
+    std::atomic<uint64_t> unmatched{0};
+    bool usesPattern = false;
+};
+
+// Watches one open file's reads. Sequential is a read starting exactly where the previous one ended, or the first read at 0
+// Not thread-safe, one per handle
+class ReadObserver {
+  public:
+    void OnRead(uint64_t offset, uint32_t size);
+    // Unknown until minReads reads, then Sequential/Random when at least 3/4 of them went that way
+    Pattern Classify(uint32_t minReads = 4) const;
+
+  private:
+    uint64_t lastEnd = 0;
+    uint32_t reads = 0;
+    uint32_t sequential = 0;
+};
+
+// How each file was read the last time it was closed, so the next open of it can be matched on that. Kept across sessions,
+// bounded so a game with a huge Mods folder doesn't grow it forever
+// Not thread-safe
+class PatternHistory {
+  public:
+    explicit PatternHistory(size_t maxEntries = 8192) : maxEntries(maxEntries) {}
+
+    // path NormalizePath'd. Recording Unknown leaves what was there, a file that's sometimes only opened isn't forgotten
+    // Any other record dirties the history, even when the pattern is unchanged it moves the file to the young end of the saved order
+    void Record(const std::string& path, Pattern pattern);
+    Pattern Lookup(const std::string& path) const;
+
+    size_t Size() const { return entries.size(); }
+    bool Dirty() const { return dirty; }
+
+    // Text file, one "s|r<TAB>path" per line after a header. Load replaces what's there and leaves it empty when the file is
+    // missing or isn't a history, Save goes through a temp file
+    bool Load(const std::filesystem::path& path);
+    bool Save(const std::filesystem::path& path);
+
+  private:
+    struct Entry {
+        Pattern pattern;
+        uint64_t lastUse;
+    };
+
+    size_t maxEntries;
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t tick = 0;
+    bool dirty = false;
+};
+
+} // namespace OpenFlagRules
@@ -0,0 +1,287 @@
+#include "prefetch.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
+namespace Prefetch {
+
+namespace {
+
+constexpr uint32_t PLAN_MAGIC = 0x46503353; // "S3PF"
+constexpr uint32_t PLAN_VERSION = 1;
+
+struct PlanHeader {
+    uint32_t magic = PLAN_MAGIC;
+    uint32_t version = PLAN_VERSION;
+    uint32_t fileCount = 0;
+    uint32_t rangeCount = 0;
+    uint64_t pathBytes = 0;
+};
+static_assert(sizeof(PlanHeader) == 24, "PlanHeader is part of the file format");
+
+struct PlanFileRecord {
+    uint64_t size;
+    int64_t mtime;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+static_assert(sizeof(PlanFileRecord) == 24, "PlanFileRecord is part of the file format");
+
+// Package paths only need ASCII folding, Windows treats the rest case-insensitively too but CC folders are ASCII in practice
+std::string LowerPath(const std::string& path) {
+    std::string lower = path;
+    for (char& c : lower) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        else if (c == '/') c = '\\';
+    }
+    return lower;
+}
+
+} // namespace
+
+Plan Plan::Build(const std::vector<std::string>& paths, const std::vector<ObservedRead>& reads, uint32_t gapBytes, uint32_t maxRangeBytes) {
+    Plan plan;
+    std::vector<int> planFile(paths.size(), -1);
+    std::vector<int64_t> lastRange; // Per plan file, the range a nearby read can still extend
+    std::unordered_set<uint64_t> covered;
+
+    auto blockKey = [](uint32_t file, uint64_t block) { return (static_cast<uint64_t>(file) << 40) | block; };
+
+    for (const ObservedRead& read : reads) {
+        if (read.path >= paths.size() || read.size == 0) continue;
+
+        int& file = planFile[read.path];
+        if (file < 0) {
+            file = plan.FindFile(paths[read.path]);
+            if (file < 0) {
+                file = static_cast<int>(plan.files.size());
+                plan.files.push_back({paths[read.path], 0, 0});
+                plan.fileIndex.emplace(LowerPath(paths[read.path]), static_cast<uint32_t>(file));
+                lastRange.push_back(-1);
+            }
+        }
+
+        // Trim blocks an earlier range already covers off both ends, a read entirely inside them adds nothing
+        uint64_t begin = read.offset;
+        uint64_t end = read.offset + read.size;
+        while (begin < end && covered.count(blockKey(file, begin >> BLOCK_SHIFT))) begin = ((begin >> BLOCK_SHIFT) + 1) << BLOCK_SHIFT;
+        while (end > begin && covered.count(blockKey(file, (end - 1) >> BLOCK_SHIFT))) end = ((end - 1) >> BLOCK_SHIFT) << BLOCK_SHIFT;
+        if (begin >= end) continue;
+
+        int64_t last = lastRange[file];
+        PlanRange* extend = last >= 0 ? &plan.ranges[last] : nullptr;
+        if (extend && begin >= extend->offset && begin <= extend->offset + extend->size + gapBytes && std::max<uint64_t>(end, extend->offset + extend->size) - extend->offset <= maxRangeBytes) {
+            extend->size = static_cast<uint32_t>(std::max<uint64_t>(end, extend->offset + extend->size) - extend->offset);
+        } else {
+            // Oversized reads are split so no single request ties up the disk for too long
+            for (uint64_t offset = begin; offset < end; offset += maxRangeBytes) {
+                uint32_t size = static_cast<uint32_t>(std::min<uint64_t>(maxRangeBytes, end - offset));
+                plan.ranges.push_back({static_cast<uint32_t>(file), size, offset});
+            }
+            lastRange[file] = static_cast<int64_t>(plan.ranges.size()) - 1;
+        }
+
+        for (uint64_t block = begin >> BLOCK_SHIFT; block <= (end - 1) >> BLOCK_SHIFT; block++) covered.insert(blockKey(file, block));
+    }
+    return plan;
+}
+
+uint64_t Plan::TotalBytes() const {
+    uint64_t total = 0;
+    for (const PlanRange& range : ranges) total += range.size;
+    return total;
+}
+
+void Plan::DisableFile(uint32_t file) {
+    std::erase_if(ranges, [file](const PlanRange& range) { return range.file == file; });
+}
+
+int Plan::FindFile(const std::string& path) const {
+    auto it = fileIndex.find(LowerPath(path));
+    return it != fileIndex.end() ? static_cast<int>(it->second) : -1;
+}
+
+bool Plan::Save(const std::filesystem::path& path) const {
+    std::string blob;
+    std::vector<PlanFileRecord> records;
+    records.reserve(files.size());
+    for (const PlanFile& file : files) {
+        records.push_back({file.size, file.mtime, static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(file.path.size())});
+        blob += file.path;
+    }
+
+    PlanHeader header;
+    header.fileCount = static_cast<uint32_t>(files.size());
+    header.rangeCount = static_cast<uint32_t>(ranges.size());
+    header.pathBytes = blob.size();
+
+    // Written next to the real file and swapped in, a crash mid-write leaves the old plan alone
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(PlanFileRecord));
+        out.write(reinterpret_cast<const char*>(ranges.data()), ranges.size() * sizeof(PlanRange));
+        out.write(blob.data(), blob.size());
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    return !ec;
+}
+
+bool Plan::Load(const std::filesystem::path& path) {
+    files.clear();
+    ranges.clear();
+    fileIndex.clear();
+
+    std::ifstream in(path, std::ios::binary);
+    PlanHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != PLAN_MAGIC || header.version != PLAN_VERSION) return false;
+    if (header.pathBytes > (64u << 20) || header.fileCount > (1u << 20) || header.rangeCount > (16u << 20)) return false;
+
+    std::vector<PlanFileRecord> records(header.fileCount);
+    ranges.resize(header.rangeCount);
+    std::string blob(header.pathBytes, '\0');
+    if (!in.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(PlanFileRecord)) || !in.read(reinterpret_cast<char*>(ranges.data()), ranges.size() * sizeof(PlanRange)) ||
+        !in.read(blob.data(), blob.size())) {
+        ranges.clear();
+        return false;
+    }
+
+    for (const PlanFileRecord& record : records) {
+        if (static_cast<uint64_t>(record.pathOffset) + record.pathLength > blob.size()) {
+            files.clear();
+            ranges.clear();
+            fileIndex.clear();
+            return false;
+        }
+        files.push_back({blob.substr(record.pathOffset, record.pathLength), record.size, record.mtime});
+        fileIndex.emplace(LowerPath(files.back().path), static_cast<uint32_t>(files.size() - 1));
+    }
+    std::erase_if(ranges, [this](const PlanRange& range) { return range.file >= files.size() || range.size == 0; });
+    return true;
+}
+
+void Scheduler::Start(const Plan& plan, const Config& newConfig) {
+    std::lock_guard<std::mutex> lock(mutex);
+    config = newConfig;
+    if (config.chunkBytes == 0) config.chunkBytes = 1 << 20;
+    if (config.maxInFlight == 0) config.maxInFlight = 1;
+
+    ranges = plan.Ranges();
+    rangeStart.assign(ranges.size() + 1, 0);
+    for (size_t i = 0; i < ranges.size(); i++) rangeStart[i + 1] = rangeStart[i] + ranges[i].size;
+    state.assign(ranges.size(), RangeState::Pending);
+    outstanding.assign(ranges.size(), 0);
+
+    // First range wins for a block, which is the earliest point in the load it was needed
+    blockToRange.clear();
+    blockToRange.reserve(rangeStart.back() >> Plan::BLOCK_SHIFT);
+    for (uint32_t i = 0; i < ranges.size(); i++) {
+        const PlanRange& range = ranges[i];
+        for (uint64_t block = range.offset >> Plan::BLOCK_SHIFT; block <= (range.offset + range.size - 1) >> Plan::BLOCK_SHIFT; block++) {
+            blockToRange.emplace((static_cast<uint64_t>(range.file) << 40) | block, i);
+        }
+    }
+
+    cursor = 0;
+    chunkOffset = 0;
+    position = 0;
+    inFlight = 0;
+    stats = {};
+    stats.rangeCount = static_cast<uint32_t>(ranges.size());
+}
+
+void Scheduler::OnGameRead(uint32_t file, uint64_t offset, uint32_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.gameReads++;
+
+    auto first = blockToRange.find(BlockKey(file, offset));
+    auto last = size ? blockToRange.find(BlockKey(file, offset + size - 1)) : blockToRange.end();
+    if (first == blockToRange.end() && last == blockToRange.end()) {
+        stats.gameOffPlan++;
+        // Reading these files but mostly not where the plan says means a different load (other world, changed CC), the reads would only get in the way
+        if (!stats.abandoned && config.abandonAfterReads && stats.gameReads >= config.abandonAfterReads && stats.gameOffPlan * 2 > stats.gameReads) stats.abandoned = true;
+        return;
+    }
+
+    uint32_t range = first != blockToRange.end() ? first->second : last->second;
+    switch (state[range]) {
+    case RangeState::Done: stats.gameHits++; break;
+    case RangeState::Issued: stats.gameInFlight++; break;
+    default: break;
+    }
+
+    // The game only ever moves the window forward, going back to something early in the plan (a package it already loaded) doesn't pull it back
+    uint32_t reached = std::max(range, last != blockToRange.end() ? last->second : range) + 1;
+    if (reached <= position) return;
+    position = reached;
+
+    // Anything the game got to first it is reading itself, prefetching it now would only compete with it
+    if (cursor < position) {
+        for (uint32_t i = cursor; i < position; i++) {
+            if (state[i] == RangeState::Pending) {
+                state[i] = RangeState::Skipped;
+                stats.skippedRanges++;
+            }
+        }
+        cursor = position;
+        chunkOffset = 0;
+    }
+}
+
+bool Scheduler::Next(Request& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (inFlight >= config.maxInFlight || stats.abandoned) return false;
+    while (cursor < ranges.size() && state[cursor] != RangeState::Pending && state[cursor] != RangeState::Issued) {
+        cursor++;
+        chunkOffset = 0;
+    }
+    if (cursor >= ranges.size()) return false;
+    if (rangeStart[cursor] + chunkOffset >= rangeStart[position] + config.lookaheadBytes) return false;
+
+    const PlanRange& range = ranges[cursor];
+    out.range = cursor;
+    out.file = range.file;
+    out.offset = range.offset + chunkOffset;
+    out.size = static_cast<uint32_t>(std::min<uint64_t>(config.chunkBytes, range.size - chunkOffset));
+
+    state[cursor] = RangeState::Issued;
+    outstanding[cursor]++;
+    inFlight++;
+    stats.issuedBytes += out.size;
+
+    chunkOffset += out.size;
+    if (chunkOffset >= range.size) {
+        cursor++;
+        chunkOffset = 0;
+    }
+    return true;
+}
+
+void Scheduler::Complete(const Request& request) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (request.range >= ranges.size()) return;
+    if (inFlight) inFlight--;
+    stats.completedBytes += request.size;
+    if (outstanding[request.range] && --outstanding[request.range] == 0 && request.range < cursor) state[request.range] = RangeState::Done;
+}
+
+bool Scheduler::Finished() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (cursor >= ranges.size() || stats.abandoned) && inFlight == 0;
+}
+
+Scheduler::Stats Scheduler::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.position = position;
+    result.cursor = cursor;
+    return result;
+}
+
+} // namespace Prefetch
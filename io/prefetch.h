@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Read-ahead for package loads: a plan (which byte ranges of which files a load read, in order) recorded on one launch,
+// and a scheduler that replays it ahead of the game on the next. Platform-neutral, the patch supplies the actual reads and
+// tools/prefetch_sim drives the same scheduler from recorded I/O traces against a simulated disk
+namespace Prefetch {
+
+// One read as the game issued it, path is an index into the recorder's own path table
+struct ObservedRead {
+    uint32_t path;
+    uint32_t size;
+    uint64_t offset;
+};
+
+struct PlanFile {
+    std::string path; // UTF-8, compared case-insensitively
+    uint64_t size = 0;
+    int64_t mtime = 0; // StatFile (mapped_file.h) units, 0 if unknown
+};
+
+struct PlanRange {
+    uint32_t file;
+    uint32_t size;
+    uint64_t offset;
+};
+static_assert(sizeof(PlanRange) == 16, "PlanRange is part of the file format");
+
+class Plan {
+  public:
+    static constexpr uint32_t BLOCK_SHIFT = 16; // Coverage granularity, 64 KB
+
+    // Ranges in first-touch order. Reads close together in a file are merged (gapBytes) up to maxRangeBytes,
+    // anything already covered by an earlier range is left out
+    static Plan Build(const std::vector<std::string>& paths, const std::vector<ObservedRead>& reads, uint32_t gapBytes = 64 << 10, uint32_t maxRangeBytes = 4 << 20);
+
+    bool Load(const std::filesystem::path& path);
+    bool Save(const std::filesystem::path& path) const;
+
+    std::vector<PlanFile>& Files() { return files; }
+    const std::vector<PlanFile>& Files() const { return files; }
+    const std::vector<PlanRange>& Ranges() const { return ranges; }
+    uint64_t TotalBytes() const;
+
+    // Drops every range of a file (e.g. it changed on disk since the plan was recorded)
+    void DisableFile(uint32_t file);
+
+    // Plan file index for a path, -1 if it isn't in the plan
+    int FindFile(const std::string& path) const;
+
+  private:
+    std::vector<PlanFile> files;
+    std::vector<PlanRange> ranges;
+    std::unordered_map<std::string, uint32_t> fileIndex; // Lowercased path
+};
+
+// Decides which plan range to read next. The game's own reads move a cursor through the plan so prefetching stays a
+// bounded distance ahead of it, skips whatever the game has already overtaken, and keeps going (within the window) when
+// the game wanders off-plan. Thread-safe: the game threads report reads while the prefetch thread pulls requests
+class Scheduler {
+  public:
+    struct Config {
+        uint64_t lookaheadBytes = 64ull << 20; // How far ahead of the game's position in the plan to read
+        uint32_t chunkBytes = 1 << 20;         // Ranges are split into requests of at most this
+        uint32_t maxInFlight = 4;
+        uint32_t abandonAfterReads = 256; // Once the game has made this many reads on plan files, give up if most weren't in the plan
+    };
+
+    struct Request {
+        uint32_t range;
+        uint32_t file;
+        uint64_t offset;
+        uint32_t size;
+    };
+
+    struct Stats {
+        uint64_t issuedBytes = 0;
+        uint64_t completedBytes = 0;
+        uint64_t skippedRanges = 0; // The game got to them first
+        uint64_t gameReads = 0;     // Game reads on plan files
+        uint64_t gameHits = 0;      // ...whose range had already been prefetched
+        uint64_t gameInFlight = 0;  // ...whose range was still being prefetched
+        uint64_t gameOffPlan = 0;   // ...that weren't in the plan at all
+        uint32_t position = 0;      // Plan range the game is at
+        uint32_t cursor = 0;        // Next plan range to prefetch
+        uint32_t rangeCount = 0;
+        bool abandoned = false;     // This load doesn't look like the recorded one, prefetching stopped
+    };
+
+    void Start(const Plan& plan, const Config& config);
+
+    // The game read [offset, offset + size) of plan file `file`
+    void OnGameRead(uint32_t file, uint64_t offset, uint32_t size);
+
+    // Next request to issue, false if the window is full or the plan is done
+    bool Next(Request& out);
+    void Complete(const Request& request);
+
+    bool Finished() const;
+    Stats GetStats() const;
+
+  private:
+    enum class RangeState : uint8_t { Pending, Issued, Done, Skipped };
+
+    static uint64_t BlockKey(uint32_t file, uint64_t offset) { return (static_cast<uint64_t>(file) << 40) | (offset >> Plan::BLOCK_SHIFT); }
+
+    mutable std::mutex mutex;
+    Config config;
+    std::vector<PlanRange> ranges;
+    std::vector<uint64_t> rangeStart; // Prefix sum of range sizes, rangeStart[i] = bytes before range i
+    std::vector<RangeState> state;
+    std::vector<uint32_t> outstanding; // Chunks of each range still in flight
+    std::unordered_map<uint64_t, uint32_t> blockToRange;
+    uint32_t cursor = 0;      // Next range to issue from
+    uint64_t chunkOffset = 0; // Progress within ranges[cursor]
+    uint32_t position = 0;    // One past the furthest range the game has touched
+    uint32_t inFlight = 0;
+    Stats stats;
+};
+
+} // namespace Prefetch
@@ -0,0 +1,112 @@
+#include "read_coalescer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ReadCoalescing {
+
+bool MemoryBudget::TryTake(uint64_t bytes) {
+    uint64_t used = inUse.load(std::memory_order_relaxed);
+    do {
+        if (used + bytes > limit) return false;
+    } while (!inUse.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+    return true;
+}
+
+HandleCache::HandleCache(const Config& newConfig, MemoryBudget* budget) : config(newConfig), budget(budget) {
+    // A read that passes the size check has to fit in one fill wherever it starts inside an alignment unit
+    config.alignment = std::max<uint32_t>(config.alignment, 1);
+    config.blockSize = std::max(config.blockSize, config.alignment * 2);
+    config.maxReadSize = std::min(config.maxReadSize, config.blockSize - config.alignment);
+    config.maxBlocks = std::max<uint32_t>(config.maxBlocks, 1);
+    blocks.reserve(config.maxBlocks);
+}
+
+HandleCache::~HandleCache() {
+    InvalidateAll();
+}
+
+HandleCache::Block* HandleCache::Find(uint64_t offset, uint32_t size) {
+    for (Block& block : blocks) {
+        if (offset < block.start) continue;
+        if (offset + size <= block.start + block.valid) return &block;
+        // Past the end of a block that hit end of file is a short or empty read, same as the real call would give
+        if (block.valid < config.blockSize && offset < block.start + config.blockSize) return &block;
+    }
+    return nullptr;
+}
+
+// Free slot if the handle is under its block count and the budget allows, otherwise the least recently used block is reused
+HandleCache::Block* HandleCache::Acquire() {
+    if (blocks.size() < config.maxBlocks && (!budget || budget->TryTake(config.blockSize))) {
+        Block& block = blocks.emplace_back();
+        block.data = std::make_unique<uint8_t[]>(config.blockSize);
+        return &block;
+    }
+    if (blocks.empty()) return nullptr;
+    return &*std::min_element(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) { return a.lastUse < b.lastUse; });
+}
+
+void HandleCache::Drop(size_t index) {
+    if (budget) budget->Give(config.blockSize);
+    blocks.erase(blocks.begin() + index);
+}
+
+Result HandleCache::Read(Backend& backend, uint64_t offset, void* buffer, uint32_t size, uint32_t& transferred) {
+    bool adjacent = haveLast && offset >= lastEnd && offset - lastEnd <= config.adjacencyGap;
+
+    // Anything else is a seek, blocks the new position isn't in are unlikely to be read again soon so their memory goes back
+    if (!adjacent) {
+        for (size_t i = blocks.size(); i-- > 0;) {
+            if (offset < blocks[i].start || offset >= blocks[i].start + config.blockSize) Drop(i);
+        }
+    }
+    haveLast = true;
+    lastEnd = offset + size;
+    if (size == 0 || size > config.maxReadSize) return Result::PassThrough;
+
+    if (Block* block = Find(offset, size)) {
+        uint64_t end = block->start + block->valid;
+        transferred = offset < end ? static_cast<uint32_t>(std::min<uint64_t>(size, end - offset)) : 0;
+        if (transferred) memcpy(buffer, block->data.get() + (offset - block->start), transferred);
+        block->lastUse = ++tick;
+        lastEnd = offset + transferred;
+        return Result::Served;
+    }
+
+    // The first small read after a seek goes through on its own, a single read on its own isn't worth a whole block
+    if (!adjacent) return Result::PassThrough;
+
+    Block* block = Acquire();
+    if (!block) return Result::PassThrough;
+
+    uint64_t start = offset - (offset % config.alignment);
+    uint32_t got = 0;
+    if (!backend.ReadAt(start, block->data.get(), config.blockSize, got)) {
+        Drop(static_cast<size_t>(block - blocks.data()));
+        return Result::PassThrough;
+    }
+    block->start = start;
+    block->valid = got;
+    block->lastUse = ++tick;
+
+    uint64_t end = start + got;
+    transferred = offset < end ? static_cast<uint32_t>(std::min<uint64_t>(size, end - offset)) : 0;
+    if (transferred) memcpy(buffer, block->data.get() + (offset - start), transferred);
+    lastEnd = offset + transferred;
+    return Result::Filled;
+}
+
+void HandleCache::Invalidate(uint64_t offset, uint64_t size) {
+    for (size_t i = blocks.size(); i-- > 0;) {
+        const Block& block = blocks[i];
+        uint64_t blockEnd = block.valid < config.blockSize ? UINT64_MAX : block.start + config.blockSize;
+        if (offset < blockEnd && offset + size > block.start) Drop(i);
+    }
+}
+
+void HandleCache::InvalidateAll() {
+    for (size_t i = blocks.size(); i-- > 0;) Drop(i);
+    haveLast = false;
+}
+
+} // namespace ReadCoalescing
@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Small-read coalescing for one file handle. The game reads packages in lots of small adjacent pieces (resource header, then
+// body, then the next resource), each its own ReadFile. Once two reads in a row are adjacent the next small one fetches a whole
+// aligned block instead, and the ones after it are copied out of that block without a syscall
+// Platform-neutral, the patch backs it with FileHooks::ReadAt and tools/read_coalesce_sim with a fake in-memory file
+namespace ReadCoalescing {
+
+// Where block fills come from
+class Backend {
+  public:
+    virtual ~Backend() = default;
+
+    // Positional read, only short at end of file. false on error
+    virtual bool ReadAt(uint64_t offset, void* buffer, uint32_t size, uint32_t& transferred) = 0;
+};
+
+// Block memory shared by every handle, a handle that can't get any just passes its reads through
+class MemoryBudget {
+  public:
+    explicit MemoryBudget(uint64_t limit) : limit(limit) {}
+
+    bool TryTake(uint64_t bytes);
+    void Give(uint64_t bytes) { inUse.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    uint64_t InUse() const { return inUse.load(std::memory_order_relaxed); }
+    uint64_t Limit() const { return limit; }
+
+  private:
+    const uint64_t limit;
+    std::atomic<uint64_t> inUse{0};
+};
+
+struct Config {
+    uint32_t blockSize = 64 << 10;   // Bytes fetched per fill
+    uint32_t maxReadSize = 16 << 10; // Bigger reads go straight through, they don't gain anything
+    uint32_t alignment = 4096;       // Fills start on this boundary
+    uint32_t maxBlocks = 2;          // Per handle, so one handle never holds more than maxBlocks * blockSize
+    uint32_t adjacencyGap = 4096;    // A read starting at most this far past the end of the previous one continues the run
+};
+
+enum class Result {
+    Served,      // Copied out of a block, no syscall
+    Filled,      // One block fetched, the read was served from it
+    PassThrough, // Caller does the real read
+};
+
+// Not thread-safe, one per handle and the caller serializes (reads on one synchronous handle are serialized by its file pointer anyway)
+class HandleCache {
+  public:
+    explicit HandleCache(const Config& config, MemoryBudget* budget = nullptr);
+    ~HandleCache();
+    HandleCache(const HandleCache&) = delete;
+    HandleCache& operator=(const HandleCache&) = delete;
+
+    // Tries to satisfy [offset, offset + size). transferred is only set for Served/Filled, short reads happen exactly where the file ends
+    Result Read(Backend& backend, uint64_t offset, void* buffer, uint32_t size, uint32_t& transferred);
+
+    // A write to [offset, offset + size) through any handle on the same file. Drops every block it could have touched,
+    // including a block that ended at the old end of file when the write lands past it
+    void Invalidate(uint64_t offset, uint64_t size);
+    void InvalidateAll();
+
+    uint64_t MemoryBytes() const { return blocks.size() * static_cast<uint64_t>(config.blockSize); }
+
+  private:
+    struct Block {
+        uint64_t start = 0;
+        uint32_t valid = 0; // Less than blockSize means the file ended there when it was filled
+        uint64_t lastUse = 0;
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    Block* Find(uint64_t offset, uint32_t size);
+    Block* Acquire();
+    void Drop(size_t index);
+
+    Config config;
+    MemoryBudget* budget;
+    std::vector<Block> blocks;
+    uint64_t lastEnd = 0;
+    bool haveLast = false;
+    uint64_t tick = 0;
+};
+
+} // namespace ReadCoalescing
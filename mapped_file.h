@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+// Read-only mapping of a whole file. Win32 inside the DLL, POSIX so the offline tools can use the same code on Linux
+// Mind the address space: every open MappedFile costs its full size in the game's 32-bit process
+class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Maps the file, false if it's missing, empty or can't be mapped
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    bool IsOpen() const { return data != nullptr; }
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+  private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+// A file opened for mapping without keeping a view of it. Copy maps just the range asked for and unmaps it again, so a big file costs
+// no address space between reads, and with no shared file position any number of threads can Copy at once without a lock
+class FileMapping {
+  public:
+    FileMapping() = default;
+    ~FileMapping() { Close(); }
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    // false if it's missing, empty or can't be mapped
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    bool IsOpen() const { return size != 0; }
+    uint64_t Size() const { return size; }
+
+    // [offset, offset + count) into destination. false if it's past the end, the view couldn't be mapped or reading it failed
+    // (an I/O error while touching a view is an in-page exception on Windows, caught here)
+    bool Copy(uint64_t offset, void* destination, size_t count) const;
+
+  private:
+    uint64_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// Size + last write time in one call (GetFileAttributesExW / stat), without opening the file. mtime is in the platform's native units, only compare it for equality
+bool StatFile(const std::filesystem::path& path, uint64_t& size, int64_t& mtime);
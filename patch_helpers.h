@@ -6,13 +6,21 @@
 #include <vector>
 #include <array>
 #include <cstring>
+#include <algorithm>
+#include <mutex>
 #include <variant>
 #include <optional>
 #include <fstream>
+#include <format>
 #include "logger.h"
 #include "settings.h"
 #include "utils.h"
 #include "patch_system.h" // For GameVersion, g_gameVersion, GAME_VERSION_COUNT
+#include "scan/signature.h"
+#include "scan/pattern_literal.h"
+#include "scan/pe_image.h"
+#include "pattern_scan.h"
+#include "config/config_paths.h"
 
 // Forward declarations for ImGui
 struct ImGuiContext;
@@ -35,49 +43,152 @@ struct PatchLocation {
 // Global mutex for thread-safe patch location tracking
 inline std::mutex g_patchLocationMutex;
 
-// Safely change memory protection and write data
-inline bool WriteProtectedMemory(LPVOID address, LPCVOID data, SIZE_T size, std::vector<PatchLocation>* tracker = nullptr) {
-    // Validate memory is accessible before attempting to patch
-    MEMORY_BASIC_INFORMATION mbi;
-    if (VirtualQuery(address, &mbi, sizeof(mbi)) == 0) {
-        LOG_ERROR("VirtualQuery failed for address 0x" + std::to_string(reinterpret_cast<uintptr_t>(address)));
-        return false;
+inline uintptr_t PageSize() {
+    static const uintptr_t size = [] {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return static_cast<uintptr_t>(info.dwPageSize);
+    }();
+    return size;
+}
+
+// Writes queued up and applied together. Protection is changed once per run of pages that share it instead of twice per write, skipped
+// for pages that are already writable (.data), and the instruction cache is flushed once at the end. Writes land in the order they were
+// added, so overlapping ones end up the same as separate calls would
+class WriteBatch {
+  public:
+    void Add(uintptr_t address, LPCVOID data, SIZE_T size) {
+        const BYTE* bytes = static_cast<const BYTE*>(data);
+        writes.push_back({address, std::vector<BYTE>(bytes, bytes + size)});
+    }
+    bool Empty() const { return writes.empty(); }
+    size_t Size() const { return writes.size(); }
+    void Clear() { writes.clear(); }
+
+    // Nothing is written unless every page is committed and can be made writable. Original bytes go to tracker in the order written
+    bool Apply(std::vector<PatchLocation>* tracker = nullptr);
+
+  private:
+    struct Write {
+        uintptr_t address;
+        std::vector<BYTE> bytes;
+    };
+    std::vector<Write> writes;
+};
+
+inline bool WriteBatch::Apply(std::vector<PatchLocation>* tracker) {
+    if (writes.empty()) return true;
+
+    // Pages each write touches, sorted and merged into runs
+    const uintptr_t page = PageSize();
+    std::vector<std::pair<uintptr_t, uintptr_t>> runs;
+    for (const auto& write : writes) {
+        if (!write.bytes.empty()) runs.push_back({write.address & ~(page - 1), (write.address + write.bytes.size() + page - 1) & ~(page - 1)});
+    }
+    if (runs.empty()) return true;
+    std::sort(runs.begin(), runs.end());
+    size_t merged = 0;
+    for (size_t i = 1; i < runs.size(); i++) {
+        if (runs[i].first <= runs[merged].second) runs[merged].second = std::max(runs[merged].second, runs[i].second);
+        else runs[++merged] = runs[i];
+    }
+    runs.resize(merged + 1);
+
+    // VirtualQuery hands back the whole stretch of pages with the same protection, so a run only splits where that changes
+    struct Region {
+        uintptr_t begin;
+        uintptr_t end;
+        DWORD protect;
+        bool changed;
+    };
+    std::vector<Region> regions;
+    for (const auto& [begin, end] : runs) {
+        for (uintptr_t at = begin; at < end;) {
+            MEMORY_BASIC_INFORMATION mbi;
+            if (VirtualQuery(reinterpret_cast<LPCVOID>(at), &mbi, sizeof(mbi)) == 0) {
+                LOG_ERROR(std::format("VirtualQuery failed for address {:#010x}", at));
+                return false;
+            }
+            if (mbi.State != MEM_COMMIT) {
+                LOG_ERROR(std::format("Memory at {:#010x} is not committed (State: {:#x})", at, mbi.State));
+                return false;
+            }
+            const uintptr_t regionEnd = std::min<uintptr_t>(end, reinterpret_cast<uintptr_t>(mbi.BaseAddress) + mbi.RegionSize);
+            regions.push_back({at, regionEnd, mbi.Protect, false});
+            at = regionEnd;
+        }
     }
 
-    if (mbi.State != MEM_COMMIT) {
-        LOG_ERROR("Memory at 0x" + std::to_string(reinterpret_cast<uintptr_t>(address)) + " is not committed (State: " + std::to_string(mbi.State) + ")");
-        return false;
+    auto restoreProtection = [&] {
+        for (const auto& region : regions) {
+            DWORD oldProtect;
+            if (region.changed) VirtualProtect(reinterpret_cast<LPVOID>(region.begin), region.end - region.begin, region.protect, &oldProtect);
+        }
+    };
+    constexpr DWORD WRITABLE_PROTECTIONS = PAGE_READWRITE | PAGE_EXECUTE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_WRITECOPY;
+    for (auto& region : regions) {
+        if (region.protect & WRITABLE_PROTECTIONS) continue;
+        DWORD oldProtect;
+        if (!VirtualProtect(reinterpret_cast<LPVOID>(region.begin), region.end - region.begin, PAGE_EXECUTE_READWRITE, &oldProtect)) {
+            LOG_ERROR(std::format("Failed to change memory protection at {:#010x}", region.begin));
+            restoreProtection();
+            return false;
+        }
+        region.changed = true;
     }
 
-    // Store original bytes if tracking is enabled
-    if (tracker) {
-        PatchLocation loc;
-        loc.address = reinterpret_cast<uintptr_t>(address);
-        loc.size = size;
-        loc.originalBytes.resize(size);
-        std::memcpy(loc.originalBytes.data(), address, size);
+    // Originals are read right before each write, so a write over an earlier one in the batch keeps what that one wrote and restoring in reverse works
+    std::vector<PatchLocation> originals;
+    originals.reserve(writes.size());
+    for (const auto& write : writes) {
+        BYTE* target = reinterpret_cast<BYTE*>(write.address);
+        originals.push_back({write.address, std::vector<BYTE>(target, target + write.bytes.size()), write.bytes.size()});
+        std::memcpy(target, write.bytes.data(), write.bytes.size());
+    }
 
+    restoreProtection();
+    FlushInstructionCache(GetCurrentProcess(), reinterpret_cast<LPCVOID>(runs.front().first), runs.back().second - runs.front().first);
+
+    if (tracker) {
         // Thread-safe!!
         std::lock_guard<std::mutex> lock(g_patchLocationMutex);
-        tracker->push_back(loc);
-    }
-
-    DWORD oldProtect;
-    if (!VirtualProtect(address, size, PAGE_EXECUTE_READWRITE, &oldProtect)) {
-        LOG_ERROR("Failed to change memory protection at 0x" + std::to_string(reinterpret_cast<uintptr_t>(address)));
-        return false;
+        tracker->insert(tracker->end(), originals.begin(), originals.end());
+    }
+
+    // Verify writes, skipping any a later write in the batch overlaps
+    bool verified = true;
+    for (size_t i = 0; i < writes.size(); i++) {
+        const uintptr_t begin = writes[i].address, end = begin + writes[i].bytes.size();
+        bool overwritten = false;
+        for (size_t j = i + 1; j < writes.size() && !overwritten; j++) overwritten = writes[j].address < end && begin < writes[j].address + writes[j].bytes.size();
+        if (!overwritten && std::memcmp(reinterpret_cast<const void*>(begin), writes[i].bytes.data(), writes[i].bytes.size()) != 0) {
+            LOG_ERROR(std::format("Failed to verify memory write at {:#010x}", begin));
+            verified = false;
+        }
     }
+    return verified;
+}
 
-    std::memcpy(address, data, size);
-
-    VirtualProtect(address, size, oldProtect, &oldProtect);
+// Multi-patch transaction: all-or-nothing helper
+// Writes given the transaction are queued and land together in CommitTransaction as one WriteBatch, so a patch with a dozen writes changes
+// protection a couple of times instead of two dozen. Expected bytes are still checked when a write is queued
+// Usage: auto tx = BeginTransaction(); WriteByte(..., tx); ... if (!ok || !CommitTransaction(tx)) RollbackTransaction(tx); patchedLocations = tx.locations;
+struct PatchTransaction {
+    std::vector<PatchLocation> locations; // Original bytes, filled in by CommitTransaction
+    WriteBatch pending;
+    bool committed = false;
+};
 
-    // Verify write
-    if (std::memcmp(address, data, size) != 0) {
-        LOG_ERROR("Failed to verify memory write at 0x" + std::to_string(reinterpret_cast<uintptr_t>(address)));
-        return false;
-    }
+// Safely change memory protection and write data
+inline bool WriteProtectedMemory(LPVOID address, LPCVOID data, SIZE_T size, std::vector<PatchLocation>* tracker = nullptr) {
+    WriteBatch batch;
+    batch.Add(reinterpret_cast<uintptr_t>(address), data, size);
+    return batch.Apply(tracker);
+}
 
+// Queue it in the transaction instead, written on commit
+inline bool WriteProtectedMemory(LPVOID address, LPCVOID data, SIZE_T size, PatchTransaction& tx) {
+    tx.pending.Add(reinterpret_cast<uintptr_t>(address), data, size);
     return true;
 }
 
@@ -130,6 +241,14 @@ inline bool WriteByte(uintptr_t address, BYTE value, std::vector<PatchLocation>*
     return WriteProtectedMemory((LPVOID)address, &value, 1, tracker);
 }
 
+inline bool WriteByte(uintptr_t address, BYTE value, PatchTransaction& tx, BYTE* expectedOld = nullptr) {
+    if (expectedOld && !ValidateBytes((LPVOID)address, expectedOld, 1)) {
+        LOG_ERROR("Byte validation failed at 0x" + std::to_string(address));
+        return false;
+    }
+    return WriteProtectedMemory((LPVOID)address, &value, 1, tx);
+}
+
 // Write multiple bytes
 inline bool WriteBytes(uintptr_t address, const std::vector<BYTE>& bytes, std::vector<PatchLocation>* tracker = nullptr, const std::vector<BYTE>* expectedOld = nullptr) {
     if (expectedOld && !ValidateBytes((LPVOID)address, expectedOld->data(), expectedOld->size())) {
@@ -139,6 +258,14 @@ inline bool WriteBytes(uintptr_t address, const std::vector<BYTE>& bytes, std::v
     return WriteProtectedMemory((LPVOID)address, bytes.data(), bytes.size(), tracker);
 }
 
+inline bool WriteBytes(uintptr_t address, const std::vector<BYTE>& bytes, PatchTransaction& tx, const std::vector<BYTE>* expectedOld = nullptr) {
+    if (expectedOld && !ValidateBytes((LPVOID)address, expectedOld->data(), expectedOld->size())) {
+        LOG_ERROR("Bytes validation failed at 0x" + std::to_string(address));
+        return false;
+    }
+    return WriteProtectedMemory((LPVOID)address, bytes.data(), bytes.size(), tx);
+}
+
 // Write a DWORD (4 bytes)
 inline bool WriteDWORD(uintptr_t address, DWORD value, std::vector<PatchLocation>* tracker = nullptr, DWORD* expectedOld = nullptr) {
     if (expectedOld && !ValidateBytes((LPVOID)address, expectedOld, sizeof(DWORD))) {
@@ -148,6 +275,14 @@ inline bool WriteDWORD(uintptr_t address, DWORD value, std::vector<PatchLocation
     return WriteProtectedMemory((LPVOID)address, &value, sizeof(DWORD), tracker);
 }
 
+inline bool WriteDWORD(uintptr_t address, DWORD value, PatchTransaction& tx, DWORD* expectedOld = nullptr) {
+    if (expectedOld && !ValidateBytes((LPVOID)address, expectedOld, sizeof(DWORD))) {
+        LOG_ERROR("DWORD validation failed at 0x" + std::to_string(address));
+        return false;
+    }
+    return WriteProtectedMemory((LPVOID)address, &value, sizeof(DWORD), tx);
+}
+
 // Write a WORD (2 bytes)
 inline bool WriteWORD(uintptr_t address, WORD value, std::vector<PatchLocation>* tracker = nullptr, WORD* expectedOld = nullptr) {
     if (expectedOld && !ValidateBytes((LPVOID)address, expectedOld, sizeof(WORD))) {
@@ -157,20 +292,44 @@ inline bool WriteWORD(uintptr_t address, WORD value, std::vector<PatchLocation>*
     return WriteProtectedMemory((LPVOID)address, &value, sizeof(WORD), tracker);
 }
 
+inline bool WriteWORD(uintptr_t address, WORD value, PatchTransaction& tx, WORD* expectedOld = nullptr) {
+    if (expectedOld && !ValidateBytes((LPVOID)address, expectedOld, sizeof(WORD))) {
+        LOG_ERROR("WORD validation failed at 0x" + std::to_string(address));
+        return false;
+    }
+    return WriteProtectedMemory((LPVOID)address, &value, sizeof(WORD), tx);
+}
+
 // NOP out bytes (replace with 0x90)
 inline bool WriteNOP(uintptr_t address, size_t count, std::vector<PatchLocation>* tracker = nullptr) {
     std::vector<BYTE> nops(count, 0x90);
     return WriteProtectedMemory((LPVOID)address, nops.data(), count, tracker);
 }
 
+inline bool WriteNOP(uintptr_t address, size_t count, PatchTransaction& tx) {
+    std::vector<BYTE> nops(count, 0x90);
+    return WriteProtectedMemory((LPVOID)address, nops.data(), count, tx);
+}
+
 // Restore all patched locations (thread-safe)
 inline bool RestoreAll(std::vector<PatchLocation>& locations) {
     std::lock_guard<std::mutex> lock(g_patchLocationMutex);
+    if (locations.empty()) return true;
+
+    // Newest first so overlapping patches unwind properly, all in one batch
+    WriteBatch batch;
+    for (auto it = locations.rbegin(); it != locations.rend(); ++it) batch.Add(it->address, it->originalBytes.data(), it->size);
+    if (batch.Apply()) {
+        locations.clear();
+        return true;
+    }
 
+    // One bad location shouldn't keep the rest patched, so go one at a time like before batching. Restoring one the batch already wrote is harmless
+    LOG_WARNING(std::format("Batched restore of {} patched location(s) failed, restoring one at a time", locations.size()));
     bool success = true;
     for (auto it = locations.rbegin(); it != locations.rend(); ++it) {
         if (!WriteProtectedMemory((LPVOID)it->address, it->originalBytes.data(), it->size, nullptr)) {
-            LOG_ERROR("Failed to restore patch at 0x" + std::to_string(it->address));
+            LOG_ERROR(std::format("Failed to restore patch at {:#010x}", it->address));
             success = false;
         }
     }
@@ -193,79 +352,40 @@ inline bool GetModuleInfo(HMODULE hModule, BYTE** baseAddr, size_t* imageSize) {
 // String-based pattern scanning with nibble-level wildcards, can you believe ts is called a nibble?
 // Supports: "FF" (exact), "??" (full wildcard), "?F" (match low nibble), "F?" (match high nibble) yum!
 // e.g. "0F 82 ?? ?? ?0 8B"  -> matches 0F 82 <any> <any> <any ending in 0> 8B
+// Compiles the pattern and hands it to Signature::Find (SIMD anchor search), compile once yourself if you're scanning in a loop
 inline uintptr_t ScanPattern(BYTE* start, size_t size, const char* pattern) {
-    std::vector<BYTE> bytes;
-    std::vector<BYTE> masks; // Per-byte mask, 0xFF = exact, 0xF0 = high nibble, 0x0F = low nibble, 0x00 = wildcard
-
-    // Helper to parse a single hex nibble
-    auto parseNibble = [](char c) -> BYTE {
-        if (c >= '0' && c <= '9') return c - '0';
-        if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
-        if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
+    Signature::Compiled compiled;
+    std::string error;
+    if (!Signature::Compile(pattern, compiled, &error)) {
+        LOG_ERROR("ScanPattern: " + error);
         return 0;
-    };
-
-    const char* p = pattern;
-    while (*p) {
-        // Skip whitespace
-        while (*p == ' ') p++;
-        if (!*p) break;
-
-        char hiChar = *p;
-        char loChar = *(p + 1);
-
-        // Need two characters for a byte
-        if (!loChar || loChar == ' ') {
-            LOG_ERROR("ScanPattern: Invalid pattern format (incomplete byte) at: " + std::string(p));
-            return 0;
-        }
-
-        bool hiWild = (hiChar == '?');
-        bool loWild = (loChar == '?');
-        bool hiHex = isxdigit(hiChar);
-        bool loHex = isxdigit(loChar);
-
-        // Validate each nibby must be hex or wildcard
-        if ((!hiWild && !hiHex) || (!loWild && !loHex)) {
-            LOG_ERROR("ScanPattern: Invalid pattern format at: " + std::string(p));
-            return 0;
-        }
-
-        // Build the byte and mask
-        BYTE byteVal = 0;
-        BYTE maskVal = 0;
-
-        if (hiHex) {
-            byteVal |= (parseNibble(hiChar) << 4);
-            maskVal |= 0xF0;
-        }
-        if (loHex) {
-            byteVal |= parseNibble(loChar);
-            maskVal |= 0x0F;
-        }
-
-        bytes.push_back(byteVal);
-        masks.push_back(maskVal);
-        p += 2;
     }
+    return reinterpret_cast<uintptr_t>(Signature::Find(start, start + size, compiled));
+}
 
-    if (bytes.empty()) {
-        LOG_ERROR("ScanPattern: Empty pattern");
-        return 0;
-    }
+// Same with a pattern compiled at build time (static constexpr Signature::PatternLiteral), typos don't build and there's nothing to parse
+inline uintptr_t ScanPattern(BYTE* start, size_t size, const Signature::PatternLiteral& pattern) {
+    return reinterpret_cast<uintptr_t>(Signature::Find(start, start + size, pattern));
+}
 
-    // Perform the scan with mask comparison
-    for (size_t i = 0; i <= size - bytes.size(); i++) {
-        bool found = true;
-        for (size_t j = 0; j < bytes.size(); j++) {
-            if ((start[i + j] & masks[j]) != (bytes[j] & masks[j])) {
-                found = false;
-                break;
-            }
-        }
-        if (found) { return reinterpret_cast<uintptr_t>(start + i); }
+// Every match in one walk (Signature::ForEachMatch), for patches that hit all the copies of a pattern instead of looping ScanPattern
+// Overlapping matches are all in there, in address order
+inline std::vector<uintptr_t> ScanPatternAll(BYTE* start, size_t size, const Signature::PatternLiteral& pattern) {
+    std::vector<uintptr_t> matches;
+    Signature::ForEachMatch(start, start + size, pattern, [&](const uint8_t* at) { matches.push_back(reinterpret_cast<uintptr_t>(at)); });
+    return matches;
+}
+
+inline std::vector<uintptr_t> ScanPatternAll(BYTE* start, size_t size, const char* pattern) {
+    Signature::Compiled compiled;
+    std::string error;
+    if (!Signature::Compile(pattern, compiled, &error)) {
+        LOG_ERROR("ScanPatternAll: " + error);
+        return {};
     }
-    return 0;
+    std::vector<uintptr_t> matches;
+    Signature::ForEachMatch(start, start + size, compiled, [&](const uint8_t* at) { matches.push_back(reinterpret_cast<uintptr_t>(at)); });
+    return matches;
 }
 
 } // namespace PatchHelper
@@ -281,11 +401,65 @@ struct AddressInfo {
         uintptr_t address;
     };
 
+    // Every AddressInfo lists itself in Registry() so PrefetchAll can find them, they only live as static patch members
+    struct Registration {
+        const AddressInfo* owner;
+        explicit Registration(const AddressInfo* info) : owner(info) { Registry().push_back(info); }
+        Registration(const Registration&) = delete;
+        Registration& operator=(const Registration&) = delete;
+        ~Registration() { std::erase(Registry(), owner); }
+    };
+
     const char* name;                        // For logging
     std::vector<VersionAddress> addresses;   // Explicit version → address mapping
-    const char* pattern = nullptr;           // Pattern scan string (nullptr = no pattern)
+    Signature::PatternLiteral pattern = {};  // Pattern scan string, compiled at build time (left out = no pattern)
     int patternOffset = 0;                   // Offset to add to pattern match
     std::vector<uint8_t> expectedBytes = {}; // Bytes to validate (empty = skip)
+    Registration registration{this};         // Leave out of initializers
+
+    static std::vector<const AddressInfo*>& Registry() {
+        static std::vector<const AddressInfo*> registry;
+        return registry;
+    }
+
+    // Whether Resolve will end up scanning for the pattern on this version
+    bool NeedsScan() const { return !pattern.Empty() && (g_gameVersion == GameVersion::Unknown || GetAddressForVersion(g_gameVersion) == 0); }
+
+    // Finds the pattern of every AddressInfo that needs one (plus extraPatterns, signatures scanned outside AddressInfo) in one pass
+    // Resolve and Pattern::Scan then answer from those results instead of walking the image once per pattern
+    // Call once the version is known and patches are registered
+    static void PrefetchAll(const std::vector<const Signature::PatternLiteral*>& extraPatterns = {}) {
+        std::vector<const AddressInfo*> scanned;
+        std::vector<const Signature::PatternLiteral*> patterns = extraPatterns;
+        for (const AddressInfo* info : Registry()) {
+            if (!info->NeedsScan()) continue;
+            scanned.push_back(info);
+            patterns.push_back(&info->pattern);
+        }
+        if (patterns.empty()) return;
+
+        // Results are kept per exe in the S3SS folder, so a relaunch (most useful on unknown versions) only compares bytes
+        std::string cachePath;
+        if (!ConfigPaths::GetS3SSDirectory().empty()) cachePath = Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory()) + "address_cache.bin";
+
+        HMODULE hModule = GetModuleHandleW(nullptr);
+        Pattern::PrefetchStats stats = Pattern::Prefetch(hModule, patterns, cachePath);
+
+        size_t missing = 0, ambiguous = 0;
+        for (const AddressInfo* info : scanned) {
+            Pattern::Prefetched result;
+            if (!Pattern::GetPrefetched(hModule, info->pattern.text, result)) continue;
+            if (result.count == 0) {
+                missing++;
+                LOG_WARNING(std::format("[{}] Pattern not found in the executable sections", info->name));
+            } else if (result.count > 1) {
+                ambiguous++;
+                LOG_WARNING(std::format("[{}] Pattern matches {} places, the first at {:#010x} will be used", info->name, result.count, result.first));
+            }
+        }
+        LOG_INFO(std::format("[AddressInfo] Prefetched {} patterns ({} from AddressInfo, {} cached, {} scanned) in {:.2f} ms, {} missing, {} ambiguous", patterns.size(), scanned.size(), stats.cached,
+                             stats.scanned, stats.ms, missing, ambiguous));
+    }
 
     // Get address for a specific version (0 if not found)
     uintptr_t GetAddressForVersion(GameVersion version) const {
@@ -312,20 +486,17 @@ struct AddressInfo {
         }
 
         // or Try pattern scan for unknown versions or known versions without addresses
-        if (pattern && pattern[0] != '\0') {
-            MODULEINFO modInfo;
-            HMODULE hModule = GetModuleHandleW(nullptr);
-            if (GetModuleInformation(GetCurrentProcess(), hModule, &modInfo, sizeof(modInfo))) {
-                if (auto addr = PatchHelper::ScanPattern(static_cast<BYTE*>(modInfo.lpBaseOfDll), modInfo.SizeOfImage, pattern)) {
-                    uintptr_t result = addr + patternOffset;
-                    LOG_DEBUG(std::format("[{}] Pattern scan found: {:#010x}", name, result));
-
-                    if (Validate(result)) {
-                        LOG_INFO(std::format("[{}] Pattern matched on unknown version at {:#010x}", name, result));
-                        return result;
-                    }
-                    LOG_WARNING(std::format("[{}] Pattern match at {:#010x} failed validation", name, result));
+        if (!pattern.Empty()) {
+            // Answered from PrefetchAll's pass when it ran, otherwise a scan of the exe's code sections
+            if (auto addr = Pattern::Scan(pattern)) {
+                uintptr_t result = addr + patternOffset;
+                LOG_DEBUG(std::format("[{}] Pattern scan found: {:#010x}", name, result));
+
+                if (Validate(result)) {
+                    LOG_INFO(std::format("[{}] Pattern matched on unknown version at {:#010x}", name, result));
+                    return result;
                 }
+                LOG_WARNING(std::format("[{}] Pattern match at {:#010x} failed validation", name, result));
             }
             LOG_ERROR(std::format("[{}] Pattern scan failed on unknown version", name));
         } else {
@@ -379,6 +550,14 @@ inline bool WriteRelativeJump(uintptr_t address, uintptr_t destination, std::vec
     return WriteProtectedMemory((LPVOID)address, jumpBytes.data(), 5, tracker);
 }
 
+inline bool WriteRelativeJump(uintptr_t address, uintptr_t destination, PatchTransaction& tx) {
+    std::vector<BYTE> jumpBytes(5);
+    jumpBytes[0] = 0xE9; // JMP rel32
+    int32_t offset = CalculateRelativeOffset(address, destination, 5);
+    std::memcpy(&jumpBytes[1], &offset, 4);
+    return WriteProtectedMemory((LPVOID)address, jumpBytes.data(), 5, tx);
+}
+
 // Write a relative call (E8 xx xx xx xx)
 inline bool WriteRelativeCall(uintptr_t address, uintptr_t destination, std::vector<PatchLocation>* tracker = nullptr) {
     std::vector<BYTE> callBytes(5);
@@ -388,23 +567,29 @@ inline bool WriteRelativeCall(uintptr_t address, uintptr_t destination, std::vec
     return WriteProtectedMemory((LPVOID)address, callBytes.data(), 5, tracker);
 }
 
-// Multi-patch transaction: all-or-nothing helper
-// Usage: auto tx = BeginTransaction(); WriteByte(..., &tx.locations); ... CommitTransaction(tx);
-struct PatchTransaction {
-    std::vector<PatchLocation> locations;
-    bool committed = false;
-};
+inline bool WriteRelativeCall(uintptr_t address, uintptr_t destination, PatchTransaction& tx) {
+    std::vector<BYTE> callBytes(5);
+    callBytes[0] = 0xE8; // CALL rel32
+    int32_t offset = CalculateRelativeOffset(address, destination, 5);
+    std::memcpy(&callBytes[1], &offset, 4);
+    return WriteProtectedMemory((LPVOID)address, callBytes.data(), 5, tx);
+}
 
 inline PatchTransaction BeginTransaction() {
     return PatchTransaction();
 }
 
+// Writes everything queued in one batch. If that fails part way (a write didn't verify) tx.locations has what did get written for RollbackTransaction
 inline bool CommitTransaction(PatchTransaction& tx) {
+    bool applied = tx.pending.Apply(&tx.locations);
+    tx.pending.Clear();
+    if (!applied) return false;
     tx.committed = true;
     return true;
 }
 
 inline bool RollbackTransaction(PatchTransaction& tx) {
+    tx.pending.Clear();
     if (!tx.committed && !tx.locations.empty()) { return RestoreAll(tx.locations); }
     return true;
 }
@@ -468,56 +653,34 @@ namespace IATHookHelper {
 inline bool Hook(HMODULE hModule, const char* dllName, const char* funcName, void* newFunc, void** originalFunc) {
     if (!hModule || !dllName || !funcName || !newFunc) return false;
 
-    PIMAGE_DOS_HEADER pDosHeader = (PIMAGE_DOS_HEADER)hModule;
-    if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE) return false;
+    // Imports come from the parsed image (PE::Image), the slot is where the loader wrote the address
+    const PE::Image* image = PE::Image::ForModule(hModule);
+    const PE::Import* entry = image ? image->FindImport(dllName, funcName) : nullptr;
+    if (!entry) return false;
 
-    PIMAGE_NT_HEADERS pNtHeaders = (PIMAGE_NT_HEADERS)((BYTE*)hModule + pDosHeader->e_lfanew);
-    if (pNtHeaders->Signature != IMAGE_NT_SIGNATURE) return false;
+    uintptr_t* slot = (uintptr_t*)((BYTE*)hModule + entry->slotRva);
+    if (originalFunc) *originalFunc = (void*)*slot;
 
-    if (pNtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size == 0) return false;
-
-    PIMAGE_IMPORT_DESCRIPTOR pImportDesc = (PIMAGE_IMPORT_DESCRIPTOR)((BYTE*)hModule + pNtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress);
-
-    for (; pImportDesc->Name; pImportDesc++) {
-        const char* moduleName = (const char*)((BYTE*)hModule + pImportDesc->Name);
-        if (_stricmp(moduleName, dllName) == 0) {
-            PIMAGE_THUNK_DATA pThunk = (PIMAGE_THUNK_DATA)((BYTE*)hModule + pImportDesc->FirstThunk);
-            PIMAGE_THUNK_DATA pOrigThunk = (PIMAGE_THUNK_DATA)((BYTE*)hModule + pImportDesc->OriginalFirstThunk);
-
-            if (!pOrigThunk) pOrigThunk = pThunk; // Fallback if no OriginalFirstThunk
-
-            for (; pThunk->u1.Function; pThunk++, pOrigThunk++) {
-                if (IMAGE_SNAP_BY_ORDINAL(pOrigThunk->u1.Ordinal)) continue;
-
-                PIMAGE_IMPORT_BY_NAME pImport = (PIMAGE_IMPORT_BY_NAME)((BYTE*)hModule + pOrigThunk->u1.AddressOfData);
-                if (strcmp(pImport->Name, funcName) == 0) {
-                    if (originalFunc) *originalFunc = (void*)pThunk->u1.Function;
-
-                    DWORD oldProtect;
-                    // Try PAGE_READWRITE first, fall back to PAGE_EXECUTE_READWRITE for Win11 compatibility
-                    if (!VirtualProtect(&pThunk->u1.Function, sizeof(uintptr_t), PAGE_READWRITE, &oldProtect)) {
-                        DWORD err = GetLastError();
-                        LOG_ERROR("IAT Hook: VirtualProtect(PAGE_READWRITE) failed for " + std::string(funcName) + ", error: " + std::to_string(err));
-                        // Try with execute permissions as fallback
-                        if (!VirtualProtect(&pThunk->u1.Function, sizeof(uintptr_t), PAGE_EXECUTE_READWRITE, &oldProtect)) {
-                            err = GetLastError();
-                            LOG_ERROR("IAT Hook: VirtualProtect(PAGE_EXECUTE_READWRITE) also failed, error: " + std::to_string(err));
-                            return false;
-                        }
-                    }
+    DWORD oldProtect;
+    // Try PAGE_READWRITE first, fall back to PAGE_EXECUTE_READWRITE for Win11 compatibility
+    if (!VirtualProtect(slot, sizeof(uintptr_t), PAGE_READWRITE, &oldProtect)) {
+        DWORD err = GetLastError();
+        LOG_ERROR("IAT Hook: VirtualProtect(PAGE_READWRITE) failed for " + std::string(funcName) + ", error: " + std::to_string(err));
+        // Try with execute permissions as fallback
+        if (!VirtualProtect(slot, sizeof(uintptr_t), PAGE_EXECUTE_READWRITE, &oldProtect)) {
+            err = GetLastError();
+            LOG_ERROR("IAT Hook: VirtualProtect(PAGE_EXECUTE_READWRITE) also failed, error: " + std::to_string(err));
+            return false;
+        }
+    }
 
-                    pThunk->u1.Function = (uintptr_t)newFunc;
+    *slot = (uintptr_t)newFunc;
 
-                    // Flush instruction cache for compatibility with certain security configurations
-                    FlushInstructionCache(GetCurrentProcess(), &pThunk->u1.Function, sizeof(uintptr_t));
+    // Flush instruction cache for compatibility with certain security configurations
+    FlushInstructionCache(GetCurrentProcess(), slot, sizeof(uintptr_t));
 
-                    VirtualProtect(&pThunk->u1.Function, sizeof(uintptr_t), oldProtect, &oldProtect);
-                    return true;
-                }
-            }
-        }
-    }
-    return false;
+    VirtualProtect(slot, sizeof(uintptr_t), oldProtect, &oldProtect);
+    return true;
 }
 } // namespace IATHookHelper
 } // namespace PatchHelper
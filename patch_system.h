@@ -6,6 +6,7 @@
 #include <vector>
 #include <string>
 #include <windows.h>
+#include "scan/pe_image.h"
 
 // Specific game versions we support
 enum class GameVersion : uint8_t {
@@ -47,11 +48,7 @@ inline uint32_t g_exeTimeDateStamp = 0;
 // Detect current game version from PE header timestamp
 // Return true if version was recognized, false otherwise
 inline bool DetectGameVersion() {
-    const auto exe = reinterpret_cast<uintptr_t>(GetModuleHandleW(nullptr));
-    const auto dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(exe);
-    const auto pe = reinterpret_cast<const IMAGE_NT_HEADERS*>(exe + dos->e_lfanew);
-
-    uint32_t timestamp = pe->FileHeader.TimeDateStamp;
+    uint32_t timestamp = PE::Image::Main().TimeDateStamp();
     g_exeTimeDateStamp = timestamp;
 
     for (size_t i = 0; i < GAME_VERSION_COUNT; i++) {
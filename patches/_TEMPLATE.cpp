@@ -51,17 +51,17 @@ class TemplatePatch : public OptimizationPatch {
         }
 
         // Just copy pattern from your disassembler! ? = wildcard
-        BYTE* found = baseAddr;
+        // (make it a static constexpr Signature::PatternLiteral member and a typo won't even build)
         int patchCount = 0;
 
-        while ((found = (BYTE*)PatchHelper::ScanPattern(found, imageSize - (found - baseAddr), "48 89 5C ? ? 08"))) {
+        // Every match in one go, ScanPattern if you only want the first
+        for (uintptr_t found : PatchHelper::ScanPatternAll(baseAddr, imageSize, "48 89 5C ? ? 08")) {
             // Patch at offset from pattern
-            if (PatchHelper::WriteByte((uintptr_t)(found + 12), 0xEB, &patchedLocations)) {
+            if (PatchHelper::WriteByte(found + 12, 0xEB, &patchedLocations)) {
                 patchCount++;
                 LOG_DEBUG("[TemplatePatch] Patched at 0x" +
-                         std::to_string((uintptr_t)(found + 12)));
+                         std::to_string(found + 12));
             }
-            found += 6;  // Move past this match (pattern length)
         }
 
         if (patchCount == 0) {
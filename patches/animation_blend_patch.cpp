@@ -168,9 +168,9 @@ class AnimationBlendPatch : public OptimizationPatch {
 
         auto tx = PatchHelper::BeginTransaction();
         bool ok = true;
-        ok &= PatchHelper::WriteRelativeJump(*inAddr, reinterpret_cast<uintptr_t>(&Trampoline_BlendIn), &tx.locations);
-        ok &= PatchHelper::WriteRelativeJump(*outAddr, reinterpret_cast<uintptr_t>(&Trampoline_BlendOut), &tx.locations);
-        if (gateAddr) ok &= PatchHelper::WriteNOP(*gateAddr, 2, &tx.locations);
+        ok &= PatchHelper::WriteRelativeJump(*inAddr, reinterpret_cast<uintptr_t>(&Trampoline_BlendIn), tx);
+        ok &= PatchHelper::WriteRelativeJump(*outAddr, reinterpret_cast<uintptr_t>(&Trampoline_BlendOut), tx);
+        if (gateAddr) ok &= PatchHelper::WriteNOP(*gateAddr, 2, tx);
 
         if (!ok || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
@@ -87,8 +87,8 @@ class BradyBunchBegonePatch : public OptimizationPatch {
             std::memcpy(&newBits, &newRGB[i], 4);
             std::memcpy(&oldPrimBits, &curPrim[i], 4);
             std::memcpy(&oldSibBits, &curSib[i], 4);
-            ok &= PatchHelper::WriteDWORD(primaryAddr + i * 4, newBits, &tx.locations, &oldPrimBits);
-            ok &= PatchHelper::WriteDWORD(siblingAddr + i * 4, newBits, &tx.locations, &oldSibBits);
+            ok &= PatchHelper::WriteDWORD(primaryAddr + i * 4, newBits, tx, &oldPrimBits);
+            ok &= PatchHelper::WriteDWORD(siblingAddr + i * 4, newBits, tx, &oldSibBits);
         }
         if (!ok) {
             PatchHelper::RollbackTransaction(tx);
@@ -131,7 +131,7 @@ class BradyBunchBegonePatch : public OptimizationPatch {
                 static_cast<BYTE>((oldRel >> 16) & 0xFF),
                 static_cast<BYTE>((oldRel >> 24) & 0xFF),
             };
-            if (!PatchHelper::WriteBytes(jbeAddr, newBytes, &tx.locations, &oldBytes)) {
+            if (!PatchHelper::WriteBytes(jbeAddr, newBytes, tx, &oldBytes)) {
                 PatchHelper::RollbackTransaction(tx);
                 return Fail("Failed to rewrite fill-light JBE -> JMP");
             }
@@ -1,37 +1,271 @@
 #include "../patch_system.h"
-#include "../patch_helpers.h"
 #include "../logger.h"
+#include "../utils.h"
+#include "../config/config_paths.h"
+#include "../io/file_hooks.h"
+#include "../io/open_flag_rules.h"
+#include <windows.h>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <toml++/toml.hpp>
 
-// CreateFileW Random Access patch - adds FILE_FLAG_RANDOM_ACCESS to main callers of CreateFileW, since sims 3 uses dbpf it makes more sense to hint random than sequential
+// CreateFileW access hints - picks FILE_FLAG_RANDOM_ACCESS, FILE_FLAG_SEQUENTIAL_SCAN or neither per file from the rules in
+// S3SS\open_flag_rules.toml, see io/open_flag_rules.h. Random access suits the game's DBPF reads, but not saves, logs or packages
+// read front to back, which is what putting it on every file used to do
+// Still registered as CreateFileRandomAccess so existing configs keep it enabled
 class CreateFileRandomAccessPatch : public OptimizationPatch {
   private:
-    // Address definitions
-    static inline const AddressInfo createFileWFlagsInit = {
-        .name = "CreateFileW::flagsInit",
-        .addresses =
-            {
-                {GameVersion::Retail, 0x00404563},
-                {GameVersion::Steam, 0x00404573},
-                {GameVersion::EA, 0x00404563},
-            },
-        .pattern = "24 08 80 00 00 00 74 ?? C7 44 24 0C 00 00 00 C0 8B C2 83 E0 06 83 E8 02 74 ?? 83 E8 02",
-        .patternOffset = 2,                        // Skip "24 08" to get to the 0x80 DWORD
-        .expectedBytes = {0x80, 0x00, 0x00, 0x00}, // DWORD 0x80
-    };
+    static constexpr DWORD WRITE_ACCESS = GENERIC_WRITE | GENERIC_ALL | FILE_WRITE_DATA | FILE_APPEND_DATA;
+    static constexpr ULONGLONG HISTORY_SAVE_INTERVAL_MS = 30000;
+    static constexpr size_t OBSERVER_SHARDS = 16;
 
-    static inline const AddressInfo randomAccessFlagBranch = {
-        .name = "CreateFileW::randomAccessBranch",
-        .addresses =
-            {
-                {GameVersion::Retail, 0x004db73c},
-                {GameVersion::Steam, 0x004db56c},
-                {GameVersion::EA, 0x004db51c},
-            },
-        .pattern = "74 ?? BD 00 00 00 10 6A 00 55 50 6A 00 52 8B 54 24 24 52 8D 46 08 50 FF 15 ?? ?? ?? ?? 83 F8 FF 89 46 04 75 ?? FF 15 ?? ?? ?? ??",
-        .expectedBytes = {0x74}, // JZ instruction
+    // Written out the first time so there's something to edit, matches OpenFlagRules::DefaultRules()
+    static constexpr const char* DEFAULT_RULES_FILE = R"(# CreateFileW access hints, first matching rule wins. Reload from the patch's UI after editing.
+#
+#   hint          = "random" | "sequential" | "none" | "keep"    (required)
+#   extensions    = ".package" or [".package", ".dbc"]           (optional, any of them)
+#   path_prefixes = "{user}\\Mods\\" or [...]                    (optional, any of them, {user} is the game's Documents folder,
+#                                                                  {game} the folder TS3.exe is in)
+#   access        = "read" | "write" | "any"                     (optional, write is any write access)
+#   pattern       = "sequential" | "random" | "unknown" | "any"  (optional, how the file was read the last time it was open)
+#
+# Files no rule matches keep whatever flags the game asked for.
+
+[[rule]]
+name = "Writes"
+access = "write"
+hint = "none"
+
+[[rule]]
+name = "Read sequentially last time"
+pattern = "sequential"
+hint = "sequential"
+
+[[rule]]
+name = "Packages"
+extensions = [".package", ".dbc", ".nhd", ".world"]
+hint = "random"
+
+[[rule]]
+name = "Text and logs"
+extensions = [".txt", ".log", ".xml", ".ini", ".cfg", ".toml", ".csv"]
+hint = "sequential"
+)";
+
+    // Only ever swapped whole, open hooks hold on to the one they started with
+    std::mutex rulesMutex;
+    std::shared_ptr<OpenFlagRules::RuleSet> rules;
+    std::string rulesError;
+
+    // Opens and closes only, and only for files whose rule depends on the pattern
+    std::mutex historyMutex;
+    OpenFlagRules::PatternHistory history;
+    ULONGLONG lastHistorySave = 0;
+
+    // Watched files by FileHooks id (sequential, so id % OBSERVER_SHARDS spreads them), reads on different files rarely share a lock
+    struct ObserverShard {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, std::pair<std::string, OpenFlagRules::ReadObserver>> observers; // id -> normalized path, reads so far
     };
+    std::array<ObserverShard, OBSERVER_SHARDS> observerShards;
+    std::atomic<uint32_t> watchedCount{0};
+
+    std::atomic<uint64_t> openCount{0};
+    std::atomic<uint64_t> changedCount{0};
+
+    static std::string GetRulesPath() { return Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory()) + "open_flag_rules.toml"; }
+    static std::string GetHistoryPath() { return Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory()) + "open_patterns.txt"; }
+
+    std::shared_ptr<OpenFlagRules::RuleSet> CurrentRules() {
+        std::lock_guard<std::mutex> lock(rulesMutex);
+        return rules;
+    }
+
+    ObserverShard& ShardFor(uint32_t id) { return observerShards[id % OBSERVER_SHARDS]; }
+
+    void ClearObservers() {
+        for (ObserverShard& shard : observerShards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.observers.clear();
+        }
+        watchedCount.store(0, std::memory_order_relaxed);
+    }
 
-    std::vector<PatchHelper::PatchLocation> patchedLocations;
+    // A single string or an array of them
+    static bool ReadStrings(toml::node_view<const toml::node> node, std::vector<std::string>& out) {
+        if (!node) return true;
+        if (auto value = node.value<std::string>()) {
+            out.push_back(*value);
+            return true;
+        }
+        const toml::array* array = node.as_array();
+        if (!array) return false;
+        for (const toml::node& item : *array) {
+            auto value = item.value<std::string>();
+            if (!value) return false;
+            out.push_back(*value);
+        }
+        return true;
+    }
+
+    static std::string ExpandPlaceholders(const std::string& prefix) {
+        // S3SS lives in <Documents>\Electronic Arts\<game>\S3SS\, {user} is the folder above it. Both already end in a backslash
+        std::string base;
+        if (prefix.compare(0, 6, "{user}") == 0) {
+            base = Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory());
+            if (base.size() >= 5 && _stricmp(base.c_str() + base.size() - 5, "S3SS\\") == 0) base.resize(base.size() - 5);
+        } else if (prefix.compare(0, 6, "{game}") == 0) {
+            base = Utils::GetGameFilePath("");
+        } else {
+            return prefix;
+        }
+        size_t rest = prefix.size() > 6 && (prefix[6] == '\\' || prefix[6] == '/') ? 7 : 6;
+        return base + prefix.substr(rest);
+    }
+
+    static bool ParseRules(const std::string& path, std::vector<OpenFlagRules::Rule>& parsed, std::string& error) {
+        toml::table root;
+        try {
+            root = toml::parse_file(Utils::Utf8ToWide(path));
+        } catch (const toml::parse_error& e) {
+            error = std::format("line {}: {}", e.source().begin.line, e.description());
+            return false;
+        }
+
+        const toml::array* array = root["rule"].as_array();
+        if (!array) {
+            error = "no [[rule]] entries";
+            return false;
+        }
+        for (const toml::node& node : *array) {
+            const toml::table* table = node.as_table();
+            size_t number = parsed.size() + 1;
+            if (!table) {
+                error = std::format("rule {} isn't a table", number);
+                return false;
+            }
+
+            OpenFlagRules::Rule rule;
+            rule.name = (*table)["name"].value_or(std::format("Rule {}", number));
+            std::string hint = (*table)["hint"].value_or(std::string());
+            std::string access = (*table)["access"].value_or(std::string("any"));
+            std::string pattern = (*table)["pattern"].value_or(std::string("any"));
+            if (!OpenFlagRules::ParseHint(hint, rule.hint)) {
+                error = std::format("{}: hint \"{}\" isn't random, sequential, none or keep", rule.name, hint);
+                return false;
+            }
+            if (!OpenFlagRules::ParseAccess(access, rule.access)) {
+                error = std::format("{}: access \"{}\" isn't read, write or any", rule.name, access);
+                return false;
+            }
+            if (!OpenFlagRules::ParsePattern(pattern, rule.pattern)) {
+                error = std::format("{}: pattern \"{}\" isn't sequential, random, unknown or any", rule.name, pattern);
+                return false;
+            }
+            if (!ReadStrings((*table)["extensions"], rule.extensions) || !ReadStrings((*table)["path_prefixes"], rule.pathPrefixes)) {
+                error = std::format("{}: extensions and path_prefixes take a string or an array of strings", rule.name);
+                return false;
+            }
+            for (std::string& prefix : rule.pathPrefixes) prefix = ExpandPlaceholders(prefix);
+            parsed.push_back(std::move(rule));
+        }
+        return true;
+    }
+
+    // Falls back to the built-in rules if the file is missing or broken, a typo shouldn't leave every file without a hint
+    void LoadRules() {
+        std::string path = GetRulesPath();
+        std::error_code ec;
+        if (!std::filesystem::exists(Utils::ToPath(path), ec) && ConfigPaths::EnsureDirectoryExists()) {
+            std::ofstream out(Utils::ToPath(path), std::ios::binary);
+            out << DEFAULT_RULES_FILE;
+        }
+
+        std::vector<OpenFlagRules::Rule> parsed;
+        std::string error;
+        if (!ParseRules(path, parsed, error)) {
+            LOG_WARNING(std::format("[CreateFileRandomAccessPatch] {}: {}, using the built-in rules", path, error));
+            parsed = OpenFlagRules::DefaultRules();
+        } else {
+            LOG_INFO(std::format("[CreateFileRandomAccessPatch] Loaded {} rules from {}", parsed.size(), path));
+        }
+
+        auto loaded = std::make_shared<OpenFlagRules::RuleSet>(std::move(parsed));
+        std::lock_guard<std::mutex> lock(rulesMutex);
+        rules = std::move(loaded);
+        rulesError = std::move(error);
+    }
+
+    void OnOpen(FileHooks::OpenContext& ctx) {
+        // Directories, devices and pipes come through CreateFileW too
+        if (!ctx.path || (ctx.flagsAndAttributes & FILE_FLAG_BACKUP_SEMANTICS) || wcsncmp(ctx.path, L"\\\\.\\", 4) == 0) return;
+
+        auto current = CurrentRules();
+        OpenFlagRules::OpenInfo info;
+        info.path = OpenFlagRules::NormalizePath(Utils::WideToUtf8(ctx.path));
+        info.access = (ctx.access & WRITE_ACCESS) ? OpenFlagRules::Access::Write : OpenFlagRules::Access::Read;
+        if (current->DependsOnPattern(info)) {
+            std::lock_guard<std::mutex> lock(historyMutex);
+            info.observed = history.Lookup(info.path);
+        }
+
+        DWORD flags = OpenFlagRules::ApplyHint(ctx.flagsAndAttributes, current->Choose(info));
+        openCount.fetch_add(1, std::memory_order_relaxed);
+        if (flags != ctx.flagsAndAttributes) changedCount.fetch_add(1, std::memory_order_relaxed);
+        ctx.flagsAndAttributes = flags;
+    }
+
+    // Reads are only watched on files whose rule asks about them
+    void OnOpened(const FileHooks::FileInfo& file) {
+        auto current = CurrentRules();
+        if (!current->UsesPattern()) return;
+        OpenFlagRules::OpenInfo info;
+        info.path = OpenFlagRules::NormalizePath(Utils::WideToUtf8(file.path));
+        info.access = (file.access & WRITE_ACCESS) ? OpenFlagRules::Access::Write : OpenFlagRules::Access::Read;
+        if (!current->DependsOnPattern(info)) return;
+
+        ObserverShard& shard = ShardFor(file.id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.observers.try_emplace(file.id, std::move(info.path), OpenFlagRules::ReadObserver{}).second) watchedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void OnRead(const FileHooks::ReadContext& ctx) {
+        if (ctx.pending || !ctx.succeeded || watchedCount.load(std::memory_order_relaxed) == 0) return;
+        ObserverShard& shard = ShardFor(ctx.file.id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.observers.find(ctx.file.id);
+        if (it != shard.observers.end()) it->second.second.OnRead(ctx.offset, ctx.transferred);
+    }
+
+    void OnClose(const FileHooks::FileInfo& file) {
+        if (watchedCount.load(std::memory_order_relaxed) == 0) return;
+        std::string path;
+        OpenFlagRules::Pattern pattern;
+        {
+            ObserverShard& shard = ShardFor(file.id);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.observers.find(file.id);
+            if (it == shard.observers.end()) return;
+            path = std::move(it->second.first);
+            pattern = it->second.second.Classify();
+            shard.observers.erase(it);
+            watchedCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> lock(historyMutex);
+        history.Record(path, pattern);
+    }
+
+    void SaveHistory() {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        if (!history.Dirty() || !ConfigPaths::EnsureDirectoryExists()) return;
+        if (!history.Save(Utils::ToPath(GetHistoryPath()))) LOG_WARNING("[CreateFileRandomAccessPatch] Failed to save open pattern history");
+    }
 
   public:
     CreateFileRandomAccessPatch() : OptimizationPatch("CreateFileRandomAccess", nullptr) {}
@@ -40,37 +274,26 @@ class CreateFileRandomAccessPatch : public OptimizationPatch {
         if (isEnabled) return true;
 
         lastError.clear();
-        LOG_INFO("[CreateFileRandomAccessPatch] Installing dual patch...");
+        LOG_INFO("[CreateFileRandomAccessPatch] Installing...");
 
-        // Resolve addresses
-        auto addr1 = createFileWFlagsInit.Resolve();
-        auto addr2 = randomAccessFlagBranch.Resolve();
-
-        if (!addr1 || !addr2) { return Fail("Could not resolve required addresses"); }
-
-        // Patch 1: add FILE_FLAG_RANDOM_ACCESS (0x10000000) to flags
-        // Change DWORD: 0x80 -> 0x10000080
-        DWORD currentValue1 = PatchHelper::ReadDWORD(*addr1);
-        LOG_DEBUG(std::format("[CreateFileRandomAccessPatch] Current value at {:#010x}: {:#x}", *addr1, currentValue1));
-
-        DWORD expectedOld1 = 0x80;
-        if (!PatchHelper::WriteDWORD(*addr1, 0x10000080, &patchedLocations, &expectedOld1)) { return Fail(std::format("Failed to patch at {:#010x} - expected 0x80, found {:#x}", *addr1, currentValue1)); }
-        LOG_DEBUG("[CreateFileRandomAccessPatch] Patch 1 applied: 0x80 -> 0x10000080");
-
-        // Patch 2: NOP out 2 bytes to skip conditional jump
-        BYTE currentByte1 = PatchHelper::ReadByte(*addr2);
-        BYTE currentByte2 = PatchHelper::ReadByte(*addr2 + 1);
-        LOG_DEBUG(std::format("[CreateFileRandomAccessPatch] Current bytes at {:#010x}: {:#x} {:#x}", *addr2, currentByte1, currentByte2));
+        LoadRules();
+        {
+            std::lock_guard<std::mutex> lock(historyMutex);
+            history.Load(Utils::ToPath(GetHistoryPath()));
+        }
+        ClearObservers();
+        lastHistorySave = GetTickCount64();
 
-        if (!PatchHelper::WriteNOP(*addr2, 2, &patchedLocations)) {
-            PatchHelper::RestoreAll(patchedLocations);
-            isEnabled = false;
-            return Fail(std::format("Failed to NOP at {:#010x} - partial install rolled back", *addr2));
+        if (!FileHooks::RegisterOpen(GetName(), [this](FileHooks::OpenContext& ctx) { OnOpen(ctx); }) ||
+            !FileHooks::RegisterOpened(GetName(), [this](const FileHooks::FileInfo& file) { OnOpened(file); }) ||
+            !FileHooks::RegisterRead(GetName(), [this](const FileHooks::ReadContext& ctx) { OnRead(ctx); }) ||
+            !FileHooks::RegisterClose(GetName(), [this](const FileHooks::FileInfo& file) { OnClose(file); })) {
+            FileHooks::UnregisterAll(GetName());
+            return Fail("Failed to install file I/O hooks");
         }
-        LOG_DEBUG("[CreateFileRandomAccessPatch] Patch 2 applied: NOPed 2 bytes");
 
         isEnabled = true;
-        LOG_INFO("[CreateFileRandomAccessPatch] Successfully installed both patches");
+        LOG_INFO("[CreateFileRandomAccessPatch] Successfully installed");
         return true;
     }
 
@@ -80,19 +303,86 @@ class CreateFileRandomAccessPatch : public OptimizationPatch {
         lastError.clear();
         LOG_INFO("[CreateFileRandomAccessPatch] Uninstalling...");
 
-        if (!PatchHelper::RestoreAll(patchedLocations)) { return Fail("Failed to restore original bytes"); }
+        FileHooks::UnregisterAll(GetName());
+        SaveHistory();
+        ClearObservers();
 
         isEnabled = false;
-        LOG_INFO("[CreateFileRandomAccessPatch] Successfully uninstalled");
+        LOG_INFO(std::format("[CreateFileRandomAccessPatch] Successfully uninstalled, changed the flags of {} of {} opens", changedCount.load(), openCount.load()));
         return true;
     }
+
+    void Update() override {
+        OptimizationPatch::Update();
+        if (!isEnabled) return;
+
+        ULONGLONG now = GetTickCount64();
+        if (now - lastHistorySave < HISTORY_SAVE_INTERVAL_MS) return;
+        lastHistorySave = now;
+        SaveHistory();
+    }
+
+    void RenderCustomUI() override {
+        SAFE_IMGUI_BEGIN();
+
+        if (isEnabled) {
+            auto current = CurrentRules();
+            std::string error;
+            {
+                std::lock_guard<std::mutex> lock(rulesMutex);
+                error = rulesError;
+            }
+            size_t known;
+            {
+                std::lock_guard<std::mutex> lock(historyMutex);
+                known = history.Size();
+            }
+
+            ImGui::Text("Opens: %llu  Flags changed: %llu  Files with a known read pattern: %zu", openCount.load(std::memory_order_relaxed), changedCount.load(std::memory_order_relaxed), known);
+            if (!error.empty()) ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.0f, 1.0f), "open_flag_rules.toml: %s (using the built-in rules)", error.c_str());
+            if (ImGui::Button("Reload Rules")) LoadRules();
+            ImGui::SameLine();
+            if (ImGui::Button("Reset Counters")) current->ResetHits();
+
+            if (ImGui::BeginTable("openFlagRules", 3, ImGuiTableFlags_SizingFixedFit)) {
+                ImGui::TableSetupColumn("Rule");
+                ImGui::TableSetupColumn("Hint");
+                ImGui::TableSetupColumn("Hits");
+                ImGui::TableHeadersRow();
+                for (size_t i = 0; i < current->Rules().size(); i++) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", current->Rules()[i].name.c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", OpenFlagRules::HintName(current->Rules()[i].hint));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", current->Hits(i));
+                }
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("(no rule)");
+                ImGui::TableNextColumn();
+                ImGui::Text("keep");
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", current->Unmatched());
+                ImGui::EndTable();
+            }
+            ImGui::Spacing();
+        }
+
+        OptimizationPatch::RenderCustomUI();
+    }
 };
 
 // Register the patch
-REGISTER_PATCH(CreateFileRandomAccessPatch, {.displayName = "CreateFileW Random Access",
-                                                .description = "Adds FILE_FLAG_RANDOM_ACCESS to CreateFileW calls for better disk I/O performance",
+REGISTER_PATCH(CreateFileRandomAccessPatch, {.displayName = "CreateFileW Access Hints",
+                                                .description = "Picks FILE_FLAG_RANDOM_ACCESS, FILE_FLAG_SEQUENTIAL_SCAN or neither for each file the game opens, from editable rules",
                                                 .category = "Performance",
                                                 .experimental = false,
                                                 .supportedVersions = VERSION_ALL,
-                                                .technicalDetails = {"Adds FILE_FLAG_RANDOM_ACCESS (0x10000000) to CreateFileW dwFlagsAndAttributes",
-                                                    "Improves file I/O performance by hinting random access pattern to Windows", "Credits to FoulPlay on discord for figuring this out! :D"}})
+                                                .technicalDetails = {"Open hook on the shared FileHooks CreateFileW detour, rules in S3SS\\open_flag_rules.toml (written with the defaults on first use)",
+                                                    "Rules match on extension, path prefix, read/write access and how the file was read the last time it was open, first match wins",
+                                                    "By default packages get random access, text and logs and anything read front to back last time get sequential scan, writes get neither",
+                                                    "Read patterns are remembered in S3SS\\open_patterns.txt, per-rule hit counts show here",
+                                                    "tools/open_rules_check runs the rules against an I/O trace",
+                                                    "Original random access idea by FoulPlay on discord! :D"}})
@@ -369,9 +369,9 @@ class ExpandedCrashLogs : public OptimizationPatch {
             endOfExceptionReportSectionsChain = 0;
         }
 
-        successful &= PatchHelper::WriteProtectedMemory(reinterpret_cast<void*>(accessViolationFormatting), formatAccessViolationCall, 16, &tx.locations);
-        successful &= PatchHelper::WriteDWORD(commandLineInCrashLogCall + 1, writeCommandLineHookCallDisplacement, &tx.locations);
-        successful &= PatchHelper::WriteRelativeCall(callSetupAfterExtraSectionInCrashLog, std::bit_cast<uintptr_t>(&CrashLogObject::HookedEndOfExceptionReportSections), &tx.locations);
+        successful &= PatchHelper::WriteProtectedMemory(reinterpret_cast<void*>(accessViolationFormatting), formatAccessViolationCall, 16, tx);
+        successful &= PatchHelper::WriteDWORD(commandLineInCrashLogCall + 1, writeCommandLineHookCallDisplacement, tx);
+        successful &= PatchHelper::WriteRelativeCall(callSetupAfterExtraSectionInCrashLog, std::bit_cast<uintptr_t>(&CrashLogObject::HookedEndOfExceptionReportSections), tx);
 
         if (!successful || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
@@ -46,11 +46,9 @@ class GCFinalizeThrottlePatch : public OptimizationPatch {
             // CMP EAX, 0xC8 (5 bytes: 3D C8 00 00 00)
             // -> CMP EAX, 0x7FFF (5 bytes: 3D FF 7F 00 00)
             std::vector<BYTE> newThreshold = {0x3D, 0xFF, 0x7F, 0x00, 0x00};
-            if (!PatchHelper::WriteBytes(*thresholdAddr, newThreshold, &tx.locations)) {
+            if (!PatchHelper::WriteBytes(*thresholdAddr, newThreshold, tx)) {
                 LOG_WARNING(std::format("[GCFinalizeThrottle] Failed to patch frame threshold at {:#010x}", *thresholdAddr));
                 success = false;
-            } else {
-                LOG_INFO(std::format("[GCFinalizeThrottle] Patched frame threshold at {:#010x} (200 -> 32767)", *thresholdAddr));
             }
         } else {
             LOG_WARNING("[GCFinalizeThrottle] Could not resolve frame threshold address");
@@ -62,11 +60,9 @@ class GCFinalizeThrottlePatch : public OptimizationPatch {
         auto loopAddr = blockingLoopJump.Resolve();
         if (loopAddr) {
             std::vector<BYTE> nops = {0x90, 0x90};
-            if (!PatchHelper::WriteBytes(*loopAddr, nops, &tx.locations)) {
+            if (!PatchHelper::WriteBytes(*loopAddr, nops, tx)) {
                 LOG_WARNING(std::format("[GCFinalizeThrottle] Failed to patch blocking loop at {:#010x}", *loopAddr));
                 success = false;
-            } else {
-                LOG_INFO(std::format("[GCFinalizeThrottle] Patched blocking loop at {:#010x} (JNZ -> NOP)", *loopAddr));
             }
         } else {
             LOG_WARNING("[GCFinalizeThrottle] Could not resolve blocking loop address");
@@ -82,6 +78,9 @@ class GCFinalizeThrottlePatch : public OptimizationPatch {
             PatchHelper::RollbackTransaction(tx);
             return Fail("Failed to commit transaction");
         }
+        // Writes are only queued until the commit, nothing's patched before here
+        LOG_INFO(std::format("[GCFinalizeThrottle] Patched frame threshold at {:#010x} (200 -> 32767)", *thresholdAddr));
+        LOG_INFO(std::format("[GCFinalizeThrottle] Patched blocking loop at {:#010x} (JNZ -> NOP)", *loopAddr));
 
         patchedLocations = tx.locations;
         isEnabled = true;
@@ -0,0 +1,278 @@
+#include "../patch_system.h"
+#include "../logger.h"
+#include "../utils.h"
+#include "../config/config_paths.h"
+#include "../io/file_hooks.h"
+#include "../io/io_trace.h"
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Records every read the game makes on .package files (file, offset, size, thread, QPC time, time blocked) to S3SS\io_trace_*.s3io
+// Hooks only push into a lock-free ring, a background thread drains it to disk every 100ms. Read it with tools/io_trace_analyze
+class IOTracePatch : public OptimizationPatch {
+  private:
+    static constexpr uint32_t RING_CAPACITY_LOG2 = 16; // 64K records (2.5 MB), ~a second of the worst loading screen bursts
+    static constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(100);
+
+    struct PendingFile {
+        uint32_t id;
+        uint64_t size;
+        std::string path;
+    };
+
+    static bool traceAllFiles;
+    static std::unique_ptr<IOTrace::RecordRing> ring;
+
+    // Paths of newly opened files, opens are rare enough for a mutex
+    static std::mutex pendingFilesMutex;
+    static std::vector<PendingFile> pendingFiles;
+
+    static std::atomic<uint64_t> filesSeen;
+    static std::atomic<uint64_t> readCount;
+    static std::atomic<uint64_t> readBytes;
+    static std::atomic<uint64_t> blockedTicks;
+
+    // Flush thread owns the writer while it runs
+    IOTrace::TraceWriter writer;
+    std::thread flushThread;
+    std::mutex flushMutex;
+    std::condition_variable flushCV;
+    bool stopFlush = false;
+    std::string tracePath;
+    std::atomic<uint64_t> bytesWritten{0};
+    uint64_t qpcFrequency = 0;
+
+    static bool Traced(const FileHooks::FileInfo& file) { return traceAllFiles || file.isPackage; }
+
+    static int64_t Now() {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return now.QuadPart;
+    }
+
+    static void OnOpened(const FileHooks::FileInfo& file) {
+        if (!Traced(file)) return;
+
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file.handle, &size);
+        {
+            std::lock_guard<std::mutex> lock(pendingFilesMutex);
+            pendingFiles.push_back({file.id, static_cast<uint64_t>(size.QuadPart), Utils::WideToUtf8(file.path)});
+        }
+        filesSeen.fetch_add(1, std::memory_order_relaxed);
+
+        IOTrace::Record record;
+        record.timestamp = Now();
+        record.offset = size.QuadPart;
+        record.fileId = file.id;
+        record.threadId = GetCurrentThreadId();
+        record.kind = IOTrace::Kind::Open;
+        ring->Push(record);
+    }
+
+    static void OnRead(const FileHooks::ReadContext& ctx) {
+        if (!Traced(ctx.file)) return;
+
+        int64_t duration = ctx.endTicks - ctx.startTicks;
+        IOTrace::Record record;
+        record.timestamp = ctx.startTicks;
+        record.offset = ctx.offset;
+        record.duration = duration > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(duration);
+        record.requested = ctx.requested;
+        record.transferred = ctx.transferred;
+        record.fileId = ctx.file.id;
+        record.threadId = GetCurrentThreadId();
+        record.kind = IOTrace::Kind::Read;
+        record.flags = (ctx.succeeded || ctx.pending ? 0 : IOTrace::RECORD_FAILED) | (ctx.overlapped ? IOTrace::RECORD_OVERLAPPED : 0) | (ctx.pending ? IOTrace::RECORD_PENDING : 0);
+        ring->Push(record);
+
+        readCount.fetch_add(1, std::memory_order_relaxed);
+        readBytes.fetch_add(ctx.transferred, std::memory_order_relaxed);
+        blockedTicks.fetch_add(duration, std::memory_order_relaxed);
+    }
+
+    static void OnClose(const FileHooks::FileInfo& file) {
+        if (!Traced(file)) return;
+
+        IOTrace::Record record;
+        record.timestamp = Now();
+        record.offset = file.position.load(std::memory_order_relaxed);
+        record.fileId = file.id;
+        record.threadId = GetCurrentThreadId();
+        record.kind = IOTrace::Kind::Close;
+        ring->Push(record);
+    }
+
+    void FlushOnce(std::vector<IOTrace::Record>& records, uint64_t& lastDropped) {
+        std::vector<PendingFile> files;
+        {
+            std::lock_guard<std::mutex> lock(pendingFilesMutex);
+            files.swap(pendingFiles);
+        }
+        for (const auto& file : files) writer.WriteFile(file.id, file.size, file.path);
+
+        records.clear();
+        ring->Drain(records);
+        writer.WriteRecords(records.data(), records.size());
+
+        uint64_t dropped = ring->Dropped();
+        if (dropped != lastDropped) {
+            writer.WriteDropped(dropped);
+            lastDropped = dropped;
+        }
+        writer.Flush();
+        bytesWritten.store(writer.BytesWritten(), std::memory_order_relaxed);
+    }
+
+    void FlushThreadFunc() {
+        std::vector<IOTrace::Record> records;
+        records.reserve(size_t(1) << RING_CAPACITY_LOG2);
+        uint64_t lastDropped = 0;
+
+        std::unique_lock<std::mutex> lock(flushMutex);
+        while (!stopFlush) {
+            flushCV.wait_for(lock, FLUSH_INTERVAL, [this] { return stopFlush; });
+            lock.unlock();
+            FlushOnce(records, lastDropped);
+            lock.lock();
+        }
+    }
+
+    bool StartTrace() {
+        auto t = std::time(nullptr);
+        auto tm = *std::localtime(&t);
+        std::ostringstream name;
+        name << "io_trace_" << std::put_time(&tm, "%Y%m%d_%H%M%S") << ".s3io";
+        tracePath = Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory()) + name.str();
+
+        if (!writer.Open(Utils::ToPath(tracePath), qpcFrequency, Now())) return false;
+
+        // Files opened before this trace (Start New Trace, or another patch had the hooks in first) never hit OnOpened for it,
+        // their reads would show up as unknown ids without these. The flush thread isn't running yet so the writer is ours
+        FileHooks::ForEachTrackedFile([this](const FileHooks::FileInfo& file) {
+            if (!Traced(file)) return;
+            LARGE_INTEGER size{};
+            GetFileSizeEx(file.handle, &size);
+            writer.WriteFile(file.id, static_cast<uint64_t>(size.QuadPart), Utils::WideToUtf8(file.path));
+        });
+
+        stopFlush = false;
+        flushThread = std::thread(&IOTracePatch::FlushThreadFunc, this);
+        LOG_INFO("[IOTrace] Tracing to " + tracePath);
+        return true;
+    }
+
+    void StopTrace() {
+        {
+            std::lock_guard<std::mutex> lock(flushMutex);
+            stopFlush = true;
+        }
+        flushCV.notify_all();
+        if (flushThread.joinable()) flushThread.join();
+        writer.Close();
+    }
+
+  public:
+    IOTracePatch() : OptimizationPatch("IOTrace", nullptr) {
+        RegisterBoolSetting(&traceAllFiles, "traceAllFiles", false, "Trace every file the game reads, not just .package files");
+    }
+
+    bool Install() override {
+        if (isEnabled) return true;
+
+        lastError.clear();
+        LOG_INFO("[IOTrace] Installing...");
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        qpcFrequency = frequency.QuadPart;
+
+        ring = std::make_unique<IOTrace::RecordRing>(RING_CAPACITY_LOG2);
+        pendingFiles.clear();
+        filesSeen.store(0, std::memory_order_relaxed);
+        readCount.store(0, std::memory_order_relaxed);
+        readBytes.store(0, std::memory_order_relaxed);
+        blockedTicks.store(0, std::memory_order_relaxed);
+
+        if (!StartTrace()) {
+            ring.reset();
+            return Fail("Could not create trace file " + tracePath);
+        }
+
+        if (!FileHooks::RegisterOpened(GetName(), OnOpened) || !FileHooks::RegisterRead(GetName(), OnRead) || !FileHooks::RegisterClose(GetName(), OnClose)) {
+            FileHooks::UnregisterAll(GetName());
+            StopTrace();
+            ring.reset();
+            return Fail("Failed to install file I/O hooks");
+        }
+
+        isEnabled = true;
+        LOG_INFO("[IOTrace] Successfully installed");
+        return true;
+    }
+
+    bool Uninstall() override {
+        if (!isEnabled) return true;
+
+        lastError.clear();
+        LOG_INFO("[IOTrace] Uninstalling...");
+
+        // No hook is running once this returns, so the ring can go after the final flush
+        FileHooks::UnregisterAll(GetName());
+        StopTrace();
+        ring.reset();
+
+        isEnabled = false;
+        LOG_INFO("[IOTrace] Successfully uninstalled, trace saved to " + tracePath);
+        return true;
+    }
+
+    void RenderCustomUI() override {
+        SAFE_IMGUI_BEGIN();
+
+        if (isEnabled) {
+            uint64_t reads = readCount.load(std::memory_order_relaxed);
+            ImGui::Text("Trace: %s", tracePath.c_str());
+            ImGui::Text("Files: %llu  Reads: %llu  Read: %.1f MB  Blocked: %.2f s", filesSeen.load(std::memory_order_relaxed), reads, readBytes.load(std::memory_order_relaxed) / (1024.0 * 1024.0),
+                qpcFrequency ? (double)blockedTicks.load(std::memory_order_relaxed) / qpcFrequency : 0.0);
+            ImGui::Text("Written: %.1f MB  Dropped: %llu", bytesWritten.load(std::memory_order_relaxed) / (1024.0 * 1024.0), ring ? ring->Dropped() : 0ull);
+
+            if (ImGui::Button("Start New Trace")) {
+                StopTrace();
+                if (!StartTrace()) LOG_ERROR("[IOTrace] Could not create trace file " + tracePath);
+            }
+            ImGui::Spacing();
+        }
+
+        OptimizationPatch::RenderCustomUI();
+    }
+};
+
+// Static member init
+bool IOTracePatch::traceAllFiles = false;
+std::unique_ptr<IOTrace::RecordRing> IOTracePatch::ring;
+std::mutex IOTracePatch::pendingFilesMutex;
+std::vector<IOTracePatch::PendingFile> IOTracePatch::pendingFiles;
+std::atomic<uint64_t> IOTracePatch::filesSeen{0};
+std::atomic<uint64_t> IOTracePatch::readCount{0};
+std::atomic<uint64_t> IOTracePatch::readBytes{0};
+std::atomic<uint64_t> IOTracePatch::blockedTicks{0};
+
+REGISTER_PATCH(IOTracePatch, {.displayName = "File I/O Trace",
+                                 .description = "Records every .package read the game makes to a trace file for tools/io_trace_analyze. For figuring out why loading screens are slow, leave it off otherwise.",
+                                 .category = "Diagnostic",
+                                 .experimental = true,
+                                 .supportedVersions = VERSION_ALL,
+                                 .technicalDetails = {"Detours CreateFileW, ReadFile, SetFilePointer(Ex) and NtClose through the shared FileHooks registry",
+                                     "Tracks each handle's file pointer so synchronous reads get their real offset",
+                                     "Hooks push 40 byte records into a lock-free ring, a background thread appends them to S3SS\\io_trace_<time>.s3io every 100ms",
+                                     "Records file, offset, size, thread, QPC timestamp and time spent inside ReadFile"}})
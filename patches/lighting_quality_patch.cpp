@@ -406,35 +406,35 @@ class LightingQualityPatch : public OptimizationPatch {
     static constexpr DWORD kOrigWallWidths[] = {256, 512, 1024};
     static constexpr DWORD kOrigWallHeights[] = {128, 256, 512};
 
-    static constexpr const char* kGetSubdivisionPattern = "8B 41 08 8B 04 85 ?? ?? ?? ?? C3";
+    static constexpr Signature::PatternLiteral kGetSubdivisionPattern = "8B 41 08 8B 04 85 ?? ?? ?? ?? C3";
     static constexpr int kSubdivisionAddrOffset = 6;
 
-    static constexpr const char* kCacheLightingParamsPattern = "53 8B 5C 24 08 56 8B F1 3B 9E CC 03 00 00 74";
+    static constexpr Signature::PatternLiteral kCacheLightingParamsPattern = "53 8B 5C 24 08 56 8B F1 3B 9E CC 03 00 00 74";
     static constexpr int kCacheJzOffset = 14;
 
     // kSoftWallShadows byte[3] at kBaseSubdivision - 0x08
     uintptr_t kSoftWallShadowsAddr = 0;
 
-    static constexpr const char* kNextHigherPow2Pattern = "B9 00 04 00 00 3B C8 1B C0 23 C1 03 C1 C3";
+    static constexpr Signature::PatternLiteral kNextHigherPow2Pattern = "B9 00 04 00 00 3B C8 1B C0 23 C1 03 C1 C3";
     uintptr_t nextHigherPow2Addr = 0;
 
-    static constexpr const char* kLightPointWithAllLightsPattern = "55 8B EC 83 E4 F0 83 EC ?? 0F 57 C0 8B 45 08 53 8B D9 8B 8B CC 00 00 00 2B 8B C8 00 00 00";
+    static constexpr Signature::PatternLiteral kLightPointWithAllLightsPattern = "55 8B EC 83 E4 F0 83 EC ?? 0F 57 C0 8B 45 08 53 8B D9 8B 8B CC 00 00 00 2B 8B C8 00 00 00";
     uintptr_t lightPointWithAllLightsAddr = 0;
 
-    static constexpr const char* kFinalizePrimePattern = "56 8B F1 57 8B BE F4 00 00 00 C1 E7 06 03 7E 04 8B CF E8";
+    static constexpr Signature::PatternLiteral kFinalizePrimePattern = "56 8B F1 57 8B BE F4 00 00 00 C1 E7 06 03 7E 04 8B CF E8";
     uintptr_t finalizePrimeAddr = 0;
 
-    static constexpr const char* kGetVisibleResPattern = "80 7C 24 0C 00 8B D1 74 ?? 8B 42 08 8B 0C 85";
+    static constexpr Signature::PatternLiteral kGetVisibleResPattern = "80 7C 24 0C 00 8B D1 74 ?? 8B 42 08 8B 0C 85";
     uintptr_t getVisibleResAddr = 0;
 
-    static constexpr const char* kBlurWallLightmapsPattern = "B8 44 40 00 00 E8 ?? ?? ?? ?? 56 8B F1 83 BE F4 00 00 00 02";
+    static constexpr Signature::PatternLiteral kBlurWallLightmapsPattern = "B8 44 40 00 00 E8 ?? ?? ?? ?? 56 8B F1 83 BE F4 00 00 00 02";
     static constexpr int kNumBlursAddrOffset = 0x20;
     uintptr_t numBlursAddr = 0;
 
     // Diagonal wall 3D occlusion flags: at kBaseSubdivision + 0x2A (surface type 2, LOD 1 & 2), this is probably wrong
     static constexpr uintptr_t kDiag3DOcclusionOffset = 0x2A;
 
-    static constexpr const char* kFuzzyEdgeFldPattern = "80 7D 14 00 74 ?? D9 05 ?? ?? ?? ?? 83 EC 08";
+    static constexpr Signature::PatternLiteral kFuzzyEdgeFldPattern = "80 7D 14 00 74 ?? D9 05 ?? ?? ?? ?? 83 EC 08";
     static constexpr int kFuzzyEdgeAddrOffset = 8;
     uintptr_t fuzzyEdgeFldAddr = 0;
 
@@ -658,9 +658,9 @@ class LightingQualityPatch : public OptimizationPatch {
             DWORD maxSub = static_cast<DWORD>(4 * multiplier);
 
             DWORD oldSub0 = currentSub[0], oldSub1 = currentSub[1], oldSub2 = currentSub[2];
-            ok &= PatchHelper::WriteDWORD(kBaseSubdivisionAddr, maxSub, &tx.locations, &oldSub0);
-            ok &= PatchHelper::WriteDWORD(kBaseSubdivisionAddr + 4, maxSub, &tx.locations, &oldSub1);
-            ok &= PatchHelper::WriteDWORD(kBaseSubdivisionAddr + 8, maxSub, &tx.locations, &oldSub2);
+            ok &= PatchHelper::WriteDWORD(kBaseSubdivisionAddr, maxSub, tx, &oldSub0);
+            ok &= PatchHelper::WriteDWORD(kBaseSubdivisionAddr + 4, maxSub, tx, &oldSub1);
+            ok &= PatchHelper::WriteDWORD(kBaseSubdivisionAddr + 8, maxSub, tx, &oldSub2);
             LOG_INFO(std::format("[LightingQualityPatch] kBaseSubdivision: {{{},{},{}}} -> {{{},{},{}}}", oldSub0, oldSub1, oldSub2, maxSub, maxSub, maxSub));
         }
 
@@ -669,7 +669,7 @@ class LightingQualityPatch : public OptimizationPatch {
             BYTE oldDiag = *reinterpret_cast<BYTE*>(kSeparateDiagonalsAddr + 2);
             if (oldDiag != 0) {
                 BYTE zero = 0;
-                ok &= PatchHelper::WriteByte(kSeparateDiagonalsAddr + 2, zero, &tx.locations, &oldDiag);
+                ok &= PatchHelper::WriteByte(kSeparateDiagonalsAddr + 2, zero, tx, &oldDiag);
                 LOG_INFO(std::format("[LightingQualityPatch] kSeparateDiagonals[2]: {} -> 0", oldDiag));
             }
         }
@@ -686,8 +686,8 @@ class LightingQualityPatch : public OptimizationPatch {
 
                 for (int i = 0; i < 3; i++) {
                     DWORD oldW = currentWallW[i], oldH = currentWallH[i];
-                    ok &= PatchHelper::WriteDWORD(wallWidthAddr + i * 4, newW, &tx.locations, &oldW);
-                    ok &= PatchHelper::WriteDWORD(wallHeightAddr + i * 4, newH, &tx.locations, &oldH);
+                    ok &= PatchHelper::WriteDWORD(wallWidthAddr + i * 4, newW, tx, &oldW);
+                    ok &= PatchHelper::WriteDWORD(wallHeightAddr + i * 4, newH, tx, &oldH);
                 }
                 LOG_INFO(
                     std::format("[LightingQualityPatch] Wall dims: {{{},{},{}}}x{{{},{},{}}} -> {}x{}", currentWallW[0], currentWallW[1], currentWallW[2], currentWallH[0], currentWallH[1], currentWallH[2], newW, newH));
@@ -697,14 +697,14 @@ class LightingQualityPatch : public OptimizationPatch {
         }
 
         // NOP the cache bypass JZ in CacheLightingParams
-        ok &= PatchHelper::WriteNOP(cacheBypassJzAddr, 2, &tx.locations);
+        ok &= PatchHelper::WriteNOP(cacheBypassJzAddr, 2, tx);
 
         // Patch kSoftWallShadows to enable soft shadow edges at all LODs
         if (softShadows > 0 && kSoftWallShadowsAddr != 0) {
             BYTE one = 1;
             for (int i = 0; i < 3; i++) {
                 BYTE oldVal = *reinterpret_cast<BYTE*>(kSoftWallShadowsAddr + i);
-                if (oldVal != 1) { ok &= PatchHelper::WriteByte(kSoftWallShadowsAddr + i, one, &tx.locations, &oldVal); }
+                if (oldVal != 1) { ok &= PatchHelper::WriteByte(kSoftWallShadowsAddr + i, one, tx, &oldVal); }
             }
             LOG_INFO("[LightingQualityPatch] kSoftWallShadows: -> {1, 1, 1}");
         }
@@ -738,7 +738,7 @@ class LightingQualityPatch : public OptimizationPatch {
                 0xC3, // RET
             };
             std::vector<BYTE> oldBytes(reinterpret_cast<BYTE*>(nextHigherPow2Addr), reinterpret_cast<BYTE*>(nextHigherPow2Addr) + doubleSbb.size());
-            ok &= PatchHelper::WriteBytes(nextHigherPow2Addr, doubleSbb, &tx.locations, &oldBytes);
+            ok &= PatchHelper::WriteBytes(nextHigherPow2Addr, doubleSbb, tx, &oldBytes);
             LOG_INFO(std::format("[LightingQualityPatch] NextHigherPow2 cap raised to 4096 at {:#010x}", nextHigherPow2Addr));
         }
 
@@ -748,8 +748,8 @@ class LightingQualityPatch : public OptimizationPatch {
             BYTE oldLod1 = *reinterpret_cast<BYTE*>(diagAddr + 1);
             BYTE oldLod2 = *reinterpret_cast<BYTE*>(diagAddr + 2);
             BYTE one = 1;
-            ok &= PatchHelper::WriteByte(diagAddr + 1, one, &tx.locations, &oldLod1);
-            ok &= PatchHelper::WriteByte(diagAddr + 2, one, &tx.locations, &oldLod2);
+            ok &= PatchHelper::WriteByte(diagAddr + 1, one, tx, &oldLod1);
+            ok &= PatchHelper::WriteByte(diagAddr + 2, one, tx, &oldLod2);
             LOG_INFO(std::format("[LightingQualityPatch] Diagonal 3D occlusion: LOD1 {}->1, LOD2 {}->1", oldLod1, oldLod2));
         }
 
@@ -757,7 +757,7 @@ class LightingQualityPatch : public OptimizationPatch {
         if (wallBlur > 0 && numBlursAddr != 0) {
             int newNumBlurs = 2 + wallBlur; // base 2 + user value
             DWORD oldVal = *reinterpret_cast<DWORD*>(numBlursAddr);
-            ok &= PatchHelper::WriteDWORD(numBlursAddr, static_cast<DWORD>(newNumBlurs), &tx.locations, &oldVal);
+            ok &= PatchHelper::WriteDWORD(numBlursAddr, static_cast<DWORD>(newNumBlurs), tx, &oldVal);
             LOG_INFO(std::format("[LightingQualityPatch] numBlurs: {} -> {}", oldVal, newNumBlurs));
         }
 
@@ -767,7 +767,7 @@ class LightingQualityPatch : public OptimizationPatch {
             uintptr_t patchAddr = fuzzyEdgeFldAddr + kFuzzyEdgeAddrOffset;
             DWORD oldAddrVal = *reinterpret_cast<DWORD*>(patchAddr);
             DWORD newAddrVal = reinterpret_cast<DWORD>(&g_fuzzyEdgeWidth);
-            ok &= PatchHelper::WriteDWORD(patchAddr, newAddrVal, &tx.locations, &oldAddrVal);
+            ok &= PatchHelper::WriteDWORD(patchAddr, newAddrVal, tx, &oldAddrVal);
             LOG_INFO(std::format("[LightingQualityPatch] fuzzyEdge redirected to {:#010x} = {:.2f}", newAddrVal, g_fuzzyEdgeWidth));
         }
 
@@ -0,0 +1,345 @@
+#include "../patch_system.h"
+#include "../logger.h"
+#include "../qol.h"
+#include "../utils.h"
+#include "../io/file_hooks.h"
+#include "../io/mapped_view_reader.h"
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cwctype>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// Copies read-only .package reads out of a sliding set of mapped views instead of a ReadFile each, see io/mapped_view_reader.h
+// Views come from a file mapping on the game's own handle. While anything has the same package open for writing its readers get
+// no views at all, a mapped section would make the writer's truncation fail
+class MappedPackageReadsPatch : public OptimizationPatch {
+  private:
+    // Touching a view or the game's buffer is where errors show up: an in-page error when the file's drive goes away, an access
+    // violation on a bad buffer. Either way the real ReadFile gets the read and reports it the way the game expects
+    static DWORD GuardedCopy(void* destination, const void* source, size_t size) {
+        __try {
+            memcpy(destination, source, size);
+            return 0;
+        } __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR || GetExceptionCode() == EXCEPTION_ACCESS_VIOLATION ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+            return GetExceptionCode();
+        }
+    }
+
+    class FileSource : public MappedViews::Source {
+      public:
+        explicit FileSource(HANDLE file) : file(file) {}
+        ~FileSource() override { CloseMapping(); }
+
+        bool Size(uint64_t& size) override {
+            if (!sizeKnown) {
+                LARGE_INTEGER value;
+                if (!GetFileSizeEx(file, &value)) {
+                    broken = true;
+                    return false;
+                }
+                cachedSize = static_cast<uint64_t>(value.QuadPart);
+                sizeKnown = true;
+            }
+            size = cachedSize;
+            return true;
+        }
+
+        const uint8_t* Map(uint64_t offset, uint32_t size) override {
+            if (!mapping) {
+                mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (!mapping) {
+                    broken = true;
+                    return nullptr;
+                }
+            }
+            // Failing here is usually address space running out, not worth giving up on the file for
+            return static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), size));
+        }
+
+        void Unmap(const uint8_t* view, uint32_t) override { UnmapViewOfFile(view); }
+
+        bool Copy(void* destination, const uint8_t* view, uint32_t size) override {
+            DWORD code = GuardedCopy(destination, view, size);
+            if (code == EXCEPTION_IN_PAGE_ERROR) broken = true;
+            return code == 0;
+        }
+
+        // Views have to be gone first. The size is looked up again next time, a writer may have changed it
+        void CloseMapping() {
+            if (mapping) CloseHandle(mapping);
+            mapping = nullptr;
+            sizeKnown = false;
+        }
+
+        bool Broken() const { return broken; }
+
+      private:
+        HANDLE file;
+        HANDLE mapping = nullptr;
+        uint64_t cachedSize = 0;
+        bool sizeKnown = false;
+        bool broken = false; // The file can't be mapped or a view read failed, reads on this handle stay plain
+    };
+
+    struct HandleState {
+        std::mutex mutex;
+        std::wstring key;
+        FileSource source;
+        MappedViews::AccessPattern pattern;
+        bool blocked = false; // Something has the package open for writing
+
+        HandleState(HANDLE file, std::wstring key, const MappedViews::Config& config) : key(std::move(key)), source(file), pattern(config) {}
+    };
+
+    static constexpr DWORD WRITE_ACCESS = GENERIC_WRITE | GENERIC_ALL | FILE_WRITE_DATA | FILE_APPEND_DATA;
+    static constexpr uint64_t MAX_VIEW_SPACE = 128ull << 20;      // Never more than this much address space in views, whatever the settings
+    static constexpr uint64_t LOW_ADDRESS_SPACE = 512ull << 20;   // Free address space below this drops every view
+    static constexpr uint64_t ADDRESS_SPACE_OK = 768ull << 20;    // and above this they come back
+    static constexpr ULONGLONG ADDRESS_CHECK_INTERVAL_MS = 1000;
+    static constexpr const char* USAGE_NAME = "Mapped package views";
+
+    static int windowKB;
+    static int windowCount;
+
+    std::unique_ptr<MappedViews::ViewPool> pool;
+    MappedViews::Config config;
+    std::shared_mutex handlesMutex;
+    std::unordered_map<uint32_t, std::shared_ptr<HandleState>> handles; // FileHooks id ->
+    std::unordered_map<std::wstring, uint32_t> writers;                   // Lowercase path -> handles open for writing
+    std::unordered_set<uint32_t> writerIds;
+
+    std::atomic<uint64_t> readCount{0};
+    std::atomic<uint64_t> servedCount{0};
+    ULONGLONG lastAddressCheck = 0;
+    uint64_t lastReportedBytes = 0;
+    bool addressSpaceLow = false;
+
+    static std::wstring Key(const std::wstring& path) {
+        std::wstring key = path;
+        std::transform(key.begin(), key.end(), key.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+        std::replace(key.begin(), key.end(), L'/', L'\\');
+        return key;
+    }
+
+    // Every reader of the package gives its views and mapping up, handlesMutex held exclusively
+    void BlockReaders(const std::wstring& key, bool blocked) {
+        for (auto& [id, state] : handles) {
+            if (state->key != key) continue;
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->blocked = blocked;
+            pool->Release(state->source);
+            state->source.CloseMapping();
+            state->pattern.Reset();
+        }
+    }
+
+    void OnOpened(const FileHooks::FileInfo& file) {
+        if (!file.isPackage) return;
+        std::wstring key = Key(file.path);
+
+        if (file.access & WRITE_ACCESS) {
+            std::unique_lock<std::shared_mutex> lock(handlesMutex);
+            writerIds.insert(file.id);
+            if (writers[key]++ == 0) BlockReaders(key, true);
+            return;
+        }
+        if (file.flagsAndAttributes & FILE_FLAG_OVERLAPPED) return;
+
+        auto state = std::make_shared<HandleState>(file.handle, key, config);
+        std::unique_lock<std::shared_mutex> lock(handlesMutex);
+        state->blocked = writers.count(key) != 0;
+        handles[file.id] = std::move(state);
+    }
+
+    bool OnReadFilter(FileHooks::ReadRequest& request) {
+        std::shared_ptr<HandleState> state;
+        {
+            std::shared_lock<std::shared_mutex> lock(handlesMutex);
+            auto it = handles.find(request.file.id);
+            if (it == handles.end()) return false;
+            state = it->second;
+        }
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->blocked || state->source.Broken()) return false;
+        readCount.fetch_add(1, std::memory_order_relaxed);
+        if (!state->pattern.Record(request.offset, request.requested)) return false;
+
+        uint32_t transferred = 0, mapped = 0;
+        bool served = pool->Read(state->source, request.offset, request.buffer, request.requested, transferred, &mapped);
+        state->pattern.Served(mapped);
+        if (!served) {
+            if (state->source.Broken()) {
+                pool->Release(state->source);
+                state->source.CloseMapping();
+                LOG_WARNING(std::format("[MappedPackageReads] Views failed for {}, reading it normally", Utils::WideToUtf8(request.file.path)));
+            }
+            return false;
+        }
+        servedCount.fetch_add(1, std::memory_order_relaxed);
+        request.transferred = transferred;
+        return true;
+    }
+
+    void OnClose(const FileHooks::FileInfo& file) {
+        std::unique_lock<std::shared_mutex> lock(handlesMutex);
+        if (writerIds.erase(file.id)) {
+            std::wstring key = Key(file.path);
+            auto it = writers.find(key);
+            if (it != writers.end() && --it->second == 0) {
+                writers.erase(it);
+                BlockReaders(key, false);
+            }
+            return;
+        }
+
+        auto it = handles.find(file.id);
+        if (it == handles.end()) return;
+        {
+            std::lock_guard<std::mutex> stateLock(it->second->mutex);
+            pool->Release(it->second->source);
+            it->second->source.CloseMapping();
+        }
+        handles.erase(it);
+    }
+
+  public:
+    MappedPackageReadsPatch() : OptimizationPatch("MappedPackageReads", nullptr) {
+        RegisterIntSetting(&windowKB, "windowKB", 1024, 256, 4096,
+            "Size of each mapped view (KB), rounded down to 64 KB.\n"
+            "Takes effect the next time the patch is enabled.");
+        RegisterIntSetting(&windowCount, "windowCount", 32, 4, 64,
+            "Views mapped at once across every open package, each package slides at most two of them.\n"
+            "windowKB x windowCount is capped at 128 MB of address space.");
+    }
+
+    bool Install() override {
+        if (isEnabled) return true;
+
+        lastError.clear();
+        LOG_INFO("[MappedPackageReads] Installing...");
+
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        config = {};
+        config.granularity = info.dwAllocationGranularity;
+        config.windowSize = std::max<uint32_t>(static_cast<uint32_t>(windowKB) << 10, config.granularity);
+        config.windowSize -= config.windowSize % config.granularity;
+        config.maxWindows = static_cast<uint32_t>(std::min<uint64_t>(windowCount, MAX_VIEW_SPACE / config.windowSize));
+        pool = std::make_unique<MappedViews::ViewPool>(config);
+        readCount.store(0, std::memory_order_relaxed);
+        servedCount.store(0, std::memory_order_relaxed);
+        lastAddressCheck = 0;
+        lastReportedBytes = 0;
+        addressSpaceLow = false;
+
+        // Early so a read served from a view never reaches the coalescer, the reads a view wouldn't pay for still do
+        if (!FileHooks::RegisterOpened(GetName(), [this](const FileHooks::FileInfo& file) { OnOpened(file); }) ||
+            !FileHooks::RegisterReadFilter(GetName(), [this](FileHooks::ReadRequest& request) { return OnReadFilter(request); }, FileHooks::Priority::Early) ||
+            !FileHooks::RegisterClose(GetName(), [this](const FileHooks::FileInfo& file) { OnClose(file); })) {
+            FileHooks::UnregisterAll(GetName());
+            handles.clear();
+            pool.reset();
+            return Fail("Failed to install file I/O hooks");
+        }
+
+        isEnabled = true;
+        LOG_INFO(std::format("[MappedPackageReads] Successfully installed ({} x {} KB views)", config.maxWindows, config.windowSize >> 10));
+        return true;
+    }
+
+    bool Uninstall() override {
+        if (!isEnabled) return true;
+
+        lastError.clear();
+        LOG_INFO("[MappedPackageReads] Uninstalling...");
+
+        // Views before the mappings they're in, and both before the pool
+        FileHooks::UnregisterAll(GetName());
+        {
+            std::unique_lock<std::shared_mutex> lock(handlesMutex);
+            for (auto& [id, state] : handles) pool->Release(state->source);
+            handles.clear();
+            writers.clear();
+            writerIds.clear();
+        }
+        pool.reset();
+        MemoryMonitor::Get().ReportUsage(USAGE_NAME, 0);
+
+        isEnabled = false;
+        LOG_INFO(std::format("[MappedPackageReads] Successfully uninstalled, {} of {} reads came from views", servedCount.load(), readCount.load()));
+        return true;
+    }
+
+    void Update() override {
+        OptimizationPatch::Update();
+        if (!isEnabled) return;
+
+        // The game runs out of address space long before it runs out of memory, views are the first thing to give back
+        ULONGLONG now = GetTickCount64();
+        if (now - lastAddressCheck >= ADDRESS_CHECK_INTERVAL_MS) {
+            lastAddressCheck = now;
+            MEMORYSTATUSEX status{sizeof(status)};
+            if (GlobalMemoryStatusEx(&status)) {
+                if (!addressSpaceLow && status.ullAvailVirtual < LOW_ADDRESS_SPACE) {
+                    addressSpaceLow = true;
+                    pool->SetLimit(0);
+                    LOG_WARNING(std::format("[MappedPackageReads] {} MB of address space left, dropping all views", status.ullAvailVirtual >> 20));
+                } else if (addressSpaceLow && status.ullAvailVirtual > ADDRESS_SPACE_OK) {
+                    addressSpaceLow = false;
+                    pool->SetLimit(config.maxWindows);
+                    LOG_INFO("[MappedPackageReads] Address space recovered, views back on");
+                }
+            }
+        }
+
+        uint64_t mappedBytes = pool->MappedBytes();
+        if (mappedBytes != lastReportedBytes) {
+            lastReportedBytes = mappedBytes;
+            MemoryMonitor::Get().ReportUsage(USAGE_NAME, mappedBytes);
+        }
+    }
+
+    void RenderCustomUI() override {
+        SAFE_IMGUI_BEGIN();
+
+        if (isEnabled) {
+            uint64_t reads = readCount.load(std::memory_order_relaxed);
+            uint64_t served = servedCount.load(std::memory_order_relaxed);
+            MappedViews::Stats stats = pool->GetStats();
+            size_t handleCount;
+            {
+                std::shared_lock<std::shared_mutex> lock(handlesMutex);
+                handleCount = handles.size();
+            }
+            ImGui::Text("Package reads: %llu  From views: %llu (%.1f%%)", reads, served, reads ? 100.0 * served / reads : 0.0);
+            ImGui::Text("Views: %u / %u  Mapped: %.1f MB  Maps: %llu  Handles: %zu", stats.windows, pool->Limit(), stats.mappedBytes / (1024.0 * 1024.0), stats.maps, handleCount);
+            if (addressSpaceLow) ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.0f, 1.0f), "Address space is low, views are off until it recovers");
+            ImGui::Spacing();
+        }
+
+        OptimizationPatch::RenderCustomUI();
+    }
+};
+
+// Static member init
+int MappedPackageReadsPatch::windowKB = 1024;
+int MappedPackageReadsPatch::windowCount = 32;
+
+REGISTER_PATCH(MappedPackageReadsPatch, {.displayName = "Mapped Package Reads",
+                                            .description = "Serves read-only .package reads from mapped views of the file while the game reads along it, instead of a ReadFile call each.",
+                                            .category = "Performance",
+                                            .experimental = true,
+                                            .supportedVersions = VERSION_ALL,
+                                            .technicalDetails = {"Read filter on the shared FileHooks ReadFile detour, read-only synchronous .package handles only",
+                                                "One pool of windowCount views of windowKB each across every package, a package slides at most two along as it reads",
+                                                "A handle only uses views while most recent reads start near where the last one ended, and goes back to ReadFile with a growing cooldown when its views don't get enough reads",
+                                                "All views are dropped while less than 512 MB of address space is free, and the mapped total shows in the QoL Memory Monitor",
+                                                "Readers of a package lose their views while any handle has it open for writing",
+                                                "tools/mapped_read_sim checks the view logic against fake files and estimates the saving from an I/O trace"}})
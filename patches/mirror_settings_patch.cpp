@@ -66,8 +66,8 @@ class MirrorSettingsPatch : public OptimizationPatch {
         std::memcpy(&oldBase, &origBaseDist, 4);
         std::memcpy(&oldScale, &origDistScale, 4);
 
-        ok &= PatchHelper::WriteDWORD(baseDistanceAddr, newBase, &tx.locations, &oldBase);
-        ok &= PatchHelper::WriteDWORD(distanceScaleAddr, newScale, &tx.locations, &oldScale);
+        ok &= PatchHelper::WriteDWORD(baseDistanceAddr, newBase, tx, &oldBase);
+        ok &= PatchHelper::WriteDWORD(distanceScaleAddr, newScale, tx, &oldScale);
 
         if (!ok || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
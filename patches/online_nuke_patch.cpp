@@ -45,7 +45,7 @@ class StoreFeaturedItemsDisablePatch : public OptimizationPatch {
         auto tx = PatchHelper::BeginTransaction();
 
         // RET (0xC3) at the start of the function - void __cdecl(void), no stack cleanup needed
-        if (!PatchHelper::WriteByte(*addr, 0xC3, &tx.locations)) {
+        if (!PatchHelper::WriteByte(*addr, 0xC3, tx)) {
             PatchHelper::RollbackTransaction(tx);
             return Fail("Failed to write RET byte");
         }
@@ -23,13 +23,13 @@ class OversizedThreadStackFix : public OptimizationPatch {
     static inline std::atomic<uint32_t> addressSpaceSaved = 0;
     static inline std::atomic<uint16_t> adjustedStackCount = 0;
 
+    // Only the stack shrinks, every watcher stays a real thread. Putting them all on one ReadDirectoryChangesW + completion port thread
+    // would need the game's watcher object (folder, filter, what it calls on a change) so its notifications could be dispatched without
+    // running threadProcedure, and none of that is mapped for any of the three exe versions. Running threadProcedure itself somewhere
+    // shared means fibers, which share a thread ID, TLS and critical section ownership the game's code relies on
     static uintptr_t __cdecl HookedBeginThreadEx(void* security, unsigned stackSize, unsigned(__stdcall* threadProcedure)(void*), void* arguments, unsigned flags, unsigned* threadID) {
         if (stackSize == 0) {
-            const auto exe = reinterpret_cast<uintptr_t>(GetModuleHandleW(nullptr));
-            const auto dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(exe);
-            const auto pe = reinterpret_cast<const IMAGE_NT_HEADERS*>(exe + dos->e_lfanew);
-
-            uint32_t defaultStackReserve = pe->OptionalHeader.SizeOfStackReserve;
+            uint32_t defaultStackReserve = static_cast<uint32_t>(PE::Image::Main().SizeOfStackReserve());
             uint32_t spaceSaved = defaultStackReserve >= sensibleStackReservation ? defaultStackReserve - sensibleStackReservation : 0;
 
             addressSpaceSaved.fetch_add(spaceSaved, std::memory_order_relaxed);
@@ -65,7 +65,7 @@ class OversizedThreadStackFix : public OptimizationPatch {
         std::memcpy(&address, reinterpret_cast<const uint8_t*>(_beginthreadexCall + 2), 4);
         originalBeginThreadEx = reinterpret_cast<decltype(originalBeginThreadEx)>(*address);
 
-        successful &= PatchHelper::WriteDWORD(_beginthreadexCall + 2, reinterpret_cast<uintptr_t>(&hookedBeginThreadEx), &tx.locations);
+        successful &= PatchHelper::WriteDWORD(_beginthreadexCall + 2, reinterpret_cast<uintptr_t>(&hookedBeginThreadEx), tx);
 
         if (!successful || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
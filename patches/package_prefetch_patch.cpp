@@ -0,0 +1,434 @@
+#include "../patch_system.h"
+#include "../logger.h"
+#include "../utils.h"
+#include "../config/config_paths.h"
+#include "../mapped_file.h"
+#include "../io/file_hooks.h"
+#include "../io/prefetch.h"
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Records which .package byte ranges a launch reads and in what order, then on the next launch reads them ahead of the game
+// on a background thread so its synchronous ReadFile calls land in the Windows file cache instead of waiting on the disk
+// Plan lives in S3SS\prefetch_plan.bin and is rewritten whenever a launch's biggest load so far goes quiet. tools/prefetch_sim replays traces against it
+class PackagePrefetchPatch : public OptimizationPatch {
+  private:
+    static constexpr ULONGLONG PLAN_IDLE_MS = 15000;          // No package reads for this long = that load is over
+    static constexpr size_t MAX_RECORDED_READS = 2'000'000;    // 32 MB of ObservedRead, far more than launch through a world load makes
+    static constexpr size_t MAX_OPEN_HANDLES = 64;             // Prefetch thread's own handles, least recently used closed first
+    static constexpr auto IDLE_POLL = std::chrono::milliseconds(20);
+
+    struct OpenFile {
+        uint32_t sessionPath; // Index into sessionPaths for the plan being recorded
+        int planFile;         // Index into the loaded plan, -1 if it isn't in it
+    };
+
+    struct CachedHandle {
+        uint32_t file;
+        HANDLE handle;
+        uint64_t lastUse;
+    };
+
+    static int lookaheadMB;
+    static thread_local bool isPrefetchThread; // The prefetch thread's own reads go through the same hooks, they mustn't count as the game's
+
+    std::string planPath;
+    Prefetch::Plan plan; // Read-only once the prefetch thread is running
+    Prefetch::Scheduler scheduler;
+    bool prefetching = false;
+    size_t staleFiles = 0;
+
+    // This session's reads, becomes the next plan
+    std::shared_mutex openFilesMutex;
+    std::unordered_map<uint32_t, OpenFile> openFiles; // FileHooks id ->
+    std::vector<std::string> sessionPaths;
+    std::mutex readsMutex;
+    std::vector<Prefetch::ObservedRead> reads;
+    std::atomic<bool> recording{false};
+    std::atomic<ULONGLONG> lastReadTick{0};
+    ULONGLONG burstEndTick = 0;     // lastReadTick of the quiet spell already handled
+    size_t burstStart = 0;          // First read of the load in progress
+    uint64_t largestBurstBytes = 0; // Biggest load seen this session, the plan is saved whenever one beats it
+    uint64_t loadedPlanBytes = 0;
+    std::string lastSave;
+
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable workerCV;
+    bool stopWorker = false;
+    std::atomic<uint32_t> handlesOpened{0};
+    std::atomic<uint32_t> readErrors{0};
+
+    void OnOpened(const FileHooks::FileInfo& file) {
+        if (isPrefetchThread || !file.isPackage) return;
+
+        std::string path = Utils::WideToUtf8(file.path);
+        int planFile = prefetching ? plan.FindFile(path) : -1;
+        std::unique_lock<std::shared_mutex> lock(openFilesMutex);
+        uint32_t sessionPath = static_cast<uint32_t>(sessionPaths.size());
+        if (recording.load(std::memory_order_relaxed)) sessionPaths.push_back(std::move(path));
+        openFiles[file.id] = {sessionPath, planFile};
+    }
+
+    void OnRead(const FileHooks::ReadContext& ctx) {
+        if (isPrefetchThread || !ctx.file.isPackage) return;
+
+        OpenFile open;
+        {
+            std::shared_lock<std::shared_mutex> lock(openFilesMutex);
+            auto it = openFiles.find(ctx.file.id);
+            if (it == openFiles.end()) return;
+            open = it->second;
+        }
+        lastReadTick.store(GetTickCount64(), std::memory_order_relaxed);
+
+        if (open.planFile >= 0) scheduler.OnGameRead(static_cast<uint32_t>(open.planFile), ctx.offset, ctx.requested);
+
+        if (recording.load(std::memory_order_relaxed) && ctx.requested) {
+            std::lock_guard<std::mutex> lock(readsMutex);
+            if (reads.size() < MAX_RECORDED_READS) reads.push_back({open.sessionPath, ctx.requested, ctx.offset});
+        }
+    }
+
+    void OnClose(const FileHooks::FileInfo& file) {
+        if (isPrefetchThread || !file.isPackage) return;
+        std::unique_lock<std::shared_mutex> lock(openFilesMutex);
+        openFiles.erase(file.id);
+    }
+
+    HANDLE GetHandle(std::vector<CachedHandle>& handles, uint32_t file, uint64_t tick, const std::vector<HANDLE>& busy) {
+        for (CachedHandle& cached : handles) {
+            if (cached.file == file) {
+                cached.lastUse = tick;
+                return cached.handle;
+            }
+        }
+
+        if (handles.size() >= MAX_OPEN_HANDLES) {
+            auto victim = handles.end();
+            for (auto it = handles.begin(); it != handles.end(); ++it) {
+                if (std::find(busy.begin(), busy.end(), it->handle) != busy.end()) continue;
+                if (victim == handles.end() || it->lastUse < victim->lastUse) victim = it;
+            }
+            if (victim != handles.end()) {
+                if (victim->handle != INVALID_HANDLE_VALUE) CloseHandle(victim->handle);
+                handles.erase(victim);
+            }
+        }
+
+        // Plain buffered read so the data stays in the file cache for the game's own handle. Failures are cached too so a deleted package isn't retried per range
+        HANDLE handle = CreateFileW(Utils::Utf8ToWide(plan.Files()[file].path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+            FILE_FLAG_OVERLAPPED, nullptr);
+        if (handle != INVALID_HANDLE_VALUE) handlesOpened.fetch_add(1, std::memory_order_relaxed);
+        handles.push_back({file, handle, tick});
+        return handle;
+    }
+
+    void WorkerThreadFunc() {
+        isPrefetchThread = true;
+        // Background mode drops I/O priority as well as CPU priority, the game's reads go first
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+        struct Slot {
+            OVERLAPPED overlapped{};
+            HANDLE event = nullptr;
+            HANDLE file = INVALID_HANDLE_VALUE;
+            std::vector<uint8_t> buffer;
+            Prefetch::Scheduler::Request request{};
+            bool busy = false;
+        };
+
+        Prefetch::Scheduler::Config config = SchedulerConfig();
+        std::vector<Slot> slots(config.maxInFlight);
+        for (Slot& slot : slots) {
+            slot.event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            slot.buffer.resize(config.chunkBytes);
+        }
+        std::vector<CachedHandle> handles;
+        std::vector<HANDLE> busyFiles, events;
+        uint64_t tick = 0;
+
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(workerMutex);
+                if (stopWorker) break;
+            }
+
+            busyFiles.clear();
+            for (const Slot& slot : slots) {
+                if (slot.busy) busyFiles.push_back(slot.file);
+            }
+
+            for (Slot& slot : slots) {
+                if (slot.busy || !slot.event) continue;
+                while (scheduler.Next(slot.request)) {
+                    HANDLE file = GetHandle(handles, slot.request.file, ++tick, busyFiles);
+                    if (file != INVALID_HANDLE_VALUE) {
+                        ResetEvent(slot.event);
+                        slot.overlapped = {};
+                        slot.overlapped.Offset = static_cast<DWORD>(slot.request.offset);
+                        slot.overlapped.OffsetHigh = static_cast<DWORD>(slot.request.offset >> 32);
+                        slot.overlapped.hEvent = slot.event;
+                        if (ReadFile(file, slot.buffer.data(), slot.request.size, nullptr, &slot.overlapped) || GetLastError() == ERROR_IO_PENDING) {
+                            slot.file = file;
+                            slot.busy = true;
+                            busyFiles.push_back(file);
+                            break;
+                        }
+                        readErrors.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    scheduler.Complete(slot.request);
+                }
+            }
+
+            events.clear();
+            for (const Slot& slot : slots) {
+                if (slot.busy) events.push_back(slot.event);
+            }
+
+            if (events.empty()) {
+                if (scheduler.Finished()) break;
+                // Window is full, wait for the game to catch up
+                std::unique_lock<std::mutex> lock(workerMutex);
+                workerCV.wait_for(lock, IDLE_POLL, [this] { return stopWorker; });
+                continue;
+            }
+
+            WaitForMultipleObjects(static_cast<DWORD>(events.size()), events.data(), FALSE, static_cast<DWORD>(IDLE_POLL.count()));
+            for (Slot& slot : slots) {
+                if (!slot.busy) continue;
+                DWORD transferred = 0;
+                if (!GetOverlappedResult(slot.file, &slot.overlapped, &transferred, FALSE)) {
+                    if (GetLastError() == ERROR_IO_INCOMPLETE) continue;
+                    if (GetLastError() != ERROR_HANDLE_EOF) readErrors.fetch_add(1, std::memory_order_relaxed);
+                }
+                slot.busy = false;
+                scheduler.Complete(slot.request);
+            }
+        }
+
+        for (Slot& slot : slots) {
+            if (slot.busy) {
+                DWORD transferred = 0;
+                CancelIoEx(slot.file, &slot.overlapped);
+                GetOverlappedResult(slot.file, &slot.overlapped, &transferred, TRUE);
+                scheduler.Complete(slot.request);
+            }
+            if (slot.event) CloseHandle(slot.event);
+        }
+        for (const CachedHandle& cached : handles) {
+            if (cached.handle != INVALID_HANDLE_VALUE) CloseHandle(cached.handle);
+        }
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+    }
+
+    Prefetch::Scheduler::Config SchedulerConfig() const {
+        Prefetch::Scheduler::Config config;
+        config.lookaheadBytes = static_cast<uint64_t>(lookaheadMB) << 20;
+        return config;
+    }
+
+    void StopWorker() {
+        {
+            std::lock_guard<std::mutex> lock(workerMutex);
+            stopWorker = true;
+        }
+        workerCV.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    // Loads last launch's plan and leaves out any package that changed since (replaced CC, patched game files)
+    void LoadPlan() {
+        prefetching = false;
+        staleFiles = 0;
+        loadedPlanBytes = 0;
+        if (!plan.Load(Utils::ToPath(planPath))) {
+            LOG_INFO("[PackagePrefetch] No plan yet, recording this launch's loads for the next one");
+            return;
+        }
+
+        for (uint32_t i = 0; i < plan.Files().size(); i++) {
+            const Prefetch::PlanFile& file = plan.Files()[i];
+            uint64_t size = 0;
+            int64_t mtime = 0;
+            if (!StatFile(Utils::ToPath(file.path), size, mtime) || size != file.size || mtime != file.mtime) {
+                plan.DisableFile(i);
+                staleFiles++;
+            }
+        }
+
+        loadedPlanBytes = plan.TotalBytes();
+        prefetching = !plan.Ranges().empty();
+        if (prefetching) scheduler.Start(plan, SchedulerConfig());
+        LOG_INFO(std::format("[PackagePrefetch] Plan: {} packages, {} ranges, {:.1f} MB ({} packages changed since it was recorded)", plan.Files().size() - staleFiles, plan.Ranges().size(),
+            plan.TotalBytes() / (1024.0 * 1024.0), staleFiles));
+    }
+
+    // Turns every read since launch into the plan for the next one, so the plan replays the menu reads in front of the load that made it worth saving
+    // A session that never got past the menu doesn't get to replace a plan that covers a world load, unless it's saved by hand
+    void SavePlan(bool manual) {
+        std::vector<std::string> paths;
+        std::vector<Prefetch::ObservedRead> observed;
+        {
+            std::shared_lock<std::shared_mutex> lock(openFilesMutex);
+            paths = sessionPaths;
+        }
+        {
+            std::lock_guard<std::mutex> lock(readsMutex);
+            observed = reads;
+        }
+        if (observed.empty()) return;
+
+        Prefetch::Plan next = Prefetch::Plan::Build(paths, observed);
+        for (uint32_t i = 0; i < next.Files().size(); i++) {
+            Prefetch::PlanFile& file = next.Files()[i];
+            if (!StatFile(Utils::ToPath(file.path), file.size, file.mtime)) next.DisableFile(i);
+        }
+        if (!manual && next.TotalBytes() < loadedPlanBytes / 2) {
+            LOG_INFO(std::format("[PackagePrefetch] Kept the existing plan, this session's loads ({:.1f} MB) are far smaller than it", next.TotalBytes() / (1024.0 * 1024.0)));
+            return;
+        }
+
+        if (next.Save(Utils::ToPath(planPath))) {
+            lastSave = std::format("{} packages, {} ranges, {:.1f} MB from {} reads", next.Files().size(), next.Ranges().size(), next.TotalBytes() / (1024.0 * 1024.0), observed.size());
+            LOG_INFO("[PackagePrefetch] Saved plan: " + lastSave);
+        } else {
+            lastSave = "failed to write " + planPath;
+            LOG_WARNING("[PackagePrefetch] Failed to write " + planPath);
+        }
+    }
+
+  public:
+    PackagePrefetchPatch() : OptimizationPatch("PackagePrefetch", nullptr) {
+        RegisterIntSetting(&lookaheadMB, "lookaheadMB", 64, 8, 512,
+            "How far ahead of the game to read (MB).\n"
+            "More hides more disk latency but uses more of the file cache, and reads more for nothing if this load goes differently from the recorded one.");
+    }
+
+    bool Install() override {
+        if (isEnabled) return true;
+
+        lastError.clear();
+        LOG_INFO("[PackagePrefetch] Installing...");
+
+        planPath = Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory()) + "prefetch_plan.bin";
+        LoadPlan();
+
+        openFiles.clear();
+        sessionPaths.clear();
+        reads.clear();
+        lastReadTick.store(0, std::memory_order_relaxed);
+        burstEndTick = 0;
+        burstStart = 0;
+        largestBurstBytes = 0;
+        recording.store(true);
+
+        if (!FileHooks::RegisterOpened(GetName(), [this](const FileHooks::FileInfo& file) { OnOpened(file); }) ||
+            !FileHooks::RegisterRead(GetName(), [this](const FileHooks::ReadContext& ctx) { OnRead(ctx); }) ||
+            !FileHooks::RegisterClose(GetName(), [this](const FileHooks::FileInfo& file) { OnClose(file); })) {
+            FileHooks::UnregisterAll(GetName());
+            recording.store(false);
+            return Fail("Failed to install file I/O hooks");
+        }
+
+        if (prefetching) {
+            stopWorker = false;
+            worker = std::thread(&PackagePrefetchPatch::WorkerThreadFunc, this);
+        }
+
+        isEnabled = true;
+        LOG_INFO("[PackagePrefetch] Successfully installed");
+        return true;
+    }
+
+    bool Uninstall() override {
+        if (!isEnabled) return true;
+
+        lastError.clear();
+        LOG_INFO("[PackagePrefetch] Uninstalling...");
+
+        StopWorker();
+        FileHooks::UnregisterAll(GetName());
+        recording.store(false);
+        prefetching = false;
+
+        isEnabled = false;
+        LOG_INFO("[PackagePrefetch] Successfully uninstalled");
+        return true;
+    }
+
+    void Update() override {
+        OptimizationPatch::Update();
+        if (!isEnabled || !recording.load(std::memory_order_relaxed)) return;
+
+        // Every quiet spell ends a load. The first is the main menu, so keep recording and save each time a load beats the biggest so far,
+        // which is normally the world load. Later, smaller ones (travel, CAS) depend on what the player does and are left alone
+        ULONGLONG lastRead = lastReadTick.load(std::memory_order_relaxed);
+        if (lastRead == 0 || lastRead == burstEndTick || GetTickCount64() - lastRead < PLAN_IDLE_MS) return;
+        burstEndTick = lastRead;
+
+        uint64_t burstBytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(readsMutex);
+            for (size_t i = burstStart; i < reads.size(); i++) burstBytes += reads[i].size;
+            burstStart = reads.size();
+        }
+        if (burstBytes <= largestBurstBytes) return;
+        largestBurstBytes = burstBytes;
+        SavePlan(false);
+    }
+
+    void RenderCustomUI() override {
+        SAFE_IMGUI_BEGIN();
+
+        if (isEnabled) {
+            if (prefetching) {
+                auto stats = scheduler.GetStats();
+                ImGui::Text("Plan: %u ranges, %.1f MB  Game at range %u, prefetch at %u%s", stats.rangeCount, plan.TotalBytes() / (1024.0 * 1024.0), stats.position, stats.cursor,
+                    stats.abandoned ? " (abandoned, this load doesn't match the plan)" : "");
+                ImGui::Text("Prefetched: %.1f MB  Skipped: %llu ranges  Handles: %u  Errors: %u", stats.completedBytes / (1024.0 * 1024.0), stats.skippedRanges,
+                    handlesOpened.load(std::memory_order_relaxed), readErrors.load(std::memory_order_relaxed));
+                ImGui::Text("Game reads: %llu  Already read ahead: %llu  In flight: %llu  Not in plan: %llu", stats.gameReads, stats.gameHits, stats.gameInFlight, stats.gameOffPlan);
+            } else {
+                ImGui::Text("No plan loaded, recording this launch");
+            }
+            if (staleFiles) ImGui::Text("%zu packages changed since the plan was recorded and were left out", staleFiles);
+
+            if (recording.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(readsMutex);
+                ImGui::Text("Recording: %zu reads, biggest load %.1f MB (saved after %llu s without package reads when a load beats it)", reads.size(),
+                    largestBurstBytes / (1024.0 * 1024.0), PLAN_IDLE_MS / 1000);
+            }
+            if (!lastSave.empty()) ImGui::Text("Next launch's plan: %s", lastSave.c_str());
+            if (recording.load(std::memory_order_relaxed) && ImGui::Button("Save Plan Now")) SavePlan(true);
+            ImGui::Spacing();
+        }
+
+        OptimizationPatch::RenderCustomUI();
+    }
+};
+
+// Static member init
+int PackagePrefetchPatch::lookaheadMB = 64;
+thread_local bool PackagePrefetchPatch::isPrefetchThread = false;
+
+REGISTER_PATCH(PackagePrefetchPatch, {.displayName = "Package Read-Ahead",
+                                         .description = "Remembers which parts of which .package files the loading screen reads and reads them ahead of the game on the next launch, so cold loads mostly hit the file cache.",
+                                         .category = "Performance",
+                                         .experimental = true,
+                                         .supportedVersions = VERSION_ALL,
+                                         .technicalDetails = {"Records every .package read (file, offset, size) through the shared FileHooks registry, a load ends when reads stop for 15s",
+                                             "Saves everything read up to the end of the session's biggest load, so the plan covers the world load rather than the main menu",
+                                             "Merges nearby reads into up to 4 MB ranges in first-use order, saved to S3SS\\prefetch_plan.bin with each package's size and timestamp",
+                                             "Next launch, a background-priority thread issues overlapped buffered reads up to lookaheadMB ahead of the game's position in the plan",
+                                             "Skips ranges the game reached first, drops changed packages and gives up if the load stops matching the plan",
+                                             "tools/prefetch_sim replays I/O traces against a simulated disk to estimate the gain"}})
@@ -0,0 +1,201 @@
+#include "../patch_system.h"
+#include "../logger.h"
+#include "../io/file_hooks.h"
+#include "../io/read_coalescer.h"
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+// Serves runs of small adjacent .package reads out of one bigger aligned read per handle, see io/read_coalescer.h
+// Only read-only synchronous handles get it. Writes to the same file through any other handle drop the affected blocks
+class ReadCoalescingPatch : public OptimizationPatch {
+  private:
+    struct HandleState {
+        std::mutex mutex;
+        std::wstring path;
+        ReadCoalescing::HandleCache cache;
+
+        HandleState(const std::wstring& path, const ReadCoalescing::Config& config, ReadCoalescing::MemoryBudget* budget) : path(path), cache(config, budget) {}
+    };
+
+    // Block fills go straight to the real ReadFile on the game's own handle, positional so its file pointer is left alone
+    class HookBackend : public ReadCoalescing::Backend {
+      public:
+        explicit HookBackend(const FileHooks::FileInfo& file) : file(file) {}
+
+        bool ReadAt(uint64_t offset, void* buffer, uint32_t size, uint32_t& transferred) override {
+            DWORD read = 0;
+            bool ok = FileHooks::ReadAt(file, offset, buffer, size, read);
+            transferred = read;
+            return ok;
+        }
+
+      private:
+        const FileHooks::FileInfo& file;
+    };
+
+    static constexpr DWORD WRITE_ACCESS = GENERIC_WRITE | GENERIC_ALL | FILE_WRITE_DATA | FILE_APPEND_DATA;
+
+    static int blockKB;
+    static int budgetMB;
+
+    ReadCoalescing::Config config;
+    std::unique_ptr<ReadCoalescing::MemoryBudget> budget;
+    std::shared_mutex handlesMutex;
+    std::unordered_map<uint32_t, std::shared_ptr<HandleState>> handles; // FileHooks id ->
+
+    std::atomic<uint64_t> readCount{0};
+    std::atomic<uint64_t> servedCount{0};
+    std::atomic<uint64_t> filledCount{0};
+    std::atomic<uint64_t> invalidations{0};
+
+    void OnOpened(const FileHooks::FileInfo& file) {
+        if (!file.isPackage || (file.access & WRITE_ACCESS) || (file.flagsAndAttributes & FILE_FLAG_OVERLAPPED)) return;
+        auto state = std::make_shared<HandleState>(file.path, config, budget.get());
+        std::unique_lock<std::shared_mutex> lock(handlesMutex);
+        handles[file.id] = std::move(state);
+    }
+
+    bool OnReadFilter(FileHooks::ReadRequest& request) {
+        std::shared_ptr<HandleState> state;
+        {
+            std::shared_lock<std::shared_mutex> lock(handlesMutex);
+            auto it = handles.find(request.file.id);
+            if (it == handles.end()) return false;
+            state = it->second;
+        }
+
+        HookBackend backend(request.file);
+        uint32_t transferred = 0;
+        ReadCoalescing::Result result;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            result = state->cache.Read(backend, request.offset, request.buffer, request.requested, transferred);
+        }
+
+        readCount.fetch_add(1, std::memory_order_relaxed);
+        if (result == ReadCoalescing::Result::PassThrough) return false;
+        (result == ReadCoalescing::Result::Served ? servedCount : filledCount).fetch_add(1, std::memory_order_relaxed);
+        request.transferred = transferred;
+        return true;
+    }
+
+    // A write can come through any tracked handle on the package, not just the one being read
+    void OnWrite(const FileHooks::WriteContext& ctx) {
+        if (!ctx.file.isPackage) return;
+        std::shared_lock<std::shared_mutex> lock(handlesMutex);
+        for (auto& [id, state] : handles) {
+            if (_wcsicmp(state->path.c_str(), ctx.file.path.c_str()) != 0) continue;
+            std::lock_guard<std::mutex> stateLock(state->mutex);
+            state->cache.Invalidate(ctx.offset, std::max<uint64_t>(ctx.requested, 1));
+            invalidations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void OnClose(const FileHooks::FileInfo& file) {
+        std::unique_lock<std::shared_mutex> lock(handlesMutex);
+        handles.erase(file.id);
+    }
+
+  public:
+    ReadCoalescingPatch() : OptimizationPatch("ReadCoalescing", nullptr) {
+        RegisterIntSetting(&blockKB, "blockKB", 64, 16, 256,
+            "Size of the block fetched once small reads start running together (KB).\n"
+            "Reads up to a quarter of this are served from blocks. Takes effect the next time the patch is enabled.");
+        RegisterIntSetting(&budgetMB, "budgetMB", 16, 1, 64,
+            "Memory for blocks across every open package (MB). Each handle holds at most two blocks,\n"
+            "handles that can't get one just read normally.");
+    }
+
+    bool Install() override {
+        if (isEnabled) return true;
+
+        lastError.clear();
+        LOG_INFO("[ReadCoalescing] Installing...");
+
+        config = {};
+        config.blockSize = static_cast<uint32_t>(blockKB) << 10;
+        config.maxReadSize = config.blockSize / 4;
+        budget = std::make_unique<ReadCoalescing::MemoryBudget>(static_cast<uint64_t>(budgetMB) << 20);
+        readCount.store(0, std::memory_order_relaxed);
+        servedCount.store(0, std::memory_order_relaxed);
+        filledCount.store(0, std::memory_order_relaxed);
+        invalidations.store(0, std::memory_order_relaxed);
+
+        if (!FileHooks::RegisterOpened(GetName(), [this](const FileHooks::FileInfo& file) { OnOpened(file); }) ||
+            !FileHooks::RegisterReadFilter(GetName(), [this](FileHooks::ReadRequest& request) { return OnReadFilter(request); }) ||
+            !FileHooks::RegisterWrite(GetName(), [this](const FileHooks::WriteContext& ctx) { OnWrite(ctx); }, FileHooks::Priority::First) ||
+            !FileHooks::RegisterClose(GetName(), [this](const FileHooks::FileInfo& file) { OnClose(file); })) {
+            FileHooks::UnregisterAll(GetName());
+            handles.clear();
+            budget.reset();
+            return Fail("Failed to install file I/O hooks");
+        }
+
+        isEnabled = true;
+        LOG_INFO(std::format("[ReadCoalescing] Successfully installed ({} KB blocks, {} MB budget)", blockKB, budgetMB));
+        return true;
+    }
+
+    bool Uninstall() override {
+        if (!isEnabled) return true;
+
+        lastError.clear();
+        LOG_INFO("[ReadCoalescing] Uninstalling...");
+
+        // Blocks hand their memory back to the budget as they go, so they go first
+        FileHooks::UnregisterAll(GetName());
+        {
+            std::unique_lock<std::shared_mutex> lock(handlesMutex);
+            handles.clear();
+        }
+        budget.reset();
+
+        isEnabled = false;
+        LOG_INFO(std::format("[ReadCoalescing] Successfully uninstalled, {} of {} reads never reached ReadFile", servedCount.load(), readCount.load()));
+        return true;
+    }
+
+    void RenderCustomUI() override {
+        SAFE_IMGUI_BEGIN();
+
+        if (isEnabled) {
+            uint64_t reads = readCount.load(std::memory_order_relaxed);
+            uint64_t served = servedCount.load(std::memory_order_relaxed);
+            uint64_t filled = filledCount.load(std::memory_order_relaxed);
+            size_t handleCount;
+            {
+                std::shared_lock<std::shared_mutex> lock(handlesMutex);
+                handleCount = handles.size();
+            }
+            ImGui::Text("Package reads: %llu  Served from blocks: %llu  Block fills: %llu", reads, served, filled);
+            ImGui::Text("ReadFile calls saved: %llu (%.1f%%)", served, reads ? 100.0 * served / reads : 0.0);
+            ImGui::Text("Handles: %zu  Block memory: %.1f / %d MB  Write invalidations: %llu", handleCount, budget ? budget->InUse() / (1024.0 * 1024.0) : 0.0, budgetMB,
+                invalidations.load(std::memory_order_relaxed));
+            ImGui::Spacing();
+        }
+
+        OptimizationPatch::RenderCustomUI();
+    }
+};
+
+// Static member init
+int ReadCoalescingPatch::blockKB = 64;
+int ReadCoalescingPatch::budgetMB = 16;
+
+REGISTER_PATCH(ReadCoalescingPatch, {.displayName = "Package Read Coalescing",
+                                        .description = "Serves runs of small adjacent .package reads from one bigger read instead of a ReadFile call each. Fewer syscalls while loading.",
+                                        .category = "Performance",
+                                        .experimental = true,
+                                        .supportedVersions = VERSION_ALL,
+                                        .technicalDetails = {"Read filter on the shared FileHooks ReadFile detour, read-only synchronous .package handles only",
+                                            "Once two small reads on a handle are adjacent, the next one fetches a 4 KB aligned block of blockKB and later reads are copied out of it",
+                                            "At most two blocks per handle and budgetMB in total, a read that isn't adjacent drops blocks it isn't in",
+                                            "Block fills are positional reads, the game's file pointer is only caught up when something depends on it",
+                                            "Any WriteFile to the same package through any handle drops the overlapping blocks",
+                                            "tools/read_coalesce_sim checks the block logic against fake files and estimates the saving from an I/O trace"}})
@@ -2,11 +2,20 @@
 #include "../patch_helpers.h"
 #include "../logger.h"
 #include "../optimization.h"
+#include "../utils.h"
+#include "../config/config_paths.h"
+#include "../refpack/refpack_decoder.h"
+#include "../refpack/refpack_cache.h"
+#include "../refpack/refpack_disk_cache.h"
+#include "../refpack/refpack_telemetry.h"
+#include "../fast_hash.h"
 #include <windows.h>
 #include <cstdint>
 #include <vector>
-#include <immintrin.h>
-// my magnum opus I fear
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <intrin.h>
 
 // There are probably other optimisations (PGO??? idk what that is but sure) but for now I am never touching this again ever
 class RefPackDecompressorPatch : public OptimizationPatch {
@@ -27,236 +36,207 @@ class RefPackDecompressorPatch : public OptimizationPatch {
     static RefPackDecompressorPatch* instance;
     static bool cpuHasAVX2;
 
-    // Strategy structs, compiler inlines these directly into template instantiations instead of causing indirect jump if we did function pointer h-haha... Totally worth it...
-    // We use these because some people can't use AVX2 :( BOOOOOOOOOOOOOOOOO
-    struct StrategySSE2 {
-        static __forceinline void Copy(uint8_t* dst, const uint8_t* src, uint32_t len) {
-            uint8_t* d = dst;
-            const uint8_t* s = src;
-            while (len >= 16) {
-                _mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
-                d += 16;
-                s += 16;
-                len -= 16;
-            }
-            while (len--) *d++ = *s++;
-        }
-    };
-
-    struct StrategyAVX2 {
-        static __forceinline void Copy(uint8_t* dst, const uint8_t* src, uint32_t len) {
-            uint8_t* d = dst;
-            const uint8_t* s = src;
-            // 32-byte chunks (AVX2)
-            while (len >= 32) {
-                _mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
-                d += 32;
-                s += 32;
-                len -= 32;
-            }
-            // 16-byte chunks (SSE2)
-            while (len >= 16) {
-                _mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
-                d += 16;
-                s += 16;
-                len -= 16;
-            }
-            // Tail
-            while (len--) *d++ = *s++;
-        }
-    };
-
-    template <typename Strategy> static __forceinline void CopyOverlapping(uint8_t* dst, const uint8_t* src, uint32_t len) {
-        ptrdiff_t offset = dst - src;
-
-        // For RLE (offset < len), src is 'history' relative to dst
-        // As long as offset >= 32, the 32-byte load reads data that was written at least 32 bytes ago
-        // Since we write 32 bytes at a time, we never overwrite data we are about to read in the SAME iteration... we pray
-        if (offset >= 32) {
-            Strategy::Copy(dst, src, len);
-        } else if (offset >= 16) {
-            while (len >= 16) {
-                _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
-                dst += 16;
-                src += 16;
-                len -= 16;
-            }
-            while (len--) *dst++ = *src++;
+    // Corpus capture for tools/refpack_bench, dumps the raw compressed inputs so real game data can be replayed off the game
+    static constexpr uint32_t CAPTURE_LIMIT = 512;
+    static bool captureCorpus;
+    static std::atomic<uint32_t> capturedCount;
+
+    // Decoded resource cache, budget is in MB and capped well below what a 32-bit process can spare
+    static constexpr int CACHE_BUDGET_MAX_MB = 256;
+    static constexpr uint32_t CACHE_MIN_SIZE = 4096; // Small resources decode faster than they hash + copy
+    static int cacheBudgetMB;
+    static RefPack::DecodeCache decodeCache;
+    bool keepCacheOnUninstall = false; // Set around a settings reinstall so the cache survives it and only gets trimmed
+
+    // Persistent cache of the hottest resources, fed from decodeCache and rewritten on a background thread once loading goes quiet
+    // Checked after the memory cache, a hit maps a view of just that payload and gets copied into the memory cache as well
+    static constexpr int DISK_CACHE_MAX_MB = 512; // Disk space only, nothing stays mapped between hits
+    static constexpr uint32_t DISK_CACHE_MIN_SIZE = 16384; // Mapping a view is a fixed cost, tools/refpack_bench has a 4 KB hit no faster than decoding it
+    static constexpr ULONGLONG DISK_CACHE_IDLE_MS = 10000;
+    static constexpr ULONGLONG DISK_CACHE_MIN_INTERVAL_MS = 120000;
+    static int diskCacheMB;
+    static bool diskCacheActive;
+    static RefPack::DiskCache diskCache;
+    static std::atomic<ULONGLONG> lastDispatchTick;
+    ULONGLONG lastDiskWriteTick = 0;
+    std::thread diskWriter;
+    std::atomic<bool> diskWriting{false};
+
+    // Per-call telemetry, off by default since it adds two rdtsc + a handful of atomics to every call
+    static bool collectTelemetry;
+    static RefPack::Telemetry telemetry;
+
+    static std::filesystem::path GetDiskCachePath() { return Utils::ToPath(Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory()) + "refpack_cache.bin"); }
+
+    // Reads back every kept entry and writes the whole file, seconds with a full cache, so never on the game thread
+    void WriteDiskCache() {
+        auto hot = decodeCache.SnapshotHot(2);
+        std::erase_if(hot, [](const RefPack::CachedResource& r) { return r.key.decompressedSize < DISK_CACHE_MIN_SIZE; });
+        if (diskCache.Rewrite(hot, (size_t)diskCacheMB << 20)) {
+            LOG_INFO(std::format("[RefPackDecompressor] Saved disk cache: {} resources", diskCache.GetStats().entries));
         } else {
-            // Tight byte-copy loop for small overlaps
-            while (len--) *dst++ = *src++;
+            LOG_WARNING("[RefPackDecompressor] Failed to write disk cache");
         }
+        diskWriting.store(false);
     }
 
-    template <typename Strategy> static int DecompressImpl(uint8_t* __restrict dst, uint32_t dstSize, uint8_t* __restrict src, uint32_t srcSize) {
-        // Basic sanity checks
-        if (!dst || !src || srcSize < 2) return 0;
-
-        uint8_t* dstStart = dst;
-        uint8_t* dstEnd = dst + dstSize;
-        uint8_t* srcEnd = src + srcSize;
+    static std::string GetCorpusDirectory() { return Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory()) + "refpack_corpus\\"; }
 
-        // Header parsing + validation
-        // We MUST validate the header to ensure we don't overrun input or output
-        uint16_t header = (src[0] << 8) | src[1];
-        src += 2;
-        // srcSize tracked implicitly by pointer comparison now, but we need to check initial header read
-        // (Checked by srcSize < 2 above)
+    static void CaptureInput(const uint8_t* src, uint32_t srcSize) {
+        uint32_t index = capturedCount.fetch_add(1, std::memory_order_relaxed);
+        if (index >= CAPTURE_LIMIT) return;
 
-        uint32_t skipBytes = 0;
-        uint32_t sizeBytes = 3;
+        std::ofstream out(Utils::ToPath(GetCorpusDirectory() + std::format("{:05}.refpack", index)), std::ios::binary);
+        if (out) out.write(reinterpret_cast<const char*>(src), srcSize);
+    }
 
-        if (header & 0x8000) {
-            skipBytes = (header & 0x100) ? 4 : 0;
-            sizeBytes = 4;
-        } else {
-            skipBytes = (header & 0x100) ? 3 : 0;
-            sizeBytes = 3;
+    static int Decompress(uint8_t* dst, uint32_t dstSize, uint8_t* src, uint32_t srcSize, RefPack::Telemetry::Source& source) {
+        RefPack::CacheKey cacheKey;
+        bool cacheable = false;
+        if (cacheBudgetMB > 0 || diskCacheActive) {
+            uint32_t expectedSize = RefPack::ReadDecompressedSize(src, srcSize);
+            if (expectedSize >= CACHE_MIN_SIZE && expectedSize <= dstSize) {
+                cacheKey = {FastHash::Hash32(src, srcSize), srcSize, expectedSize};
+                cacheable = cacheBudgetMB > 0;
+                // Memory first, a memcpy beats mapping a view of the disk cache
+                if (cacheable && decodeCache.Lookup(cacheKey, dst, dstSize)) {
+                    source = RefPack::Telemetry::Source::MemoryCache;
+                    return (int)expectedSize;
+                }
+                if (diskCacheActive) {
+                    lastDispatchTick.store(GetTickCount64(), std::memory_order_relaxed);
+                    if (expectedSize >= DISK_CACHE_MIN_SIZE && diskCache.Lookup(cacheKey, dst, dstSize)) {
+                        // Kept in memory too so the next use doesn't touch the file again
+                        if (cacheable) decodeCache.Insert(cacheKey, dst, expectedSize, (size_t)cacheBudgetMB << 20);
+                        source = RefPack::Telemetry::Source::DiskCache;
+                        return (int)expectedSize;
+                    }
+                }
+            }
         }
 
-        // Validate header read bounds
-        if (src + skipBytes + sizeBytes > srcEnd) return 0;
-
-        src += skipBytes;
-
-        // Read expected size to validate against buffer size
-        uint32_t expectedSize = 0;
-        if (sizeBytes == 4) {
-            expectedSize = (src[0] << 24) | (src[1] << 16) | (src[2] << 8) | src[3];
-            src += 4;
+        int result;
+        if (cpuHasAVX2) {
+            result = RefPack::DecompressImpl<RefPack::StrategyAVX2>(dst, dstSize, src, srcSize);
         } else {
-            expectedSize = (src[0] << 16) | (src[1] << 8) | src[2];
-            src += 3;
-        }
-
-        // Validate output buffer size
-        // If the caller provided a buffer smaller than the decompressed size, fail asap
-        if (expectedSize > dstSize) {
-            // Log error? For now just return 0 to match original behavior on error, really doubt this ever gets hit anyway
-            return 0;
+            result = RefPack::DecompressImpl<RefPack::StrategySSE2>(dst, dstSize, src, srcSize);
         }
 
-        // main loop
-        while (src < srcEnd) {
-            // Ensure we can read at least the command byte
-            if (src >= srcEnd) break;
-
-            uint8_t cmd = *src++;
-
-            // Type 1: Short Backref (0x00-0x7F)
-            if (cmd < 0x80) {
-                if (src >= srcEnd) goto error_truncated;
-                uint8_t offset_low = *src++;
-
-                uint32_t literal_len = cmd & 0x3;
-                uint32_t match_len = ((cmd >> 2) & 0x7) + 3;
-                uint32_t offset = (((cmd & 0x60) << 3) | offset_low) + 1;
-
-                // Literal Copy
-                if (literal_len) {
-                    // Bounds check: input and output
-                    if (src + literal_len > srcEnd || dst + literal_len > dstEnd) goto error_overflow;
+        if (cacheable && result > 0) decodeCache.Insert(cacheKey, dst, (uint32_t)result, (size_t)cacheBudgetMB << 20);
+        if (captureCorpus && result > 0) CaptureInput(src, srcSize);
+        return result;
+    }
 
-                    dst[0] = src[0];
-                    if (literal_len > 1) dst[1] = src[1];
-                    if (literal_len > 2) dst[2] = src[2];
+    // Hook target, the original function is jumped to so _ReturnAddress is the engine code that asked for the resource
+    static int __cdecl Dispatch(uint8_t* dst, uint32_t dstSize, uint8_t* src, uint32_t srcSize) {
+        auto source = RefPack::Telemetry::Source::Decoded;
+        if (!collectTelemetry) return Decompress(dst, dstSize, src, srcSize, source);
 
-                    dst += literal_len;
-                    src += literal_len;
-                }
+        uint64_t start = __rdtsc();
+        int result = Decompress(dst, dstSize, src, srcSize, source);
+        telemetry.Record((uintptr_t)_ReturnAddress(), srcSize, result > 0 ? (uint32_t)result : 0, __rdtsc() - start, source);
+        return result;
+    }
 
-                // Backref Copy
-                if (offset > (uint32_t)(dst - dstStart) || dst + match_len > dstEnd) goto error_overflow;
+    static void DumpTelemetry() {
+        auto t = std::time(nullptr);
+        auto tm = *std::localtime(&t);
+        std::ostringstream name;
+        name << "refpack_telemetry_" << std::put_time(&tm, "%Y%m%d_%H%M%S") << ".csv";
 
-                CopyOverlapping<Strategy>(dst, dst - offset, match_len);
-                dst += match_len;
-            }
-            // Type 2: Medium Backref (0x80-0xBF)
-            else if (!(cmd & 0x40)) {
-                if (src + 2 > srcEnd) goto error_truncated;
-                uint8_t offset_high = *src++;
-                uint8_t offset_low = *src++;
-
-                uint32_t literal_len = offset_high >> 6;
-                uint32_t match_len = (cmd & 0x3F) + 4;
-                uint32_t offset = (((offset_high & 0x3F) << 8) | offset_low) + 1;
-
-                if (literal_len) {
-                    if (src + literal_len > srcEnd || dst + literal_len > dstEnd) goto error_overflow;
-                    dst[0] = src[0];
-                    if (literal_len > 1) dst[1] = src[1];
-                    if (literal_len > 2) dst[2] = src[2];
-                    dst += literal_len;
-                    src += literal_len;
-                }
+        std::string path = Utils::WideToUtf8(ConfigPaths::GetS3SSDirectory()) + name.str();
+        if (telemetry.WriteCsv(Utils::ToPath(path), (uintptr_t)GetModuleHandleW(nullptr))) {
+            LOG_INFO("[RefPackDecompressor] Telemetry written to " + path);
+        } else {
+            LOG_ERROR("[RefPackDecompressor] Failed to write telemetry to " + path);
+        }
+    }
 
-                if (offset > (uint32_t)(dst - dstStart) || dst + match_len > dstEnd) goto error_overflow;
-                CopyOverlapping<Strategy>(dst, dst - offset, match_len);
-                dst += match_len;
+    static void RenderTelemetry() {
+        auto totals = telemetry.GetTotals();
+        double cyclesPerByte = totals.decompressedBytes ? (double)totals.ticks / totals.decompressedBytes : 0.0;
+        ImGui::Text("Calls: %llu (%llu cached)  In: %.1f MB  Out: %.1f MB", totals.calls, totals.cacheHits, totals.compressedBytes / (1024.0 * 1024.0), totals.decompressedBytes / (1024.0 * 1024.0));
+        ImGui::Text("Cycles: %.2f G total, %.0f per call, %.2f per output byte", totals.ticks / 1e9, totals.calls ? (double)totals.ticks / totals.calls : 0.0, cyclesPerByte);
+
+        // The check that each cache pays for itself, a disk hit has to come in under decoding per byte or the disk cache is a loss
+        auto perByte = [](const RefPack::Telemetry::Counters& c) { return c.decompressedBytes ? (double)c.ticks / c.decompressedBytes : 0.0; };
+        auto decoded = telemetry.GetSource(RefPack::Telemetry::Source::Decoded);
+        auto memoryHits = telemetry.GetSource(RefPack::Telemetry::Source::MemoryCache);
+        auto diskHits = telemetry.GetSource(RefPack::Telemetry::Source::DiskCache);
+        ImGui::Text("Cycles per output byte: decoded %.2f (%llu), memory hit %.2f (%llu), disk hit %.2f (%llu)", perByte(decoded), decoded.calls, perByte(memoryHits), memoryHits.calls,
+            perByte(diskHits), diskHits.calls);
+
+        if (ImGui::Button("Dump CSV")) DumpTelemetry();
+        ImGui::SameLine();
+        if (ImGui::Button("Reset")) telemetry.Reset();
+
+        if (ImGui::CollapsingHeader("Size Histogram") && ImGui::BeginTable("refpackSizes", 4, ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("Decompressed Size");
+            ImGui::TableSetupColumn("Calls");
+            ImGui::TableSetupColumn("Output");
+            ImGui::TableSetupColumn("Cycles/Byte");
+            ImGui::TableHeadersRow();
+            for (uint32_t i = 0; i < RefPack::Telemetry::SIZE_BUCKETS; i++) {
+                auto bucket = telemetry.GetSizeBucket(i);
+                if (!bucket.calls) continue;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text(">= %u KB", RefPack::Telemetry::BucketFloor(i) >> 10);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", bucket.calls);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f MB", bucket.decompressedBytes / (1024.0 * 1024.0));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", bucket.decompressedBytes ? (double)bucket.ticks / bucket.decompressedBytes : 0.0);
             }
-            // Type 3: Long Backref (0xC0-0xDF)
-            else if (!(cmd & 0x20)) {
-                if (src + 3 > srcEnd) goto error_truncated;
-                uint8_t b2 = *src++;
-                uint8_t b3 = *src++;
-                uint8_t b4 = *src++;
-
-                uint32_t literal_len = cmd & 0x3;
-                uint32_t match_len = (((cmd & 0xC) << 6) + b4) + 5;
-                uint32_t offset = (((cmd & 0x10) << 12) | (b2 << 8) | b3) + 1;
-
-                if (literal_len) {
-                    if (src + literal_len > srcEnd || dst + literal_len > dstEnd) goto error_overflow;
-                    dst[0] = src[0];
-                    if (literal_len > 1) dst[1] = src[1];
-                    if (literal_len > 2) dst[2] = src[2];
-                    dst += literal_len;
-                    src += literal_len;
-                }
+            ImGui::EndTable();
+        }
 
-                if (offset > (uint32_t)(dst - dstStart) || dst + match_len > dstEnd) goto error_overflow;
-                CopyOverlapping<Strategy>(dst, dst - offset, match_len);
-                dst += match_len;
-            }
-            // Type 4: Literal Run / Stop (0xE0-0xFF)
-            else {
-                uint32_t len = ((cmd & 0x1F) << 2) + 4;
-
-                if (len > 112) {
-                    len = cmd & 0x3; // Stop code
-                    // Handle tail bytes
-                    if (len) {
-                        if (src + len > srcEnd || dst + len > dstEnd) goto error_overflow;
-                        dst[0] = src[0];
-                        if (len > 1) dst[1] = src[1];
-                        if (len > 2) dst[2] = src[2];
-                    }
-                    return (int)expectedSize;
+        // Return addresses relative to the exe, match them up against the disassembly to see which engine path is loading
+        if (ImGui::CollapsingHeader("Callers") && ImGui::BeginTable("refpackCallers", 4, ImGuiTableFlags_SizingFixedFit)) {
+            uintptr_t moduleBase = (uintptr_t)GetModuleHandleW(nullptr);
+            ImGui::TableSetupColumn("Return Address");
+            ImGui::TableSetupColumn("Calls");
+            ImGui::TableSetupColumn("Output");
+            ImGui::TableSetupColumn("Share of Cycles");
+            ImGui::TableHeadersRow();
+            for (const auto& caller : telemetry.GetCallers()) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                if (caller.address == 0) {
+                    ImGui::Text("(other)");
+                } else {
+                    ImGui::Text("%#010x (exe+%#x)", (unsigned)caller.address, (unsigned)(caller.address - moduleBase));
                 }
-
-                if (src + len > srcEnd || dst + len > dstEnd) goto error_overflow;
-                Strategy::Copy(dst, src, len);
-                dst += len;
-                src += len;
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", caller.counters.calls);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f MB", caller.counters.decompressedBytes / (1024.0 * 1024.0));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f%%", totals.ticks ? 100.0 * caller.counters.ticks / totals.ticks : 0.0);
             }
+            ImGui::EndTable();
         }
-        return 0; // Source exhausted without stop code = malformed data
-
-    error_truncated:
-    error_overflow:
-        return 0;
     }
 
-    static int __cdecl Dispatch(uint8_t* dst, uint32_t dstSize, uint8_t* src, uint32_t srcSize) {
-        if (cpuHasAVX2) {
-            return DecompressImpl<StrategyAVX2>(dst, dstSize, src, srcSize);
-        } else {
-            return DecompressImpl<StrategySSE2>(dst, dstSize, src, srcSize);
-        }
+  public:
+    RefPackDecompressorPatch() : OptimizationPatch("RefPackDecompressor", nullptr) {
+        instance = this;
+        RegisterIntSetting(&cacheBudgetMB, "cacheBudgetMB", 64, 0, CACHE_BUDGET_MAX_MB,
+            "Memory for caching decompressed resources (MB, 0 = off).\n"
+            "Shared CC textures/meshes get copied from here instead of decoded again when lots stream back in.\n"
+            "This comes out of the game's 4GB address space, keep it modest if you're near the memory limit.");
+        RegisterIntSetting(&diskCacheMB, "diskCacheMB", 128, 0, DISK_CACHE_MAX_MB,
+            "Size cap for the on-disk cache of frequently decompressed resources (MB, 0 = off).\n"
+            "Saved to S3SS\\refpack_cache.bin after loading finishes, used on the next launch to speed up the first loading screen.\n"
+            "Needs the memory cache enabled to learn which resources are hot.");
+        RegisterBoolSetting(&collectTelemetry, "collectTelemetry", false, "Count calls, bytes and cycles per call, broken down by size and calling code. Shown below and dumpable to CSV");
+        RegisterBoolSetting(&captureCorpus, "captureCorpus", false, "Dump the first 512 compressed resources to S3SS\\refpack_corpus for tools/refpack_bench");
     }
 
-  public:
-    RefPackDecompressorPatch() : OptimizationPatch("RefPackDecompressor", nullptr) { instance = this; }
+    ~RefPackDecompressorPatch() {
+        if (diskWriter.joinable()) { diskWriter.join(); }
+    }
 
     bool Install() override {
         if (isEnabled) return true;
@@ -275,6 +255,27 @@ class RefPackDecompressorPatch : public OptimizationPatch {
             LOG_INFO("[RefPackDecompressor] Installing optimized decompressor (SSE2 + Safety Checks)...");
         }
 
+        if (captureCorpus) {
+            std::error_code ec;
+            std::filesystem::create_directories(Utils::ToPath(GetCorpusDirectory()), ec);
+            if (ec) {
+                LOG_WARNING("[RefPackDecompressor] Could not create corpus directory, capture disabled: " + ec.message());
+                captureCorpus = false;
+            }
+        }
+
+        // Anything cached before a settings reinstall stays, a lowered budget just evicts down to it
+        decodeCache.Trim((size_t)cacheBudgetMB << 20);
+
+        if (diskCacheMB > 0) {
+            if (diskCache.Open(GetDiskCachePath())) {
+                LOG_INFO(std::format("[RefPackDecompressor] Loaded disk cache: {} resources", diskCache.GetStats().entries));
+            } else {
+                LOG_INFO("[RefPackDecompressor] No usable disk cache, a new one will be written after loading");
+            }
+            diskCacheActive = true;
+        }
+
         uintptr_t targetAddr = (uintptr_t)&Dispatch;
 
         if (!PatchHelper::WriteRelativeJump(*addr, targetAddr, &patchedLocations)) { return Fail(std::format("Failed to install decompressor hook at {:#010x}", *addr)); }
@@ -291,16 +292,80 @@ class RefPackDecompressorPatch : public OptimizationPatch {
         LOG_INFO("[RefPackDecompressor] Uninstalling...");
 
         if (!PatchHelper::RestoreAll(patchedLocations)) { return Fail("Failed to restore original decompressor"); }
+        if (!keepCacheOnUninstall) { decodeCache.Clear(); }
+        diskCacheActive = false;
+        if (diskWriter.joinable()) { diskWriter.join(); }
+        diskCache.Close();
 
         isEnabled = false;
         LOG_INFO("[RefPackDecompressor] Successfully uninstalled");
         return true;
     }
+
+    void Update() override {
+        // The base class reinstalls from here after a setting change, that shouldn't throw away a warm cache
+        keepCacheOnUninstall = PendingReinstall();
+        OptimizationPatch::Update();
+        keepCacheOnUninstall = false;
+        if (!isEnabled || !diskCacheActive || cacheBudgetMB <= 0 || diskWriting.load()) return;
+
+        // Only write once loading has gone quiet, and not too often
+        ULONGLONG now = GetTickCount64();
+        ULONGLONG lastDispatch = lastDispatchTick.load(std::memory_order_relaxed);
+        if (lastDispatch == 0 || lastDispatch <= lastDiskWriteTick || now - lastDispatch < DISK_CACHE_IDLE_MS || now - lastDiskWriteTick < DISK_CACHE_MIN_INTERVAL_MS) return;
+        lastDiskWriteTick = now;
+
+        if (diskWriter.joinable()) { diskWriter.join(); } // Already finished, diskWriting says so
+        diskWriting.store(true);
+        diskWriter = std::thread(&RefPackDecompressorPatch::WriteDiskCache, this);
+    }
+
+    void RenderCustomUI() override {
+        SAFE_IMGUI_BEGIN();
+
+        if (cacheBudgetMB > 0) {
+            auto stats = decodeCache.GetStats();
+            uint64_t lookups = stats.hits + stats.misses;
+            ImGui::Text("Cache: %.1f / %d MB, %zu resources", stats.bytes / (1024.0 * 1024.0), cacheBudgetMB, stats.entries);
+            ImGui::Text("Hits: %llu  Misses: %llu (%.1f%% hit rate)  Evictions: %llu", stats.hits, stats.misses, lookups ? 100.0 * stats.hits / lookups : 0.0, stats.evictions);
+            if (ImGui::Button("Clear Cache")) decodeCache.Clear();
+            ImGui::Spacing();
+        }
+
+        if (diskCacheActive) {
+            auto stats = diskCache.GetStats();
+            ImGui::Text("Disk cache: %.1f / %d MB, %zu resources", stats.bytes / (1024.0 * 1024.0), diskCacheMB, stats.entries);
+            ImGui::Text("Hits: %llu  Misses: %llu  Rejected: %llu", stats.hits, stats.misses, stats.rejected);
+            ImGui::Spacing();
+        }
+
+        if (collectTelemetry) {
+            RenderTelemetry();
+            ImGui::Spacing();
+        }
+
+        if (captureCorpus) {
+            uint32_t captured = capturedCount.load(std::memory_order_relaxed);
+            ImGui::Text("Corpus captured: %u / %u resources", captured < CAPTURE_LIMIT ? captured : CAPTURE_LIMIT, CAPTURE_LIMIT);
+        }
+
+        OptimizationPatch::RenderCustomUI();
+    }
 };
 
 // Static member init
 RefPackDecompressorPatch* RefPackDecompressorPatch::instance = nullptr;
 bool RefPackDecompressorPatch::cpuHasAVX2 = false;
+bool RefPackDecompressorPatch::captureCorpus = false;
+int RefPackDecompressorPatch::cacheBudgetMB = 64;
+RefPack::DecodeCache RefPackDecompressorPatch::decodeCache;
+int RefPackDecompressorPatch::diskCacheMB = 128;
+bool RefPackDecompressorPatch::diskCacheActive = false;
+RefPack::DiskCache RefPackDecompressorPatch::diskCache;
+std::atomic<ULONGLONG> RefPackDecompressorPatch::lastDispatchTick{0};
+bool RefPackDecompressorPatch::collectTelemetry = false;
+RefPack::Telemetry RefPackDecompressorPatch::telemetry;
+std::atomic<uint32_t> RefPackDecompressorPatch::capturedCount{0};
 
 REGISTER_PATCH(RefPackDecompressorPatch, {.displayName = "RefPack Decompressor Optimization",
                                              .description = "Highly optimized RefPack decompression using AVX2/SSE2 intrinsics with safety checks. Auto-detects CPU capabilities.",
@@ -308,4 +373,7 @@ REGISTER_PATCH(RefPackDecompressorPatch, {.displayName = "RefPack Decompressor O
                                              .experimental = false,
                                              .supportedVersions = VERSION_ALL,
                                              .technicalDetails = {"Replaces original RefPack decompressor entirely", "AVX2 path for modern CPUs, SSE2 fallback for older ones",
+                                                 "LRU cache of decoded resources keyed by XXH32 of the compressed data (cheap on x86) plus both sizes, repeats become a memcpy",
+                                                 "Hottest resources persist to S3SS\\refpack_cache.bin for the next launch, checked after the memory cache. A hit copies out of a view mapped for just that payload, no lock, hash-verified on first use",
+                                                 "Telemetry splits cycles per output byte by decoded / memory hit / disk hit, to check the caches actually beat decoding",
                                                  "Optimizes quite a significant amount, probably one of the most impactful patches", "Essentially decompression/reading .package files big faster now yes :D yipeee"}})
@@ -7,6 +7,9 @@ class SmoothPatchClassic : public OptimizationPatch {
     std::vector<PatchHelper::PatchLocation> patchedLocations;
     int customTPS = 500;
 
+    // MOV EAX,[ESP+4]; MOV ECX,[EAX]; PUSH 1; PUSH ECX; CALL - the sleep sites, the exe has more than one
+    static constexpr Signature::PatternLiteral kSleepSitePattern = "8B 44 24 04 8B 08 6A 01 51 FF";
+
     int CalculateMSPT() const {
         if (customTPS <= 0) return customTPS; // Special modes: 0 = system, -1 = uncapped
         return 1000 / customTPS;
@@ -29,12 +32,11 @@ class SmoothPatchClassic : public OptimizationPatch {
 
         if (!PatchHelper::GetModuleInfo(hModule, &baseAddr, &imageSize)) { return Fail("Failed to get module information"); }
 
-        BYTE* found = baseAddr;
         int patchCount = 0;
         int mspt = CalculateMSPT();
 
-        while ((found = (BYTE*)PatchHelper::ScanPattern(found, imageSize - (found - baseAddr), "8B 44 24 04 8B 08 6A 01 51 FF"))) {
-
+        // All the sites in one walk, then patch them
+        for (uintptr_t found : PatchHelper::ScanPatternAll(baseAddr, imageSize, kSleepSitePattern)) {
             std::vector<BYTE> patch;
 
             if (mspt == -1) {
@@ -53,15 +55,13 @@ class SmoothPatchClassic : public OptimizationPatch {
                 patch.push_back(0x90);
             }
 
-            if (!PatchHelper::WriteBytes((uintptr_t)found, patch, &patchedLocations)) {
-                LOG_ERROR("[SmoothPatchClassic] Failed to patch at 0x" + std::to_string((uintptr_t)found));
-                found += 10;
+            if (!PatchHelper::WriteBytes(found, patch, &patchedLocations)) {
+                LOG_ERROR("[SmoothPatchClassic] Failed to patch at 0x" + std::to_string(found));
                 continue;
             }
 
             patchCount++;
-            LOG_DEBUG("[SmoothPatchClassic] Patched at 0x" + std::to_string((uintptr_t)found));
-            found += 10;
+            LOG_DEBUG("[SmoothPatchClassic] Patched at 0x" + std::to_string(found));
         }
 
         if (patchCount == 0) { return Fail("Failed to find any matching patterns"); }
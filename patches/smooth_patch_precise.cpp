@@ -295,8 +295,8 @@ class SmoothPatchPrecise : public OptimizationPatch {
         uintptr_t idleSimulationCycle = std::bit_cast<uintptr_t>(&ScriptHostBase::HookedIdleSimulationCycle);
         int32_t idleCallDisplacement = PatchHelper::CalculateRelativeOffset(idleSimulationCycleCall, idleSimulationCycle);
 
-        successful &= PatchHelper::WriteDWORD(idleSimulationCycleCall + 1, idleCallDisplacement, &tx.locations);
-        successful &= PatchHelper::WriteProtectedMemory(reinterpret_cast<void*>(limitFrameRate), frameRateLimiter, 9, &tx.locations);
+        successful &= PatchHelper::WriteDWORD(idleSimulationCycleCall + 1, idleCallDisplacement, tx);
+        successful &= PatchHelper::WriteProtectedMemory(reinterpret_cast<void*>(limitFrameRate), frameRateLimiter, 9, tx);
 
         if (!successful || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
@@ -36,7 +36,7 @@ class SplitLevelLightingFixPatch : public OptimizationPatch {
         std::vector<BYTE> oldBytes(getLotIdFunc.expectedBytes.begin(), getLotIdFunc.expectedBytes.end());
 
         auto tx = PatchHelper::BeginTransaction();
-        bool ok = PatchHelper::WriteBytes(*addr, newBytes, &tx.locations, &oldBytes);
+        bool ok = PatchHelper::WriteBytes(*addr, newBytes, tx, &oldBytes);
 
         if (!ok || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
@@ -84,7 +84,7 @@ class StartupWarningDialogFix : public OptimizationPatch {
         const std::vector<BYTE> stub = {0x33, 0xC0, 0xC3};
 
         auto tx = PatchHelper::BeginTransaction();
-        bool successful = PatchHelper::WriteBytes(*wrapperAddress, stub, &tx.locations);
+        bool successful = PatchHelper::WriteBytes(*wrapperAddress, stub, tx);
 
         if (!successful || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
@@ -127,9 +127,9 @@ class StartupWarningDialogFix : public OptimizationPatch {
         std::memcpy(&address, reinterpret_cast<const uint8_t*>(getTopWindowCall + offsetOfPushDialogProcedureAddress + 1), 4);
         originalDialogProcedure = reinterpret_cast<decltype(originalDialogProcedure)>(address);
 
-        successful &= PatchHelper::WriteDWORD(getTopWindowCall + 2, reinterpret_cast<uintptr_t>(&hijackedGetTopWindow), &tx.locations);
-        successful &= PatchHelper::WriteDWORD(getTopWindowCall + offsetOfMessageBoxWCall + 2, reinterpret_cast<uintptr_t>(&hookedMessageBoxW), &tx.locations);
-        successful &= PatchHelper::WriteDWORD(getTopWindowCall + offsetOfPushDialogProcedureAddress + 1, reinterpret_cast<uintptr_t>(&HookedDialogProcedure), &tx.locations);
+        successful &= PatchHelper::WriteDWORD(getTopWindowCall + 2, reinterpret_cast<uintptr_t>(&hijackedGetTopWindow), tx);
+        successful &= PatchHelper::WriteDWORD(getTopWindowCall + offsetOfMessageBoxWCall + 2, reinterpret_cast<uintptr_t>(&hookedMessageBoxW), tx);
+        successful &= PatchHelper::WriteDWORD(getTopWindowCall + offsetOfPushDialogProcedureAddress + 1, reinterpret_cast<uintptr_t>(&HookedDialogProcedure), tx);
 
         if (!successful || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
@@ -36,26 +36,26 @@ class UncompressedLotTexturesPatch : public OptimizationPatch {
         auto tx = PatchHelper::BeginTransaction();
 
         // Replace MOVZX EAX, byte ptr [EBP+0x84] (7 bytes) with MOV EAX, 0x3E (5 bytes) + 2 NOPs
-        successful &= PatchHelper::WriteBytes(base, {0xB8, 0x3E, 0x00, 0x00, 0x00, 0x90, 0x90}, &tx.locations);
+        successful &= PatchHelper::WriteBytes(base, {0xB8, 0x3E, 0x00, 0x00, 0x00, 0x90, 0x90}, tx);
 
         // NOP out AND EAX, 0x1 (3 bytes)
-        successful &= PatchHelper::WriteNOP(base + 7, 3, &tx.locations);
+        successful &= PatchHelper::WriteNOP(base + 7, 3, tx);
 
         // NOP out first ADD EAX, EAX (2 bytes)
-        successful &= PatchHelper::WriteNOP(base + 10, 2, &tx.locations);
+        successful &= PatchHelper::WriteNOP(base + 10, 2, tx);
 
         // offset 12-16: PUSH <allocator name>, keep :)
 
         // NOP out second ADD EAX, EAX (2 bytes)
-        successful &= PatchHelper::WriteNOP(base + 17, 2, &tx.locations);
+        successful &= PatchHelper::WriteNOP(base + 17, 2, tx);
 
         // offset 19-20: PUSH 0x2, keep
 
         // NOP out third ADD EAX, EAX (2 bytes)
-        successful &= PatchHelper::WriteNOP(base + 21, 2, &tx.locations);
+        successful &= PatchHelper::WriteNOP(base + 21, 2, tx);
 
         // NOP out OR EAX, 0x2 (3 bytes)
-        successful &= PatchHelper::WriteNOP(base + 23, 3, &tx.locations);
+        successful &= PatchHelper::WriteNOP(base + 23, 3, tx);
 
         if (!successful || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
@@ -65,12 +65,12 @@ class UncompressedSimTexturesPatch : public OptimizationPatch {
         if (onlyForLOD0) {
             // Change a `cmp dword ptr [ecx + 0x1a0], 2` to `cmp dword ptr [ecx + 0x1a0], 1`.
             // Such that the subsequent check becomes `if (lodLevel < 1) {/* Use uncompressed textures. */}`
-            successful &= PatchHelper::WriteByte(base + offsetOfLODLevelThreshold, 1, &tx.locations);
+            successful &= PatchHelper::WriteByte(base + offsetOfLODLevelThreshold, 1, tx);
         }
 
         // Turn an `and edx, -51` into `and edx, 0` so that kSurfaceFormat_A8R8G8B8
         // is used regardless of what the function's third parameter was supplied as.
-        successful &= PatchHelper::WriteByte(base + offsetOfConditionalSurfaceFormatDeltaMask, 0, &tx.locations);
+        successful &= PatchHelper::WriteByte(base + offsetOfConditionalSurfaceFormatDeltaMask, 0, tx);
 
         if (!successful || !PatchHelper::CommitTransaction(tx)) {
             PatchHelper::RollbackTransaction(tx);
@@ -1,9 +1,41 @@
 #include "pattern_scan.h"
+#include "scan/signature.h"
+#include "scan/multi_pattern.h"
+#include "scan/match_cache.h"
+#include "scan/parallel_scan.h"
+#include "scan/pe_image.h"
+#include "fast_hash.h"
+#include "logger.h"
+#include "utils.h"
 #include <Psapi.h>
+#include <chrono>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace Pattern {
 
+namespace {
+std::mutex prefetchMutex;
+HMODULE prefetchModule = nullptr;
+std::unordered_map<std::string, Prefetched> prefetched;
+
+// Headers to the end of the last section, what every scan walked before the PE model
+std::vector<PE::Range> ImageRanges(HMODULE module) {
+    MODULEINFO moduleInfo;
+    if (!GetModuleInformation(GetCurrentProcess(), module, &moduleInfo, sizeof(moduleInfo))) return {};
+    const uint8_t* base = (const uint8_t*)module;
+    return {{base, base + moduleInfo.SizeOfImage}};
+}
+
+// PatternLiterals are all code signatures, so only the executable sections get walked. A module whose headers don't parse gets the whole image
+std::vector<PE::Range> ScanRanges(HMODULE module) {
+    if (const PE::Image* image = PE::Image::ForModule(module)) return image->CodeRanges();
+    return ImageRanges(module);
+}
+} // namespace
+
 std::vector<std::pair<uint8_t, bool>> ParsePattern(const char* pattern) {
     std::vector<std::pair<uint8_t, bool>> bytes;
 
@@ -28,38 +60,127 @@ uintptr_t Scan(const char* pattern, const char* mask) {
 uintptr_t ScanModule(HMODULE module, const char* pattern, const char* mask) {
     if (!module) return 0;
 
-    MODULEINFO moduleInfo;
-    if (!GetModuleInformation(GetCurrentProcess(), module, &moduleInfo, sizeof(moduleInfo))) { return 0; }
+    // Prefetch already looked through this module's code for it. Text patterns can be data too, so a miss there still scans
+    Prefetched known;
+    if (!mask && GetPrefetched(module, pattern, known) && known.count) return known.first;
 
-    std::vector<std::pair<uint8_t, bool>> bytes;
+    Signature::Compiled compiled;
+    std::string error;
     if (mask) {
         // Using raw pattern + mask
-        const uint8_t* pat = (const uint8_t*)pattern;
-        bytes.reserve(strlen(mask));
-        for (size_t i = 0; mask[i]; i++) { bytes.push_back({pat[i], mask[i] == 'x'}); }
-    } else {
+        compiled = Signature::CompileMasked((const uint8_t*)pattern, mask);
+    } else if (!Signature::Compile(pattern, compiled, &error)) {
         // Using space-separated hex string pattern
-        bytes = ParsePattern(pattern);
+        LOG_ERROR("[Pattern] ScanModule: " + error);
+        return 0;
     }
 
-    uintptr_t start = (uintptr_t)module;
-    size_t size = moduleInfo.SizeOfImage;
-
-    for (uintptr_t i = 0; i < size - bytes.size(); i++) {
-        bool found = true;
-        for (size_t j = 0; j < bytes.size(); j++) {
-            if (bytes[j].second) { // If this byte should be checked
-                if (*(uint8_t*)(start + i + j) != bytes[j].first) {
-                    found = false;
-                    break;
-                }
-            }
+    // Untyped and masked patterns keep searching the whole image, nothing says they're code
+    return (uintptr_t)Signature::FindParallel(ImageRanges(module), compiled);
+}
+
+uintptr_t Scan(const Signature::PatternLiteral& pattern) {
+    return ScanModule(GetModuleHandle(nullptr), pattern);
+}
+
+uintptr_t ScanModule(HMODULE module, const Signature::PatternLiteral& pattern) {
+    if (!module || pattern.Empty()) return 0;
+
+    Prefetched known;
+    if (GetPrefetched(module, pattern.text, known)) return known.first;
+    return (uintptr_t)Signature::FindParallel(ScanRanges(module), pattern);
+}
+
+PrefetchStats Prefetch(HMODULE module, const std::vector<const Signature::PatternLiteral*>& patterns, const std::string& cachePath) {
+    PrefetchStats stats;
+    if (!module) return stats;
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Already compiled, just drop repeats of the same text
+    std::vector<std::string> texts;
+    std::vector<Signature::View> compiled;
+    std::unordered_set<std::string> seen;
+    for (const Signature::PatternLiteral* pattern : patterns) {
+        if (!pattern || pattern->Empty() || !seen.insert(pattern->text).second) continue;
+        texts.push_back(pattern->text);
+        compiled.push_back(*pattern);
+    }
+
+    // Code sections only, hashed for the cache key too
+    const uint8_t* base = (const uint8_t*)module;
+    const std::vector<PE::Range> ranges = ScanRanges(module);
+    const PE::Image* image = PE::Image::ForModule(module);
+    Signature::ImageKey imageKey;
+    if (image) {
+        imageKey.timeDateStamp = image->TimeDateStamp();
+        imageKey.sizeOfImage = image->SizeOfImage();
+    }
+
+    std::vector<Prefetched> results(texts.size());
+    std::vector<bool> fromCache(texts.size(), false);
+    Signature::MatchCache cache;
+    const bool useCache = !cachePath.empty() && imageKey.sizeOfImage;
+    if (useCache) {
+        for (const auto& [begin, end] : ranges) imageKey.codeHash = FastHash::Hash64(begin, end - begin, imageKey.codeHash);
+        cache.Load(Utils::ToPath(cachePath), imageKey);
+        for (size_t i = 0; i < texts.size(); i++) {
+            Signature::MatchCache::Match match;
+            if (!cache.Lookup(texts[i].c_str(), base, imageKey.sizeOfImage, match)) continue;
+            results[i] = {match.count ? (uintptr_t)base + match.rva : 0, match.count};
+            fromCache[i] = true;
+            stats.cached++;
         }
-        if (found) { return start + i; }
     }
 
-    return 0;
+    Signature::MultiPattern multi;
+    std::vector<size_t> scannedIndex;
+    for (size_t i = 0; i < texts.size(); i++) {
+        if (fromCache[i]) continue;
+        multi.Add(compiled[i]);
+        scannedIndex.push_back(i);
+    }
+    stats.scanned = scannedIndex.size();
+    if (!scannedIndex.empty()) {
+        multi.Build();
+        auto onMatch = [&](size_t index, const uint8_t* at) {
+            Prefetched& result = results[scannedIndex[index]];
+            // Different sections come in order but one section's patterns interleave, so keep the lowest
+            if (!result.count || (uintptr_t)at < result.first) result.first = (uintptr_t)at;
+            result.count++;
+        };
+        Signature::ScanParallel(multi, ranges, onMatch);
+    }
+
+    if (useCache) {
+        for (size_t i : scannedIndex) {
+            const Prefetched& result = results[i];
+            cache.Store(texts[i].c_str(), base, imageKey.sizeOfImage, {result.count ? static_cast<uint32_t>(result.first - (uintptr_t)base) : 0, result.count}, compiled[i].Size());
+        }
+        if (cache.IsDirty() && !cache.Save(Utils::ToPath(cachePath))) LOG_WARNING("[Pattern] Failed to write " + cachePath);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex);
+        if (prefetchModule != module) prefetched.clear();
+        prefetchModule = module;
+        for (size_t i = 0; i < texts.size(); i++) prefetched[texts[i]] = results[i];
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+    stats.ms = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    return stats;
 }
+
+bool GetPrefetched(HMODULE module, const char* pattern, Prefetched& out) {
+    if (!pattern) return false;
+    std::lock_guard<std::mutex> lock(prefetchMutex);
+    if (module != prefetchModule) return false;
+    auto it = prefetched.find(pattern);
+    if (it == prefetched.end()) return false;
+    out = it->second;
+    return true;
+}
+
 // AUUHHHHHHHGHHHHHHHHHHHH
 std::string CreateMask(const char* pattern) {
     std::stringstream ss(pattern);
@@ -2,6 +2,8 @@
 #include <Windows.h>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include "scan/pattern_literal.h"
 
 namespace Pattern {
 // Convert string pattern to byte pattern
@@ -10,9 +12,33 @@ std::vector<std::pair<uint8_t, bool>> ParsePattern(const char* pattern);
 // Find a pattern in the main module
 uintptr_t Scan(const char* pattern, const char* mask = nullptr);
 
-// Find a pattern in a specific module
+// Find a pattern anywhere in a specific module's image, split across threads. Not from DllMain
 uintptr_t ScanModule(HMODULE module, const char* pattern, const char* mask = nullptr);
 
+// Same for a code signature compiled at build time, nothing gets parsed and only the executable sections (PE::Image::CodeRanges) are searched
+uintptr_t Scan(const Signature::PatternLiteral& pattern);
+uintptr_t ScanModule(HMODULE module, const Signature::PatternLiteral& pattern);
+
 // Utility to create a mask from a pattern string
 std::string CreateMask(const char* pattern);
+
+// Where a prefetched pattern matched, first is 0 when count is 0
+struct Prefetched {
+    uintptr_t first = 0;
+    uint32_t count = 0;
+};
+
+struct PrefetchStats {
+    double ms = 0.0;
+    size_t cached = 0;  // Answered by the cache file
+    size_t scanned = 0; // Had to be found in the pass
+};
+
+// Finds every pattern in one pass over the module's executable sections (Signature::MultiPattern) and keeps the results by pattern text
+// ScanModule answers text patterns from here afterwards, anything not prefetched gets its own scan
+// With a cachePath, results from an earlier launch of the same exe (Signature::MatchCache) are checked and reused, only the rest gets scanned
+PrefetchStats Prefetch(HMODULE module, const std::vector<const Signature::PatternLiteral*>& patterns, const std::string& cachePath = {});
+
+// false if the pattern wasn't part of a Prefetch for this module
+bool GetPrefetched(HMODULE module, const char* pattern, Prefetched& out);
 } // namespace Pattern
\ No newline at end of file
@@ -101,6 +101,20 @@ void MemoryMonitor::ResetWarning() {
     m_warningDismissed = true; // Mark as dismissed until memory drops below threshold
 }
 
+void MemoryMonitor::ReportUsage(const std::string& component, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(m_usageMutex);
+    if (bytes) {
+        m_reportedUsage[component] = bytes;
+    } else {
+        m_reportedUsage.erase(component);
+    }
+}
+
+std::vector<std::pair<std::string, uint64_t>> MemoryMonitor::GetReportedUsage() const {
+    std::lock_guard<std::mutex> lock(m_usageMutex);
+    return {m_reportedUsage.begin(), m_reportedUsage.end()};
+}
+
 // UISettings implementation
 void UISettings::SetUIToggleKey(UINT key) {
     {
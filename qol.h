@@ -2,6 +2,8 @@
 #include <Windows.h>
 #include <string>
 #include <mutex>
+#include <map>
+#include <vector>
 
 // Forward declare toml table
 namespace toml {
@@ -37,6 +39,11 @@ class MemoryMonitor {
 
     void ResetWarning();
 
+    // Address space S3SS itself holds on to (mapped views, caches), listed under the total so it's clear how much of it is ours
+    // Thread-safe, components report their current total whenever it changes, 0 removes the entry
+    void ReportUsage(const std::string& component, uint64_t bytes);
+    std::vector<std::pair<std::string, uint64_t>> GetReportedUsage() const;
+
   private:
     MemoryMonitor()
         : m_warningThresholdGB(3.5f), m_enabled(false), m_currentMemoryGB(0.0f), m_hasWarned(false), m_warningDisplayTime(0.0f), m_WARNING_DISPLAY_DURATION(15.0f), m_warningStyle(WarningStyle::Overlay),
@@ -50,6 +57,9 @@ class MemoryMonitor {
     const float m_WARNING_DISPLAY_DURATION;
     WarningStyle m_warningStyle;
     bool m_warningDismissed;
+
+    mutable std::mutex m_usageMutex;
+    std::map<std::string, uint64_t> m_reportedUsage;
 };
 
 // UI Settings for S3SS itself (not game settings)
@@ -0,0 +1,76 @@
+#include "refpack_cache.h"
+#include <cstring>
+
+namespace RefPack {
+
+bool DecodeCache::Lookup(const CacheKey& key, uint8_t* dst, uint32_t dstSize) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = index.find(key);
+    if (it == index.end() || key.decompressedSize > dstSize) {
+        stats.misses++;
+        return false;
+    }
+
+    // Bump to the front, splice keeps the iterator in the index valid
+    lru.splice(lru.begin(), lru, it->second);
+    it->second->uses++;
+    memcpy(dst, it->second->data->data(), it->second->data->size());
+    stats.hits++;
+    return true;
+}
+
+void DecodeCache::Insert(const CacheKey& key, const uint8_t* data, uint32_t size, size_t budgetBytes) {
+    if (size == 0 || size > budgetBytes / 4) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index.count(key)) return; // Another thread decoded the same resource first
+
+    lru.push_front({key, 1, std::make_shared<const std::vector<uint8_t>>(data, data + size)});
+    index.emplace(key, lru.begin());
+    stats.bytes += size;
+    stats.entries++;
+    stats.insertions++;
+
+    EvictTo(budgetBytes);
+}
+
+void DecodeCache::Trim(size_t budgetBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    EvictTo(budgetBytes);
+}
+
+std::vector<CachedResource> DecodeCache::SnapshotHot(uint32_t minUses) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<CachedResource> hot;
+    for (const auto& entry : lru) {
+        if (entry.uses >= minUses) hot.push_back(entry);
+    }
+    return hot;
+}
+
+void DecodeCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    index.clear();
+    lru.clear();
+    stats.bytes = 0;
+    stats.entries = 0;
+}
+
+DecodeCache::Stats DecodeCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void DecodeCache::EvictTo(size_t budgetBytes) {
+    while (stats.bytes > budgetBytes && !lru.empty()) {
+        CachedResource& victim = lru.back();
+        stats.bytes -= victim.data->size();
+        stats.entries--;
+        stats.evictions++;
+        index.erase(victim.key);
+        lru.pop_back();
+    }
+}
+
+} // namespace RefPack
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// LRU cache of decompressed RefPack resources, keyed by hash of the compressed input + both sizes
+// Sits in front of the decoder so shared CC textures/meshes that stream in and out of lots only get decoded once
+namespace RefPack {
+
+struct CacheKey {
+    uint32_t hash = 0;           // FastHash::Hash32 of the compressed stream, with both sizes it's enough to tell resources apart
+    uint32_t compressedSize = 0;
+    uint32_t decompressedSize = 0;
+
+    bool operator==(const CacheKey& other) const { return hash == other.hash && compressedSize == other.compressedSize && decompressedSize == other.decompressedSize; }
+};
+
+struct CacheKeyHasher {
+    size_t operator()(const CacheKey& key) const { return static_cast<size_t>(key.hash); }
+};
+
+struct CachedResource {
+    CacheKey key;
+    uint32_t uses = 0; // Decodes + hits this session, what the disk cache ranks by
+    std::shared_ptr<const std::vector<uint8_t>> data; // Shared so a snapshot can hold it without a copy, even after it's evicted
+};
+
+class DecodeCache {
+  public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        size_t bytes = 0; // Decompressed bytes currently held
+        size_t entries = 0;
+    };
+
+    // Copies the cached payload to dst if present, false on miss (or if it wouldn't fit in dstSize)
+    bool Lookup(const CacheKey& key, uint8_t* dst, uint32_t dstSize);
+
+    // Takes a copy of data, then evicts least recently used entries until the cache fits budgetBytes
+    // Payloads bigger than a quarter of the budget are skipped, one huge texture shouldn't flush everything else
+    void Insert(const CacheKey& key, const uint8_t* data, uint32_t size, size_t budgetBytes);
+
+    // Evict down to budgetBytes without inserting, for when the budget setting was lowered
+    void Trim(size_t budgetBytes);
+
+    // Every resource used at least minUses times, for persisting to the disk cache. Payloads are shared not copied, and evicted
+    // ones stay alive until the snapshot is dropped
+    std::vector<CachedResource> SnapshotHot(uint32_t minUses) const;
+
+    void Clear();
+    Stats GetStats() const;
+
+  private:
+    using EntryList = std::list<CachedResource>;
+
+    void EvictTo(size_t budgetBytes);
+
+    mutable std::mutex mutex;
+    EntryList lru; // Front = most recently used
+    std::unordered_map<CacheKey, EntryList::iterator, CacheKeyHasher> index;
+    Stats stats;
+};
+
+} // namespace RefPack
@@ -0,0 +1,463 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <immintrin.h>
+// my magnum opus I fear
+
+// Lives in its own header (no Windows dependency) so the decoder can be benchmarked and verified off the game
+// On GCC/Clang anything instantiating StrategyAVX2 has to be built with -mavx2, MSVC doesn't care
+#if defined(_MSC_VER)
+#define REFPACK_FORCEINLINE __forceinline
+#else
+#define REFPACK_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+namespace RefPack {
+
+// Shuffle masks for replicating a short backref, masks[offset][i] = i % offset
+// Storing the same 16 bytes every steps[offset] bytes (largest multiple of offset <= 16) keeps the pattern in phase
+struct PatternShuffleTable {
+    alignas(16) uint8_t masks[16][16];
+    uint8_t steps[16];
+};
+
+constexpr PatternShuffleTable MakePatternShuffleTable() {
+    PatternShuffleTable table{};
+    for (uint32_t offset = 1; offset < 16; offset++) {
+        for (uint32_t i = 0; i < 16; i++) table.masks[offset][i] = (uint8_t)(i % offset);
+        table.steps[offset] = (uint8_t)(16 - 16 % offset);
+    }
+    return table;
+}
+
+inline constexpr PatternShuffleTable PATTERN_SHUFFLE = MakePatternShuffleTable();
+
+// Fast loop only, copies in whole 16-byte chunks so it can write up to 15 bytes past dst + len
+REFPACK_FORCEINLINE void WildCopy16(uint8_t* dst, const uint8_t* src, uint32_t len) {
+    uint8_t* end = dst + len;
+    do {
+        _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+        dst += 16;
+        src += 16;
+    } while (dst < end);
+}
+
+// Strategy structs, compiler inlines these directly into template instantiations instead of causing indirect jump if we did function pointer h-haha... Totally worth it...
+// We use these because some people can't use AVX2 :( BOOOOOOOOOOOOOOOOO
+struct StrategySSE2 {
+    static REFPACK_FORCEINLINE void Copy(uint8_t* dst, const uint8_t* src, uint32_t len) {
+        uint8_t* d = dst;
+        const uint8_t* s = src;
+        while (len >= 16) {
+            _mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+            d += 16;
+            s += 16;
+            len -= 16;
+        }
+        while (len--) *d++ = *s++;
+    }
+
+    // Fast loop only, copies in whole chunks so it can write up to 15 bytes past dst + len
+    static REFPACK_FORCEINLINE void WildCopy(uint8_t* dst, const uint8_t* src, uint32_t len) { WildCopy16(dst, src, len); }
+
+    // Offsets under 16 without SSSE3, LZ4's trick: 4 single bytes + one adjusted 4-byte copy push the effective offset to >= 8,
+    // after that plain 8-byte chunks never read bytes they haven't written yet. Spills up to 7 bytes past dst + len
+    static REFPACK_FORCEINLINE void WildCopyPattern(uint8_t* dst, uint32_t offset, uint32_t len) {
+        static constexpr uint8_t INC32[8] = {0, 1, 2, 1, 0, 4, 4, 4};
+        static constexpr int8_t DEC64[8] = {0, 0, 0, -1, -4, 1, 2, 3};
+        const uint8_t* src = dst - offset;
+        uint8_t* end = dst + len;
+        if (offset < 8) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            dst[3] = src[3];
+            src += INC32[offset];
+            memcpy(dst + 4, src, 4);
+            src -= DEC64[offset];
+            dst += 8;
+        }
+        while (dst < end) {
+            memcpy(dst, src, 8);
+            dst += 8;
+            src += 8;
+        }
+    }
+};
+
+struct StrategyAVX2 {
+    static REFPACK_FORCEINLINE void Copy(uint8_t* dst, const uint8_t* src, uint32_t len) {
+        uint8_t* d = dst;
+        const uint8_t* s = src;
+        // 32-byte chunks (AVX2)
+        while (len >= 32) {
+            _mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+            d += 32;
+            s += 32;
+            len -= 32;
+        }
+        // 16-byte chunks (SSE2)
+        while (len >= 16) {
+            _mm_storeu_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+            d += 16;
+            s += 16;
+            len -= 16;
+        }
+        // Tail
+        while (len--) *d++ = *s++;
+    }
+
+    // Fast loop only, copies in whole chunks so it can write up to 31 bytes past dst + len
+    static REFPACK_FORCEINLINE void WildCopy(uint8_t* dst, const uint8_t* src, uint32_t len) {
+        uint8_t* end = dst + len;
+        do {
+            _mm256_storeu_si256((__m256i*)dst, _mm256_loadu_si256((const __m256i*)src));
+            dst += 32;
+            src += 32;
+        } while (dst < end);
+    }
+
+    // Offsets under 16, every AVX2 CPU has SSSE3 so the pattern is one load + pshufb, then the same 16 bytes get stamped out
+    // every PATTERN_SHUFFLE.steps[offset] bytes. Spills up to 15 bytes past dst + len
+    static REFPACK_FORCEINLINE void WildCopyPattern(uint8_t* dst, uint32_t offset, uint32_t len) {
+        __m128i history = _mm_loadu_si128((const __m128i*)(dst - offset));
+        __m128i pattern = _mm_shuffle_epi8(history, _mm_load_si128((const __m128i*)PATTERN_SHUFFLE.masks[offset]));
+        uint32_t step = PATTERN_SHUFFLE.steps[offset];
+        _mm_storeu_si128((__m128i*)dst, pattern);
+        for (uint32_t i = step; i < len; i += step) _mm_storeu_si128((__m128i*)(dst + i), pattern);
+    }
+};
+
+template <typename Strategy> REFPACK_FORCEINLINE void CopyOverlapping(uint8_t* dst, const uint8_t* src, uint32_t len) {
+    ptrdiff_t offset = dst - src;
+
+    // For RLE (offset < len), src is 'history' relative to dst
+    // As long as offset >= 32, the 32-byte load reads data that was written at least 32 bytes ago
+    // Since we write 32 bytes at a time, we never overwrite data we are about to read in the SAME iteration... we pray
+    if (offset >= 32) {
+        Strategy::Copy(dst, src, len);
+    } else if (offset >= 16) {
+        while (len >= 16) {
+            _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+            dst += 16;
+            src += 16;
+            len -= 16;
+        }
+        while (len--) *dst++ = *src++;
+    } else {
+        // Tight byte-copy loop for small overlaps
+        while (len--) *dst++ = *src++;
+    }
+}
+
+// Fast loop version of CopyOverlapping, same overlap rules but whole-chunk stores (spills up to 31 bytes past dst + len)
+// Offsets under 16 used to be a byte loop, they're the bulk of texture data so they get pattern replication now
+template <typename Strategy> REFPACK_FORCEINLINE void WildCopyMatch(uint8_t* dst, uint32_t offset, uint32_t len) {
+    if (offset >= 32) {
+        Strategy::WildCopy(dst, dst - offset, len);
+    } else if (offset >= 16) {
+        WildCopy16(dst, dst - offset, len);
+    } else {
+        Strategy::WildCopyPattern(dst, offset, len);
+    }
+}
+
+// Slack the fast loop needs before it can skip bounds checks
+// src: command (4) + literal run of 112 read as 128 by WildCopy
+// dst: 3 literals written as 4 + a 1028 byte match spilling 31 bytes, or a 112 byte literal run written as 128
+constexpr ptrdiff_t FAST_SRC_SLACK = 136;
+constexpr ptrdiff_t FAST_DST_SLACK = 1088;
+
+template <typename Strategy> int DecompressImpl(uint8_t* __restrict dst, uint32_t dstSize, uint8_t* __restrict src, uint32_t srcSize) {
+    // Basic sanity checks
+    if (!dst || !src || srcSize < 2) return 0;
+
+    uint8_t* dstStart = dst;
+    uint8_t* dstEnd = dst + dstSize;
+    uint8_t* srcEnd = src + srcSize;
+
+    // Header parsing + validation
+    // We MUST validate the header to ensure we don't overrun input or output
+    uint16_t header = (src[0] << 8) | src[1];
+    src += 2;
+    // srcSize tracked implicitly by pointer comparison now, but we need to check initial header read
+    // (Checked by srcSize < 2 above)
+
+    uint32_t skipBytes = 0;
+    uint32_t sizeBytes = 3;
+
+    if (header & 0x8000) {
+        skipBytes = (header & 0x100) ? 4 : 0;
+        sizeBytes = 4;
+    } else {
+        skipBytes = (header & 0x100) ? 3 : 0;
+        sizeBytes = 3;
+    }
+
+    // Validate header read bounds
+    if (src + skipBytes + sizeBytes > srcEnd) return 0;
+
+    src += skipBytes;
+
+    // Read expected size to validate against buffer size
+    uint32_t expectedSize = 0;
+    if (sizeBytes == 4) {
+        expectedSize = (src[0] << 24) | (src[1] << 16) | (src[2] << 8) | src[3];
+        src += 4;
+    } else {
+        expectedSize = (src[0] << 16) | (src[1] << 8) | src[2];
+        src += 3;
+    }
+
+    // Validate output buffer size
+    // If the caller provided a buffer smaller than the decompressed size, fail asap
+    if (expectedSize > dstSize) {
+        // Log error? For now just return 0 to match original behavior on error, really doubt this ever gets hit anyway
+        return 0;
+    }
+
+    // Fast loop, while neither pointer is within one command of its end nothing can overrun so the per-command bounds checks go
+    // Output is limited to expectedSize rather than dstSize so the spill never touches bytes the original decoder wouldn't have written
+    // Offsets are still validated, stop codes and the last ~1KB of output go through the checked loop below
+    uint8_t* dstLimit = dstStart + expectedSize;
+    while (srcEnd - src >= FAST_SRC_SLACK && dstLimit - dst >= FAST_DST_SLACK) {
+        uint8_t cmd = *src++;
+        uint32_t literal_len;
+        uint32_t match_len;
+        uint32_t offset;
+
+        if (cmd < 0x80) {
+            literal_len = cmd & 0x3;
+            match_len = ((cmd >> 2) & 0x7) + 3;
+            offset = (((cmd & 0x60) << 3) | src[0]) + 1;
+            src += 1;
+        } else if (!(cmd & 0x40)) {
+            literal_len = src[0] >> 6;
+            match_len = (cmd & 0x3F) + 4;
+            offset = (((src[0] & 0x3F) << 8) | src[1]) + 1;
+            src += 2;
+        } else if (!(cmd & 0x20)) {
+            literal_len = cmd & 0x3;
+            match_len = (((cmd & 0xC) << 6) + src[2]) + 5;
+            offset = (((cmd & 0x10) << 12) | (src[0] << 8) | src[1]) + 1;
+            src += 3;
+        } else {
+            if (cmd >= 0xFC) {
+                src--; // Stop code, let the checked loop finish it
+                break;
+            }
+            uint32_t len = ((cmd & 0x1F) << 2) + 4;
+            Strategy::WildCopy(dst, src, len);
+            dst += len;
+            src += len;
+            continue;
+        }
+
+        // 0-3 literals, always move 4
+        memcpy(dst, src, 4);
+        dst += literal_len;
+        src += literal_len;
+
+        if (offset > (uint32_t)(dst - dstStart)) goto error_overflow;
+        WildCopyMatch<Strategy>(dst, offset, match_len);
+        dst += match_len;
+    }
+
+    // main loop
+    while (src < srcEnd) {
+        // Ensure we can read at least the command byte
+        if (src >= srcEnd) break;
+
+        uint8_t cmd = *src++;
+
+        // Type 1: Short Backref (0x00-0x7F)
+        if (cmd < 0x80) {
+            if (src >= srcEnd) goto error_truncated;
+            uint8_t offset_low = *src++;
+
+            uint32_t literal_len = cmd & 0x3;
+            uint32_t match_len = ((cmd >> 2) & 0x7) + 3;
+            uint32_t offset = (((cmd & 0x60) << 3) | offset_low) + 1;
+
+            // Literal Copy
+            if (literal_len) {
+                // Bounds check: input and output
+                if (src + literal_len > srcEnd || dst + literal_len > dstEnd) goto error_overflow;
+
+                dst[0] = src[0];
+                if (literal_len > 1) dst[1] = src[1];
+                if (literal_len > 2) dst[2] = src[2];
+
+                dst += literal_len;
+                src += literal_len;
+            }
+
+            // Backref Copy
+            if (offset > (uint32_t)(dst - dstStart) || dst + match_len > dstEnd) goto error_overflow;
+
+            CopyOverlapping<Strategy>(dst, dst - offset, match_len);
+            dst += match_len;
+        }
+        // Type 2: Medium Backref (0x80-0xBF)
+        else if (!(cmd & 0x40)) {
+            if (src + 2 > srcEnd) goto error_truncated;
+            uint8_t offset_high = *src++;
+            uint8_t offset_low = *src++;
+
+            uint32_t literal_len = offset_high >> 6;
+            uint32_t match_len = (cmd & 0x3F) + 4;
+            uint32_t offset = (((offset_high & 0x3F) << 8) | offset_low) + 1;
+
+            if (literal_len) {
+                if (src + literal_len > srcEnd || dst + literal_len > dstEnd) goto error_overflow;
+                dst[0] = src[0];
+                if (literal_len > 1) dst[1] = src[1];
+                if (literal_len > 2) dst[2] = src[2];
+                dst += literal_len;
+                src += literal_len;
+            }
+
+            if (offset > (uint32_t)(dst - dstStart) || dst + match_len > dstEnd) goto error_overflow;
+            CopyOverlapping<Strategy>(dst, dst - offset, match_len);
+            dst += match_len;
+        }
+        // Type 3: Long Backref (0xC0-0xDF)
+        else if (!(cmd & 0x20)) {
+            if (src + 3 > srcEnd) goto error_truncated;
+            uint8_t b2 = *src++;
+            uint8_t b3 = *src++;
+            uint8_t b4 = *src++;
+
+            uint32_t literal_len = cmd & 0x3;
+            uint32_t match_len = (((cmd & 0xC) << 6) + b4) + 5;
+            uint32_t offset = (((cmd & 0x10) << 12) | (b2 << 8) | b3) + 1;
+
+            if (literal_len) {
+                if (src + literal_len > srcEnd || dst + literal_len > dstEnd) goto error_overflow;
+                dst[0] = src[0];
+                if (literal_len > 1) dst[1] = src[1];
+                if (literal_len > 2) dst[2] = src[2];
+                dst += literal_len;
+                src += literal_len;
+            }
+
+            if (offset > (uint32_t)(dst - dstStart) || dst + match_len > dstEnd) goto error_overflow;
+            CopyOverlapping<Strategy>(dst, dst - offset, match_len);
+            dst += match_len;
+        }
+        // Type 4: Literal Run / Stop (0xE0-0xFF)
+        else {
+            uint32_t len = ((cmd & 0x1F) << 2) + 4;
+
+            if (len > 112) {
+                len = cmd & 0x3; // Stop code
+                // Handle tail bytes
+                if (len) {
+                    if (src + len > srcEnd || dst + len > dstEnd) goto error_overflow;
+                    dst[0] = src[0];
+                    if (len > 1) dst[1] = src[1];
+                    if (len > 2) dst[2] = src[2];
+                }
+                return (int)expectedSize;
+            }
+
+            if (src + len > srcEnd || dst + len > dstEnd) goto error_overflow;
+            Strategy::Copy(dst, src, len);
+            dst += len;
+            src += len;
+        }
+    }
+    return 0; // Source exhausted without stop code = malformed data
+
+error_truncated:
+error_overflow:
+    return 0;
+}
+
+// Decompressed size from a stream's header, 0 if the header is truncated
+inline uint32_t ReadDecompressedSize(const uint8_t* src, uint32_t srcSize) {
+    if (!src || srcSize < 2) return 0;
+    uint16_t header = (src[0] << 8) | src[1];
+    uint32_t sizeBytes = (header & 0x8000) ? 4 : 3;
+    uint32_t pos = 2 + ((header & 0x100) ? sizeBytes : 0);
+    if (pos + sizeBytes > srcSize) return 0;
+    if (sizeBytes == 4) return (src[pos] << 24) | (src[pos + 1] << 16) | (src[pos + 2] << 8) | src[pos + 3];
+    return (src[pos] << 16) | (src[pos + 1] << 8) | src[pos + 2];
+}
+
+// Per-stream command breakdown, used by the benchmark tool and anything else that wants to know what the data looks like
+struct CommandStats {
+    uint64_t shortBackrefs = 0;  // 0x00-0x7F
+    uint64_t mediumBackrefs = 0; // 0x80-0xBF
+    uint64_t longBackrefs = 0;   // 0xC0-0xDF
+    uint64_t literalRuns = 0;    // 0xE0-0xFB
+    uint64_t literalBytes = 0;   // Literal bytes from every command type (including the 0-3 carried by backrefs/stop)
+    uint64_t matchBytes = 0;     // Bytes produced by backrefs
+
+    CommandStats& operator+=(const CommandStats& other) {
+        shortBackrefs += other.shortBackrefs;
+        mediumBackrefs += other.mediumBackrefs;
+        longBackrefs += other.longBackrefs;
+        literalRuns += other.literalRuns;
+        literalBytes += other.literalBytes;
+        matchBytes += other.matchBytes;
+        return *this;
+    }
+};
+
+// Walk a stream's commands without producing output, returns false if the stream is malformed
+inline bool AnalyzeStream(const uint8_t* src, uint32_t srcSize, CommandStats& stats) {
+    if (!src || srcSize < 2) return false;
+    const uint8_t* srcEnd = src + srcSize;
+
+    uint16_t header = (src[0] << 8) | src[1];
+    src += 2;
+    uint32_t headerBytes = (header & 0x8000) ? ((header & 0x100) ? 8 : 4) : ((header & 0x100) ? 6 : 3);
+    if (src + headerBytes > srcEnd) return false;
+    src += headerBytes;
+
+    while (src < srcEnd) {
+        uint8_t cmd = *src++;
+        uint32_t literalLen;
+        uint32_t commandBytes;
+
+        if (cmd < 0x80) {
+            if (src + 1 > srcEnd) return false;
+            literalLen = cmd & 0x3;
+            stats.matchBytes += ((cmd >> 2) & 0x7) + 3;
+            stats.shortBackrefs++;
+            commandBytes = 1;
+        } else if (!(cmd & 0x40)) {
+            if (src + 2 > srcEnd) return false;
+            literalLen = src[0] >> 6;
+            stats.matchBytes += (cmd & 0x3F) + 4;
+            stats.mediumBackrefs++;
+            commandBytes = 2;
+        } else if (!(cmd & 0x20)) {
+            if (src + 3 > srcEnd) return false;
+            literalLen = cmd & 0x3;
+            stats.matchBytes += ((cmd & 0xC) << 6) + src[2] + 5;
+            stats.longBackrefs++;
+            commandBytes = 3;
+        } else {
+            literalLen = ((cmd & 0x1F) << 2) + 4;
+            commandBytes = 0;
+            if (literalLen > 112) {
+                literalLen = cmd & 0x3;
+                if (src + literalLen > srcEnd) return false;
+                stats.literalBytes += literalLen;
+                return true;
+            }
+            stats.literalRuns++;
+        }
+
+        src += commandBytes;
+        if (src + literalLen > srcEnd) return false;
+        src += literalLen;
+        stats.literalBytes += literalLen;
+    }
+    return false; // No stop code
+}
+
+} // namespace RefPack
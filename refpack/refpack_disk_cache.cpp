@@ -0,0 +1,215 @@
+#include "refpack_disk_cache.h"
+#include "../fast_hash.h"
+#include <algorithm>
+#include <fstream>
+
+namespace RefPack {
+
+bool DiskCache::Open(const std::filesystem::path& cachePath) {
+    std::unique_lock lock(mutex);
+    CloseLocked();
+    path = cachePath;
+    return OpenLocked();
+}
+
+void DiskCache::Close() {
+    std::unique_lock lock(mutex);
+    CloseLocked();
+}
+
+bool DiskCache::OpenLocked() {
+    if (!file.Open(path)) return false;
+    const uint64_t size = file.Size();
+
+    // Structural validation only, payload hashes are checked lazily on first hit so a big cache doesn't stall startup
+    FileHeader header;
+    if (!file.Copy(0, &header, sizeof(header))) {
+        CloseLocked();
+        return false;
+    }
+
+    const uint64_t tableBytes = static_cast<uint64_t>(header.entryCount) * sizeof(FileEntry);
+    const uint64_t payloadStart = sizeof(FileHeader) + tableBytes;
+    if (header.magic != MAGIC || header.version != VERSION || payloadStart + header.payloadBytes != size) {
+        CloseLocked();
+        return false;
+    }
+
+    std::vector<FileEntry> entries(header.entryCount);
+    if (!file.Copy(sizeof(header), entries.data(), static_cast<size_t>(tableBytes)) || FastHash::Hash32(entries.data(), static_cast<size_t>(tableBytes)) != header.tableHash) {
+        CloseLocked();
+        return false;
+    }
+
+    for (const FileEntry& e : entries) {
+        if (e.decompressedSize == 0 || e.payloadOffset < payloadStart || e.payloadOffset + e.decompressedSize > size) {
+            CloseLocked();
+            return false;
+        }
+    }
+
+    table = std::move(entries);
+    entryCount = header.entryCount;
+    payloadBytes = header.payloadBytes;
+    index.reserve(entryCount);
+    for (uint32_t i = 0; i < entryCount; i++) index.emplace(CacheKey{table[i].hash, table[i].compressedSize, table[i].decompressedSize}, i);
+
+    verified = std::make_unique<std::atomic<uint8_t>[]>(entryCount);
+    sessionHits = std::make_unique<std::atomic<uint32_t>[]>(entryCount);
+    for (uint32_t i = 0; i < entryCount; i++) {
+        verified[i].store(static_cast<uint8_t>(Verified::Unchecked), std::memory_order_relaxed);
+        sessionHits[i].store(0, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void DiskCache::CloseLocked() {
+    file.Close();
+    table.clear();
+    table.shrink_to_fit();
+    entryCount = 0;
+    payloadBytes = 0;
+    index.clear();
+    verified.reset();
+    sessionHits.reset();
+}
+
+bool DiskCache::ReadPayload(uint32_t i, uint8_t* dst) const {
+    return file.Copy(table[i].payloadOffset, dst, table[i].decompressedSize);
+}
+
+bool DiskCache::Lookup(const CacheKey& key, uint8_t* dst, uint32_t dstSize) {
+    std::shared_lock lock(mutex);
+
+    auto it = index.find(key);
+    if (it == index.end() || key.decompressedSize > dstSize) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const uint32_t i = it->second;
+    const FileEntry& entry = table[i];
+    auto state = static_cast<Verified>(verified[i].load(std::memory_order_acquire));
+    if (state == Verified::Bad || !ReadPayload(i, dst)) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Straight into dst and hashed there, on a mismatch the caller decodes over it anyway
+    if (state == Verified::Unchecked) {
+        // Two threads racing here both hash and agree, harmless
+        state = FastHash::Hash32(dst, entry.decompressedSize) == entry.payloadHash ? Verified::Good : Verified::Bad;
+        verified[i].store(static_cast<uint8_t>(state), std::memory_order_release);
+        if (state == Verified::Bad) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    sessionHits[i].fetch_add(1, std::memory_order_relaxed);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool DiskCache::Rewrite(const std::vector<CachedResource>& fresh, size_t capBytes) {
+    struct Candidate {
+        CacheKey key;
+        uint32_t score;
+        const uint8_t* payload; // nullptr = carried over from the current file, entry says where
+        uint32_t entry;
+        uint32_t payloadHash;
+    };
+
+    const std::filesystem::path tempPath = std::filesystem::path(path).concat(".tmp");
+
+    {
+        std::shared_lock lock(mutex);
+        if (path.empty()) return false;
+
+        std::vector<Candidate> candidates;
+        candidates.reserve(entryCount + fresh.size());
+
+        for (uint32_t i = 0; i < entryCount; i++) {
+            const FileEntry& e = table[i];
+            if (static_cast<Verified>(verified[i].load(std::memory_order_acquire)) == Verified::Bad) continue;
+            candidates.push_back({{e.hash, e.compressedSize, e.decompressedSize}, e.score / 2 + sessionHits[i].load(std::memory_order_relaxed), nullptr, i, e.payloadHash});
+        }
+
+        for (const auto& resource : fresh) {
+            if (index.count(resource.key)) continue; // Already on disk, its hits were counted above
+            candidates.push_back({resource.key, resource.uses, resource.data->data(), 0, FastHash::Hash32(resource.data->data(), resource.data->size())});
+        }
+
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+
+        // Carried over payloads go through one buffer, read back from the current file as they're written out
+        std::vector<uint8_t> buffer;
+        std::vector<Candidate> kept;
+        uint64_t keptBytes = 0;
+        for (const auto& c : candidates) {
+            if (c.score < 2) break;
+            if (keptBytes + c.key.decompressedSize > capBytes) continue;
+            // Don't carry a corrupt payload forward, hash anything that hasn't been hit yet
+            if (!c.payload && static_cast<Verified>(verified[c.entry].load(std::memory_order_acquire)) == Verified::Unchecked) {
+                buffer.resize(c.key.decompressedSize);
+                const bool good = ReadPayload(c.entry, buffer.data()) && FastHash::Hash32(buffer.data(), buffer.size()) == c.payloadHash;
+                verified[c.entry].store(static_cast<uint8_t>(good ? Verified::Good : Verified::Bad), std::memory_order_release);
+                if (!good) continue;
+            }
+            keptBytes += c.key.decompressedSize;
+            kept.push_back(c);
+        }
+
+        std::vector<FileEntry> entries(kept.size());
+        uint64_t offset = sizeof(FileHeader) + entries.size() * sizeof(FileEntry);
+        for (size_t i = 0; i < kept.size(); i++) {
+            entries[i] = {kept[i].key.hash, kept[i].key.compressedSize, kept[i].key.decompressedSize, kept[i].payloadHash, offset, kept[i].score, 0};
+            offset += kept[i].key.decompressedSize;
+        }
+
+        FileHeader header{MAGIC, VERSION, static_cast<uint32_t>(entries.size()), FastHash::Hash32(entries.data(), entries.size() * sizeof(FileEntry)), keptBytes};
+
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(FileEntry));
+        bool readOk = true;
+        for (const auto& c : kept) {
+            const uint8_t* payload = c.payload;
+            if (!payload) {
+                buffer.resize(c.key.decompressedSize);
+                readOk = readOk && ReadPayload(c.entry, buffer.data());
+                payload = buffer.data();
+            }
+            out.write(reinterpret_cast<const char*>(payload), c.key.decompressedSize);
+        }
+        out.close();
+        if (!out || !readOk) {
+            std::error_code ec;
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    // Windows won't replace an open file, so close, swap, reopen. Lookups wait on the lock for the few ms this takes
+    std::unique_lock lock(mutex);
+    CloseLocked();
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    bool opened = OpenLocked();
+    return !ec && opened;
+}
+
+DiskCache::Stats DiskCache::GetStats() const {
+    std::shared_lock lock(mutex);
+    Stats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.rejected = rejected.load(std::memory_order_relaxed);
+    stats.entries = entryCount;
+    stats.bytes = static_cast<size_t>(payloadBytes);
+    return stats;
+}
+
+} // namespace RefPack
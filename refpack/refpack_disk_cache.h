@@ -0,0 +1,87 @@
+#pragma once
+#include "refpack_cache.h"
+#include "../mapped_file.h"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+// Sidecar file of hot decompressed resources, so the next launch can serve them with a copy instead of a decode
+// Layout: FileHeader, FileEntry[entryCount], payloads. Only the table is kept in memory, a hit copies its payload out of a view mapped
+// for just that copy (a view of the whole file would cost its full size in the game's 32-bit address space for the life of the process)
+// Rewritten whole by Rewrite()
+namespace RefPack {
+
+class DiskCache {
+  public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t rejected = 0; // Entries whose payload failed hash verification
+        size_t bytes = 0;      // Payload bytes in the file
+        size_t entries = 0;
+    };
+
+    // Reads and validates the header and table, anything malformed/stale leaves the cache empty (the next Rewrite replaces it)
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    // Copies the payload into dst if present. Each entry's payload hash is verified on its first hit. No lock besides the shared one,
+    // concurrent lookups each map their own view
+    bool Lookup(const CacheKey& key, uint8_t* dst, uint32_t dstSize);
+
+    // Rebuilds the file from the current entries (score halved each rewrite, plus this session's hits) and fresh,
+    // then reopens it. Entries are ranked by score, only ones used at least twice are kept, total payload stays under capBytes
+    // Slow (reads back every kept entry), meant for a background thread. Lookups keep working until the final swap
+    bool Rewrite(const std::vector<CachedResource>& fresh, size_t capBytes);
+
+    Stats GetStats() const;
+
+  private:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t tableHash; // FastHash::Hash32 of the entry table
+        uint64_t payloadBytes;
+    };
+
+    struct FileEntry {
+        uint32_t hash;
+        uint32_t compressedSize;
+        uint32_t decompressedSize;
+        uint32_t payloadHash;   // FastHash::Hash32 of the decompressed bytes, checked on the game thread so 32-bit
+        uint64_t payloadOffset; // From the start of the file
+        uint32_t score;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 24 && sizeof(FileEntry) == 32, "On-disk layout changed, bump VERSION");
+
+    static constexpr uint32_t MAGIC = 0x43445052; // "RPDC"
+    static constexpr uint32_t VERSION = 2;
+
+    enum class Verified : uint8_t { Unchecked, Good, Bad };
+
+    bool OpenLocked();
+    void CloseLocked();
+    // Payload of table[i] into dst, false if it couldn't be read
+    bool ReadPayload(uint32_t i, uint8_t* dst) const;
+
+    mutable std::shared_mutex mutex; // Shared for lookups, exclusive while the file is swapped
+    std::filesystem::path path;
+    FileMapping file;
+    std::vector<FileEntry> table;
+    uint32_t entryCount = 0;
+    uint64_t payloadBytes = 0;
+    std::unordered_map<CacheKey, uint32_t, CacheKeyHasher> index;
+    std::unique_ptr<std::atomic<uint8_t>[]> verified;
+    std::unique_ptr<std::atomic<uint32_t>[]> sessionHits;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> rejected{0};
+};
+
+} // namespace RefPack
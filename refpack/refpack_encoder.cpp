@@ -0,0 +1,221 @@
+#include "refpack_encoder.h"
+#include <algorithm>
+#include <iterator>
+
+namespace RefPack {
+
+namespace {
+
+// Command limits, these mirror what the decoder accepts:
+// Short  (2 bytes): match 3-10,   offset 1-1024
+// Medium (3 bytes): match 4-67,   offset 1-16384
+// Long   (4 bytes): match 5-1028, offset 1-131072
+// Literal run (1 byte): 4-112 literals, multiples of 4
+// Stop   (1 byte): 0-3 trailing literals
+constexpr uint32_t MIN_MATCH = 3;
+constexpr uint32_t MAX_MATCH = 1028;
+constexpr uint32_t MAX_OFFSET = 131072;
+constexpr uint32_t MAX_LITERAL_RUN = 112;
+
+constexpr uint32_t HASH_BITS = 16;
+constexpr uint32_t HASH_SIZE = 1u << HASH_BITS;
+constexpr uint32_t WINDOW_MASK = MAX_OFFSET - 1; // prev[] is a ring over the whole window
+
+struct LevelParams {
+    uint32_t maxChain;   // Candidates visited per position
+    uint32_t niceLength; // Stop searching once a match this long is found
+    bool lazy;           // Try position+1 before committing to a match
+};
+
+constexpr LevelParams LEVEL_PARAMS[] = {
+    {8, 32, false},          // Fast
+    {48, 128, true},         // Normal
+    {1024, MAX_MATCH, true}, // Max
+};
+
+struct Match {
+    uint32_t length = 0;
+    uint32_t offset = 0;
+};
+
+// Bytes a command needs to carry this match, 0 if no command can represent it
+inline uint32_t MatchCost(uint32_t length, uint32_t offset) {
+    if (length >= 3 && length <= 10 && offset <= 1024) return 2;
+    if (length >= 4 && length <= 67 && offset <= 16384) return 3;
+    if (length >= 5 && length <= MAX_MATCH && offset <= MAX_OFFSET) return 4;
+    return 0;
+}
+
+inline uint32_t Hash3(const uint8_t* p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+class Encoder {
+  public:
+    Encoder(const uint8_t* src, uint32_t size, const LevelParams& params, std::vector<uint8_t>& out) : src(src), size(size), params(params), out(out), head(HASH_SIZE, -1), prev(MAX_OFFSET, -1) {}
+
+    void Run() {
+        uint32_t pos = 0;
+        uint32_t literalStart = 0;
+        Match current = FindMatch(0);
+
+        while (pos < size) {
+            if (current.length == 0) {
+                Insert(pos);
+                current = FindMatch(++pos);
+                continue;
+            }
+
+            Insert(pos);
+
+            // Lazy evaluation, if the next position has a longer match, emit this byte as a literal instead
+            if (params.lazy && current.length < params.niceLength && pos + 1 < size) {
+                Match next = FindMatch(pos + 1);
+                if (next.length > current.length) {
+                    ++pos;
+                    current = next;
+                    continue;
+                }
+            }
+
+            EmitMatch(src + literalStart, pos - literalStart, current);
+
+            uint32_t matchEnd = pos + current.length;
+            for (uint32_t i = pos + 1; i < matchEnd; i++) Insert(i);
+
+            pos = matchEnd;
+            literalStart = pos;
+            current = FindMatch(pos);
+        }
+
+        // Trailing literals go out as runs, with the last 0-3 carried by the stop code
+        uint32_t remaining = EmitLiteralRuns(src + literalStart, size - literalStart);
+        out.push_back(static_cast<uint8_t>(0xFC | remaining));
+        out.insert(out.end(), src + size - remaining, src + size);
+    }
+
+  private:
+    const uint8_t* src;
+    uint32_t size;
+    const LevelParams& params;
+    std::vector<uint8_t>& out;
+    std::vector<int32_t> head;
+    std::vector<int32_t> prev;
+
+    void Insert(uint32_t pos) {
+        if (pos + MIN_MATCH > size) return;
+        uint32_t h = Hash3(src + pos);
+        prev[pos & WINDOW_MASK] = head[h];
+        head[h] = static_cast<int32_t>(pos);
+    }
+
+    Match FindMatch(uint32_t pos) const {
+        Match best;
+        if (pos + MIN_MATCH > size) return best;
+
+        const uint32_t maxLength = std::min(MAX_MATCH, size - pos);
+        const uint8_t* cur = src + pos;
+        int32_t candidate = head[Hash3(cur)];
+        uint32_t chain = params.maxChain;
+
+        while (candidate >= 0 && chain--) {
+            uint32_t offset = pos - static_cast<uint32_t>(candidate);
+            if (offset > MAX_OFFSET) break;
+
+            const uint8_t* ref = src + candidate;
+            // Cheap reject, a longer match has to agree on the byte just past the current best
+            if (best.length < maxLength && ref[best.length] == cur[best.length]) {
+                uint32_t length = 0;
+                while (length < maxLength && ref[length] == cur[length]) length++;
+
+                if (length > best.length && MatchCost(length, offset)) {
+                    best = {length, offset};
+                    if (length >= params.niceLength) break;
+                }
+            }
+
+            int32_t next = prev[static_cast<uint32_t>(candidate) & WINDOW_MASK];
+            if (next >= candidate) break; // Ring slot was reused, chain is stale from here
+            candidate = next;
+        }
+
+        return best;
+    }
+
+    // Emits as many 4-112 byte literal runs as possible, returns how many (0-3) literals are left over
+    uint32_t EmitLiteralRuns(const uint8_t* literals, uint32_t count) {
+        while (count >= 4) {
+            uint32_t run = std::min(count & ~3u, MAX_LITERAL_RUN);
+            out.push_back(static_cast<uint8_t>(0xE0 | ((run >> 2) - 1)));
+            out.insert(out.end(), literals, literals + run);
+            literals += run;
+            count -= run;
+        }
+        return count;
+    }
+
+    void EmitMatch(const uint8_t* literals, uint32_t literalCount, const Match& match) {
+        uint32_t carried = EmitLiteralRuns(literals, literalCount);
+        literals += literalCount - carried;
+
+        uint32_t length = match.length;
+        uint32_t o = match.offset - 1;
+
+        switch (MatchCost(length, match.offset)) {
+        case 2:
+            out.push_back(static_cast<uint8_t>(((o >> 3) & 0x60) | ((length - 3) << 2) | carried));
+            out.push_back(static_cast<uint8_t>(o));
+            break;
+        case 3:
+            out.push_back(static_cast<uint8_t>(0x80 | (length - 4)));
+            out.push_back(static_cast<uint8_t>((carried << 6) | (o >> 8)));
+            out.push_back(static_cast<uint8_t>(o));
+            break;
+        default: {
+            uint32_t l = length - 5;
+            out.push_back(static_cast<uint8_t>(0xC0 | ((o >> 12) & 0x10) | ((l >> 6) & 0x0C) | carried));
+            out.push_back(static_cast<uint8_t>(o >> 8));
+            out.push_back(static_cast<uint8_t>(o));
+            out.push_back(static_cast<uint8_t>(l));
+            break;
+        }
+        }
+
+        out.insert(out.end(), literals, literals + carried);
+    }
+};
+
+} // namespace
+
+uint32_t CompressBound(uint32_t srcSize) {
+    return 6 + srcSize + srcSize / MAX_LITERAL_RUN + 4;
+}
+
+bool Compress(const uint8_t* src, uint32_t srcSize, std::vector<uint8_t>& out, CompressionLevel level) {
+    out.clear();
+    if (!src && srcSize) return false;
+    if (srcSize > 0x7FFFFFFF) return false; // Positions are tracked as int32
+    if (static_cast<size_t>(level) >= std::size(LEVEL_PARAMS)) return false;
+
+    out.reserve(CompressBound(srcSize));
+
+    // Header, large flag (0x80) switches the size field to 4 bytes
+    if (srcSize >= (1u << 24)) {
+        out.push_back(0x90);
+        out.push_back(0xFB);
+        out.push_back(static_cast<uint8_t>(srcSize >> 24));
+    } else {
+        out.push_back(0x10);
+        out.push_back(0xFB);
+    }
+    out.push_back(static_cast<uint8_t>(srcSize >> 16));
+    out.push_back(static_cast<uint8_t>(srcSize >> 8));
+    out.push_back(static_cast<uint8_t>(srcSize));
+
+    Encoder encoder(src, srcSize, LEVEL_PARAMS[static_cast<size_t>(level)], out);
+    encoder.Run();
+    return true;
+}
+
+} // namespace RefPack
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// RefPack (QFS) compressor, the inverse of RefPackDecompressorPatch's decoder
+// Deliberately has no Windows/game dependencies so it can be used offline to recompress CC .package resources
+namespace RefPack {
+
+enum class CompressionLevel : uint8_t {
+    Fast = 0,   // Short hash chains, greedy parsing
+    Normal = 1, // Medium hash chains with lazy matching
+    Max = 2,    // Long hash chains with lazy matching, for offline recompression where time doesn't matter
+};
+
+// Compress srcSize bytes into out (replaces its contents) using the game's header format:
+// 10 FB + 3 byte big-endian uncompressed size, or 90 FB + 4 byte size for inputs of 16 MB and up
+// Returns false if the input can't be represented
+bool Compress(const uint8_t* src, uint32_t srcSize, std::vector<uint8_t>& out, CompressionLevel level = CompressionLevel::Normal);
+
+// Worst-case size of a compressed stream (incompressible data grows by ~1/112 plus header + stop code)
+uint32_t CompressBound(uint32_t srcSize);
+
+} // namespace RefPack
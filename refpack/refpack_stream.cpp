@@ -0,0 +1,152 @@
+#include "refpack_stream.h"
+#include "refpack_decoder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace RefPack {
+
+void StreamDecoder::Begin(uint8_t* output, uint32_t outputSize) {
+    dst = output;
+    dstSize = outputSize;
+    produced = 0;
+    expectedSize = 0;
+    pendingSize = 0;
+    stage = output ? Stage::Header : Stage::Error;
+}
+
+size_t StreamDecoder::RequiredBytes(const uint8_t* p, size_t avail) const {
+    if (stage == Stage::Header) {
+        if (avail < 2) return 2;
+        uint16_t header = (p[0] << 8) | p[1];
+        uint32_t sizeBytes = (header & 0x8000) ? 4 : 3;
+        return 2 + ((header & 0x100) ? sizeBytes : 0) + sizeBytes;
+    }
+
+    uint8_t cmd = p[0];
+    if (cmd < 0x80) return 2 + (cmd & 0x3);
+    if (!(cmd & 0x40)) return avail < 2 ? 3 : 3 + (p[1] >> 6);
+    if (!(cmd & 0x20)) return 4 + (cmd & 0x3);
+    uint32_t len = ((cmd & 0x1F) << 2) + 4;
+    return 1 + (len > 112 ? (cmd & 0x3) : len);
+}
+
+bool StreamDecoder::Execute(const uint8_t* p) {
+    if (stage == Stage::Header) {
+        uint16_t header = (p[0] << 8) | p[1];
+        p += 2;
+        if (header & 0x8000) {
+            p += (header & 0x100) ? 4 : 0;
+            expectedSize = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        } else {
+            p += (header & 0x100) ? 3 : 0;
+            expectedSize = (p[0] << 16) | (p[1] << 8) | p[2];
+        }
+
+        if (expectedSize > dstSize) {
+            stage = Stage::Error;
+            return false;
+        }
+        stage = Stage::Commands;
+        return true;
+    }
+
+    // Same decode + validation as DecompressImpl's checked loop, one command at a time
+    uint8_t cmd = p[0];
+    uint32_t literalLen;
+    uint32_t matchLen = 0;
+    uint32_t offset = 0;
+    const uint8_t* literals;
+    bool stop = false;
+
+    if (cmd < 0x80) {
+        literalLen = cmd & 0x3;
+        matchLen = ((cmd >> 2) & 0x7) + 3;
+        offset = (((cmd & 0x60) << 3) | p[1]) + 1;
+        literals = p + 2;
+    } else if (!(cmd & 0x40)) {
+        literalLen = p[1] >> 6;
+        matchLen = (cmd & 0x3F) + 4;
+        offset = (((p[1] & 0x3F) << 8) | p[2]) + 1;
+        literals = p + 3;
+    } else if (!(cmd & 0x20)) {
+        literalLen = cmd & 0x3;
+        matchLen = (((cmd & 0xC) << 6) + p[3]) + 5;
+        offset = (((cmd & 0x10) << 12) | (p[1] << 8) | p[2]) + 1;
+        literals = p + 4;
+    } else {
+        literalLen = ((cmd & 0x1F) << 2) + 4;
+        literals = p + 1;
+        if (literalLen > 112) {
+            literalLen = cmd & 0x3;
+            stop = true;
+        }
+    }
+
+    if (literalLen > dstSize - produced) {
+        stage = Stage::Error;
+        return false;
+    }
+    memcpy(dst + produced, literals, literalLen);
+    produced += literalLen;
+
+    if (stop) {
+        stage = Stage::Done;
+        return false;
+    }
+
+    if (matchLen) {
+        if (offset > produced || matchLen > dstSize - produced) {
+            stage = Stage::Error;
+            return false;
+        }
+        CopyOverlapping<StrategySSE2>(dst + produced, dst + produced - offset, matchLen);
+        produced += matchLen;
+    }
+    return true;
+}
+
+StreamDecoder::Status StreamDecoder::Feed(const uint8_t* data, size_t size) {
+    for (;;) {
+        if (stage == Stage::Done) return Status::Done;
+        if (stage == Stage::Error) return Status::Error;
+
+        // Finish a header/command that straddled the previous chunk boundary
+        if (pendingSize) {
+            size_t need = RequiredBytes(pending, pendingSize);
+            size_t take = std::min(need - pendingSize, size);
+            memcpy(pending + pendingSize, data, take);
+            pendingSize += take;
+            data += take;
+            size -= take;
+
+            // A medium backref only knows its full length once its second byte is in
+            if (pendingSize < RequiredBytes(pending, pendingSize)) {
+                if (!size) return Status::NeedInput;
+                continue;
+            }
+
+            pendingSize = 0;
+            Execute(pending);
+            continue;
+        }
+
+        // Whole commands straight out of the chunk
+        while (size) {
+            size_t need = RequiredBytes(data, size);
+            if (size < need) break;
+            bool more = Execute(data);
+            data += need;
+            size -= need;
+            if (!more) break;
+        }
+
+        if (stage == Stage::Done || stage == Stage::Error) continue;
+        if (size) {
+            memcpy(pending, data, size);
+            pendingSize = size;
+        }
+        return Status::NeedInput;
+    }
+}
+
+} // namespace RefPack
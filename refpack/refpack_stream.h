@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Resumable RefPack decoder, takes the compressed stream in whatever chunks the reads hand back and decodes as it goes
+// so file I/O and decoding can overlap. Output goes straight into the caller's buffer, the whole buffer is needed anyway
+// since backrefs reach up to 128 KB back. Produces exactly what DecompressImpl does for the same input
+namespace RefPack {
+
+class StreamDecoder {
+  public:
+    enum class Status {
+        NeedInput, // Everything fed so far has been consumed, feed more
+        Done,      // Stop code reached, Result() is the decompressed size
+        Error,     // Malformed stream or dst too small, Result() is 0
+    };
+
+    // dst has to stay valid until Done/Error, dstSize is checked against the header just like DecompressImpl
+    void Begin(uint8_t* dst, uint32_t dstSize);
+
+    // Consumes the whole chunk unless the stream finishes or fails partway through it (anything after the stop code is ignored)
+    Status Feed(const uint8_t* data, size_t size);
+
+    // What DecompressImpl would have returned: the header's size once Done, 0 for errors or a stream that never finished
+    int Result() const { return stage == Stage::Done ? static_cast<int>(expectedSize) : 0; }
+
+    // dst[0, Produced()) is final and can be consumed while the rest is still streaming in
+    uint32_t Produced() const { return produced; }
+
+    // 0 until the header has been read
+    uint32_t ExpectedSize() const { return expectedSize; }
+
+  private:
+    enum class Stage { Header, Commands, Done, Error };
+
+    // Bytes the next header/command needs (including its literals), given the first avail bytes of it
+    // A medium backref's literal count lives in its second byte, so with 1 byte available this is a lower bound
+    size_t RequiredBytes(const uint8_t* p, size_t avail) const;
+
+    // p holds the complete header/command, false once the stream is Done or in Error
+    bool Execute(const uint8_t* p);
+
+    // Largest header/command: literal run of 112 + its command byte
+    static constexpr size_t PENDING_CAPACITY = 128;
+
+    Stage stage = Stage::Error;
+    uint8_t* dst = nullptr;
+    uint32_t dstSize = 0;
+    uint32_t produced = 0;
+    uint32_t expectedSize = 0;
+
+    // A header/command split across chunks is assembled here before executing
+    uint8_t pending[PENDING_CAPACITY];
+    size_t pendingSize = 0;
+};
+
+} // namespace RefPack
@@ -0,0 +1,120 @@
+#include "refpack_telemetry.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace RefPack {
+
+void Telemetry::AtomicCounters::Add(uint32_t compressedSize, uint32_t decompressedSize, uint64_t elapsed, bool cacheHit) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    if (cacheHit) cacheHits.fetch_add(1, std::memory_order_relaxed);
+    compressedBytes.fetch_add(compressedSize, std::memory_order_relaxed);
+    decompressedBytes.fetch_add(decompressedSize, std::memory_order_relaxed);
+    ticks.fetch_add(elapsed, std::memory_order_relaxed);
+}
+
+Telemetry::Counters Telemetry::AtomicCounters::Load() const {
+    return {calls.load(std::memory_order_relaxed), cacheHits.load(std::memory_order_relaxed), compressedBytes.load(std::memory_order_relaxed), decompressedBytes.load(std::memory_order_relaxed),
+        ticks.load(std::memory_order_relaxed)};
+}
+
+void Telemetry::AtomicCounters::Clear() {
+    calls.store(0, std::memory_order_relaxed);
+    cacheHits.store(0, std::memory_order_relaxed);
+    compressedBytes.store(0, std::memory_order_relaxed);
+    decompressedBytes.store(0, std::memory_order_relaxed);
+    ticks.store(0, std::memory_order_relaxed);
+}
+
+void Telemetry::Record(uintptr_t caller, uint32_t compressedSize, uint32_t decompressedSize, uint64_t ticks, Source source) {
+    const bool cacheHit = source != Source::Decoded;
+    totals.Add(compressedSize, decompressedSize, ticks, cacheHit);
+    sources[static_cast<uint32_t>(source)].Add(compressedSize, decompressedSize, ticks, cacheHit);
+
+    uint32_t bucket = 0;
+    for (uint32_t size = decompressedSize; size > 1 && bucket < SIZE_BUCKETS - 1; size >>= 1) bucket++;
+    sizeBuckets[bucket].Add(compressedSize, decompressedSize, ticks, cacheHit);
+
+    // Linear probe from a hash of the return address, first caller to land on an empty slot claims it
+    uint32_t slot = static_cast<uint32_t>((caller >> 2) * 2654435761u) % MAX_CALLERS;
+    for (uint32_t probe = 0; probe < MAX_CALLERS; probe++, slot = (slot + 1) % MAX_CALLERS) {
+        uintptr_t owner = callers[slot].address.load(std::memory_order_acquire);
+        // On failure the CAS leaves whoever beat us in owner
+        if (owner == 0 && callers[slot].address.compare_exchange_strong(owner, caller, std::memory_order_acq_rel)) owner = caller;
+        if (owner == caller) {
+            callers[slot].counters.Add(compressedSize, decompressedSize, ticks, cacheHit);
+            return;
+        }
+    }
+    callerOverflow.Add(compressedSize, decompressedSize, ticks, cacheHit);
+}
+
+void Telemetry::Reset() {
+    totals.Clear();
+    for (auto& counters : sources) counters.Clear();
+    for (auto& bucket : sizeBuckets) bucket.Clear();
+    for (auto& slot : callers) {
+        slot.counters.Clear();
+        slot.address.store(0, std::memory_order_release);
+    }
+    callerOverflow.Clear();
+}
+
+Telemetry::Counters Telemetry::GetTotals() const {
+    return totals.Load();
+}
+
+Telemetry::Counters Telemetry::GetSizeBucket(uint32_t bucket) const {
+    return bucket < SIZE_BUCKETS ? sizeBuckets[bucket].Load() : Counters{};
+}
+
+Telemetry::Counters Telemetry::GetSource(Source source) const {
+    return source < Source::Count ? sources[static_cast<uint32_t>(source)].Load() : Counters{};
+}
+
+std::vector<Telemetry::CallerCounters> Telemetry::GetCallers() const {
+    std::vector<CallerCounters> result;
+    for (const auto& slot : callers) {
+        uintptr_t address = slot.address.load(std::memory_order_acquire);
+        if (address) result.push_back({address, slot.counters.Load()});
+    }
+    Counters overflow = callerOverflow.Load();
+    if (overflow.calls) result.push_back({0, overflow});
+
+    std::sort(result.begin(), result.end(), [](const CallerCounters& a, const CallerCounters& b) { return a.counters.ticks > b.counters.ticks; });
+    return result;
+}
+
+bool Telemetry::WriteCsv(const std::filesystem::path& path, uintptr_t moduleBase) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+
+    auto row = [&](const char* kind, const std::string& key, const Counters& c) {
+        out << kind << ',' << key << ',' << c.calls << ',' << c.cacheHits << ',' << c.compressedBytes << ',' << c.decompressedBytes << ',' << c.ticks << '\n';
+    };
+
+    out << "kind,key,calls,cache_hits,compressed_bytes,decompressed_bytes,ticks\n";
+    row("total", "all", GetTotals());
+    row("source", "decoded", GetSource(Source::Decoded));
+    row("source", "memory", GetSource(Source::MemoryCache));
+    row("source", "disk", GetSource(Source::DiskCache));
+    for (uint32_t i = 0; i < SIZE_BUCKETS; i++) {
+        Counters c = GetSizeBucket(i);
+        if (c.calls) row("size", std::to_string(BucketFloor(i)), c);
+    }
+    for (const auto& caller : GetCallers()) {
+        char key[32];
+        if (caller.address == 0) {
+            snprintf(key, sizeof(key), "other");
+        } else if (caller.address >= moduleBase) {
+            snprintf(key, sizeof(key), "+0x%llx", static_cast<unsigned long long>(caller.address - moduleBase));
+        } else {
+            snprintf(key, sizeof(key), "0x%llx", static_cast<unsigned long long>(caller.address));
+        }
+        row("caller", key, caller.counters);
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace RefPack
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Lock-free counters for RefPack decode calls: totals, a log2 size histogram, per-caller breakdown and where the bytes came from
+// Ticks are whatever the caller measures with (TSC in the patch), nothing here converts them to time
+namespace RefPack {
+
+class Telemetry {
+  public:
+    static constexpr uint32_t SIZE_BUCKETS = 28;  // log2 of the decompressed size, the last bucket takes everything >= 128 MB
+    static constexpr uint32_t MAX_CALLERS = 128;  // Open addressed, calls from callers past this land in the overflow slot
+
+    // Where a call's output came from. Cycles per byte of each side by side is what says whether a cache is worth it over decoding
+    enum class Source : uint32_t { Decoded, MemoryCache, DiskCache, Count };
+
+    struct Counters {
+        uint64_t calls = 0;
+        uint64_t cacheHits = 0;
+        uint64_t compressedBytes = 0;
+        uint64_t decompressedBytes = 0;
+        uint64_t ticks = 0;
+    };
+
+    struct CallerCounters {
+        uintptr_t address = 0; // 0 for the overflow slot
+        Counters counters;
+    };
+
+    void Record(uintptr_t caller, uint32_t compressedSize, uint32_t decompressedSize, uint64_t ticks, Source source);
+    void Reset();
+
+    Counters GetTotals() const;
+    Counters GetSizeBucket(uint32_t bucket) const;
+    Counters GetSource(Source source) const;
+    // Every caller seen so far (plus the overflow slot if it was used), busiest first
+    std::vector<CallerCounters> GetCallers() const;
+
+    // Lower bound of a size bucket in bytes
+    static uint32_t BucketFloor(uint32_t bucket) { return bucket == 0 ? 0 : 1u << bucket; }
+
+    // One row per total/source/bucket/caller: kind,key,calls,cache_hits,compressed_bytes,decompressed_bytes,ticks
+    // Caller keys are written relative to moduleBase so runs with ASLR'd modules still line up
+    bool WriteCsv(const std::filesystem::path& path, uintptr_t moduleBase) const;
+
+  private:
+    struct AtomicCounters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> cacheHits{0};
+        std::atomic<uint64_t> compressedBytes{0};
+        std::atomic<uint64_t> decompressedBytes{0};
+        std::atomic<uint64_t> ticks{0};
+
+        void Add(uint32_t compressedSize, uint32_t decompressedSize, uint64_t ticks, bool cacheHit);
+        Counters Load() const;
+        void Clear();
+    };
+
+    struct CallerSlot {
+        std::atomic<uintptr_t> address{0};
+        AtomicCounters counters;
+    };
+
+    AtomicCounters totals;
+    AtomicCounters sources[static_cast<uint32_t>(Source::Count)];
+    AtomicCounters sizeBuckets[SIZE_BUCKETS];
+    CallerSlot callers[MAX_CALLERS];
+    AtomicCounters callerOverflow;
+};
+
+} // namespace RefPack
@@ -0,0 +1,139 @@
+#include "match_cache.h"
+#include "../fast_hash.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace Signature {
+
+namespace {
+
+// File layout: CacheHeader, MatchRecord[entryCount], matched bytes of every record back to back
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t sizeOfImage;
+    uint32_t timeDateStamp;
+    uint32_t reserved;
+    uint64_t codeHash;
+    uint64_t contentHash; // FastHash of everything after the header
+};
+
+struct MatchRecord {
+    uint64_t patternHash;
+    uint32_t rva;
+    uint32_t count;
+    uint32_t bytesOffset;
+    uint32_t bytesLength;
+};
+
+constexpr uint32_t CACHE_MAGIC = 0x43414353; // "SCAC"
+constexpr uint32_t CACHE_VERSION = 1;
+
+static_assert(sizeof(CacheHeader) == 40 && sizeof(MatchRecord) == 24, "On-disk layout changed, bump CACHE_VERSION");
+
+} // namespace
+
+uint64_t MatchCache::PatternHash(const char* pattern) {
+    return FastHash::Hash64(pattern, std::strlen(pattern));
+}
+
+bool MatchCache::Load(const std::filesystem::path& cachePath, const ImageKey& imageKey) {
+    key = imageKey;
+    entries.clear();
+    dirty = false;
+
+    std::ifstream in(cachePath, std::ios::binary);
+    if (!in) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    CacheHeader header;
+    if (data.size() < sizeof(header)) return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.entryCount > data.size() / sizeof(MatchRecord)) return false;
+    if (header.timeDateStamp != key.timeDateStamp || header.sizeOfImage != key.sizeOfImage || header.codeHash != key.codeHash) return false;
+    if (FastHash::Hash64(data.data() + sizeof(header), data.size() - sizeof(header)) != header.contentHash) return false;
+
+    const uint8_t* records = data.data() + sizeof(header);
+    const uint64_t recordBytes = static_cast<uint64_t>(header.entryCount) * sizeof(MatchRecord);
+    const uint8_t* bytes = records + recordBytes;
+    const uint64_t bytesSize = data.size() - sizeof(header) - recordBytes;
+
+    std::unordered_map<uint64_t, Entry> loaded;
+    loaded.reserve(header.entryCount);
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        MatchRecord record;
+        memcpy(&record, records + i * sizeof(MatchRecord), sizeof(record));
+        if (static_cast<uint64_t>(record.bytesOffset) + record.bytesLength > bytesSize) return false;
+
+        Entry& entry = loaded[record.patternHash];
+        entry.match = {record.rva, record.count};
+        entry.bytes.assign(bytes + record.bytesOffset, bytes + record.bytesOffset + record.bytesLength);
+    }
+    entries = std::move(loaded);
+    return true;
+}
+
+bool MatchCache::Save(const std::filesystem::path& cachePath) const {
+    std::vector<MatchRecord> records;
+    std::vector<uint8_t> bytes;
+    for (const auto& [patternHash, entry] : entries) {
+        if (!entry.used) continue;
+        records.push_back({patternHash, entry.match.rva, entry.match.count, static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(entry.bytes.size())});
+        bytes.insert(bytes.end(), entry.bytes.begin(), entry.bytes.end());
+    }
+
+    std::vector<uint8_t> body;
+    body.reserve(records.size() * sizeof(MatchRecord) + bytes.size());
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(records.data());
+    body.insert(body.end(), raw, raw + records.size() * sizeof(MatchRecord));
+    body.insert(body.end(), bytes.begin(), bytes.end());
+
+    CacheHeader header{CACHE_MAGIC, CACHE_VERSION, static_cast<uint32_t>(records.size()), key.sizeOfImage, key.timeDateStamp, 0, key.codeHash, FastHash::Hash64(body.data(), body.size())};
+
+    // Temp + rename so a crash mid-write leaves the old cache intact
+    std::filesystem::path tempPath = std::filesystem::path(cachePath).concat(".tmp");
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(body.data()), body.size());
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    return !ec;
+}
+
+bool MatchCache::Lookup(const char* pattern, const uint8_t* image, size_t imageSize, Match& out) {
+    auto it = entries.find(PatternHash(pattern));
+    if (it == entries.end()) return false;
+    Entry& entry = it->second;
+    // The image key already says the code is the same, this just makes sure the cache isn't handing out an address that doesn't hold the match
+    if (entry.match.count) {
+        if (static_cast<uint64_t>(entry.match.rva) + entry.bytes.size() > imageSize || std::memcmp(image + entry.match.rva, entry.bytes.data(), entry.bytes.size()) != 0) return false;
+    }
+    entry.used = true;
+    out = entry.match;
+    return true;
+}
+
+void MatchCache::Store(const char* pattern, const uint8_t* image, size_t imageSize, const Match& match, size_t length) {
+    Entry& entry = entries[PatternHash(pattern)];
+    entry.match = match;
+    entry.bytes.clear();
+    if (match.count && static_cast<uint64_t>(match.rva) + length <= imageSize) entry.bytes.assign(image + match.rva, image + match.rva + length);
+    entry.used = true;
+    dirty = true;
+}
+
+bool MatchCache::IsDirty() const {
+    if (dirty) return true;
+    for (const auto& [patternHash, entry] : entries) {
+        if (!entry.used) return true;
+    }
+    return false;
+}
+
+} // namespace Signature
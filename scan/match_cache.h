@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+// Where each pattern matched in one particular exe, saved so the next launch checks a few bytes instead of scanning again
+// Mostly for unknown game versions, where every AddressInfo falls back to its pattern. No Windows dependency, pattern_scan_bench round-trips it
+namespace Signature {
+
+// Which exe a cache belongs to: PE header fields plus a hash of the executable sections as mapped (so a patched or relocated image doesn't match)
+struct ImageKey {
+    uint32_t timeDateStamp = 0;
+    uint32_t sizeOfImage = 0;
+    uint64_t codeHash = 0;
+
+    bool operator==(const ImageKey&) const = default;
+};
+
+class MatchCache {
+  public:
+    struct Match {
+        uint32_t rva = 0;   // First match, relative to the image base. Meaningless when count is 0
+        uint32_t count = 0; // Matches in the scanned sections, 0 = not found
+    };
+
+    // Reads a cache file, anything missing/corrupt/built from a different image just starts empty
+    bool Load(const std::filesystem::path& cachePath, const ImageKey& key);
+
+    // Writes the entries looked up or stored since Load, patterns nobody asked for anymore are dropped
+    bool Save(const std::filesystem::path& cachePath) const;
+
+    // Cached result for pattern, only if the bytes at the match are still the ones it was stored with
+    bool Lookup(const char* pattern, const uint8_t* image, size_t imageSize, Match& out);
+
+    // Remembers a scan result, length is the pattern's size in bytes (what gets compared on Lookup)
+    void Store(const char* pattern, const uint8_t* image, size_t imageSize, const Match& match, size_t length);
+
+    // Something was stored, or something loaded wasn't asked for and Save would drop it
+    bool IsDirty() const;
+    size_t Size() const { return entries.size(); }
+
+  private:
+    struct Entry {
+        Match match;
+        std::vector<uint8_t> bytes; // What the match covered when stored
+        bool used = false;
+    };
+
+    static uint64_t PatternHash(const char* pattern);
+
+    ImageKey key;
+    std::unordered_map<uint64_t, Entry> entries;
+    bool dirty = false;
+};
+
+} // namespace Signature
@@ -0,0 +1,208 @@
+#include "multi_pattern.h"
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Same deal as signature.cpp, GCC/Clang only emit pshufb inside functions marked for it
+#if defined(_MSC_VER)
+#define MULTI_PATTERN_SSSE3
+#define MULTI_PATTERN_AVX2
+#else
+#define MULTI_PATTERN_SSSE3 __attribute__((target("ssse3")))
+#define MULTI_PATTERN_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Signature {
+
+namespace {
+
+inline uint32_t LowestBit(uint32_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctz(bits));
+#endif
+}
+
+inline uint32_t Load32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+// Buckets that have a gram byte equal to each of the 16 bytes at `at`, looked up one nibble at a time
+MULTI_PATTERN_SSSE3 inline __m128i NibbleLookup(const uint8_t* at, __m128i low, __m128i high, __m128i lowNibble) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+    return _mm_and_si128(_mm_shuffle_epi8(low, _mm_and_si128(v, lowNibble)), _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(v, 4), lowNibble)));
+}
+
+MULTI_PATTERN_AVX2 inline __m256i NibbleLookup(const uint8_t* at, __m256i low, __m256i high, __m256i lowNibble) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(at));
+    return _mm256_and_si256(_mm256_shuffle_epi8(low, _mm256_and_si256(v, lowNibble)), _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibble)));
+}
+
+inline __m128i LoadTable(const uint8_t* table) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(table));
+}
+
+MULTI_PATTERN_AVX2 inline __m256i BroadcastTable(const uint8_t* table) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+}
+
+} // namespace
+
+size_t MultiPattern::Add(const View& pattern) {
+    Entry entry{Compiled(pattern)};
+    // Rarest window of 4 exact bytes, so offsets that pass the nibble lookup are mostly real matches
+    uint32_t best = UINT32_MAX;
+    for (size_t i = 0; i + 4 <= pattern.Size(); i++) {
+        uint32_t weight = 0;
+        for (size_t j = i; j < i + 4 && weight != UINT32_MAX; j++) weight = pattern.masks[j] == 0xFF ? weight + MatchWeight(pattern.bytes[j], 0xFF) : UINT32_MAX;
+        if (weight < best) {
+            best = weight;
+            entry.gramOffset = i;
+            entry.keyed = true;
+        }
+    }
+    if (entry.keyed) entry.gram = Load32(pattern.bytes + entry.gramOffset);
+    maxLength = std::max(maxLength, pattern.Size());
+    patterns.push_back(std::move(entry));
+    built = false;
+    return patterns.size() - 1;
+}
+
+void MultiPattern::Build() {
+    unkeyed.clear();
+    for (auto& bucket : buckets) bucket.clear();
+    std::memset(nibbleMasks, 0, sizeof(nibbleMasks));
+    filter.assign((size_t(1) << FILTER_BITS) / 64, 0);
+
+    std::vector<uint32_t> keyed;
+    for (size_t i = 0; i < patterns.size(); i++) {
+        if (patterns[i].keyed) keyed.push_back(static_cast<uint32_t>(i));
+        else if (!patterns[i].pattern.Empty()) unkeyed.push_back(i);
+    }
+    // Neighbouring grams (by first byte, then second...) tend to share nibbles, so a bucket of them lets fewer strangers through
+    std::stable_sort(keyed.begin(), keyed.end(), [&](uint32_t a, uint32_t b) {
+        uint32_t x = patterns[a].gram, y = patterns[b].gram;
+        for (int k = 0; k < 4; k++, x >>= 8, y >>= 8) {
+            if ((x & 0xFF) != (y & 0xFF)) return (x & 0xFF) < (y & 0xFF);
+        }
+        return false;
+    });
+    for (size_t rank = 0; rank < keyed.size(); rank++) {
+        uint32_t bucket = static_cast<uint32_t>(rank * BUCKETS / keyed.size());
+        uint32_t gram = patterns[keyed[rank]].gram;
+        buckets[bucket].push_back(keyed[rank]);
+        for (int k = 0; k < 4; k++) {
+            uint8_t b = static_cast<uint8_t>(gram >> (k * 8));
+            nibbleMasks[k][0][b & 0x0F] |= static_cast<uint8_t>(1u << bucket);
+            nibbleMasks[k][1][b >> 4] |= static_cast<uint8_t>(1u << bucket);
+        }
+        uint32_t h = Hash(gram);
+        filter[h >> 6] |= uint64_t(1) << (h & 63);
+    }
+    built = true;
+}
+
+void MultiPattern::CheckAt(const uint8_t* p, uint32_t bucketMask, const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const {
+    const uint32_t gram = Load32(p);
+    for (; bucketMask; bucketMask &= bucketMask - 1) {
+        for (uint32_t index : buckets[LowestBit(bucketMask)]) {
+            const Entry& entry = patterns[index];
+            if (entry.gram != gram || static_cast<size_t>(p - begin) < entry.gramOffset) continue;
+            const uint8_t* start = p - entry.gramOffset;
+            if (static_cast<size_t>(end - start) < entry.pattern.Size()) continue;
+            bool match = true;
+            for (size_t j = 0; j < entry.pattern.Size() && match; j++) match = (start[j] & entry.pattern.masks[j]) == entry.pattern.bytes[j];
+            if (match) onMatch(index, start);
+        }
+    }
+}
+
+void MultiPattern::ScanFiltered(const uint8_t* p, const uint8_t* last, const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const {
+    const uint64_t* bits = filter.data();
+    for (; p <= last; p++) {
+        uint32_t h = Hash(Load32(p));
+        if ((bits[h >> 6] >> (h & 63)) & 1) CheckAt(p, (1u << BUCKETS) - 1, begin, end, onMatch);
+    }
+}
+
+// Gram offsets from p on, returns where it stopped since the last few don't have a full 16 bytes behind every gram byte
+MULTI_PATTERN_SSSE3 const uint8_t* MultiPattern::ScanSSSE3(const uint8_t* p, const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const {
+    const __m128i lowNibble = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+    // Written out per byte so all 8 tables stay in registers, the compiler won't unroll a loop over an array of them
+    const __m128i low0 = LoadTable(nibbleMasks[0][0]), high0 = LoadTable(nibbleMasks[0][1]);
+    const __m128i low1 = LoadTable(nibbleMasks[1][0]), high1 = LoadTable(nibbleMasks[1][1]);
+    const __m128i low2 = LoadTable(nibbleMasks[2][0]), high2 = LoadTable(nibbleMasks[2][1]);
+    const __m128i low3 = LoadTable(nibbleMasks[3][0]), high3 = LoadTable(nibbleMasks[3][1]);
+    for (; end - p >= 19; p += 16) {
+        __m128i candidates = _mm_and_si128(_mm_and_si128(NibbleLookup(p, low0, high0, lowNibble), NibbleLookup(p + 1, low1, high1, lowNibble)),
+            _mm_and_si128(NibbleLookup(p + 2, low2, high2, lowNibble), NibbleLookup(p + 3, low3, high3, lowNibble)));
+        uint32_t hits = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(candidates, zero))) & 0xFFFF;
+        if (!hits) continue;
+        alignas(16) uint8_t lanes[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), candidates);
+        for (; hits; hits &= hits - 1) {
+            uint32_t lane = LowestBit(hits);
+            CheckAt(p + lane, lanes[lane], begin, end, onMatch);
+        }
+    }
+    return p;
+}
+
+// Same as ScanSSSE3 over 32 offsets, pshufb works per 128-bit lane so both lanes get the same tables
+MULTI_PATTERN_AVX2 const uint8_t* MultiPattern::ScanAVX2(const uint8_t* p, const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const {
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i low0 = BroadcastTable(nibbleMasks[0][0]), high0 = BroadcastTable(nibbleMasks[0][1]);
+    const __m256i low1 = BroadcastTable(nibbleMasks[1][0]), high1 = BroadcastTable(nibbleMasks[1][1]);
+    const __m256i low2 = BroadcastTable(nibbleMasks[2][0]), high2 = BroadcastTable(nibbleMasks[2][1]);
+    const __m256i low3 = BroadcastTable(nibbleMasks[3][0]), high3 = BroadcastTable(nibbleMasks[3][1]);
+    for (; end - p >= 35; p += 32) {
+        __m256i candidates = _mm256_and_si256(_mm256_and_si256(NibbleLookup(p, low0, high0, lowNibble), NibbleLookup(p + 1, low1, high1, lowNibble)),
+            _mm256_and_si256(NibbleLookup(p + 2, low2, high2, lowNibble), NibbleLookup(p + 3, low3, high3, lowNibble)));
+        uint32_t hits = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(candidates, zero)));
+        if (!hits) continue;
+        alignas(32) uint8_t lanes[32];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), candidates);
+        for (; hits; hits &= hits - 1) {
+            uint32_t lane = LowestBit(hits);
+            CheckAt(p + lane, lanes[lane], begin, end, onMatch);
+        }
+    }
+    return p;
+}
+
+void MultiPattern::ScanUnkeyed(const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const {
+    for (size_t index : unkeyed) {
+        ForEachMatch(begin, end, patterns[index].pattern, [&](const uint8_t* at) { onMatch(index, at); });
+    }
+}
+
+void MultiPattern::Scan(const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const {
+    static const bool hasSSSE3 = CpuHasSSSE3();
+    static const bool hasAVX2 = CpuHasAVX2();
+    if (!built || !begin || end <= begin) return;
+    if (!hasSSSE3) return ScanScalar(begin, end, onMatch);
+    if (end - begin >= 4) {
+        const uint8_t* p = hasAVX2 ? ScanAVX2(begin, begin, end, onMatch) : begin;
+        p = ScanSSSE3(p, begin, end, onMatch);
+        ScanFiltered(p, end - 4, begin, end, onMatch);
+    }
+    ScanUnkeyed(begin, end, onMatch);
+}
+
+void MultiPattern::ScanScalar(const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const {
+    if (!built || !begin || end <= begin) return;
+    if (end - begin >= 4) ScanFiltered(begin, end - 4, begin, end, onMatch);
+    ScanUnkeyed(begin, end, onMatch);
+}
+
+} // namespace Signature
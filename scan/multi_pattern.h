@@ -0,0 +1,64 @@
+#pragma once
+#include "signature.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Many signatures found in a single walk over the image, for resolving every patch's pattern at startup on builds without known addresses
+// No Windows dependency, tools/pattern_scan_bench.cpp checks it against Signature::Find
+namespace Signature {
+
+// Each pattern is keyed by its rarest run of 4 exact bytes (its gram) and the patterns are spread over 8 buckets. Per gram byte a pshufb
+// nibble lookup says which buckets have a gram with that byte there, ANDed over the 4 bytes that leaves the buckets that could have a gram
+// starting at each of 16 (32 with AVX2) offsets. Only those offsets get the gram compared and the pattern verified in full (wildcards and nibbles included).
+// Without SSSE3 every offset is hashed into a bit filter instead. Patterns without 4 exact bytes in a row get a Find loop of their own
+class MultiPattern {
+  public:
+    // Returns the index matches are reported under, call Build after the last one
+    size_t Add(const View& pattern);
+    void Build();
+
+    // Calls onMatch(index, start) for every match of every pattern that lies entirely inside [begin, end)
+    // A pattern's own matches come in address order, different patterns' matches are interleaved
+    void Scan(const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const;
+    // Same walk with the bit filter even on SSSE3 CPUs, for the benchmark
+    void ScanScalar(const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const;
+
+    size_t Size() const { return patterns.size(); }
+    size_t UnkeyedCount() const { return unkeyed.size(); }
+    // Longest pattern, how far chunked scans have to overlap
+    size_t MaxLength() const { return maxLength; }
+
+  private:
+    static constexpr uint32_t BUCKETS = 8;
+    static constexpr uint32_t FILTER_BITS = 16;
+
+    struct Entry {
+        Compiled pattern;
+        size_t gramOffset = 0;
+        uint32_t gram = 0;
+        bool keyed = false;
+    };
+
+    static uint32_t Hash(uint32_t gram) { return (gram * 0x9E3779B1u) >> (32 - FILTER_BITS); }
+
+    // Verifies the patterns of every bucket in bucketMask whose gram starts at p
+    void CheckAt(const uint8_t* p, uint32_t bucketMask, const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const;
+    // Gram offsets in [p, last], the filter walk and the tail of the vector ones. begin/end are the bounds matches have to fit in
+    void ScanFiltered(const uint8_t* p, const uint8_t* last, const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const;
+    const uint8_t* ScanSSSE3(const uint8_t* p, const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const;
+    const uint8_t* ScanAVX2(const uint8_t* p, const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const;
+    void ScanUnkeyed(const uint8_t* begin, const uint8_t* end, const std::function<void(size_t, const uint8_t*)>& onMatch) const;
+
+    std::vector<Entry> patterns;
+    std::vector<size_t> unkeyed;
+    std::vector<uint32_t> buckets[BUCKETS];
+    // nibbleMasks[byte][0][low nibble] / [byte][1][high nibble] = buckets with a gram that has that nibble at that byte
+    alignas(16) uint8_t nibbleMasks[4][2][16] = {};
+    std::vector<uint64_t> filter;
+    size_t maxLength = 0;
+    bool built = false;
+};
+
+} // namespace Signature
@@ -0,0 +1,98 @@
+#include "parallel_scan.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace Signature {
+
+namespace {
+
+// Below this there isn't enough to split, thread start-up would eat the gain
+constexpr size_t DEFAULT_MIN_CHUNK = 1 << 20;
+
+struct Chunk {
+    const uint8_t* begin; // Matches have to start in [begin, stop)
+    const uint8_t* stop;
+    const uint8_t* end;   // stop + overlap, clamped to the range
+};
+
+std::vector<Chunk> SplitRanges(const std::vector<PE::Range>& ranges, size_t overlap, ScanSplit& split) {
+    if (!split.threads) split.threads = DefaultScanThreads();
+    if (!split.minChunk) split.minChunk = DEFAULT_MIN_CHUNK;
+    size_t total = 0;
+    for (const auto& [begin, end] : ranges) total += end - begin;
+    // A few chunks per thread so one slow chunk (lots of candidates) doesn't hold the rest up
+    const size_t chunkSize = std::max(split.minChunk, total / (split.threads * 4) + 1);
+    std::vector<Chunk> chunks;
+    for (const auto& [begin, end] : ranges) {
+        for (const uint8_t* at = begin; at < end;) {
+            const uint8_t* stop = static_cast<size_t>(end - at) > chunkSize ? at + chunkSize : end;
+            chunks.push_back({at, stop, static_cast<size_t>(end - stop) > overlap ? stop + overlap : end});
+            at = stop;
+        }
+    }
+    return chunks;
+}
+
+// Runs work(i) for every chunk index, on `threads` threads counting the caller
+template <typename F>
+void RunChunks(size_t count, unsigned threads, F&& work) {
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) work(i);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < std::min<size_t>(threads, count); t++) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+}
+
+} // namespace
+
+unsigned DefaultScanThreads() {
+    static const unsigned threads = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+    return threads;
+}
+
+const uint8_t* FindParallel(const std::vector<PE::Range>& ranges, const View& pattern, ScanSplit split) {
+    if (pattern.Empty()) return nullptr;
+    std::vector<Chunk> chunks = SplitRanges(ranges, pattern.Size() - 1, split);
+    if (split.threads == 1 || chunks.size() <= 1) {
+        for (const auto& chunk : chunks) {
+            if (const uint8_t* at = Find(chunk.begin, chunk.end, pattern); at && at < chunk.stop) return at;
+        }
+        return nullptr;
+    }
+
+    std::vector<const uint8_t*> found(chunks.size(), nullptr);
+    // Chunks past one that already matched can't have the lowest match
+    std::atomic<size_t> firstHit{chunks.size()};
+    RunChunks(chunks.size(), split.threads, [&](size_t i) {
+        if (i > firstHit.load(std::memory_order_relaxed)) return;
+        const uint8_t* at = Find(chunks[i].begin, chunks[i].end, pattern);
+        if (!at || at >= chunks[i].stop) return;
+        found[i] = at;
+        for (size_t seen = firstHit.load(std::memory_order_relaxed); i < seen && !firstHit.compare_exchange_weak(seen, i, std::memory_order_relaxed);) {}
+    });
+    for (const uint8_t* at : found) {
+        if (at) return at;
+    }
+    return nullptr;
+}
+
+void ScanParallel(const MultiPattern& multi, const std::vector<PE::Range>& ranges, const std::function<void(size_t, const uint8_t*)>& onMatch, ScanSplit split) {
+    std::vector<Chunk> chunks = SplitRanges(ranges, multi.MaxLength() ? multi.MaxLength() - 1 : 0, split);
+
+    std::vector<std::vector<std::pair<size_t, const uint8_t*>>> found(chunks.size());
+    RunChunks(chunks.size(), split.threads, [&](size_t i) {
+        const Chunk& chunk = chunks[i];
+        multi.Scan(chunk.begin, chunk.end, [&](size_t index, const uint8_t* at) {
+            if (at < chunk.stop) found[i].push_back({index, at});
+        });
+    });
+    for (const auto& matches : found) {
+        for (const auto& [index, at] : matches) onMatch(index, at);
+    }
+}
+
+} // namespace Signature
@@ -0,0 +1,29 @@
+#pragma once
+#include "multi_pattern.h"
+#include "pe_image.h"
+#include "signature.h"
+#include <functional>
+#include <vector>
+
+// Scans over a list of ranges (PE::Image::CodeRanges) split into chunks across worker threads
+// Chunks overlap by the longest pattern minus one and a match belongs to the chunk its first byte is in, so every match is found exactly once
+// Small inputs just run on the calling thread
+namespace Signature {
+
+// threads 0 = DefaultScanThreads(). minChunk 0 = 1 MB, smaller is only useful to pe_scan_check for putting lots of chunk edges through small files
+struct ScanSplit {
+    unsigned threads = 0;
+    size_t minChunk = 0;
+};
+
+// Lowest match across all ranges (ranges in address order, like the section table), nullptr if none
+const uint8_t* FindParallel(const std::vector<PE::Range>& ranges, const View& pattern, ScanSplit split = {});
+
+// MultiPattern::Scan over every range. onMatch runs on the calling thread after the workers are done,
+// in the same order a single threaded scan of the ranges would give per pattern
+void ScanParallel(const MultiPattern& multi, const std::vector<PE::Range>& ranges, const std::function<void(size_t, const uint8_t*)>& onMatch, ScanSplit split = {});
+
+// Hardware threads capped at 8, past that the scan is bound by memory bandwidth
+unsigned DefaultScanThreads();
+
+} // namespace Signature
@@ -0,0 +1,60 @@
+#pragma once
+#include "signature.h"
+
+// Patterns written in the source ("8B 4C 24 ?? 85 C9") compiled by the compiler into fixed byte/mask arrays, so scanning one starts with nothing to parse or allocate
+// A malformed one doesn't build, the error lands on a call to one of the PatternError functions below, named for what's wrong with it
+// Patterns that only exist at runtime (typed in, read from a file) still go through Signature::Compile
+namespace Signature {
+
+namespace PatternError {
+// Not constexpr on purpose, reaching one while the compiler evaluates a PatternLiteral is the compile error
+inline void IncompleteByte() {}
+inline void InvalidHexDigit() {}
+inline void Empty() {}
+inline void LongerThanMaxSize() {}
+} // namespace PatternError
+
+struct PatternLiteral {
+    static constexpr size_t MAX_SIZE = 128; // Bytes, the longest pattern in the patches is under 80
+
+    const char* text = nullptr; // What Prefetch and the match cache key results by, nullptr = no pattern
+    uint8_t bytes[MAX_SIZE] = {}; // Pre-masked like Compiled
+    uint8_t masks[MAX_SIZE] = {};
+    uint8_t size = 0;
+    uint8_t anchor = 0;
+    uint8_t second = 0;
+    bool wildcardOnly = true;
+
+    constexpr PatternLiteral() = default;
+
+    // Implicit so `.pattern = "..."` keeps working in AddressInfo initializers
+    consteval PatternLiteral(const char* pattern) : text(pattern) {
+        for (const char* p = pattern; *p;) {
+            if (*p == ' ') {
+                p++;
+                continue;
+            }
+            if (size == MAX_SIZE) PatternError::LongerThanMaxSize();
+            switch (ParseByte(p, bytes[size], masks[size])) {
+            case ParseError::IncompleteByte: PatternError::IncompleteByte(); break;
+            case ParseError::InvalidDigit: PatternError::InvalidHexDigit(); break;
+            case ParseError::None: break;
+            }
+            size++;
+        }
+        if (!size) PatternError::Empty();
+
+        Anchors anchors = ChooseAnchors(bytes, masks, size);
+        anchor = static_cast<uint8_t>(anchors.anchor);
+        second = static_cast<uint8_t>(anchors.second);
+        wildcardOnly = anchors.wildcardOnly;
+    }
+
+    constexpr size_t Size() const { return size; }
+    constexpr bool Empty() const { return size == 0; }
+    operator View() const { return {bytes, masks, size, anchor, second, wildcardOnly}; }
+};
+
+static_assert(PatternLiteral::MAX_SIZE <= UINT8_MAX, "size and anchors are stored in a byte");
+
+} // namespace Signature
@@ -0,0 +1,329 @@
+#include "pe_image.h"
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#include <Psapi.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#endif
+
+namespace PE {
+
+namespace {
+
+// Offsets into the headers, the structs themselves are in winnt.h which the tools don't have
+constexpr uint16_t DOS_MAGIC = 0x5A4D;     // "MZ"
+constexpr uint32_t NT_SIGNATURE = 0x4550;  // "PE\0\0"
+constexpr uint16_t OPTIONAL_PE32 = 0x10B;
+constexpr uint16_t OPTIONAL_PE32PLUS = 0x20B;
+constexpr size_t FILE_HEADER_SIZE = 20;
+constexpr size_t SECTION_HEADER_SIZE = 40;
+constexpr size_t IMPORT_DESCRIPTOR_SIZE = 20;
+constexpr uint32_t DIRECTORY_EXPORT = 0;
+constexpr uint32_t DIRECTORY_IMPORT = 1;
+constexpr uint32_t DIRECTORY_BASERELOC = 5;
+constexpr uint16_t RELOC_HIGHLOW = 3;
+constexpr uint16_t RELOC_DIR64 = 10;
+constexpr uint32_t SCN_CNT_INITIALIZED_DATA = 0x00000040;
+
+template <typename T>
+T Read(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+bool EqualsNoCase(const char* a, const char* b) {
+    for (; *a && *b; a++, b++) {
+        char x = (*a >= 'A' && *a <= 'Z') ? *a + 32 : *a;
+        char y = (*b >= 'A' && *b <= 'Z') ? *b + 32 : *b;
+        if (x != y) return false;
+    }
+    return *a == *b;
+}
+
+uint32_t Extent(const Section& section) {
+    return section.virtualSize ? section.virtualSize : section.rawSize;
+}
+
+} // namespace
+
+bool Image::Fail(const std::string& message) {
+    error = message;
+    return false;
+}
+
+bool Image::Open(const std::filesystem::path& path) {
+    if (!file.Open(path)) return Fail("could not map file");
+    return Parse(file.Data(), file.Size(), Layout::File);
+}
+
+bool Image::Parse(const uint8_t* bytes, size_t byteCount, Layout imageLayout) {
+    data = bytes;
+    size = byteCount;
+    layout = imageLayout;
+    error.clear();
+    sections.clear();
+    imports.clear();
+    exports.clear();
+    relocations.clear();
+
+    if (!data || size < 0x40 || Read<uint16_t>(data) != DOS_MAGIC) return Fail("no MZ header");
+    const uint32_t ntOffset = Read<uint32_t>(data + 0x3C);
+    if (static_cast<uint64_t>(ntOffset) + 4 + FILE_HEADER_SIZE + 2 > size || Read<uint32_t>(data + ntOffset) != NT_SIGNATURE) return Fail("no PE header");
+
+    const uint8_t* fileHeader = data + ntOffset + 4;
+    machine = Read<uint16_t>(fileHeader);
+    const uint16_t sectionCount = Read<uint16_t>(fileHeader + 2);
+    timeDateStamp = Read<uint32_t>(fileHeader + 4);
+    const uint16_t optionalSize = Read<uint16_t>(fileHeader + 16);
+
+    const size_t optionalOffset = ntOffset + 4 + FILE_HEADER_SIZE;
+    if (optionalOffset + optionalSize > size) return Fail("optional header past the end");
+    const uint8_t* optional = data + optionalOffset;
+    const uint16_t magic = Read<uint16_t>(optional);
+    if (magic != OPTIONAL_PE32 && magic != OPTIONAL_PE32PLUS) return Fail("unknown optional header magic");
+    is64 = magic == OPTIONAL_PE32PLUS;
+    const size_t directoriesAt = is64 ? 112 : 96;
+    if (optionalSize < directoriesAt) return Fail("optional header too small");
+
+    imageBase = is64 ? Read<uint64_t>(optional + 24) : Read<uint32_t>(optional + 28);
+    sizeOfImage = Read<uint32_t>(optional + 56);
+    sizeOfHeaders = Read<uint32_t>(optional + 60);
+    sizeOfStackReserve = is64 ? Read<uint64_t>(optional + 72) : Read<uint32_t>(optional + 72);
+    const uint32_t directoryCount = Read<uint32_t>(optional + directoriesAt - 4);
+    auto directory = [&](uint32_t index) -> std::pair<uint32_t, uint32_t> {
+        if (index >= directoryCount || directoriesAt + (index + 1) * 8 > optionalSize) return {0, 0};
+        return {Read<uint32_t>(optional + directoriesAt + index * 8), Read<uint32_t>(optional + directoriesAt + index * 8 + 4)};
+    };
+
+    const size_t sectionsAt = optionalOffset + optionalSize;
+    if (sectionsAt + static_cast<size_t>(sectionCount) * SECTION_HEADER_SIZE > size) return Fail("section table past the end");
+    sections.reserve(sectionCount);
+    for (uint16_t i = 0; i < sectionCount; i++) {
+        const uint8_t* header = data + sectionsAt + i * SECTION_HEADER_SIZE;
+        Section section;
+        section.name.assign(reinterpret_cast<const char*>(header), strnlen(reinterpret_cast<const char*>(header), 8));
+        section.virtualSize = Read<uint32_t>(header + 8);
+        section.rva = Read<uint32_t>(header + 12);
+        section.rawSize = Read<uint32_t>(header + 16);
+        section.fileOffset = Read<uint32_t>(header + 20);
+        section.characteristics = Read<uint32_t>(header + 36);
+        sections.push_back(std::move(section));
+    }
+
+    // A broken directory drops that directory, not the image, scans only need the sections
+    auto [exportRva, exportSize] = directory(DIRECTORY_EXPORT);
+    if (exportRva && !ParseExports(exportRva, exportSize)) exports.clear();
+    auto [importRva, importSize] = directory(DIRECTORY_IMPORT);
+    if (importRva && !ParseImports(importRva, importSize)) imports.clear();
+    auto [relocRva, relocSize] = directory(DIRECTORY_BASERELOC);
+    if (relocRva && !ParseRelocations(relocRva, relocSize)) relocations.clear();
+    return true;
+}
+
+size_t Image::Offset(uint32_t rva, size_t count) const {
+    if (layout == Layout::Mapped) {
+        if (static_cast<uint64_t>(rva) + count > size) return SIZE_MAX;
+        return rva;
+    }
+    if (static_cast<uint64_t>(rva) + count <= sizeOfHeaders) return static_cast<uint64_t>(rva) + count <= size ? rva : SIZE_MAX;
+    const Section* section = SectionForRva(rva);
+    if (!section) return SIZE_MAX;
+    const uint64_t within = rva - section->rva;
+    if (within + count > section->rawSize || section->fileOffset + within + count > size) return SIZE_MAX;
+    return static_cast<size_t>(section->fileOffset + within);
+}
+
+const uint8_t* Image::AtRva(uint32_t rva, size_t count) const {
+    size_t offset = Offset(rva, count);
+    return offset == SIZE_MAX ? nullptr : data + offset;
+}
+
+uint32_t Image::RvaOf(const uint8_t* at) const {
+    if (at < data || at >= data + size) return 0;
+    const size_t offset = at - data;
+    if (layout == Layout::Mapped || offset < sizeOfHeaders) return static_cast<uint32_t>(offset);
+    for (const auto& section : sections) {
+        if (offset >= section.fileOffset && offset - section.fileOffset < section.rawSize) return section.rva + static_cast<uint32_t>(offset - section.fileOffset);
+    }
+    return 0;
+}
+
+const char* Image::StringAt(uint32_t rva) const {
+    size_t offset = Offset(rva, 1);
+    if (offset == SIZE_MAX) return nullptr;
+    // Has to end before the data does
+    const void* end = std::memchr(data + offset, 0, size - offset);
+    return end ? reinterpret_cast<const char*>(data + offset) : nullptr;
+}
+
+const Section* Image::FindSection(const char* name) const {
+    for (const auto& section : sections) {
+        if (section.name == name) return &section;
+    }
+    return nullptr;
+}
+
+const Section* Image::SectionForRva(uint32_t rva) const {
+    for (const auto& section : sections) {
+        if (rva >= section.rva && rva - section.rva < Extent(section)) return &section;
+    }
+    return nullptr;
+}
+
+bool Image::ParseImports(uint32_t rva, uint32_t) {
+    const size_t thunkSize = is64 ? 8 : 4;
+    for (uint32_t at = rva;; at += IMPORT_DESCRIPTOR_SIZE) {
+        const uint8_t* descriptor = AtRva(at, IMPORT_DESCRIPTOR_SIZE);
+        if (!descriptor) return false;
+        const uint32_t lookupRva = Read<uint32_t>(descriptor);
+        const uint32_t nameRva = Read<uint32_t>(descriptor + 12);
+        const uint32_t slotsRva = Read<uint32_t>(descriptor + 16);
+        if (!nameRva) return true;
+        const char* module = StringAt(nameRva);
+        if (!module) return false;
+
+        // Loaded modules have their IAT overwritten with addresses, names only survive in the lookup table
+        if (!lookupRva && layout == Layout::Mapped) continue;
+        const uint32_t namesRva = lookupRva ? lookupRva : slotsRva;
+        for (uint32_t i = 0;; i++) {
+            const uint8_t* thunk = AtRva(namesRva + i * static_cast<uint32_t>(thunkSize), thunkSize);
+            if (!thunk) return false;
+            const uint64_t value = is64 ? Read<uint64_t>(thunk) : Read<uint32_t>(thunk);
+            if (!value) break;
+
+            Import entry;
+            entry.module = module;
+            entry.slotRva = slotsRva + i * static_cast<uint32_t>(thunkSize);
+            const uint64_t ordinalFlag = is64 ? 0x8000000000000000ull : 0x80000000ull;
+            if (value & ordinalFlag) {
+                entry.ordinal = static_cast<uint16_t>(value & 0xFFFF);
+            } else {
+                const uint8_t* hint = AtRva(static_cast<uint32_t>(value), 2);
+                const char* name = StringAt(static_cast<uint32_t>(value) + 2);
+                if (!hint || !name) return false;
+                entry.ordinal = Read<uint16_t>(hint);
+                entry.name = name;
+            }
+            imports.push_back(std::move(entry));
+        }
+    }
+}
+
+bool Image::ParseExports(uint32_t rva, uint32_t directorySize) {
+    const uint8_t* directory = AtRva(rva, 40);
+    if (!directory) return false;
+    const uint32_t base = Read<uint32_t>(directory + 16);
+    const uint32_t functionCount = Read<uint32_t>(directory + 20);
+    const uint32_t nameCount = Read<uint32_t>(directory + 24);
+    const uint8_t* functions = AtRva(Read<uint32_t>(directory + 28), static_cast<size_t>(functionCount) * 4);
+    const uint8_t* names = nameCount ? AtRva(Read<uint32_t>(directory + 32), static_cast<size_t>(nameCount) * 4) : nullptr;
+    const uint8_t* ordinals = nameCount ? AtRva(Read<uint32_t>(directory + 36), static_cast<size_t>(nameCount) * 2) : nullptr;
+    if ((functionCount && !functions) || (nameCount && (!names || !ordinals))) return false;
+
+    std::vector<const char*> nameOf(functionCount, nullptr);
+    for (uint32_t i = 0; i < nameCount; i++) {
+        uint16_t index = Read<uint16_t>(ordinals + i * 2);
+        if (index < functionCount) nameOf[index] = StringAt(Read<uint32_t>(names + i * 4));
+    }
+    for (uint32_t i = 0; i < functionCount; i++) {
+        const uint32_t functionRva = Read<uint32_t>(functions + i * 4);
+        if (!functionRva) continue;
+        Export entry;
+        entry.ordinal = base + i;
+        entry.rva = functionRva;
+        if (nameOf[i]) entry.name = nameOf[i];
+        if (functionRva >= rva && functionRva - rva < directorySize) {
+            if (const char* forwarder = StringAt(functionRva)) entry.forwarder = forwarder;
+        }
+        exports.push_back(std::move(entry));
+    }
+    return true;
+}
+
+bool Image::ParseRelocations(uint32_t rva, uint32_t directorySize) {
+    for (uint32_t at = rva; at + 8 <= rva + directorySize;) {
+        const uint8_t* block = AtRva(at, 8);
+        if (!block) return false;
+        const uint32_t pageRva = Read<uint32_t>(block);
+        const uint32_t blockSize = Read<uint32_t>(block + 4);
+        if (blockSize < 8) break;
+        const uint8_t* entries = AtRva(at + 8, blockSize - 8);
+        if (!entries) return false;
+        for (uint32_t i = 0; i < (blockSize - 8) / 2; i++) {
+            const uint16_t entry = Read<uint16_t>(entries + i * 2);
+            const uint16_t type = entry >> 12;
+            if (type == RELOC_HIGHLOW || type == RELOC_DIR64) relocations.push_back(pageRva + (entry & 0x0FFF));
+        }
+        at += blockSize;
+    }
+    return true;
+}
+
+const Import* Image::FindImport(const char* module, const char* name) const {
+    for (const auto& entry : imports) {
+        if (entry.name == name && EqualsNoCase(entry.module.c_str(), module)) return &entry;
+    }
+    return nullptr;
+}
+
+Range Image::SectionBytes(const Section& section) const {
+    // The file only has rawSize of it, a mapped section is zero filled up to virtualSize (which no signature or string will match anyway)
+    uint64_t start = layout == Layout::Mapped ? section.rva : section.fileOffset;
+    uint64_t length = layout == Layout::Mapped ? Extent(section) : std::min(section.rawSize, Extent(section));
+    if (start >= size) return {nullptr, nullptr};
+    length = std::min<uint64_t>(length, size - start);
+    return {data + start, data + start + length};
+}
+
+std::vector<Range> Image::CodeRanges() const {
+    std::vector<Range> ranges;
+    for (const auto& section : sections) {
+        if (!section.IsExecutable()) continue;
+        Range range = SectionBytes(section);
+        if (range.first != range.second) ranges.push_back(range);
+    }
+    return ranges;
+}
+
+std::vector<Range> Image::ReadOnlyDataRanges() const {
+    std::vector<Range> ranges;
+    for (const auto& section : sections) {
+        if (section.IsExecutable() || section.IsWritable() || section.IsDiscardable() || !(section.characteristics & SCN_CNT_INITIALIZED_DATA)) continue;
+        Range range = SectionBytes(section);
+        if (range.first != range.second) ranges.push_back(range);
+    }
+    return ranges;
+}
+
+#ifdef _WIN32
+const Image* Image::ForModule(void* module) {
+    static std::mutex mutex;
+    static std::unordered_map<void*, std::unique_ptr<Image>> images;
+    if (!module) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& image = images[module];
+    if (!image) {
+        image = std::make_unique<Image>();
+        MODULEINFO moduleInfo{};
+        if (GetModuleInformation(GetCurrentProcess(), static_cast<HMODULE>(module), &moduleInfo, sizeof(moduleInfo))) {
+            image->Parse(static_cast<const uint8_t*>(module), moduleInfo.SizeOfImage, Layout::Mapped);
+        } else {
+            image->Fail("GetModuleInformation failed");
+        }
+    }
+    return image->GetError().empty() ? image.get() : nullptr;
+}
+
+const Image& Image::Main() {
+    static const Image* main = ForModule(GetModuleHandleW(nullptr));
+    static const Image empty;
+    return main ? *main : empty;
+}
+#endif
+
+} // namespace PE
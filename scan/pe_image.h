@@ -0,0 +1,129 @@
+#pragma once
+#include "../mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+// PE headers parsed once: sections, imports, exports and base relocations, for everything that used to walk IMAGE_NT_HEADERS itself
+// (DetectGameVersion, IATHookHelper, VTableManager, Pattern::ScanModule). Platform-neutral and bounds checked, so the offline tools
+// can open exe/dll files from disk (tools/pe_scan_check.cpp), the DLL side gets loaded modules through ForModule/Main
+namespace PE {
+
+struct Section {
+    std::string name;
+    uint32_t rva = 0;
+    uint32_t virtualSize = 0;
+    uint32_t fileOffset = 0;
+    uint32_t rawSize = 0;
+    uint32_t characteristics = 0;
+
+    bool IsExecutable() const { return (characteristics & 0x20000000) != 0; } // IMAGE_SCN_MEM_EXECUTE
+    bool IsWritable() const { return (characteristics & 0x80000000) != 0; }   // IMAGE_SCN_MEM_WRITE
+    bool IsDiscardable() const { return (characteristics & 0x02000000) != 0; } // IMAGE_SCN_MEM_DISCARDABLE
+};
+
+struct Import {
+    std::string module;
+    std::string name;     // Empty when imported by ordinal
+    uint16_t ordinal = 0; // Hint for named imports
+    uint32_t slotRva = 0; // The IAT entry the loader writes the address into
+};
+
+struct Export {
+    std::string name; // Empty for ordinal-only exports
+    uint32_t ordinal = 0;
+    uint32_t rva = 0;
+    std::string forwarder; // "DLL.Function" when the export forwards, rva then points at that string
+};
+
+// What a scan walks: [first, second) inside the image
+using Range = std::pair<const uint8_t*, const uint8_t*>;
+
+class Image {
+  public:
+    // How the bytes are laid out: Mapped = a loaded module (RVA == offset), File = the file as it is on disk
+    enum class Layout { Mapped, File };
+
+    // Map + parse a file from disk, false with GetError() set on failure
+    bool Open(const std::filesystem::path& path);
+
+    // Parse an image already in memory, data has to outlive the Image
+    bool Parse(const uint8_t* data, size_t size, Layout layout);
+
+    const std::string& GetError() const { return error; }
+    const uint8_t* Data() const { return data; }
+    Layout GetLayout() const { return layout; }
+
+    uint16_t Machine() const { return machine; }
+    bool Is64Bit() const { return is64; }
+    uint32_t TimeDateStamp() const { return timeDateStamp; }
+    uint32_t SizeOfImage() const { return sizeOfImage; }
+    uint32_t SizeOfHeaders() const { return sizeOfHeaders; }
+    uint64_t ImageBase() const { return imageBase; }
+    uint64_t SizeOfStackReserve() const { return sizeOfStackReserve; }
+
+    const std::vector<Section>& Sections() const { return sections; }
+    const std::vector<Import>& Imports() const { return imports; }
+    const std::vector<Export>& Exports() const { return exports; }
+    // RVAs of every absolute address the loader fixes up when the image moves (HIGHLOW / DIR64 entries)
+    const std::vector<uint32_t>& Relocations() const { return relocations; }
+
+    const Section* FindSection(const char* name) const;
+    const Section* SectionForRva(uint32_t rva) const;
+
+    // Pointer to size bytes at rva, nullptr if they aren't all backed by data (bss, past the file, between sections)
+    const uint8_t* AtRva(uint32_t rva, size_t size = 1) const;
+    // The other way, for a pointer into Data() (what a scan over CodeRanges/ReadOnlyDataRanges hands back). 0 if it isn't in the headers or a section
+    uint32_t RvaOf(const uint8_t* at) const;
+
+    // Mapped layout: whether an absolute address lies inside the image
+    bool Contains(uintptr_t address) const { return address >= reinterpret_cast<uintptr_t>(data) && address - reinterpret_cast<uintptr_t>(data) < sizeOfImage; }
+
+    // Named import, nullptr if the image doesn't import it. Module names compare case-insensitively like the loader does
+    const Import* FindImport(const char* module, const char* name) const;
+
+    // The executable sections, where every signature lives
+    std::vector<Range> CodeRanges() const;
+    // Read-only initialized data (.rdata and friends), where string literals and vtables live
+    std::vector<Range> ReadOnlyDataRanges() const;
+
+#ifdef _WIN32
+    // Loaded module, parsed on first use and kept for the life of the process
+    static const Image* ForModule(void* module);
+    // The game exe
+    static const Image& Main();
+#endif
+
+  private:
+    bool Fail(const std::string& message);
+    // rva -> offset into data for this layout, SIZE_MAX if not backed
+    size_t Offset(uint32_t rva, size_t size) const;
+    const char* StringAt(uint32_t rva) const;
+    Range SectionBytes(const Section& section) const;
+    bool ParseImports(uint32_t rva, uint32_t size);
+    bool ParseExports(uint32_t rva, uint32_t size);
+    bool ParseRelocations(uint32_t rva, uint32_t size);
+
+    MappedFile file;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    Layout layout = Layout::Mapped;
+    std::string error;
+
+    uint16_t machine = 0;
+    bool is64 = false;
+    uint32_t timeDateStamp = 0;
+    uint32_t sizeOfImage = 0;
+    uint32_t sizeOfHeaders = 0;
+    uint64_t imageBase = 0;
+    uint64_t sizeOfStackReserve = 0;
+    std::vector<Section> sections;
+    std::vector<Import> imports;
+    std::vector<Export> exports;
+    std::vector<uint32_t> relocations;
+};
+
+} // namespace PE
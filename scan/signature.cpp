@@ -0,0 +1,223 @@
+#include "signature.h"
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// GCC/Clang only emit AVX2 inside functions marked for it, so nothing here needs -mavx2 and the SSE2 path stays SSE2. MSVC doesn't care
+#if defined(_MSC_VER)
+#define SIGNATURE_AVX2
+#else
+#define SIGNATURE_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Signature {
+
+namespace {
+
+void SetAnchors(Compiled& pattern) {
+    Anchors anchors = ChooseAnchors(pattern.bytes.data(), pattern.masks.data(), pattern.Size());
+    pattern.anchor = anchors.anchor;
+    pattern.second = anchors.second;
+    pattern.wildcardOnly = anchors.wildcardOnly;
+}
+
+inline uint32_t LowestBit(uint32_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctz(bits));
+#endif
+}
+
+inline bool Matches(const uint8_t* at, const View& pattern) {
+    const uint8_t* bytes = pattern.bytes;
+    const uint8_t* masks = pattern.masks;
+    for (size_t j = 0, n = pattern.Size(); j < n; j++) {
+        if ((at[j] & masks[j]) != bytes[j]) return false;
+    }
+    return true;
+}
+
+// The vector loops below hand every full match to onHit, which returns true to stop there. onHit always gets inlined (Find stops at the first,
+// ForEachMatch fills a batch), an opaque call in there would have the compiler keep the vector constants in memory for the whole walk
+
+// Scalar finish for the candidates the vector loops couldn't cover, last is the final start offset that still fits
+template <typename OnHit>
+const uint8_t* WalkTail(const uint8_t* p, const uint8_t* last, const View& pattern, OnHit&& onHit) {
+    const uint8_t anchorByte = pattern.bytes[pattern.anchor];
+    const uint8_t anchorMask = pattern.masks[pattern.anchor];
+    for (; p <= last; p++) {
+        if ((p[pattern.anchor] & anchorMask) == anchorByte && Matches(p, pattern) && onHit(p)) return p;
+    }
+    return nullptr;
+}
+
+// Both anchors are compared 16 candidates at a time, only starts where both hit get the full masked compare
+template <typename OnHit>
+const uint8_t* WalkSSE2(const uint8_t* begin, const uint8_t* last, const View& pattern, OnHit&& onHit) {
+    const size_t anchor = pattern.anchor;
+    const size_t second = pattern.second;
+    const __m128i anchorByte = _mm_set1_epi8(static_cast<char>(pattern.bytes[anchor]));
+    const __m128i anchorMask = _mm_set1_epi8(static_cast<char>(pattern.masks[anchor]));
+    const __m128i secondByte = _mm_set1_epi8(static_cast<char>(pattern.bytes[second]));
+    const __m128i secondMask = _mm_set1_epi8(static_cast<char>(pattern.masks[second]));
+    const uint8_t* p = begin;
+    // p + 15 <= last keeps every load (at most p + Size() - 1 + 15) inside the range
+    for (; last - p >= 15; p += 16) {
+        __m128i a = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + anchor)), anchorMask), anchorByte);
+        __m128i s = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + second)), secondMask), secondByte);
+        uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(a, s)));
+        while (bits) {
+            const uint8_t* candidate = p + LowestBit(bits);
+            if (Matches(candidate, pattern) && onHit(candidate)) return candidate;
+            bits &= bits - 1;
+        }
+    }
+    return WalkTail(p, last, pattern, onHit);
+}
+
+template <typename OnHit>
+SIGNATURE_AVX2 const uint8_t* WalkAVX2(const uint8_t* begin, const uint8_t* last, const View& pattern, OnHit&& onHit) {
+    const size_t anchor = pattern.anchor;
+    const size_t second = pattern.second;
+    const __m256i anchorByte = _mm256_set1_epi8(static_cast<char>(pattern.bytes[anchor]));
+    const __m256i anchorMask = _mm256_set1_epi8(static_cast<char>(pattern.masks[anchor]));
+    const __m256i secondByte = _mm256_set1_epi8(static_cast<char>(pattern.bytes[second]));
+    const __m256i secondMask = _mm256_set1_epi8(static_cast<char>(pattern.masks[second]));
+    const uint8_t* p = begin;
+    for (; last - p >= 31; p += 32) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + anchor)), anchorMask), anchorByte);
+        __m256i s = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + second)), secondMask), secondByte);
+        uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(a, s)));
+        while (bits) {
+            const uint8_t* candidate = p + LowestBit(bits);
+            if (Matches(candidate, pattern) && onHit(candidate)) return candidate;
+            bits &= bits - 1;
+        }
+    }
+    return WalkTail(p, last, pattern, onHit);
+}
+
+// Find's onHit, stops at the first match
+inline bool StopAtFirst(const uint8_t*) {
+    return true;
+}
+
+} // namespace
+
+bool Compile(const char* pattern, Compiled& out, std::string* error) {
+    out = Compiled{};
+    auto fail = [&](const char* what, const char* at) {
+        if (error) *error = std::string(what) + " at: " + at;
+        out = Compiled{};
+        return false;
+    };
+    if (!pattern) return fail("Null pattern", "");
+
+    const char* p = pattern;
+    while (*p) {
+        while (*p == ' ') p++;
+        if (!*p) break;
+
+        uint8_t byte = 0, mask = 0;
+        const char* at = p;
+        switch (ParseByte(p, byte, mask)) {
+        case ParseError::IncompleteByte: return fail("Invalid pattern format (incomplete byte)", at);
+        case ParseError::InvalidDigit: return fail("Invalid pattern format", at);
+        case ParseError::None: break;
+        }
+        out.bytes.push_back(byte);
+        out.masks.push_back(mask);
+    }
+    if (out.bytes.empty()) return fail("Empty pattern", pattern);
+
+    SetAnchors(out);
+    return true;
+}
+
+Compiled CompileMasked(const uint8_t* bytes, const char* mask) {
+    Compiled out;
+    for (size_t i = 0; mask && mask[i]; i++) {
+        uint8_t m = mask[i] == 'x' ? 0xFF : 0x00;
+        out.bytes.push_back(bytes[i] & m);
+        out.masks.push_back(m);
+    }
+    SetAnchors(out);
+    return out;
+}
+
+bool CpuHasSSSE3() {
+#ifdef _MSC_VER
+    int leaves[4] = {0};
+    __cpuid(leaves, 1);
+    return (leaves[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+bool CpuHasAVX2() {
+#ifdef _MSC_VER
+    int leaves[4] = {0};
+    __cpuidex(leaves, 7, 0);
+    return (leaves[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+const uint8_t* Find(const uint8_t* begin, const uint8_t* end, const View& pattern) {
+    static const bool hasAVX2 = CpuHasAVX2();
+    if (pattern.Empty() || !begin || end < begin || static_cast<size_t>(end - begin) < pattern.Size()) return nullptr;
+    if (pattern.wildcardOnly) return begin;
+    const uint8_t* last = end - pattern.Size();
+    return hasAVX2 ? WalkAVX2(begin, last, pattern, StopAtFirst) : WalkSSE2(begin, last, pattern, StopAtFirst);
+}
+
+void ForEachMatch(const uint8_t* begin, const uint8_t* end, const View& pattern, const std::function<void(const uint8_t*)>& onMatch) {
+    static const bool hasAVX2 = CpuHasAVX2();
+    if (pattern.Empty() || !begin || end < begin || static_cast<size_t>(end - begin) < pattern.Size()) return;
+    const uint8_t* last = end - pattern.Size();
+    if (pattern.wildcardOnly) {
+        for (const uint8_t* p = begin; p <= last; p++) onMatch(p);
+        return;
+    }
+    // Hits are collected a batch at a time and the walk picks up right after the last one, so onMatch never runs inside the vector loop
+    const uint8_t* batch[64];
+    size_t count = 0;
+    auto collect = [&](const uint8_t* at) {
+        batch[count++] = at;
+        return count == std::size(batch);
+    };
+    for (const uint8_t* p = begin; p <= last;) {
+        count = 0;
+        const uint8_t* full = hasAVX2 ? WalkAVX2(p, last, pattern, collect) : WalkSSE2(p, last, pattern, collect);
+        for (size_t i = 0; i < count; i++) onMatch(batch[i]);
+        if (!full) break;
+        p = full + 1;
+    }
+}
+
+MatchRange::Iterator& MatchRange::Iterator::operator++() {
+    at = Find(at + 1, end, pattern);
+    return *this;
+}
+
+const uint8_t* FindSSE2(const uint8_t* begin, const uint8_t* end, const View& pattern) {
+    if (pattern.Empty() || !begin || end < begin || static_cast<size_t>(end - begin) < pattern.Size()) return nullptr;
+    if (pattern.wildcardOnly) return begin;
+    return WalkSSE2(begin, end - pattern.Size(), pattern, StopAtFirst);
+}
+
+const uint8_t* FindNaive(const uint8_t* begin, const uint8_t* end, const View& pattern) {
+    if (pattern.Empty() || !begin || end < begin || static_cast<size_t>(end - begin) < pattern.Size()) return nullptr;
+    for (const uint8_t* p = begin, *last = end - pattern.Size(); p <= last; p++) {
+        if (Matches(p, pattern)) return p;
+    }
+    return nullptr;
+}
+
+} // namespace Signature
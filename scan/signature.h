@@ -0,0 +1,194 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Compiled byte signatures and the scanner behind PatchHelper::ScanPattern and Pattern::ScanModule
+// No Windows dependency so the scanner can be benchmarked off the game (tools/pattern_scan_bench.cpp)
+namespace Signature {
+
+// Rough weight of each byte value in 32-bit MSVC code (TS3.exe's .text and friends), only the ordering matters
+// Picking the anchor off this means "8B 44 24 ?? 85 C9" gets searched by C9 instead of stopping at every mov
+constexpr std::array<uint16_t, 256> MakeByteWeights() {
+    std::array<uint16_t, 256> weights{};
+    for (auto& w : weights) w = 4;
+    for (uint8_t b : {0x00, 0xFF, 0x8B, 0xCC}) weights[b] = 64;
+    for (uint8_t b : {0x01, 0x02, 0x03, 0x04, 0x06, 0x08, 0x0C, 0x0F, 0x10, 0x14, 0x18, 0x1C, 0x20, 0x24, 0x33, 0x3B, 0x40, 0x44, 0x45, 0x46, 0x48, 0x4C, 0x4E, 0x50, 0x51, 0x54, 0x55, 0x56,
+             0x57, 0x5D, 0x5E, 0x5F, 0x6A, 0x74, 0x75, 0x80, 0x83, 0x85, 0x89, 0x8D, 0x90, 0xC0, 0xC3, 0xC4, 0xC7, 0xE8, 0xEB, 0xEC, 0xF8})
+        weights[b] = 32;
+    return weights;
+}
+
+inline constexpr std::array<uint16_t, 256> BYTE_WEIGHTS = MakeByteWeights();
+
+// How often a masked byte is expected to match in x86 code, lower is rarer. What the anchors are picked by
+constexpr uint32_t MatchWeight(uint8_t value, uint8_t mask) {
+    uint32_t total = 0;
+    for (uint32_t v = 0; v < 256; v++) {
+        if ((v & mask) == value) total += BYTE_WEIGHTS[v];
+    }
+    return total;
+}
+
+// Positions the vector pass compares, anchor is the least likely byte to show up in x86 code and second the next least likely
+// second == anchor when the pattern only has one non-wildcard byte. wildcardOnly = everything is a wildcard (or the pattern is empty), matches at the first offset that fits
+struct Anchors {
+    size_t anchor = 0;
+    size_t second = 0;
+    bool wildcardOnly = true;
+};
+
+constexpr Anchors ChooseAnchors(const uint8_t* bytes, const uint8_t* masks, size_t size) {
+    Anchors out;
+    uint32_t best = UINT32_MAX;
+    uint32_t runnerUp = UINT32_MAX;
+    for (size_t i = 0; i < size; i++) {
+        if (!masks[i]) continue;
+        uint32_t weight = MatchWeight(bytes[i], masks[i]);
+        if (weight < best) {
+            runnerUp = best;
+            out.second = out.anchor;
+            best = weight;
+            out.anchor = i;
+        } else if (weight < runnerUp) {
+            runnerUp = weight;
+            out.second = i;
+        }
+        out.wildcardOnly = false;
+    }
+    if (runnerUp == UINT32_MAX) out.second = out.anchor;
+    return out;
+}
+
+enum class ParseError : uint8_t { None, IncompleteByte, InvalidDigit };
+
+// One byte of the text form at p (spaces before it already skipped), p is left after it. Shared by Compile and PatternLiteral so both read patterns the same way
+constexpr ParseError ParseByte(const char*& p, uint8_t& byte, uint8_t& mask) {
+    // Lone "?" is a whole-byte wildcard, same as "??"
+    if (p[0] == '?' && (p[1] == ' ' || p[1] == '\0')) {
+        byte = mask = 0;
+        p++;
+        return ParseError::None;
+    }
+    if (!p[1] || p[1] == ' ') return ParseError::IncompleteByte;
+
+    auto nibble = [](char c) -> int {
+        if (c == '?') return 0;
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
+        if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
+        return -1;
+    };
+    int hi = nibble(p[0]);
+    int lo = nibble(p[1]);
+    if (hi < 0 || lo < 0) return ParseError::InvalidDigit;
+
+    mask = static_cast<uint8_t>((p[0] == '?' ? 0 : 0xF0) | (p[1] == '?' ? 0 : 0x0F));
+    byte = static_cast<uint8_t>((hi << 4) | lo) & mask;
+    p += 2;
+    return ParseError::None;
+}
+
+// What the scanners take, a compiled pattern someone else owns. Compiled and PatternLiteral (pattern_literal.h) both convert to one
+struct View {
+    const uint8_t* bytes = nullptr;
+    const uint8_t* masks = nullptr;
+    size_t size = 0;
+    size_t anchor = 0;
+    size_t second = 0;
+    bool wildcardOnly = true;
+
+    size_t Size() const { return size; }
+    bool Empty() const { return size == 0; }
+};
+
+// A pattern parsed once at runtime, bytes are stored pre-masked so verifying is (data & mask) == byte
+// masks: 0xFF exact, 0xF0 high nibble, 0x0F low nibble, 0x00 wildcard
+struct Compiled {
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> masks;
+    // See Anchors
+    size_t anchor = 0;
+    size_t second = 0;
+    bool wildcardOnly = true;
+
+    Compiled() = default;
+    explicit Compiled(const View& view)
+        : bytes(view.bytes, view.bytes + view.size), masks(view.masks, view.masks + view.size), anchor(view.anchor), second(view.second), wildcardOnly(view.wildcardOnly) {}
+
+    size_t Size() const { return bytes.size(); }
+    bool Empty() const { return bytes.empty(); }
+    operator View() const { return {bytes.data(), masks.data(), bytes.size(), anchor, second, wildcardOnly}; }
+};
+
+// Text form: "8B 4C 24 ?? 85 C9", "?" and "??" are whole-byte wildcards, "?F"/"F?" match one nibble
+// Returns false and fills error on anything else, an empty pattern is an error too
+bool Compile(const char* pattern, Compiled& out, std::string* error = nullptr);
+
+// Raw bytes plus an IDA style mask, 'x' = compare, anything else = wildcard
+Compiled CompileMasked(const uint8_t* bytes, const char* mask);
+
+// First match in [begin, end), nullptr if none. The whole match has to fit, nothing past end is read
+const uint8_t* Find(const uint8_t* begin, const uint8_t* end, const View& pattern);
+
+// Every match in [begin, end) in address order, overlapping ones included. One walk of the vector loop, not a Find restarted after each hit
+void ForEachMatch(const uint8_t* begin, const uint8_t* end, const View& pattern, const std::function<void(const uint8_t*)>& onMatch);
+
+// The same matches as a range, for loops that want to break out or patch as they go: for (const uint8_t* at : Signature::FindAll(begin, end, pattern))
+// Each step resumes Find right after the previous match. The pattern has to outlive the range, so a PatternLiteral or a named Compiled, not a temporary
+class MatchRange {
+  public:
+    class Iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = const uint8_t*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = value_type;
+
+        Iterator() = default;
+        Iterator(const uint8_t* match, const uint8_t* rangeEnd, const View& view) : at(match), end(rangeEnd), pattern(view) {}
+
+        const uint8_t* operator*() const { return at; }
+        Iterator& operator++();
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        // Past the last match at is nullptr, same as a default constructed one
+        bool operator==(const Iterator& other) const { return at == other.at; }
+
+      private:
+        const uint8_t* at = nullptr;
+        const uint8_t* end = nullptr;
+        View pattern;
+    };
+
+    MatchRange(const uint8_t* rangeBegin, const uint8_t* rangeEnd, const View& pattern) : first(Find(rangeBegin, rangeEnd, pattern), rangeEnd, pattern) {}
+
+    Iterator begin() const { return first; }
+    Iterator end() const { return {}; }
+
+  private:
+    Iterator first;
+};
+
+inline MatchRange FindAll(const uint8_t* begin, const uint8_t* end, const View& pattern) {
+    return {begin, end, pattern};
+}
+
+// Same search without the vector pass, kept as the reference the benchmark checks Find against
+const uint8_t* FindNaive(const uint8_t* begin, const uint8_t* end, const View& pattern);
+
+// Forces the SSE2 path even on AVX2 CPUs, for the benchmark
+const uint8_t* FindSSE2(const uint8_t* begin, const uint8_t* end, const View& pattern);
+
+bool CpuHasSSSE3();
+bool CpuHasAVX2();
+
+} // namespace Signature
@@ -0,0 +1,164 @@
+#include "string_index.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace PE {
+
+namespace {
+
+using StringMap = std::unordered_multimap<std::string_view, uint32_t>;
+
+uint32_t Read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+bool Printable(uint8_t c) {
+    return (c >= 0x20 && c < 0x7F) || c == '\t' || c == '\n' || c == '\r';
+}
+
+// rva = where begin is in the image
+void IndexAscii(const uint8_t* begin, const uint8_t* end, uint32_t rva, StringMap& strings) {
+    for (const uint8_t* at = begin; at < end;) {
+        if (!Printable(*at)) {
+            at++;
+            continue;
+        }
+        const uint8_t* run = at;
+        while (at < end && Printable(*at)) at++;
+        if (at < end && *at == 0 && static_cast<size_t>(at - run) >= StringIndex::MIN_LENGTH) strings.emplace(std::string_view(reinterpret_cast<const char*>(run), at - run), rva + static_cast<uint32_t>(run - begin));
+    }
+}
+
+// Compilers put wide literals on 2 byte boundaries, so only even RVAs are tried
+void IndexUtf16(const uint8_t* begin, const uint8_t* end, uint32_t rva, StringMap& strings) {
+    const size_t size = end - begin;
+    auto isChar = [&](size_t i) { return begin[i + 1] == 0 && Printable(begin[i]); };
+    for (size_t i = rva & 1; i + 1 < size;) {
+        if (!isChar(i)) {
+            i += 2;
+            continue;
+        }
+        const size_t run = i;
+        while (i + 1 < size && isChar(i)) i += 2;
+        if (i + 1 < size && begin[i] == 0 && begin[i + 1] == 0 && (i - run) / 2 >= StringIndex::MIN_LENGTH) strings.emplace(std::string_view(reinterpret_cast<const char*>(begin + run), i - run), rva + static_cast<uint32_t>(run));
+    }
+}
+
+std::vector<uint32_t> Lookup(const StringMap& strings, std::string_view key) {
+    std::vector<uint32_t> rvas;
+    auto [first, last] = strings.equal_range(key);
+    for (auto it = first; it != last; ++it) rvas.push_back(it->second);
+    std::sort(rvas.begin(), rvas.end());
+    return rvas;
+}
+
+// UTF-16LE bytes, how the strings are keyed
+std::string Utf16Key(std::u16string_view text) {
+    std::string key;
+    key.reserve(text.size() * 2);
+    for (char16_t c : text) {
+        key.push_back(static_cast<char>(c & 0xFF));
+        key.push_back(static_cast<char>(c >> 8));
+    }
+    return key;
+}
+
+} // namespace
+
+void StringIndex::Build(const Image& image, uint64_t loadedBase) {
+    ascii.clear();
+    utf16.clear();
+    referenceSpans.clear();
+    sources.clear();
+    fromRelocations = false;
+
+    // [begin, end) RVAs a reference has to land in
+    std::vector<std::pair<uint32_t, uint32_t>> data;
+    for (const auto& [begin, end] : image.ReadOnlyDataRanges()) {
+        const uint32_t rva = image.RvaOf(begin);
+        data.push_back({rva, rva + static_cast<uint32_t>(end - begin)});
+        IndexAscii(begin, end, rva, ascii);
+        IndexUtf16(begin, end, rva, utf16);
+    }
+    auto inData = [&](uint32_t target) {
+        for (const auto& [begin, end] : data) {
+            if (target - begin < end - begin) return true;
+        }
+        return false;
+    };
+
+    std::vector<std::pair<uint32_t, uint32_t>> found; // target, source
+    const uint32_t base = static_cast<uint32_t>(loadedBase);
+    if (!image.Is64Bit() && !image.Relocations().empty()) {
+        // Every absolute address in code has an entry, nothing else does
+        fromRelocations = true;
+        for (uint32_t rva : image.Relocations()) {
+            const Section* section = image.SectionForRva(rva);
+            const uint8_t* at = section && section->IsExecutable() ? image.AtRva(rva, 4) : nullptr;
+            if (!at) continue;
+            const uint32_t target = Read32(at) - base;
+            if (inData(target)) found.push_back({target, rva});
+        }
+    } else {
+        for (const auto& [begin, end] : image.CodeRanges()) {
+            const uint32_t rva = image.RvaOf(begin);
+            for (const uint8_t* at = begin; end - at >= 4; at++) {
+                const uint32_t source = rva + static_cast<uint32_t>(at - begin);
+                const uint32_t target = image.Is64Bit() ? source + 4 + Read32(at) : Read32(at) - base;
+                if (inData(target)) found.push_back({target, source});
+            }
+        }
+    }
+
+    std::sort(found.begin(), found.end());
+    sources.reserve(found.size());
+    for (size_t i = 0; i < found.size();) {
+        const uint32_t target = found[i].first;
+        const size_t first = i;
+        for (; i < found.size() && found[i].first == target; i++) sources.push_back(found[i].second);
+        referenceSpans[target] = {static_cast<uint32_t>(first), static_cast<uint32_t>(i - first)};
+    }
+}
+
+std::vector<uint32_t> StringIndex::FindAscii(std::string_view text) const {
+    return Lookup(ascii, text);
+}
+
+std::vector<uint32_t> StringIndex::FindUtf16(std::u16string_view text) const {
+    return Lookup(utf16, Utf16Key(text));
+}
+
+std::span<const uint32_t> StringIndex::ReferencesTo(uint32_t targetRva) const {
+    auto it = referenceSpans.find(targetRva);
+    if (it == referenceSpans.end()) return {};
+    return std::span<const uint32_t>(sources).subspan(it->second.first, it->second.second);
+}
+
+std::vector<uint32_t> StringIndex::Merge(const std::vector<uint32_t>& targets) const {
+    std::vector<uint32_t> merged;
+    for (uint32_t target : targets) {
+        std::span<const uint32_t> references = ReferencesTo(target);
+        merged.insert(merged.end(), references.begin(), references.end());
+    }
+    std::sort(merged.begin(), merged.end());
+    return merged;
+}
+
+std::vector<uint32_t> StringIndex::ReferencesToAscii(std::string_view text) const {
+    return Merge(FindAscii(text));
+}
+
+std::vector<uint32_t> StringIndex::ReferencesToUtf16(std::u16string_view text) const {
+    return Merge(FindUtf16(text));
+}
+
+bool StringIndex::References(uint32_t begin, uint32_t end, uint32_t targetRva) const {
+    std::span<const uint32_t> references = ReferencesTo(targetRva);
+    auto it = std::lower_bound(references.begin(), references.end(), begin);
+    return it != references.end() && *it < end;
+}
+
+} // namespace PE
@@ -0,0 +1,59 @@
+#pragma once
+#include "pe_image.h"
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Every string literal in an image's read-only data, and every place in its code that points into that data, each found in one pass
+// "The function that uses "Debug/VarMan"" is then a couple of hash lookups instead of a scan for the string and another for the pointer to it
+// Tooling only (tools/pe_scan_check): building one takes a few ms and several MB for the game exe, and the only lookups in the .asi are
+// VTableManager's two literals once per launch, which a scan of .rdata answers faster than the index can be built
+// A code reference is what the compiler emits for a literal's address: on x86 an absolute imm32/disp32 (read off the relocation table when the
+// image has one, otherwise every 4 bytes of code are tried), on x64 a rip-relative disp32 that ends the instruction (lea/mov reg, [rip+x])
+namespace PE {
+
+class StringIndex {
+  public:
+    // Chars, shorter printable runs are mostly other data that happens to look like text
+    static constexpr size_t MIN_LENGTH = 4;
+
+    // loadedBase = what the image's absolute addresses are relative to, ImageBase() for a file or a copy nobody relocated,
+    // the module's address for a loaded one. The image has to outlive the index, strings are looked up in place
+    void Build(const Image& image, uint64_t loadedBase);
+    void Build(const Image& image) { Build(image, image.ImageBase()); }
+
+    // RVA of every NUL-terminated copy of text (no terminator in text), lowest first. Only printable ASCII is indexed,
+    // so UTF-16 text outside that range is never found. Text that's only the tail of a longer string isn't either
+    std::vector<uint32_t> FindAscii(std::string_view text) const;
+    std::vector<uint32_t> FindUtf16(std::u16string_view text) const;
+
+    // Code RVAs that reference targetRva, in address order. Any target inside read-only data is indexed, not just string starts,
+    // so this also works for a constant or a string found some other way
+    std::span<const uint32_t> ReferencesTo(uint32_t targetRva) const;
+    // References to any copy of the string, in address order
+    std::vector<uint32_t> ReferencesToAscii(std::string_view text) const;
+    std::vector<uint32_t> ReferencesToUtf16(std::u16string_view text) const;
+    // Whether code in [begin, end) references targetRva, the "does this function use that literal" check
+    bool References(uint32_t begin, uint32_t end, uint32_t targetRva) const;
+
+    size_t StringCount() const { return ascii.size() + utf16.size(); }
+    size_t ReferenceCount() const { return sources.size(); }
+    // Whether references came from the relocation table (exact) or from trying every 4 bytes of code (can include bytes that only look like one)
+    bool FromRelocations() const { return fromRelocations; }
+
+  private:
+    std::vector<uint32_t> Merge(const std::vector<uint32_t>& targets) const;
+
+    // Views straight into the image, the UTF-16 ones over the raw little-endian bytes
+    std::unordered_multimap<std::string_view, uint32_t> ascii;
+    std::unordered_multimap<std::string_view, uint32_t> utf16;
+    // target RVA -> [first, first + count) in sources
+    std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> referenceSpans;
+    std::vector<uint32_t> sources;
+    bool fromRelocations = false;
+};
+
+} // namespace PE
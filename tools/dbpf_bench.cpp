@@ -0,0 +1,213 @@
+// DBPF index reader benchmark: how many packages per second can be mapped + indexed, and how fast lookups are
+// Build (Linux): g++ -O2 -std=c++20 -I.. dbpf_bench.cpp ../dbpf/dbpf_reader.cpp ../dbpf/dbpf_writer.cpp ../dbpf/dbpf_index_cache.cpp ../mapped_file.cpp -o dbpf_bench
+// Usage:         dbpf_bench [package dir]... [--synthetic N] [--passes N]
+// Without dirs it writes N synthetic packages (default 2000) to a temp dir, shaped like a CC folder: mostly small, a few huge
+#include "dbpf/dbpf_index_cache.h"
+#include "dbpf/dbpf_reader.h"
+#include "dbpf/dbpf_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static double Seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void CollectPackages(const fs::path& dir, std::vector<fs::path>& out) {
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dir, ec), end; it != end; it.increment(ec)) {
+        if (ec) break;
+        if (it->is_regular_file() && it->path().extension() == ".package") out.push_back(it->path());
+    }
+}
+
+// Writes count packages and checks each one reads back exactly as laid out
+static bool WriteSynthetic(const fs::path& dir, uint32_t count, std::vector<fs::path>& out) {
+    std::mt19937 rng(0xDB9F);
+    std::lognormal_distribution<double> entryCounts(3.0, 1.5); // Median ~20 entries, long tail into the thousands
+    static const uint32_t types[] = {0x00B2D882, 0x015A1849, 0x0333406C, 0x034AEECB, 0x01661233, 0x220557DA, 0x319E4F1D, 0x025ED6F4};
+    std::vector<uint8_t> payload(512);
+    for (auto& b : payload) b = static_cast<uint8_t>(rng());
+
+    fs::create_directories(dir);
+    for (uint32_t i = 0; i < count; i++) {
+        DBPF::PackageWriter writer;
+        uint32_t entries = std::clamp<uint32_t>(static_cast<uint32_t>(entryCounts(rng)), 1, 20000);
+        bool singleType = rng() % 3 == 0; // Exercises the constant-type index flag
+        uint32_t group = rng() % 4 == 0 ? rng() : 0;
+        for (uint32_t e = 0; e < entries; e++) {
+            DBPF::ResourceKey key{singleType ? types[0] : types[rng() % std::size(types)], group, (static_cast<uint64_t>(rng()) << 32) | rng()};
+            uint32_t size = 16 + rng() % 480;
+            writer.AddView(key, payload.data(), size, size * 2, rng() % 2 == 0 ? DBPF::COMPRESSION_REFPACK : DBPF::COMPRESSION_NONE);
+        }
+
+        fs::path path = dir / ("synthetic_" + std::to_string(i) + ".package");
+        if (!writer.Write(path)) {
+            std::printf("failed to write %s\n", path.string().c_str());
+            return false;
+        }
+
+        DBPF::Package package;
+        auto layout = writer.Layout();
+        if (!package.Open(path) || package.Entries().size() != layout.size()) {
+            std::printf("%s did not read back: %s\n", path.string().c_str(), package.GetError().c_str());
+            return false;
+        }
+        for (size_t e = 0; e < layout.size(); e++) {
+            const auto& a = package.Entries()[e];
+            const auto& b = layout[e];
+            if (!(a.key == b.key) || a.offset != b.offset || a.compressedSize != b.compressedSize || a.memSize != b.memSize || a.compression != b.compression) {
+                std::printf("%s entry %zu mismatch\n", path.string().c_str(), e);
+                return false;
+            }
+        }
+        out.push_back(path);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint32_t syntheticCount = 2000;
+    uint32_t passes = 3;
+    std::vector<fs::path> packages;
+    bool haveDirs = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) {
+            syntheticCount = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+            passes = std::max(1, std::atoi(argv[++i]));
+        } else {
+            CollectPackages(argv[i], packages);
+            haveDirs = true;
+        }
+    }
+
+    fs::path syntheticDir = fs::temp_directory_path() / "dbpf_bench_packages";
+    if (!haveDirs) {
+        std::error_code ec;
+        fs::remove_all(syntheticDir, ec);
+        auto start = Clock::now();
+        if (!WriteSynthetic(syntheticDir, syntheticCount, packages)) return 1;
+        std::printf("wrote + verified %u synthetic packages in %.2f s (%s)\n", syntheticCount, Seconds(start), syntheticDir.string().c_str());
+    }
+    if (packages.empty()) {
+        std::printf("no packages found\n");
+        return 1;
+    }
+
+    // Open + parse + hash every package, the first pass pays for the page cache so report the best
+    double bestSeconds = 1e30;
+    uint64_t totalEntries = 0, totalBytes = 0, failures = 0;
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        totalEntries = totalBytes = failures = 0;
+        auto start = Clock::now();
+        for (const auto& path : packages) {
+            DBPF::Package package;
+            if (!package.Open(path)) {
+                if (pass == 0) std::printf("  %s: %s\n", path.string().c_str(), package.GetError().c_str());
+                failures++;
+                continue;
+            }
+            totalEntries += package.Entries().size();
+            totalBytes += package.Size();
+        }
+        bestSeconds = std::min(bestSeconds, Seconds(start));
+    }
+
+    std::printf("%zu packages (%llu failed), %llu entries, %.1f MB\n", packages.size(), static_cast<unsigned long long>(failures), static_cast<unsigned long long>(totalEntries), totalBytes / 1048576.0);
+    std::printf("open + index: %.3f s -> %.0f packages/s, %.2f M entries/s\n", bestSeconds, packages.size() / bestSeconds, totalEntries / bestSeconds / 1e6);
+
+    // Lookups, hits against every key in one of the bigger packages plus the same number of misses
+    DBPF::Package biggest;
+    size_t biggestCount = 0;
+    for (const auto& path : packages) {
+        DBPF::Package package;
+        if (package.Open(path) && package.Entries().size() > biggestCount) {
+            biggestCount = package.Entries().size();
+            biggest = std::move(package);
+        }
+    }
+    if (biggestCount) {
+        std::vector<DBPF::ResourceKey> keys;
+        for (const auto& e : biggest.Entries()) keys.push_back(e.key);
+        std::mt19937 rng(5);
+        std::shuffle(keys.begin(), keys.end(), rng);
+
+        const uint32_t rounds = std::max<uint32_t>(1, 4000000 / static_cast<uint32_t>(keys.size()));
+        uint64_t found = 0;
+        auto start = Clock::now();
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (const auto& key : keys) found += biggest.Find(key) != nullptr;
+        }
+        double hitSeconds = Seconds(start);
+
+        uint64_t falseHits = 0;
+        start = Clock::now();
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (const auto& key : keys) falseHits += biggest.Find({key.type, key.group ^ 0x5A5A5A5A, key.instance}) != nullptr;
+        }
+        double missSeconds = Seconds(start);
+
+        uint64_t lookups = static_cast<uint64_t>(rounds) * keys.size();
+        std::printf("lookups in %zu-entry package: hit %.1f M/s, miss %.1f M/s%s\n", biggestCount, lookups / hitSeconds / 1e6, lookups / missSeconds / 1e6,
+            found == lookups && falseHits == 0 ? "" : "  (LOOKUP MISMATCH)");
+        if (found != lookups || falseHits) return 1;
+    }
+
+    // Index cache: cold run parses everything and saves, warm run loads the cache and only stats each package
+    {
+        fs::path cachePath = fs::temp_directory_path() / "dbpf_bench_index.cache";
+        std::error_code ec;
+        fs::remove(cachePath, ec);
+
+        DBPF::IndexCache cold;
+        std::vector<DBPF::IndexEntry> entries;
+        auto start = Clock::now();
+        for (const auto& path : packages) cold.GetEntries(path, entries);
+        bool saved = cold.Save(cachePath);
+        double coldSeconds = Seconds(start);
+
+        double warmSeconds = 1e30;
+        DBPF::IndexCache::Stats warmStats;
+        bool identical = true;
+        for (uint32_t pass = 0; pass < passes; pass++) {
+            DBPF::IndexCache warm;
+            start = Clock::now();
+            warm.Load(cachePath);
+            for (const auto& path : packages) warm.GetEntries(path, entries);
+            warmSeconds = std::min(warmSeconds, Seconds(start));
+            warmStats = warm.GetStats();
+        }
+
+        // Cached entries have to match a fresh parse exactly
+        DBPF::IndexCache check;
+        check.Load(cachePath);
+        for (const auto& path : packages) {
+            DBPF::Package package;
+            bool fromCache = false;
+            if (!package.Open(path) || !check.GetEntries(path, entries, &fromCache)) continue;
+            if (!fromCache || entries.size() != package.Entries().size() || memcmp(entries.data(), package.Entries().data(), entries.size() * sizeof(DBPF::IndexEntry)) != 0) identical = false;
+        }
+
+        std::printf("index cache: cold %.3f s (%.0f packages/s, saved %.1f KB%s), warm %.3f s (%.0f packages/s, %llu hits, %llu parsed)%s\n", coldSeconds, packages.size() / coldSeconds,
+            saved ? fs::file_size(cachePath) / 1024.0 : 0.0, saved ? "" : " SAVE FAILED", warmSeconds, packages.size() / warmSeconds, static_cast<unsigned long long>(warmStats.hits),
+            static_cast<unsigned long long>(warmStats.misses + warmStats.stale), identical ? "" : "  (CACHE MISMATCH)");
+        fs::remove(cachePath, ec);
+        if (!saved || !identical) failures++;
+    }
+
+    if (!haveDirs) {
+        std::error_code ec;
+        fs::remove_all(syntheticDir, ec);
+    }
+    return failures ? 1 : 0;
+}
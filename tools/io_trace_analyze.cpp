@@ -0,0 +1,227 @@
+// Reads an S3SS I/O trace (S3SS\io_trace_*.s3io from the File I/O Trace patch) and reports where loading time goes
+// Build (Linux): g++ -O2 -std=c++20 -I.. io_trace_analyze.cpp ../io/io_trace.cpp -o io_trace_analyze
+// Usage:         io_trace_analyze <trace.s3io> [--top N] [--timeline]
+#include "io/io_trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using IOTrace::Record;
+
+static constexpr uint32_t BUCKETS = 33; // log2 buckets, bucket 0 is exactly 0
+
+static uint32_t Log2Bucket(uint64_t v) {
+    uint32_t bucket = 0;
+    while (v && bucket < BUCKETS - 1) {
+        v >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static std::string BytesLabel(uint64_t bytes) {
+    char buf[32];
+    if (bytes >= (1ull << 30)) std::snprintf(buf, sizeof(buf), "%llu GB", static_cast<unsigned long long>(bytes >> 30));
+    else if (bytes >= (1ull << 20)) std::snprintf(buf, sizeof(buf), "%llu MB", static_cast<unsigned long long>(bytes >> 20));
+    else if (bytes >= (1ull << 10)) std::snprintf(buf, sizeof(buf), "%llu KB", static_cast<unsigned long long>(bytes >> 10));
+    else std::snprintf(buf, sizeof(buf), "%llu B", static_cast<unsigned long long>(bytes));
+    return buf;
+}
+
+// Floor of a log2 bucket as a readable size
+static std::string BucketLabel(uint32_t bucket) {
+    return bucket == 0 ? "0" : ">= " + BytesLabel(1ull << (bucket - 1));
+}
+
+struct Histogram {
+    uint64_t count[BUCKETS] = {};
+    uint64_t bytes[BUCKETS] = {};
+    uint64_t ticks[BUCKETS] = {};
+
+    void Add(uint64_t value, uint64_t transferred, uint64_t duration) {
+        uint32_t b = Log2Bucket(value);
+        count[b]++;
+        bytes[b] += transferred;
+        ticks[b] += duration;
+    }
+};
+
+// Per path, the same package opened over and over shows up as one row with a high open count
+struct FileStats {
+    std::string path;
+    uint64_t size = 0;
+    uint64_t reads = 0;
+    uint64_t bytes = 0;
+    uint64_t ticks = 0;
+    uint64_t seeks = 0; // Reads that didn't start where the previous one on the same handle ended
+    uint64_t opens = 0;
+};
+
+// Per open (file id), where the next sequential read would start
+struct HandleState {
+    uint64_t nextOffset = 0;
+    bool haveNext = false;
+};
+
+struct ThreadStats {
+    uint64_t reads = 0;
+    uint64_t bytes = 0;
+    uint64_t ticks = 0;
+};
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    size_t top = 20;
+    bool timeline = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--timeline") == 0) {
+            timeline = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        std::printf("usage: io_trace_analyze <trace.s3io> [--top N] [--timeline]\n");
+        return 2;
+    }
+
+    IOTrace::Trace trace;
+    std::string error;
+    if (!IOTrace::ReadTrace(path, trace, error)) {
+        std::printf("%s: %s\n", path, error.c_str());
+        return 1;
+    }
+
+    // Records are in flush order, which is close to but not exactly call order across threads
+    std::stable_sort(trace.records.begin(), trace.records.end(), [](const Record& a, const Record& b) { return a.timestamp < b.timestamp; });
+
+    const double frequency = trace.header.qpcFrequency ? static_cast<double>(trace.header.qpcFrequency) : 1.0;
+    auto ms = [&](uint64_t ticks) { return ticks * 1000.0 / frequency; };
+
+    Histogram sizes;       // Bytes requested per read
+    Histogram seekForward; // Gap skipped forward on the same file
+    Histogram seekBack;    // Distance jumped backwards on the same file
+    uint64_t sequential = 0, reads = 0, bytes = 0, ticks = 0, failed = 0, pending = 0, fileSwitches = 0;
+    uint32_t lastFile = 0;
+    std::unordered_map<std::string, FileStats> files;
+    std::unordered_map<uint32_t, HandleState> handles;
+    std::map<uint32_t, ThreadStats> threads;
+    std::map<uint64_t, ThreadStats> seconds;
+
+    // Union of in-flight read intervals: blocked time summed across threads can exceed wall time when reads overlap
+    uint64_t busyTicks = 0, busyEnd = 0;
+
+    for (const Record& r : trace.records) {
+        auto known = trace.files.find(r.fileId);
+        std::string path = known != trace.files.end() ? known->second.path : "(unknown id " + std::to_string(r.fileId) + ")";
+        FileStats& file = files[path];
+        if (file.path.empty()) {
+            file.path = path;
+            file.size = known != trace.files.end() ? known->second.size : 0;
+        }
+        if (r.kind == IOTrace::Kind::Open) file.opens++;
+        if (r.kind != IOTrace::Kind::Read) continue;
+        HandleState& handle = handles[r.fileId];
+
+        reads++;
+        bytes += r.transferred;
+        ticks += r.duration;
+        if (r.flags & IOTrace::RECORD_FAILED) failed++;
+        if (r.flags & IOTrace::RECORD_PENDING) pending++;
+        sizes.Add(r.requested, r.transferred, r.duration);
+
+        if (handle.haveNext) {
+            if (r.offset == handle.nextOffset) {
+                sequential++;
+            } else {
+                file.seeks++;
+                if (r.offset > handle.nextOffset) seekForward.Add(r.offset - handle.nextOffset, r.transferred, r.duration);
+                else seekBack.Add(handle.nextOffset - r.offset, r.transferred, r.duration);
+            }
+        }
+        handle.nextOffset = r.offset + r.transferred;
+        handle.haveNext = true;
+        file.reads++;
+        file.bytes += r.transferred;
+        file.ticks += r.duration;
+
+        if (lastFile && r.fileId != lastFile) fileSwitches++;
+        lastFile = r.fileId;
+
+        ThreadStats& thread = threads[r.threadId];
+        thread.reads++;
+        thread.bytes += r.transferred;
+        thread.ticks += r.duration;
+
+        uint64_t end = r.timestamp + r.duration;
+        if (end > busyEnd) {
+            busyTicks += end - std::max<uint64_t>(r.timestamp, busyEnd);
+            busyEnd = end;
+        }
+
+        if (timeline) {
+            ThreadStats& second = seconds[static_cast<uint64_t>((r.timestamp - trace.header.startTimestamp) / frequency)];
+            second.reads++;
+            second.bytes += r.transferred;
+            second.ticks += r.duration;
+        }
+    }
+
+    uint64_t span = trace.records.empty() ? 0 : trace.records.back().timestamp - trace.records.front().timestamp;
+    std::printf("%s: %.1f s traced, %zu opens of %zu files, %llu reads, %.1f MB read\n", path, ms(span) / 1000.0, trace.files.size(), files.size(), static_cast<unsigned long long>(reads), bytes / 1048576.0);
+    std::printf("blocked in ReadFile: %.0f ms summed over threads, %.0f ms of wall time with at least one read in flight (%.1f%% of the trace)\n", ms(ticks), ms(busyTicks),
+        span ? 100.0 * busyTicks / span : 0.0);
+    uint64_t seeks = 0;
+    for (const auto& [path, file] : files) seeks += file.seeks;
+    std::printf("sequential reads: %.1f%%  seeks: %llu  switches between files: %llu\n", reads ? 100.0 * sequential / reads : 0.0, static_cast<unsigned long long>(seeks),
+        static_cast<unsigned long long>(fileSwitches));
+    if (failed || pending) std::printf("failed reads: %llu  async (pending) reads: %llu\n", static_cast<unsigned long long>(failed), static_cast<unsigned long long>(pending));
+    if (trace.dropped) std::printf("WARNING: %llu records were dropped because the ring was full, numbers are a lower bound\n", static_cast<unsigned long long>(trace.dropped));
+    if (trace.truncated) std::printf("note: the trace ends in a partial block (game still running or crashed)\n");
+
+    std::printf("\nread sizes\n%12s %10s %10s %12s %12s\n", "requested", "reads", "MB", "blocked ms", "us/read");
+    for (uint32_t b = 0; b < BUCKETS; b++) {
+        if (!sizes.count[b]) continue;
+        std::printf("%12s %10llu %10.1f %12.1f %12.1f\n", BucketLabel(b).c_str(), static_cast<unsigned long long>(sizes.count[b]), sizes.bytes[b] / 1048576.0, ms(sizes.ticks[b]),
+            ms(sizes.ticks[b]) * 1000.0 / sizes.count[b]);
+    }
+
+    std::printf("\nseek distances (same file, from the end of the previous read)\n%12s %10s %12s %10s %12s\n", "distance", "forward", "blocked ms", "backward", "blocked ms");
+    for (uint32_t b = 1; b < BUCKETS; b++) {
+        if (!seekForward.count[b] && !seekBack.count[b]) continue;
+        std::printf("%12s %10llu %12.1f %10llu %12.1f\n", BucketLabel(b).c_str(), static_cast<unsigned long long>(seekForward.count[b]), ms(seekForward.ticks[b]),
+            static_cast<unsigned long long>(seekBack.count[b]), ms(seekBack.ticks[b]));
+    }
+
+    std::vector<const FileStats*> hot;
+    for (const auto& [path, file] : files) {
+        if (file.reads) hot.push_back(&file);
+    }
+    std::sort(hot.begin(), hot.end(), [](const FileStats* a, const FileStats* b) { return a->ticks > b->ticks; });
+    std::printf("\nhot files (by time blocked)\n%12s %8s %10s %10s %8s %8s  %s\n", "blocked ms", "reads", "MB read", "file MB", "seeks", "opens", "path");
+    for (size_t i = 0; i < std::min(top, hot.size()); i++) {
+        const FileStats& f = *hot[i];
+        std::printf("%12.1f %8llu %10.2f %10.2f %8llu %8llu  %s\n", ms(f.ticks), static_cast<unsigned long long>(f.reads), f.bytes / 1048576.0, f.size / 1048576.0, static_cast<unsigned long long>(f.seeks),
+            static_cast<unsigned long long>(f.opens), f.path.c_str());
+    }
+
+    std::printf("\nthreads\n%10s %10s %10s %12s\n", "thread", "reads", "MB", "blocked ms");
+    for (const auto& [id, thread] : threads) {
+        std::printf("%10u %10llu %10.1f %12.1f\n", id, static_cast<unsigned long long>(thread.reads), thread.bytes / 1048576.0, ms(thread.ticks));
+    }
+
+    if (timeline) {
+        std::printf("\ntimeline (seconds since the trace started)\n%8s %10s %10s %12s\n", "second", "reads", "MB", "blocked ms");
+        for (const auto& [second, s] : seconds) {
+            std::printf("%8llu %10llu %10.1f %12.1f\n", static_cast<unsigned long long>(second), static_cast<unsigned long long>(s.reads), s.bytes / 1048576.0, ms(s.ticks));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,315 @@
+// Runs MappedViews::ViewPool and AccessPattern against fake in-memory files: the synchronous reads from an I/O trace, or a random
+// synthetic workload over several threads sharing one pool. Every byte handed back is checked against the fake file, and the
+// syscalls and page faults are counted against plain ReadFile to see whether views pay off for that load
+// Build (Linux): g++ -O2 -std=c++20 -I.. mapped_read_sim.cpp ../io/mapped_view_reader.cpp ../io/io_trace.cpp -o mapped_read_sim
+// Usage:         mapped_read_sim <trace.s3io> | --synthetic [seed] [--threads N]   [--window KB] [--windows N] [--per-file N] [--max-read KB] [--always]
+#include "io/io_trace.h"
+#include "io/mapped_view_reader.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Rough per-operation costs on Windows with the data already in the file cache, only used to weigh the counts against each other
+constexpr double READFILE_US = 3.0; // Syscall + copy setup for a small cached read
+constexpr double MAP_US = 15.0;     // MapViewOfFile
+constexpr double UNMAP_US = 15.0;   // UnmapViewOfFile, includes the TLB flush
+constexpr double FAULT_US = 0.8;    // Soft fault per 4 KB page first touched in a view
+
+// Contents generated from (seed, offset) so traces with multi-GB packages don't need the memory. Views are generated on map,
+// so a view that outlives its unmap or a copy from the wrong place shows up as a mismatch
+class FakeSource : public MappedViews::Source {
+  public:
+    FakeSource(uint32_t seed, uint64_t size) : seed(seed), size(size) {}
+    ~FakeSource() override {
+        if (!views.empty()) std::printf("LEAK: %zu views still mapped when the source went away\n", views.size());
+    }
+
+    uint32_t Read(uint64_t offset, uint8_t* buffer, uint32_t length) const {
+        uint32_t n = offset < size ? static_cast<uint32_t>(std::min<uint64_t>(length, size - offset)) : 0;
+        Generate(offset, buffer, n);
+        return n;
+    }
+
+    bool Size(uint64_t& result) override {
+        result = size;
+        return true;
+    }
+
+    const uint8_t* Map(uint64_t offset, uint32_t length) override {
+        auto view = std::make_unique<uint8_t[]>(length);
+        Generate(offset, view.get(), length);
+        const uint8_t* data = view.get();
+        std::lock_guard<std::mutex> lock(mutex);
+        views.emplace(data, View{length, std::move(view)});
+        maps++;
+        return data;
+    }
+
+    void Unmap(const uint8_t* view, uint32_t) override {
+        // Another thread's read can evict this source's windows, so the bookkeeping needs its own lock. The memory is freed
+        // here, a copy still running out of it is a use-after-free that a -fsanitize=address build reports
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = views.find(view);
+        if (it == views.end()) {
+            std::printf("BAD UNMAP of a view that isn't mapped\n");
+            badUnmaps++;
+            return;
+        }
+        touched.erase(view);
+        views.erase(it);
+        unmaps++;
+    }
+
+    bool Copy(void* destination, const uint8_t* view, uint32_t length) override {
+        // Which mapped view this lands in, to count the pages faulted in the first time each is touched
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& [data, mapped] : views) {
+                if (view < data || view >= data + mapped.size) continue;
+                auto& pages = touched[data];
+                for (uint64_t page = (view - data) >> 12; page <= static_cast<uint64_t>(view + length - 1 - data) >> 12; page++) {
+                    if (pages.insert(page).second) faults++;
+                }
+                break;
+            }
+        }
+        memcpy(destination, view, length);
+        return true;
+    }
+
+    uint64_t maps = 0;
+    uint64_t unmaps = 0;
+    uint64_t faults = 0;
+    uint64_t badUnmaps = 0;
+
+  private:
+    struct View {
+        uint32_t size;
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    void Generate(uint64_t offset, uint8_t* buffer, uint32_t length) const {
+        for (uint32_t i = 0; i < length; i++) {
+            uint64_t x = ((offset + i) ^ (static_cast<uint64_t>(seed) << 40)) * 0x9E3779B97F4A7C15ull;
+            buffer[i] = static_cast<uint8_t>(x >> 56);
+        }
+    }
+
+    uint32_t seed;
+    uint64_t size;
+    std::mutex mutex;
+    std::unordered_map<const uint8_t*, View> views;
+    std::unordered_map<const uint8_t*, std::unordered_set<uint64_t>> touched;
+};
+
+struct Totals {
+    uint64_t reads = 0;
+    uint64_t served = 0;
+    uint64_t passed = 0;
+    uint64_t maps = 0;
+    uint64_t unmaps = 0;
+    uint64_t faults = 0;
+    uint64_t mismatches = 0;
+    uint64_t peakMapped = 0;
+
+    void Add(const Totals& other) {
+        reads += other.reads;
+        served += other.served;
+        passed += other.passed;
+        maps += other.maps;
+        unmaps += other.unmaps;
+        faults += other.faults;
+        mismatches += other.mismatches;
+        peakMapped = std::max(peakMapped, other.peakMapped);
+    }
+};
+
+struct Handle {
+    std::unique_ptr<FakeSource> source;
+    std::unique_ptr<MappedViews::AccessPattern> pattern;
+};
+
+static bool always = false;
+
+// One game read: through the pool if the handle's pattern says so, checked against what the real call would have returned
+static void DoRead(MappedViews::ViewPool& pool, Handle& handle, uint64_t offset, uint32_t size, Totals& totals, std::vector<uint8_t>& buffer, std::vector<uint8_t>& expected) {
+    totals.reads++;
+    bool useViews = handle.pattern->Record(offset, size) || always;
+    if (!useViews) {
+        totals.passed++;
+        return;
+    }
+
+    buffer.resize(size);
+    expected.resize(size);
+    uint32_t want = handle.source->Read(offset, expected.data(), size);
+    uint32_t transferred = 0, mapped = 0;
+    bool served = pool.Read(*handle.source, offset, buffer.data(), size, transferred, &mapped);
+    handle.pattern->Served(mapped);
+    if (!served) {
+        totals.passed++;
+        return;
+    }
+    totals.served++;
+    if (transferred != want || memcmp(buffer.data(), expected.data(), want) != 0) {
+        if (totals.mismatches++ < 10) std::printf("MISMATCH at offset %llu size %u: got %u bytes, expected %u\n", static_cast<unsigned long long>(offset), size, transferred, want);
+    }
+    totals.peakMapped = std::max(totals.peakMapped, pool.MappedBytes());
+}
+
+static void Close(MappedViews::ViewPool& pool, Handle& handle, Totals& totals) {
+    pool.Release(*handle.source);
+    totals.maps += handle.source->maps;
+    totals.unmaps += handle.source->unmaps;
+    totals.faults += handle.source->faults;
+    if (handle.source->badUnmaps || handle.source->maps != handle.source->unmaps) totals.mismatches++;
+}
+
+static bool RunTrace(const char* path, MappedViews::ViewPool& pool, const MappedViews::Config& config, Totals& totals) {
+    IOTrace::Trace trace;
+    std::string error;
+    if (!IOTrace::ReadTrace(path, trace, error)) {
+        std::printf("%s: %s\n", path, error.c_str());
+        return false;
+    }
+    std::stable_sort(trace.records.begin(), trace.records.end(), [](const IOTrace::Record& a, const IOTrace::Record& b) { return a.timestamp < b.timestamp; });
+
+    std::unordered_map<uint32_t, Handle> handles;
+    std::vector<uint8_t> buffer, expected;
+    for (const IOTrace::Record& r : trace.records) {
+        if (r.kind == IOTrace::Kind::Close) {
+            auto it = handles.find(r.fileId);
+            if (it != handles.end()) {
+                Close(pool, it->second, totals);
+                handles.erase(it);
+            }
+            continue;
+        }
+        if (r.kind != IOTrace::Kind::Read || (r.flags & (IOTrace::RECORD_FAILED | IOTrace::RECORD_OVERLAPPED))) continue;
+
+        Handle& handle = handles[r.fileId];
+        if (!handle.source) {
+            auto known = trace.files.find(r.fileId);
+            uint64_t size = known != trace.files.end() && known->second.size ? known->second.size : r.offset + r.requested;
+            handle.source = std::make_unique<FakeSource>(r.fileId, size);
+            handle.pattern = std::make_unique<MappedViews::AccessPattern>(config);
+        }
+        DoRead(pool, handle, r.offset, r.requested, totals, buffer, expected);
+    }
+    for (auto& [id, handle] : handles) Close(pool, handle, totals);
+    return true;
+}
+
+// DBPF-ish access per thread: a few files each, runs of small forward reads, jumps around the index, the odd big read and reads off
+// the end. Threads share the pool but never a handle, same as the patch where each game handle serializes its own reads
+static void RunSyntheticThread(uint32_t seed, MappedViews::ViewPool& pool, const MappedViews::Config& config, Totals& totals, std::mutex& totalsMutex) {
+    std::mt19937 rng(seed);
+    std::vector<Handle> handles(4);
+    for (size_t i = 0; i < handles.size(); i++) {
+        handles[i].source = std::make_unique<FakeSource>(seed * 16 + static_cast<uint32_t>(i), 4096 + rng() % (24 << 20));
+        handles[i].pattern = std::make_unique<MappedViews::AccessPattern>(config);
+    }
+
+    Totals local;
+    std::vector<uint8_t> buffer, expected;
+    for (int op = 0; op < 2000; op++) {
+        Handle& handle = handles[rng() % handles.size()];
+        uint64_t size;
+        handle.source->Size(size);
+        uint32_t kind = rng() % 100;
+
+        if (kind < 3) {
+            DoRead(pool, handle, rng() % size, 64 + rng() % (512 << 10), local, buffer, expected);
+        } else if (kind < 25) {
+            // Index lookups, scattered small reads
+            for (int i = 0; i < 8; i++) DoRead(pool, handle, rng() % size, 16 + rng() % 256, local, buffer, expected);
+        } else {
+            // Reading resources one after another, some running off the end of the file
+            uint64_t offset = kind < 30 ? (size > 100000 ? size - rng() % 100000 : 0) : rng() % size;
+            int run = 4 + rng() % 40;
+            for (int i = 0; i < run; i++) {
+                uint32_t length = 1 + rng() % 20000;
+                DoRead(pool, handle, offset, length, local, buffer, expected);
+                offset += length + (rng() % 4 == 0 ? rng() % 8000 : 0);
+            }
+        }
+    }
+    for (Handle& handle : handles) Close(pool, handle, local);
+
+    std::lock_guard<std::mutex> lock(totalsMutex);
+    totals.Add(local);
+}
+
+int main(int argc, char** argv) {
+    MappedViews::Config config;
+    const char* tracePath = nullptr;
+    bool synthetic = false;
+    uint32_t seed = 1;
+    int threads = 4;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--synthetic") == 0) {
+            synthetic = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') seed = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            config.windowSize = static_cast<uint32_t>(std::max(64, std::atoi(argv[++i]))) << 10;
+        } else if (std::strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+            config.maxWindows = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--per-file") == 0 && i + 1 < argc) {
+            config.windowsPerSource = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--max-read") == 0 && i + 1 < argc) {
+            config.maxReadSize = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i]))) << 10;
+        } else if (std::strcmp(argv[i], "--always") == 0) {
+            always = true;
+        } else {
+            tracePath = argv[i];
+        }
+    }
+    if (!synthetic && !tracePath) {
+        std::printf("usage: mapped_read_sim <trace.s3io> | --synthetic [seed] [--threads N]   [--window KB] [--windows N] [--per-file N] [--max-read KB] [--always]\n");
+        return 2;
+    }
+
+    Totals totals;
+    MappedViews::Stats stats;
+    {
+        MappedViews::ViewPool pool(config);
+        if (synthetic) {
+            std::mutex totalsMutex;
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; t++) workers.emplace_back(RunSyntheticThread, seed * 1000 + t, std::ref(pool), std::cref(config), std::ref(totals), std::ref(totalsMutex));
+            for (auto& worker : workers) worker.join();
+        } else if (!RunTrace(tracePath, pool, config, totals)) {
+            return 1;
+        }
+        stats = pool.GetStats();
+        config = pool.GetConfig();
+    }
+
+    double plainUs = totals.reads * READFILE_US;
+    double viewUs = totals.passed * READFILE_US + totals.maps * MAP_US + totals.unmaps * UNMAP_US + totals.faults * FAULT_US;
+    std::printf("%u KB windows, %u max (%u per file), reads up to %u KB, %s\n", config.windowSize >> 10, config.maxWindows, config.windowsPerSource, config.maxReadSize >> 10,
+        always ? "every read through views" : "sequential/random heuristic");
+    std::printf("reads: %llu  served from views: %llu  passed through: %llu\n", static_cast<unsigned long long>(totals.reads), static_cast<unsigned long long>(totals.served),
+        static_cast<unsigned long long>(totals.passed));
+    std::printf("maps: %llu  unmaps: %llu  pages faulted: %llu  peak mapped: %.1f MB (limit %.1f MB)\n", static_cast<unsigned long long>(totals.maps), static_cast<unsigned long long>(totals.unmaps),
+        static_cast<unsigned long long>(totals.faults), totals.peakMapped / 1048576.0, static_cast<double>(config.maxWindows) * config.windowSize / 1048576.0);
+    std::printf("estimated CPU in reads: %.1f ms plain -> %.1f ms (%.1f%% saved)\n", plainUs / 1000.0, viewUs / 1000.0, plainUs ? 100.0 * (plainUs - viewUs) / plainUs : 0.0);
+    if (stats.windows || stats.maps != stats.unmaps) {
+        std::printf("FAILED: %u windows left mapped after every handle closed\n", stats.windows);
+        totals.mismatches++;
+    }
+    if (totals.peakMapped > static_cast<uint64_t>(config.maxWindows) * config.windowSize) totals.mismatches++;
+    std::printf("%s\n", totals.mismatches ? "FAILED: data mismatches or view accounting errors" : "all served data matched the file");
+    return totals.mismatches ? 1 : 0;
+}
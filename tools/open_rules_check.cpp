@@ -0,0 +1,126 @@
+// Replays the opens, reads and closes of one or more I/O traces through OpenFlagRules the way the CreateFileW Access Hints patch
+// does, sessions in the order given so what one trace learns about read patterns carries into the next. Reports what each rule
+// matched and how the files it matched were actually read, so a rule handing random access to front-to-back readers stands out
+// Build (Linux): g++ -O2 -std=c++20 -I.. open_rules_check.cpp ../io/open_flag_rules.cpp ../io/io_trace.cpp -o open_rules_check
+// Usage:         open_rules_check <trace.s3io>... [--history open_patterns.txt] [--save-history out.txt]
+#include "io/io_trace.h"
+#include "io/open_flag_rules.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using OpenFlagRules::Pattern;
+
+struct RuleTotals {
+    uint64_t hits = 0;
+    uint64_t readAs[4] = {}; // By Pattern, how the matched opens went on to be read
+};
+
+struct OpenFile {
+    std::string path;
+    int rule = -1;
+    bool watched = false; // The patch only remembers how files read when their rule depends on it
+    OpenFlagRules::ReadObserver observer;
+};
+
+static void Replay(const IOTrace::Trace& trace, OpenFlagRules::RuleSet& rules, OpenFlagRules::PatternHistory& history, std::vector<RuleTotals>& totals, uint64_t& opens) {
+    std::vector<IOTrace::Record> records = trace.records;
+    std::stable_sort(records.begin(), records.end(), [](const IOTrace::Record& a, const IOTrace::Record& b) { return a.timestamp < b.timestamp; });
+
+    std::unordered_map<uint32_t, OpenFile> open;
+    auto close = [&](uint32_t fileId) {
+        auto it = open.find(fileId);
+        if (it == open.end()) return;
+        Pattern pattern = it->second.observer.Classify();
+        totals[it->second.rule < 0 ? rules.Rules().size() : it->second.rule].readAs[static_cast<int>(pattern)]++;
+        if (it->second.watched) history.Record(it->second.path, pattern);
+        open.erase(it);
+    };
+
+    for (const IOTrace::Record& r : records) {
+        if (r.kind == IOTrace::Kind::Close) {
+            close(r.fileId);
+            continue;
+        }
+        // Files opened before the trace started only show up as reads, the first one stands in for the open
+        if (r.kind == IOTrace::Kind::Open || !open.count(r.fileId)) {
+            close(r.fileId);
+            auto known = trace.files.find(r.fileId);
+            OpenFile& file = open[r.fileId];
+            file.path = OpenFlagRules::NormalizePath(known != trace.files.end() ? known->second.path : "");
+
+            // Traces don't record the access mode, everything the game reads it opened for reading
+            OpenFlagRules::OpenInfo info;
+            info.path = file.path;
+            info.access = OpenFlagRules::Access::Read;
+            file.watched = rules.DependsOnPattern(info);
+            if (file.watched) info.observed = history.Lookup(file.path);
+            rules.Choose(info, &file.rule);
+            totals[file.rule < 0 ? rules.Rules().size() : file.rule].hits++;
+            opens++;
+            if (r.kind == IOTrace::Kind::Open) continue;
+        }
+        if (r.kind == IOTrace::Kind::Read && !(r.flags & (IOTrace::RECORD_FAILED | IOTrace::RECORD_PENDING))) open[r.fileId].observer.OnRead(r.offset, r.transferred);
+    }
+    // Still open when the trace ended
+    while (!open.empty()) close(open.begin()->first);
+}
+
+int main(int argc, char** argv) {
+    std::vector<const char*> traces;
+    const char* historyPath = nullptr;
+    const char* saveHistoryPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            historyPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--save-history") == 0 && i + 1 < argc) {
+            saveHistoryPath = argv[++i];
+        } else {
+            traces.push_back(argv[i]);
+        }
+    }
+    if (traces.empty()) {
+        std::printf("usage: open_rules_check <trace.s3io>... [--history open_patterns.txt] [--save-history out.txt]\n");
+        return 2;
+    }
+
+    OpenFlagRules::RuleSet rules(OpenFlagRules::DefaultRules());
+    OpenFlagRules::PatternHistory history;
+    if (historyPath && !history.Load(historyPath)) {
+        std::printf("%s: not an open pattern history\n", historyPath);
+        return 1;
+    }
+
+    for (const char* path : traces) {
+        IOTrace::Trace trace;
+        std::string error;
+        if (!IOTrace::ReadTrace(path, trace, error)) {
+            std::printf("%s: %s\n", path, error.c_str());
+            return 1;
+        }
+
+        std::vector<RuleTotals> totals(rules.Rules().size() + 1);
+        uint64_t opens = 0;
+        Replay(trace, rules, history, totals, opens);
+
+        std::printf("\n%s: %llu opens, %zu files with a known pattern afterwards\n", path, static_cast<unsigned long long>(opens), history.Size());
+        std::printf("  %-32s %-10s %8s   read as: %8s %8s %8s\n", "rule", "hint", "opens", "seq", "random", "unknown");
+        for (size_t i = 0; i < totals.size(); i++) {
+            const RuleTotals& t = totals[i];
+            if (!t.hits) continue;
+            bool unmatched = i == rules.Rules().size();
+            std::printf("  %-32s %-10s %8llu   %17llu %8llu %8llu\n", unmatched ? "(no rule)" : rules.Rules()[i].name.c_str(), unmatched ? "keep" : OpenFlagRules::HintName(rules.Rules()[i].hint),
+                static_cast<unsigned long long>(t.hits), static_cast<unsigned long long>(t.readAs[static_cast<int>(Pattern::Sequential)]),
+                static_cast<unsigned long long>(t.readAs[static_cast<int>(Pattern::Random)]), static_cast<unsigned long long>(t.readAs[static_cast<int>(Pattern::Unknown)]));
+        }
+    }
+
+    if (saveHistoryPath && !history.Save(saveHistoryPath)) {
+        std::printf("failed to write %s\n", saveHistoryPath);
+        return 1;
+    }
+    return 0;
+}
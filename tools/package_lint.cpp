@@ -0,0 +1,279 @@
+// CC package health check: ranks .package files by roughly how much they cost the game to load and says why
+// Build (Linux): g++ -O2 -std=c++20 -I.. package_lint.cpp ../dbpf/dbpf_reader.cpp ../refpack/refpack_encoder.cpp ../mapped_file.cpp -o package_lint
+// Usage:         package_lint <package dir>... [--top N] [--csv out.csv] [--deep]
+//
+// Works from the index alone unless --deep is given, then RefPack streams are decoded to check they're intact and
+// big uncompressed resources are trial-compressed to see what they'd save
+#include "dbpf/dbpf_reader.h"
+#include "refpack/refpack_decoder.h"
+#include "refpack/refpack_encoder.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Rough costs on a typical CC setup (HDD or SATA SSD, one core decoding), only meant to rank packages against each other
+namespace Cost {
+constexpr double OPEN_MS = 0.35;              // Handle, mapping, header, plus the game's per-file watcher + bookkeeping
+constexpr double ENTRY_MS = 0.0005;           // Index parse + resource table insert
+constexpr double READ_MS_PER_MB = 1000.0 / 250.0;
+constexpr double DECODE_MS_PER_MB = 1000.0 / 800.0;
+} // namespace Cost
+
+constexpr uint32_t HUGE_UNCOMPRESSED = 1u << 20; // Uncompressed resources this big are worth compressing
+constexpr uint64_t TINY_PACKAGE = 32u << 10;      // Packages under this are mostly fixed cost
+constexpr uint32_t TINY_WARNING_COUNT = 100;      // Past this many tiny packages merging them is worth it
+constexpr uint32_t POOR_RATIO_MIN_SIZE = 4096;    // Small streams always compress badly, not worth reporting
+constexpr double POOR_RATIO = 0.95;               // Compressed streams that keep more than this are decoded for nothing
+
+enum Flags : uint32_t {
+    FLAG_HUGE_UNCOMPRESSED = 1 << 0,
+    FLAG_TINY = 1 << 1,
+    FLAG_SHADOWED = 1 << 2,
+    FLAG_POOR_RATIO = 1 << 3,
+    FLAG_CORRUPT = 1 << 4,
+    FLAG_UNREADABLE = 1 << 5,
+};
+
+struct Report {
+    fs::path path;
+    std::string relative;
+    uint32_t flags = 0;
+    std::string error;
+
+    uint64_t fileSize = 0;
+    uint32_t entries = 0;
+    uint64_t compressedBytes = 0; // On disk, live entries only
+    uint64_t memBytes = 0;
+    uint64_t refpackMemBytes = 0;
+
+    uint32_t hugeUncompressed = 0;
+    uint64_t hugeUncompressedBytes = 0;
+    uint32_t shadowed = 0; // Entries a later package (or later index entry) overrides, read and indexed for nothing
+    uint64_t shadowedBytes = 0;
+    uint32_t poorRatio = 0;
+    uint64_t poorRatioBytes = 0;
+    uint32_t corrupt = 0;
+    uint64_t recompressSavings = 0; // --deep only
+
+    double startupMs = 0;
+    double loadMs = 0;
+    double wastedMs = 0;
+
+    double Score() const { return startupMs + loadMs + wastedMs; }
+};
+
+static std::string Lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+static double MB(uint64_t bytes) {
+    return bytes / 1048576.0;
+}
+
+static std::string FlagString(uint32_t flags) {
+    std::string s;
+    s += flags & FLAG_HUGE_UNCOMPRESSED ? 'U' : '.';
+    s += flags & FLAG_TINY ? 'T' : '.';
+    s += flags & FLAG_SHADOWED ? 'S' : '.';
+    s += flags & FLAG_POOR_RATIO ? 'R' : '.';
+    s += flags & FLAG_CORRUPT ? 'C' : '.';
+    s += flags & FLAG_UNREADABLE ? 'X' : '.';
+    return s;
+}
+
+static void Analyze(Report& report, const DBPF::Package& package, bool deep) {
+    std::vector<uint8_t> scratch;
+    for (const auto& entry : package.Entries()) {
+        if (entry.IsDeleted()) continue;
+        report.compressedBytes += entry.compressedSize;
+        report.memBytes += entry.memSize;
+
+        if (entry.IsCompressed()) {
+            report.refpackMemBytes += entry.memSize;
+            if (entry.memSize >= POOR_RATIO_MIN_SIZE && entry.compressedSize >= entry.memSize * POOR_RATIO) {
+                report.poorRatio++;
+                report.poorRatioBytes += entry.memSize;
+            }
+        } else if (entry.compression == DBPF::COMPRESSION_NONE && entry.memSize >= HUGE_UNCOMPRESSED) {
+            report.hugeUncompressed++;
+            report.hugeUncompressedBytes += entry.memSize;
+        }
+
+        if (!deep) continue;
+        const uint8_t* data = package.ResourceData(entry);
+        if (!data) {
+            report.corrupt++;
+            continue;
+        }
+        if (entry.IsCompressed()) {
+            scratch.resize(entry.memSize);
+            if (RefPack::DecompressImpl<RefPack::StrategySSE2>(scratch.data(), entry.memSize, const_cast<uint8_t*>(data), entry.compressedSize) != static_cast<int>(entry.memSize)) report.corrupt++;
+        } else if (entry.compression == DBPF::COMPRESSION_NONE && entry.memSize >= HUGE_UNCOMPRESSED) {
+            if (RefPack::Compress(data, entry.compressedSize, scratch, RefPack::CompressionLevel::Fast) && scratch.size() < entry.compressedSize) {
+                report.recompressSavings += entry.compressedSize - scratch.size();
+            }
+        }
+    }
+}
+
+static void Score(Report& report) {
+    report.startupMs = Cost::OPEN_MS + report.entries * Cost::ENTRY_MS;
+    report.loadMs = MB(report.compressedBytes) * Cost::READ_MS_PER_MB + MB(report.refpackMemBytes) * Cost::DECODE_MS_PER_MB;
+    // Extra on top of the plain load: shadowed copies still get read/indexed, poor ratios decode without saving a read
+    // and huge uncompressed resources read roughly twice what they would compressed
+    report.wastedMs = report.shadowed * Cost::ENTRY_MS + MB(report.shadowedBytes) * Cost::READ_MS_PER_MB + MB(report.poorRatioBytes) * Cost::DECODE_MS_PER_MB +
+                      MB(report.hugeUncompressedBytes) * Cost::READ_MS_PER_MB * 0.5;
+
+    if (report.hugeUncompressed) report.flags |= FLAG_HUGE_UNCOMPRESSED;
+    if (report.fileSize < TINY_PACKAGE) report.flags |= FLAG_TINY;
+    if (report.shadowed) report.flags |= FLAG_SHADOWED;
+    if (report.poorRatio) report.flags |= FLAG_POOR_RATIO;
+    if (report.corrupt) report.flags |= FLAG_CORRUPT;
+}
+
+static bool WriteCsv(const fs::path& path, const std::vector<Report>& reports) {
+    FILE* f = std::fopen(path.string().c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "path,score_ms,startup_ms,load_ms,wasted_ms,flags,file_bytes,entries,mem_bytes,huge_uncompressed,huge_uncompressed_bytes,shadowed,shadowed_bytes,poor_ratio,poor_ratio_bytes,corrupt,"
+                    "recompress_savings,error\n");
+    for (const auto& r : reports) {
+        std::fprintf(f, "\"%s\",%.3f,%.3f,%.3f,%.3f,%s,%llu,%u,%llu,%u,%llu,%u,%llu,%u,%llu,%u,%llu,\"%s\"\n", r.relative.c_str(), r.Score(), r.startupMs, r.loadMs, r.wastedMs, FlagString(r.flags).c_str(),
+            static_cast<unsigned long long>(r.fileSize), r.entries, static_cast<unsigned long long>(r.memBytes), r.hugeUncompressed, static_cast<unsigned long long>(r.hugeUncompressedBytes), r.shadowed,
+            static_cast<unsigned long long>(r.shadowedBytes), r.poorRatio, static_cast<unsigned long long>(r.poorRatioBytes), r.corrupt, static_cast<unsigned long long>(r.recompressSavings), r.error.c_str());
+    }
+    return std::fclose(f) == 0;
+}
+
+int main(int argc, char** argv) {
+    std::vector<fs::path> dirs;
+    size_t top = 25;
+    bool deep = false;
+    fs::path csvPath;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csvPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--deep") == 0) {
+            deep = true;
+        } else {
+            dirs.emplace_back(argv[i]);
+        }
+    }
+    if (dirs.empty()) {
+        std::printf("usage: package_lint <package dir>... [--top N] [--csv out.csv] [--deep]\n");
+        return 2;
+    }
+
+    std::vector<Report> reports;
+    for (const auto& dir : dirs) {
+        std::error_code ec;
+        for (fs::recursive_directory_iterator it(dir, ec), end; it != end; it.increment(ec)) {
+            if (ec) break;
+            if (!it->is_regular_file() || Lower(it->path().extension().string()) != ".package") continue;
+            Report report;
+            report.path = it->path();
+            report.relative = fs::relative(it->path(), dir).generic_string();
+            reports.push_back(std::move(report));
+        }
+    }
+    // Same load order the game (and package_merge) uses, later packages override earlier ones
+    std::sort(reports.begin(), reports.end(), [](const Report& a, const Report& b) { return Lower(a.relative) < Lower(b.relative); });
+
+    // Key -> index of the report that currently owns it, in load order
+    std::unordered_map<DBPF::ResourceKey, uint32_t, DBPF::ResourceKeyHasher> owners;
+    std::unordered_map<DBPF::ResourceKey, uint32_t, DBPF::ResourceKeyHasher> ownerSizes;
+    for (uint32_t i = 0; i < reports.size(); i++) {
+        Report& report = reports[i];
+        DBPF::Package package;
+        if (!package.Open(report.path)) {
+            report.flags |= FLAG_UNREADABLE;
+            report.error = package.GetError();
+            std::error_code ec;
+            report.fileSize = fs::file_size(report.path, ec);
+            continue;
+        }
+        report.fileSize = package.Size();
+        report.entries = static_cast<uint32_t>(package.Entries().size());
+        Analyze(report, package, deep);
+
+        for (const auto& entry : package.Entries()) {
+            auto [it, inserted] = owners.try_emplace(entry.key, i);
+            if (!inserted) {
+                Report& loser = reports[it->second];
+                loser.shadowed++;
+                loser.shadowedBytes += ownerSizes[entry.key];
+                it->second = i;
+            }
+            ownerSizes[entry.key] = entry.compressedSize;
+        }
+    }
+
+    uint32_t tiny = 0, unreadable = 0;
+    uint64_t totalBytes = 0, totalEntries = 0, totalShadowed = 0, totalShadowedBytes = 0, totalHugeBytes = 0, totalSavings = 0;
+    double totalStartup = 0, totalScore = 0, tinyStartup = 0;
+    for (auto& report : reports) {
+        if (!(report.flags & FLAG_UNREADABLE)) Score(report);
+        totalBytes += report.fileSize;
+        totalEntries += report.entries;
+        totalShadowed += report.shadowed;
+        totalShadowedBytes += report.shadowedBytes;
+        totalHugeBytes += report.hugeUncompressedBytes;
+        totalSavings += report.recompressSavings;
+        totalStartup += report.startupMs;
+        totalScore += report.Score();
+        if (report.flags & FLAG_TINY) {
+            tiny++;
+            tinyStartup += report.startupMs;
+        }
+        if (report.flags & FLAG_UNREADABLE) unreadable++;
+    }
+
+    std::vector<const Report*> ranked;
+    for (const auto& report : reports) ranked.push_back(&report);
+    std::stable_sort(ranked.begin(), ranked.end(), [](const Report* a, const Report* b) {
+        if ((a->flags & FLAG_UNREADABLE) != (b->flags & FLAG_UNREADABLE)) return (a->flags & FLAG_UNREADABLE) != 0;
+        return a->Score() > b->Score();
+    });
+
+    std::printf("%zu packages, %.1f MB, %llu entries, estimated %.0f ms to open + index, %.0f ms to load everything once\n\n", reports.size(), MB(totalBytes), static_cast<unsigned long long>(totalEntries),
+        totalStartup, totalScore);
+    std::printf("%4s %10s %10s %9s %8s  %-6s %s\n", "rank", "score ms", "wasted ms", "size MB", "entries", "flags", "package");
+    for (size_t i = 0; i < std::min(top, ranked.size()); i++) {
+        const Report& r = *ranked[i];
+        std::printf("%4zu %10.2f %10.2f %9.2f %8u  %-6s %s", i + 1, r.Score(), r.wastedMs, MB(r.fileSize), r.entries, FlagString(r.flags).c_str(), r.relative.c_str());
+        if (!r.error.empty()) std::printf("  (%s)", r.error.c_str());
+        std::printf("\n");
+    }
+    std::printf("\nflags: U huge uncompressed resource, T tiny package, S has entries overridden by a later package, R RefPack that barely compresses, C corrupt resource, X not a readable DBPF 2.0 package\n\n");
+
+    if (unreadable) std::printf("- %u files aren't readable DBPF 2.0 packages, the game skips or chokes on them\n", unreadable);
+    if (tiny >= TINY_WARNING_COUNT) {
+        std::printf("- %u packages are under %llu KB, that's ~%.0f ms of mostly per-file overhead plus a handle each. Merge them (package_merge)\n", tiny, static_cast<unsigned long long>(TINY_PACKAGE >> 10),
+            tinyStartup);
+    }
+    if (totalShadowed) std::printf("- %llu entries (%.1f MB) are overridden by later packages and never used\n", static_cast<unsigned long long>(totalShadowed), MB(totalShadowedBytes));
+    if (totalHugeBytes) {
+        std::printf("- %.1f MB sits in uncompressed resources of 1 MB or more", MB(totalHugeBytes));
+        if (deep) std::printf(", RefPack would save %.1f MB of it", MB(totalSavings));
+        std::printf("\n");
+    }
+
+    if (!csvPath.empty()) {
+        if (!WriteCsv(csvPath, reports)) {
+            std::printf("failed to write %s\n", csvPath.string().c_str());
+            return 1;
+        }
+        std::printf("\nwrote %s\n", csvPath.string().c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,362 @@
+// Merges a folder of .package files into a few large ones: fewer handles, fewer watcher threads, fewer seeks
+// Build (Linux): g++ -O2 -std=c++20 -I.. package_merge.cpp ../dbpf/dbpf_reader.cpp ../dbpf/dbpf_writer.cpp ../refpack/refpack_encoder.cpp ../mapped_file.cpp -o package_merge
+// Usage:         package_merge <input dir> <output dir> [--first-wins] [--max-size MB] [--recompress fast|normal|max] [--move-originals <backup dir>] [--dry-run]
+//                package_merge --undo <manifest>
+//
+// Override order: packages load in case-insensitive path order and, by default, the last one to define a key wins (the "zzz_" convention)
+// Duplicate keys are resolved here so only the winning copy is written, which keeps the merged set's behaviour independent of output names
+// The manifest (merge_manifest.tsv in the output dir) records every source + output with size and hash so --undo can put things back
+#include "dbpf/dbpf_reader.h"
+#include "dbpf/dbpf_writer.h"
+#include "fast_hash.h"
+#include "mapped_file.h"
+#include "refpack/refpack_decoder.h"
+#include "refpack/refpack_encoder.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char* MANIFEST_NAME = "merge_manifest.tsv";
+
+struct Options {
+    fs::path input;
+    fs::path output;
+    fs::path backup;
+    bool lastWins = true;
+    bool dryRun = false;
+    bool recompress = false;
+    RefPack::CompressionLevel level = RefPack::CompressionLevel::Normal;
+    uint64_t maxSize = 512ull << 20;
+};
+
+struct Source {
+    fs::path path;
+    std::string relative;
+    DBPF::Package package;
+    uint64_t hash = 0;
+    uint32_t kept = 0;
+    uint32_t shadowed = 0;
+};
+
+struct Output {
+    std::string name;
+    DBPF::PackageWriter writer;
+    uint64_t bytes = 0;
+    uint64_t hash = 0;
+    uint64_t fileSize = 0;
+};
+
+static std::string Lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+static std::string Hex(uint64_t v) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return buf;
+}
+
+static uint64_t HashFile(const fs::path& path, uint64_t* size = nullptr) {
+    MappedFile file;
+    if (!file.Open(path)) return 0;
+    if (size) *size = file.Size();
+    return FastHash::Hash64(file.Data(), file.Size());
+}
+
+// rename() can't cross filesystems, fall back to copy + remove
+static bool MoveFile(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    fs::create_directories(to.parent_path(), ec);
+    fs::rename(from, to, ec);
+    if (!ec) return true;
+    if (!fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec)) return false;
+    return fs::remove(from, ec);
+}
+
+static int Undo(const fs::path& manifestPath) {
+    std::ifstream in(manifestPath);
+    if (!in) {
+        std::printf("can't read %s\n", manifestPath.string().c_str());
+        return 1;
+    }
+
+    fs::path inputDir, outputDir, backupDir;
+    std::vector<std::vector<std::string>> sources, outputs;
+    for (std::string line; std::getline(in, line);) {
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        for (std::string field; std::getline(ss, field, '\t');) fields.push_back(field);
+        if (fields.size() >= 2 && fields[0] == "input") inputDir = fs::u8path(fields[1]);
+        if (fields.size() >= 2 && fields[0] == "output_dir") outputDir = fs::u8path(fields[1]);
+        if (fields.size() >= 2 && fields[0] == "backup" && fields[1] != "-") backupDir = fs::u8path(fields[1]);
+        if (fields.size() >= 4 && fields[0] == "source") sources.push_back(fields);
+        if (fields.size() >= 4 && fields[0] == "output") outputs.push_back(fields);
+    }
+
+    uint32_t restored = 0, removed = 0, problems = 0;
+
+    // Originals first, outputs only go once everything they replaced is back
+    if (!backupDir.empty()) {
+        for (const auto& s : sources) {
+            fs::path from = backupDir / fs::u8path(s[1]);
+            fs::path to = inputDir / fs::u8path(s[1]);
+            uint64_t size = 0;
+            if (Hex(HashFile(from, &size)) != s[3] || std::to_string(size) != s[2]) {
+                std::printf("  backup of %s is missing or changed, leaving it\n", s[1].c_str());
+                problems++;
+                continue;
+            }
+            if (MoveFile(from, to)) {
+                restored++;
+            } else {
+                std::printf("  could not move %s back\n", s[1].c_str());
+                problems++;
+            }
+        }
+    }
+
+    if (problems) {
+        std::printf("%u originals restored, %u problems, merged outputs left in place\n", restored, problems);
+        return 1;
+    }
+
+    for (const auto& o : outputs) {
+        fs::path path = outputDir / fs::u8path(o[1]);
+        if (Hex(HashFile(path)) != o[3]) {
+            std::printf("  %s was modified since the merge, leaving it\n", o[1].c_str());
+            problems++;
+            continue;
+        }
+        std::error_code ec;
+        if (fs::remove(path, ec)) removed++;
+    }
+
+    std::error_code ec;
+    fs::rename(manifestPath, fs::path(manifestPath).concat(".undone"), ec);
+    std::printf("undo: %u originals restored, %u merged packages removed%s\n", restored, removed, problems ? ", some outputs kept (see above)" : "");
+    return problems ? 1 : 0;
+}
+
+static bool ParseArgs(int argc, char** argv, Options& options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--first-wins") {
+            options.lastWins = false;
+        } else if (arg == "--dry-run") {
+            options.dryRun = true;
+        } else if (arg == "--max-size" && i + 1 < argc) {
+            options.maxSize = static_cast<uint64_t>(std::max(1, std::atoi(argv[++i]))) << 20;
+        } else if (arg == "--move-originals" && i + 1 < argc) {
+            options.backup = argv[++i];
+        } else if (arg == "--recompress" && i + 1 < argc) {
+            std::string level = argv[++i];
+            options.recompress = true;
+            if (level == "fast") options.level = RefPack::CompressionLevel::Fast;
+            else if (level == "max") options.level = RefPack::CompressionLevel::Max;
+            else options.level = RefPack::CompressionLevel::Normal;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) return false;
+    options.input = fs::absolute(positional[0]);
+    options.output = fs::absolute(positional[1]);
+    // DBPF 2.0 offsets are 32-bit
+    options.maxSize = std::min<uint64_t>(options.maxSize, 0xFFFFFFFFull - (64ull << 20));
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::strcmp(argv[1], "--undo") == 0) return Undo(argv[2]);
+
+    Options options;
+    if (!ParseArgs(argc, argv, options)) {
+        std::printf("usage: package_merge <input dir> <output dir> [--first-wins] [--max-size MB] [--recompress fast|normal|max] [--move-originals <backup dir>] [--dry-run]\n"
+                    "       package_merge --undo <manifest>\n");
+        return 2;
+    }
+
+    // Load order
+    std::vector<std::unique_ptr<Source>> sources;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(options.input, ec), end; it != end; it.increment(ec)) {
+        if (ec) break;
+        if (!it->is_regular_file() || Lower(it->path().extension().string()) != ".package") continue;
+        if (fs::equivalent(it->path().parent_path(), options.output, ec)) continue; // Don't eat our own output on a rerun
+        auto source = std::make_unique<Source>();
+        source->path = it->path();
+        auto relative = fs::relative(it->path(), options.input).generic_u8string();
+        source->relative.assign(relative.begin(), relative.end());
+        sources.push_back(std::move(source));
+    }
+    std::sort(sources.begin(), sources.end(), [](const auto& a, const auto& b) { return Lower(a->relative) < Lower(b->relative); });
+
+    uint64_t bytesBefore = 0;
+    uint64_t entriesBefore = 0;
+    std::vector<std::unique_ptr<Source>> merged;
+    for (auto& source : sources) {
+        uint64_t size = 0;
+        source->hash = HashFile(source->path, &size);
+        bytesBefore += size;
+        if (!source->package.Open(source->path)) {
+            std::printf("  skipping %s: %s\n", source->relative.c_str(), source->package.GetError().c_str());
+            continue;
+        }
+        entriesBefore += source->package.Entries().size();
+        merged.push_back(std::move(source));
+    }
+
+    // Pick the winning copy of every key
+    struct Winner {
+        uint32_t source;
+        uint32_t entry;
+    };
+    std::unordered_map<DBPF::ResourceKey, Winner, DBPF::ResourceKeyHasher> winners;
+    for (uint32_t s = 0; s < merged.size(); s++) {
+        const auto& entries = merged[s]->package.Entries();
+        for (uint32_t e = 0; e < entries.size(); e++) {
+            auto [it, inserted] = winners.try_emplace(entries[e].key, Winner{s, e});
+            if (!inserted && options.lastWins) it->second = {s, e};
+        }
+    }
+
+    // Lay winners out into outputs in load order
+    std::vector<std::unique_ptr<Output>> outputs;
+    uint64_t recompressedBefore = 0, recompressedAfter = 0, recompressedCount = 0;
+    std::vector<uint8_t> compressed, check;
+    for (uint32_t s = 0; s < merged.size(); s++) {
+        Source& source = *merged[s];
+        const auto& entries = source.package.Entries();
+        for (uint32_t e = 0; e < entries.size(); e++) {
+            const auto& winner = winners[entries[e].key];
+            if (winner.source != s || winner.entry != e) {
+                source.shadowed++;
+                continue;
+            }
+
+            const DBPF::IndexEntry& entry = entries[e];
+            const uint8_t* data = source.package.ResourceData(entry);
+            if (!data) {
+                std::printf("  %s: entry %u points outside the file, dropped\n", source.relative.c_str(), e);
+                continue;
+            }
+
+            if (outputs.empty() || (outputs.back()->bytes && outputs.back()->bytes + entry.compressedSize > options.maxSize)) {
+                outputs.push_back(std::make_unique<Output>());
+                outputs.back()->name = "merged_" + std::string(3 - std::min<size_t>(3, std::to_string(outputs.size() - 1).size()), '0') + std::to_string(outputs.size() - 1) + ".package";
+            }
+            Output& output = *outputs.back();
+
+            // Only uncompressed resources get compressed, and only if it's smaller and decodes back exactly
+            bool added = false;
+            if (options.recompress && entry.compression == DBPF::COMPRESSION_NONE && entry.compressedSize >= 64) {
+                check.resize(entry.compressedSize);
+                if (RefPack::Compress(data, entry.compressedSize, compressed, options.level) && compressed.size() + 16 < entry.compressedSize &&
+                    RefPack::DecompressImpl<RefPack::StrategySSE2>(check.data(), entry.compressedSize, compressed.data(), static_cast<uint32_t>(compressed.size())) == static_cast<int>(entry.compressedSize) &&
+                    memcmp(check.data(), data, entry.compressedSize) == 0) {
+                    output.writer.Add(entry.key, compressed.data(), static_cast<uint32_t>(compressed.size()), entry.compressedSize, DBPF::COMPRESSION_REFPACK);
+                    output.bytes += compressed.size();
+                    recompressedBefore += entry.compressedSize;
+                    recompressedAfter += compressed.size();
+                    recompressedCount++;
+                    added = true;
+                }
+            }
+            if (!added) {
+                output.writer.AddView(entry.key, data, entry.compressedSize, entry.memSize, entry.compression);
+                output.bytes += entry.compressedSize;
+            }
+            source.kept++;
+        }
+    }
+
+    uint64_t bytesAfter = 0, entriesAfter = 0;
+    if (!options.dryRun) {
+        fs::create_directories(options.output, ec);
+        if (fs::exists(options.output / MANIFEST_NAME)) {
+            std::printf("%s already has a manifest, undo that merge first\n", options.output.string().c_str());
+            return 1;
+        }
+
+        for (auto& output : outputs) {
+            fs::path path = options.output / output->name;
+            if (!output->writer.Write(path)) {
+                std::printf("failed to write %s\n", path.string().c_str());
+                return 1;
+            }
+            // Read it back, every key has to be there
+            DBPF::Package verify;
+            if (!verify.Open(path) || verify.Entries().size() != output->writer.Count()) {
+                std::printf("%s did not read back: %s\n", path.string().c_str(), verify.GetError().c_str());
+                return 1;
+            }
+            for (const auto& entry : output->writer.Layout()) {
+                if (!verify.Find(entry.key)) {
+                    std::printf("%s is missing a key after writing\n", path.string().c_str());
+                    return 1;
+                }
+            }
+            output->hash = HashFile(path, &output->fileSize);
+            bytesAfter += output->fileSize;
+            entriesAfter += verify.Entries().size();
+        }
+
+        std::ofstream manifest(options.output / MANIFEST_NAME, std::ios::trunc);
+        auto u8 = [](const fs::path& p) {
+            auto s = p.generic_u8string();
+            return std::string(s.begin(), s.end());
+        };
+        manifest << "# package_merge manifest v1, undo with: package_merge --undo <this file>\n";
+        manifest << "input\t" << u8(options.input) << "\n";
+        manifest << "output_dir\t" << u8(options.output) << "\n";
+        manifest << "backup\t" << (options.backup.empty() ? std::string("-") : u8(fs::absolute(options.backup))) << "\n";
+        manifest << "policy\t" << (options.lastWins ? "last-wins" : "first-wins") << "\n";
+        manifest << "# output\tname\tsize\thash\tentries\n";
+        for (const auto& output : outputs) manifest << "output\t" << output->name << "\t" << output->fileSize << "\t" << Hex(output->hash) << "\t" << output->writer.Count() << "\n";
+        manifest << "# source\trelative path\tsize\thash\tkept\tshadowed\n";
+        for (const auto& source : merged) manifest << "source\t" << source->relative << "\t" << fs::file_size(source->path) << "\t" << Hex(source->hash) << "\t" << source->kept << "\t" << source->shadowed << "\n";
+        if (!manifest) {
+            std::printf("failed to write manifest\n");
+            return 1;
+        }
+        manifest.close();
+
+        if (!options.backup.empty()) {
+            for (const auto& source : merged) {
+                source->package.Close();
+                if (!MoveFile(source->path, options.backup / fs::u8path(source->relative))) std::printf("  could not move %s to the backup dir\n", source->relative.c_str());
+            }
+        }
+    } else {
+        for (const auto& output : outputs) {
+            bytesAfter += output->writer.Build().size();
+            entriesAfter += output->writer.Count();
+        }
+    }
+
+    uint64_t shadowed = 0;
+    for (const auto& source : merged) shadowed += source->shadowed;
+
+    std::printf("before: %zu packages (%zu merged, %zu skipped), %.1f MB, %llu entries\n", sources.size(), merged.size(), sources.size() - merged.size(), bytesBefore / 1048576.0,
+        static_cast<unsigned long long>(entriesBefore));
+    std::printf("after:  %zu packages, %.1f MB, %llu entries (%llu shadowed duplicates dropped, %s wins)%s\n", outputs.size(), bytesAfter / 1048576.0, static_cast<unsigned long long>(entriesAfter),
+        static_cast<unsigned long long>(shadowed), options.lastWins ? "last" : "first", options.dryRun ? " [dry run]" : "");
+    if (options.recompress) {
+        std::printf("recompressed %llu resources: %.1f MB -> %.1f MB\n", static_cast<unsigned long long>(recompressedCount), recompressedBefore / 1048576.0, recompressedAfter / 1048576.0);
+    }
+    return 0;
+}
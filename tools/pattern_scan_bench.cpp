@@ -0,0 +1,457 @@
+// Pattern scanner benchmark, times Signature::Find (SSE2 and AVX2 anchor search) against the old byte-by-byte loop on a synthetic module image
+// Build (Linux): g++ -O2 -std=c++20 -I.. pattern_scan_bench.cpp ../scan/signature.cpp ../scan/multi_pattern.cpp ../scan/match_cache.cpp -o pattern_scan_bench
+// Usage:         pattern_scan_bench [--size MB] [--seconds N] [--fuzz N] [--seed N]
+// The image is made of x86-looking instruction fragments, a zeroed data section and int3 padding, the patterns are real ones from the patches
+// Every pattern gets planted somewhere in the image and all three scanners have to return that exact address
+// Then all of them at once through Signature::MultiPattern, which has to report the same first match and match count per pattern as a Find loop,
+// and those results through a Signature::MatchCache file, which has to give them back unchanged for the same image and nothing for another one
+// Then patterns with thousands of hits, every match through the old rescan-after-each-hit loop vs Signature::FindAll and ForEachMatch, all three have to agree
+// --fuzz N cuts N random patterns (random wildcards/nibbles, random unaligned ranges) out of the image and checks Find and ForEachMatch against the naive loop,
+// and checks N / 16 random sets of them through MultiPattern
+#include "fast_hash.h"
+#include "scan/match_cache.h"
+#include "scan/multi_pattern.h"
+#include "scan/signature.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// Lifted from the patches, a mix of short, long, wildcard-heavy and common-byte-heavy signatures
+static const char* const PATTERNS[] = {
+    "83 EC 2C 8B 44 24 ?? 53 55 56 57 33 DB 8B F1 BF ?? ?? ?? ?? 50 8D 4C 24 ?? 89 5C 24 ?? 89 5C 24 ?? 89 5C 24 ?? 89 7C 24 ??",
+    "56 8B F1 C7 06 ?? ?? ?? ?? 33 C9 89 4E 0C",
+    "8B 41 08 8B 04 85 ?? ?? ?? ?? C3",
+    "B9 00 04 00 00 3B C8 1B C0 23 C1 03 C1 C3",
+    "80 7D 14 00 74 ?? D9 05 ?? ?? ?? ?? 83 EC 08",
+    "0F 82 ?? ?? ?? ?? 8B 0F E8",
+    "E8 ?? ?? ?? ?? 85 C0 75 F7 89 1D",
+    "8B 81 C0 00 00 00 8B 91 C4 00 00 00 C3",
+    "B9 ?? ?? ?? ?? 75 05 B9 ?? ?? ?? ?? E8",
+    "51 C1 FA 18 F6 D0 22 D0",
+    "8B 4C 24 08 56 8B 74 24 08 8D 44 24 10 50 51 8B CE E8 ?? ?? ?? ?? 8B C6 5E C3 CC CC CC CC CC CC 53 8B 5C 24 08",
+    "0F 82 ?? ?? ?0 8B",
+};
+
+// Fragments of typical 32-bit MSVC output, ? bytes get a random value
+static const char* const FRAGMENTS[] = {
+    "55", "8B EC", "83 EC ?", "56", "57", "53", "8B F1", "8B 44 24 ?", "8B 4C 24 ?", "8B 54 24 ?", "89 44 24 ?", "8D 4C 24 ?", "E8 ? ? ? ?", "83 C4 ?",
+    "85 C0", "74 ?", "75 ?", "EB ?", "33 C0", "33 C9", "8B 06", "8B 0E", "8B 46 ?", "89 46 ?", "C7 46 ? ? ? ? ?", "6A 00", "6A ?", "50", "51", "FF D0",
+    "FF 15 ? ? ? ?", "8B 01", "8B 50 ?", "5F", "5E", "5B", "5D", "C3", "C2 ? 00", "0F 84 ? ? 00 00", "0F 85 ? ? 00 00", "3B C3", "A1 ? ? ? ?",
+    "D9 44 24 ?", "D9 5C 24 ?", "F3 0F 10 ? ?", "F3 0F 11 ? ?", "68 ? ? ? ?", "B8 ? ? ? ?", "8B E5", "CC CC CC CC",
+};
+
+struct Fragment {
+    std::vector<uint8_t> bytes;
+    std::vector<bool> random;
+};
+
+static std::vector<Fragment> ParseFragments() {
+    std::vector<Fragment> fragments;
+    for (const char* text : FRAGMENTS) {
+        Fragment f;
+        for (const char* p = text; *p;) {
+            while (*p == ' ') p++;
+            if (!*p) break;
+            if (*p == '?') {
+                f.bytes.push_back(0);
+                f.random.push_back(true);
+                p++;
+            } else {
+                f.bytes.push_back(static_cast<uint8_t>(std::strtoul(std::string(p, 2).c_str(), nullptr, 16)));
+                f.random.push_back(false);
+                p += 2;
+            }
+        }
+        fragments.push_back(std::move(f));
+    }
+    return fragments;
+}
+
+// Roughly a game exe: 60% code, 25% mostly zero data, the rest resource-ish noise
+static std::vector<uint8_t> MakeImage(size_t size, std::mt19937& rng) {
+    std::vector<uint8_t> image(size, 0);
+    std::vector<Fragment> fragments = ParseFragments();
+    std::uniform_int_distribution<size_t> pick(0, fragments.size() - 1);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    size_t codeEnd = size * 60 / 100;
+    size_t dataEnd = size * 85 / 100;
+    size_t at = 0x1000;
+    while (at < codeEnd) {
+        const Fragment& f = fragments[pick(rng)];
+        for (size_t i = 0; i < f.bytes.size() && at < codeEnd; i++, at++) image[at] = f.random[i] ? static_cast<uint8_t>(byte(rng)) : f.bytes[i];
+    }
+    for (at = codeEnd; at < dataEnd; at++) {
+        if (rng() % 8 == 0) image[at] = static_cast<uint8_t>(byte(rng));
+    }
+    for (at = dataEnd; at < size; at++) image[at] = static_cast<uint8_t>(byte(rng));
+    return image;
+}
+
+// Pattern bytes with the wildcards filled in from the image so planting doesn't leave a seam
+static void Plant(std::vector<uint8_t>& image, size_t at, const Signature::Compiled& pattern) {
+    for (size_t j = 0; j < pattern.Size(); j++) image[at + j] = static_cast<uint8_t>((image[at + j] & ~pattern.masks[j]) | pattern.bytes[j]);
+}
+
+template <typename F>
+static double Measure(F&& scan, double seconds) {
+    using Clock = std::chrono::steady_clock;
+    scan();
+    size_t runs = 0;
+    auto start = Clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        scan();
+        runs++;
+        elapsed = Clock::now() - start;
+    } while (elapsed.count() < seconds);
+    return elapsed.count() / runs;
+}
+
+// Cut from near the range so it often hits, sometimes multiple times, sometimes not at all
+static std::string RandomPattern(const std::vector<uint8_t>& image, size_t rangeStart, size_t rangeSize, std::mt19937& rng) {
+    size_t length = 1 + rng() % 24;
+    size_t source = std::min(rangeStart + rng() % (rangeSize + 64), image.size() - length);
+    std::string text;
+    for (size_t j = 0; j < length; j++) {
+        char piece[4];
+        uint8_t b = image[source + j];
+        switch (rng() % 8) {
+        case 0: std::snprintf(piece, sizeof(piece), "??"); break;
+        case 1: std::snprintf(piece, sizeof(piece), "?%X", b & 0xF); break;
+        case 2: std::snprintf(piece, sizeof(piece), "%X?", b >> 4); break;
+        case 3: std::snprintf(piece, sizeof(piece), "?"); break;
+        default: std::snprintf(piece, sizeof(piece), "%02X", b); break;
+        }
+        if (!text.empty()) text += ' ';
+        text += piece;
+    }
+    if (rng() % 16 == 0) text += " 7F"; // Occasionally tack on a byte so it likely misses
+    return text;
+}
+
+// Every match of one pattern, the slow obvious way
+static std::vector<const uint8_t*> FindAllNaive(const uint8_t* begin, const uint8_t* end, const Signature::Compiled& pattern) {
+    std::vector<const uint8_t*> found;
+    for (const uint8_t* at = Signature::FindNaive(begin, end, pattern); at; at = Signature::FindNaive(at + 1, end, pattern)) found.push_back(at);
+    return found;
+}
+
+static int Fuzz(const std::vector<uint8_t>& image, uint32_t iterations, std::mt19937& rng) {
+    const bool hasAVX2 = Signature::CpuHasAVX2();
+    int failures = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        // Ranges are kept small so the fuzz run stays quick, with odd ends to exercise the scalar tail
+        size_t rangeSize = 1 + rng() % 4096;
+        size_t rangeStart = rng() % (image.size() - rangeSize);
+        const uint8_t* begin = image.data() + rangeStart;
+        const uint8_t* end = begin + rangeSize;
+
+        std::string text = RandomPattern(image, rangeStart, rangeSize, rng);
+        Signature::Compiled compiled;
+        std::string error;
+        if (!Signature::Compile(text.c_str(), compiled, &error)) {
+            std::printf("fuzz: failed to compile \"%s\": %s\n", text.c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+        const uint8_t* expected = Signature::FindNaive(begin, end, compiled);
+        const uint8_t* sse2 = Signature::FindSSE2(begin, end, compiled);
+        const uint8_t* best = hasAVX2 ? Signature::Find(begin, end, compiled) : sse2;
+        if (sse2 != expected || best != expected) {
+            std::printf("fuzz: \"%s\" over [%zu, %zu): naive %td, SSE2 %td, Find %td\n", text.c_str(), rangeStart, rangeStart + rangeSize, expected ? expected - begin : -1,
+                sse2 ? sse2 - begin : -1, best ? best - begin : -1);
+            failures++;
+        }
+        std::vector<const uint8_t*> all;
+        Signature::ForEachMatch(begin, end, compiled, [&](const uint8_t* at) { all.push_back(at); });
+        if (all != FindAllNaive(begin, end, compiled)) {
+            std::printf("fuzz: \"%s\" over [%zu, %zu): ForEachMatch found %zu matches, naive %zu\n", text.c_str(), rangeStart, rangeStart + rangeSize, all.size(), FindAllNaive(begin, end, compiled).size());
+            failures++;
+        }
+    }
+    return failures;
+}
+
+
+// Patterns with thousands of hits, what SmoothPatchClassic-style "patch every copy" loops scan for. The first is SmoothPatchClassic's own,
+// planted every couple of KB, the others just turn up a lot in the fragments
+static const char* const MANY_HIT_PATTERNS[] = {"8B 44 24 04 8B 08 6A 01 51 FF", "E8 ?? ?? ?? ?? 83 C4 ??", "6A 00 6A ??", "8B 4C 24 ?? 85 C0 74 ??"};
+
+// The loop the patches used to run: PatchHelper::ScanPattern (compile the text, then Find) restarted right after every hit
+static std::vector<const uint8_t*> RescanLoop(const uint8_t* begin, const uint8_t* end, const char* text) {
+    std::vector<const uint8_t*> found;
+    for (const uint8_t* from = begin;;) {
+        Signature::Compiled compiled;
+        Signature::Compile(text, compiled);
+        const uint8_t* at = Signature::Find(from, end, compiled);
+        if (!at) return found;
+        found.push_back(at);
+        from = at + 1;
+    }
+}
+
+static int ManyHits(std::vector<uint8_t> image, size_t codeEnd, double seconds, std::mt19937& rng) {
+    int failures = 0;
+    Signature::Compiled sleepSite;
+    Signature::Compile(MANY_HIT_PATTERNS[0], sleepSite);
+    for (size_t at = 0x1000 + rng() % 2048; at + sleepSite.Size() < codeEnd; at += 1024 + rng() % 2048) Plant(image, at, sleepSite);
+    const uint8_t* begin = image.data();
+    const uint8_t* end = begin + image.size();
+
+    std::printf("%-40s %7s | %10s | %9s %7s | %9s %7s\n", "many hits", "matches", "rescan ms", "FindAll", "x", "ForEach", "x");
+    for (const char* text : MANY_HIT_PATTERNS) {
+        Signature::Compiled compiled;
+        Signature::Compile(text, compiled);
+        std::vector<const uint8_t*> expected = FindAllNaive(begin, end, compiled);
+        std::vector<const uint8_t*> rescan = RescanLoop(begin, end, text);
+        std::vector<const uint8_t*> iterated, visited;
+        for (const uint8_t* at : Signature::FindAll(begin, end, compiled)) iterated.push_back(at);
+        Signature::ForEachMatch(begin, end, compiled, [&](const uint8_t* at) { visited.push_back(at); });
+        if (rescan != expected || iterated != expected || visited != expected) {
+            std::printf("MANY HITS MISMATCH on \"%s\": naive %zu, rescan %zu, FindAll %zu, ForEachMatch %zu\n", text, expected.size(), rescan.size(), iterated.size(), visited.size());
+            failures++;
+        }
+
+        size_t sink = 0;
+        double loop = Measure([&] { sink += RescanLoop(begin, end, text).size(); }, seconds);
+        double range = Measure([&] {
+            for (const uint8_t* at : Signature::FindAll(begin, end, compiled)) sink += at != nullptr;
+        }, seconds);
+        double visitor = Measure([&] { Signature::ForEachMatch(begin, end, compiled, [&](const uint8_t*) { sink++; }); }, seconds);
+        std::printf("%-40s %7zu | %10.3f | %9.3f %6.1fx | %9.3f %6.1fx\n", text, expected.size(), loop * 1e3, range * 1e3, loop / range, visitor * 1e3, loop / visitor);
+        if (sink == 0) std::printf("(nothing matched)\n");
+    }
+    return failures;
+}
+
+static int FuzzMulti(const std::vector<uint8_t>& image, uint32_t iterations, std::mt19937& rng) {
+    int failures = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        size_t rangeSize = 1 + rng() % 4096;
+        size_t rangeStart = rng() % (image.size() - rangeSize);
+        const uint8_t* begin = image.data() + rangeStart;
+        const uint8_t* end = begin + rangeSize;
+
+        // Patterns cut from the same spot share prefixes and suffixes, which is what exercises the failure links
+        std::vector<Signature::Compiled> set(1 + rng() % 12);
+        std::vector<std::string> texts;
+        Signature::MultiPattern multi;
+        for (auto& compiled : set) {
+            texts.push_back(RandomPattern(image, rangeStart, rng() % 2 ? rangeSize : 8, rng));
+            Signature::Compile(texts.back().c_str(), compiled);
+            multi.Add(compiled);
+        }
+        multi.Build();
+        std::vector<std::vector<const uint8_t*>> found(set.size()), scalar(set.size());
+        multi.Scan(begin, end, [&](size_t index, const uint8_t* at) { found[index].push_back(at); });
+        multi.ScanScalar(begin, end, [&](size_t index, const uint8_t* at) { scalar[index].push_back(at); });
+        for (size_t j = 0; j < set.size(); j++) {
+            if (found[j] != FindAllNaive(begin, end, set[j]) || scalar[j] != found[j]) {
+                std::printf("fuzz multi: \"%s\" (%zu of %zu) over [%zu, %zu): %zu matches, naive %zu\n", texts[j].c_str(), j, set.size(), rangeStart, rangeStart + rangeSize, found[j].size(),
+                    FindAllNaive(begin, end, set[j]).size());
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = 20;
+    double seconds = 0.5;
+    uint32_t fuzz = 0;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--size") && i + 1 < argc) megabytes = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--fuzz") && i + 1 < argc) fuzz = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc) seed = std::strtoul(argv[++i], nullptr, 10);
+        else {
+            std::printf("usage: pattern_scan_bench [--size MB] [--seconds N] [--fuzz N] [--seed N]\n");
+            return 1;
+        }
+    }
+    if (megabytes < 1) megabytes = 1;
+
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> image = MakeImage(megabytes << 20, rng);
+    const size_t codeEnd = image.size() * 60 / 100;
+
+    std::vector<Signature::Compiled> patterns;
+    for (const char* text : PATTERNS) {
+        Signature::Compiled compiled;
+        std::string error;
+        if (!Signature::Compile(text, compiled, &error)) {
+            std::printf("failed to compile \"%s\": %s\n", text, error.c_str());
+            return 1;
+        }
+        patterns.push_back(std::move(compiled));
+    }
+
+    // Plant each one past the earliest accidental match so the expected address is known, spread over the code section
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < patterns.size(); i++) {
+        size_t at = codeEnd / 8 + rng() % (codeEnd - codeEnd / 8 - 256);
+        const uint8_t* early = Signature::FindNaive(image.data(), image.data() + at, patterns[i]);
+        if (early) at = early - image.data();
+        else Plant(image, at, patterns[i]);
+        expected.push_back(at);
+    }
+
+    const bool hasAVX2 = Signature::CpuHasAVX2();
+    const uint8_t* begin = image.data();
+    const uint8_t* end = begin + image.size();
+    std::printf("image %zu MB, AVX2 %s\n", megabytes, hasAVX2 ? "yes" : "no");
+    std::printf("%-40s %4s %7s %10s | %9s | %9s %7s | %9s %7s\n", "pattern", "len", "anchor", "offset", "naive ms", "SSE2 ms", "x", "AVX2 ms", "x");
+
+    int failures = 0;
+    double total[3] = {};
+    auto run = [&](const char* text, const Signature::Compiled& pattern, size_t expectedOffset, bool present) {
+        const uint8_t* want = present ? begin + expectedOffset : nullptr;
+        const uint8_t* got[3] = {Signature::FindNaive(begin, end, pattern), Signature::FindSSE2(begin, end, pattern), hasAVX2 ? Signature::Find(begin, end, pattern) : want};
+        for (const uint8_t* g : got) {
+            if (g != want) {
+                std::printf("MISMATCH on \"%s\": expected %td, naive %td, SSE2 %td, AVX2 %td\n", text, want ? want - begin : -1, got[0] ? got[0] - begin : -1, got[1] ? got[1] - begin : -1,
+                    got[2] ? got[2] - begin : -1);
+                failures++;
+                break;
+            }
+        }
+        double naive = Measure([&] { return Signature::FindNaive(begin, end, pattern); }, seconds);
+        double sse2 = Measure([&] { return Signature::FindSSE2(begin, end, pattern); }, seconds);
+        double avx2 = hasAVX2 ? Measure([&] { return Signature::Find(begin, end, pattern); }, seconds) : 0.0;
+        total[0] += naive;
+        total[1] += sse2;
+        total[2] += avx2;
+        std::string name(text);
+        if (name.size() > 40) name = name.substr(0, 37) + "...";
+        char offset[16];
+        if (present) std::snprintf(offset, sizeof(offset), "%#zx", expectedOffset);
+        else std::snprintf(offset, sizeof(offset), "miss");
+        char anchor[8];
+        std::snprintf(anchor, sizeof(anchor), "%02X@%zu", pattern.bytes[pattern.anchor], pattern.anchor);
+        std::printf("%-40s %4zu %7s %10s | %9.3f | %9.3f %6.1fx | %9.3f %6.1fx\n", name.c_str(), pattern.Size(), anchor, offset, naive * 1e3, sse2 * 1e3, naive / sse2, avx2 * 1e3,
+            hasAVX2 ? naive / avx2 : 0.0);
+    };
+
+    for (size_t i = 0; i < patterns.size(); i++) run(PATTERNS[i], patterns[i], expected[i], true);
+
+    // A signature that isn't in the image at all, the full-module walk an unknown game version pays for
+    Signature::Compiled missing;
+    Signature::Compile("F3 0F 10 46 68 0F 2E 05 ?? ?? ?? ?? 9F F6 C4 44 7A 08", missing);
+    if (!Signature::FindNaive(begin, end, missing)) run("(absent) F3 0F 10 46 68 0F 2E 05 ...", missing, 0, false);
+
+    std::printf("total: naive %.2f ms, SSE2 %.2f ms (%.1fx)", total[0] * 1e3, total[1] * 1e3, total[0] / total[1]);
+    if (hasAVX2) std::printf(", AVX2 %.2f ms (%.1fx)", total[2] * 1e3, total[0] / total[2]);
+    std::printf("\n");
+
+    // Everything in one walk, what a startup on an unknown build does. Per pattern scans only give the first hit, so the comparison
+    // that counts matches too is a Find loop per pattern. The patches have a few dozen signatures, the rest are cut from the code section
+    std::vector<std::string> texts(std::begin(PATTERNS), std::end(PATTERNS));
+    patterns.push_back(missing);
+    texts.push_back("F3 0F 10 46 68 0F 2E 05 ?? ?? ?? ?? 9F F6 C4 44 7A 08");
+    while (patterns.size() < 48) {
+        size_t length = 12 + rng() % 13;
+        size_t at = 0x1000 + rng() % (codeEnd - 0x1000 - length);
+        std::string text;
+        for (size_t j = 0; j < length; j++) {
+            char piece[4];
+            std::snprintf(piece, sizeof(piece), rng() % 6 ? "%02X" : "??", image[at + j]);
+            text += (j ? " " : "") + std::string(piece);
+        }
+        Signature::Compiled compiled;
+        Signature::Compile(text.c_str(), compiled);
+        patterns.push_back(std::move(compiled));
+        texts.push_back(text);
+    }
+    Signature::MultiPattern multi;
+    for (const auto& pattern : patterns) multi.Add(pattern);
+    multi.Build();
+    std::vector<size_t> counts(patterns.size());
+    std::vector<const uint8_t*> firsts(patterns.size());
+    auto scanMulti = [&] {
+        std::fill(counts.begin(), counts.end(), 0);
+        multi.Scan(begin, end, [&](size_t index, const uint8_t* at) {
+            if (!counts[index]++) firsts[index] = at;
+        });
+    };
+    scanMulti();
+    for (size_t i = 0; i < patterns.size(); i++) {
+        size_t count = 0;
+        const uint8_t* first = Signature::Find(begin, end, patterns[i]);
+        for (const uint8_t* at = first; at; at = Signature::Find(at + 1, end, patterns[i])) count++;
+        if (count != counts[i] || (count && first != firsts[i])) {
+            std::printf("MULTI MISMATCH on pattern %zu: %zu matches (first %td), Find loop %zu (first %td)\n", i, counts[i], counts[i] ? firsts[i] - begin : -1, count, first ? first - begin : -1);
+            failures++;
+        }
+    }
+    double single = Measure([&] {
+        for (const auto& pattern : patterns) Signature::Find(begin, end, pattern);
+    }, seconds);
+    double loops = Measure([&] {
+        for (const auto& pattern : patterns) {
+            for (const uint8_t* at = Signature::Find(begin, end, pattern); at; at = Signature::Find(at + 1, end, pattern)) {}
+        }
+    }, seconds);
+    double once = Measure(scanMulti, seconds);
+    double scalar = Measure([&] { multi.ScanScalar(begin, end, [](size_t, const uint8_t*) {}); }, seconds);
+    std::printf("one pass over %zu patterns (%zu unkeyed): %.2f ms (%.2f ms without SSSE3), first match each %.2f ms, all matches each %.2f ms\n", patterns.size(), multi.UnkeyedCount(),
+        once * 1e3, scalar * 1e3, single * 1e3, loops * 1e3);
+
+    // The next launch of the same exe: hash the code for the cache key, load the file, compare each cached match's bytes
+    std::filesystem::path cachePath = std::filesystem::temp_directory_path() / "pattern_scan_bench_matches.bin";
+    Signature::ImageKey key{0x4B1D0000, static_cast<uint32_t>(image.size()), FastHash::Hash64(begin, codeEnd)};
+    {
+        std::filesystem::remove(cachePath);
+        Signature::MatchCache cache;
+        cache.Load(cachePath, key);
+        for (size_t i = 0; i < patterns.size(); i++) cache.Store(texts[i].c_str(), begin, image.size(), {counts[i] ? static_cast<uint32_t>(firsts[i] - begin) : 0, static_cast<uint32_t>(counts[i])}, patterns[i].Size());
+        if (!cache.Save(cachePath)) std::printf("failed to write %s\n", cachePath.string().c_str());
+        // A cache from another build of the exe has to come back empty
+        Signature::MatchCache other;
+        if (other.Load(cachePath, {key.timeDateStamp, key.sizeOfImage, key.codeHash ^ 1}) || other.Size()) {
+            std::printf("CACHE MISMATCH: entries loaded for a different image\n");
+            failures++;
+        }
+    }
+    size_t cacheHits = 0;
+    double relaunch = Measure([&] {
+        Signature::MatchCache cache;
+        cache.Load(cachePath, {key.timeDateStamp, key.sizeOfImage, FastHash::Hash64(begin, codeEnd)});
+        cacheHits = 0;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            Signature::MatchCache::Match match;
+            if (!cache.Lookup(texts[i].c_str(), begin, image.size(), match)) continue;
+            cacheHits++;
+            if (match.count != counts[i] || (match.count && begin + match.rva != firsts[i])) {
+                std::printf("CACHE MISMATCH on pattern %zu: %u matches (first %u), scan %zu\n", i, match.count, match.rva, counts[i]);
+                failures++;
+            }
+        }
+    }, seconds);
+    if (cacheHits != patterns.size()) {
+        std::printf("CACHE MISMATCH: %zu of %zu patterns came back\n", cacheHits, patterns.size());
+        failures++;
+    }
+    std::printf("relaunch from the match cache: %.2f ms (code hash + load + byte compares)\n", relaunch * 1e3);
+    std::filesystem::remove(cachePath);
+
+    failures += ManyHits(image, codeEnd, seconds, rng);
+
+    if (fuzz) {
+        int fuzzFailures = Fuzz(image, fuzz, rng);
+        std::printf("fuzz: %u patterns, %d mismatches\n", fuzz, fuzzFailures);
+        failures += fuzzFailures;
+        int multiFailures = FuzzMulti(image, fuzz / 16, rng);
+        std::printf("fuzz multi: %u pattern sets, %d mismatches\n", fuzz / 16, multiFailures);
+        failures += multiFailures;
+    }
+    return failures ? 1 : 0;
+}
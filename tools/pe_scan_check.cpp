@@ -0,0 +1,289 @@
+// Opens exe/dll files with PE::Image and checks the things the DLL relies on it for: the same sections, imports, exports and relocations
+// parsed from the file on disk and from a copy laid out the way the loader maps it, parallel section scans (Signature::FindParallel,
+// ScanParallel) giving exactly what a single threaded scan of the same ranges gives, and PE::StringIndex finding the same strings and code
+// references a brute force search does. Point it at TS3.exe / TS3W.exe to see what the game has
+// Build (Linux): g++ -O2 -std=c++20 -I.. pe_scan_check.cpp ../scan/pe_image.cpp ../scan/parallel_scan.cpp ../scan/multi_pattern.cpp ../scan/signature.cpp ../scan/string_index.cpp ../mapped_file.cpp -o pe_scan_check -pthread
+// Usage:         pe_scan_check <file.exe|file.dll>... [--patterns N] [--seconds N] [--seed N] [--list]
+// Patterns are cut from the code sections with random wildcards. Chunk sizes are forced down to a few KB for the checks so even small files
+// put lots of matches across chunk edges, the timings use the real split
+#include "scan/multi_pattern.h"
+#include "scan/parallel_scan.h"
+#include "scan/pe_image.h"
+#include "scan/signature.h"
+#include "scan/string_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+template <typename F>
+static double Measure(F&& work, double seconds) {
+    using Clock = std::chrono::steady_clock;
+    int runs = 0;
+    auto start = Clock::now();
+    do {
+        work();
+        runs++;
+    } while (std::chrono::duration<double>(Clock::now() - start).count() < seconds);
+    return std::chrono::duration<double>(Clock::now() - start).count() / runs;
+}
+
+// Headers + each section's raw data at its RVA, what the loader does short of relocating and binding imports
+static std::vector<uint8_t> MapLikeLoader(const PE::Image& file) {
+    std::vector<uint8_t> mapped(file.SizeOfImage(), 0);
+    const uint8_t* data = file.Data();
+    std::memcpy(mapped.data(), data, std::min<size_t>(file.SizeOfHeaders(), mapped.size()));
+    for (const auto& section : file.Sections()) {
+        size_t length = std::min<size_t>(section.rawSize, section.virtualSize ? section.virtualSize : section.rawSize);
+        const uint8_t* raw = file.AtRva(section.rva, length);
+        if (raw && section.rva + length <= mapped.size()) std::memcpy(mapped.data() + section.rva, raw, length);
+    }
+    return mapped;
+}
+
+static int CompareParses(const PE::Image& file, const PE::Image& mapped) {
+    int failures = 0;
+    auto check = [&](bool same, const char* what) {
+        if (same) return;
+        std::printf("  PARSE MISMATCH: %s differ between the file and the mapped copy\n", what);
+        failures++;
+    };
+    check(file.Sections().size() == mapped.Sections().size(), "section counts");
+    for (size_t i = 0; i < std::min(file.Sections().size(), mapped.Sections().size()); i++) {
+        const auto& a = file.Sections()[i];
+        const auto& b = mapped.Sections()[i];
+        check(a.name == b.name && a.rva == b.rva && a.virtualSize == b.virtualSize && a.characteristics == b.characteristics, "sections");
+    }
+    check(file.Imports().size() == mapped.Imports().size(), "import counts");
+    for (size_t i = 0; i < std::min(file.Imports().size(), mapped.Imports().size()); i++) {
+        const auto& a = file.Imports()[i];
+        const auto& b = mapped.Imports()[i];
+        check(a.module == b.module && a.name == b.name && a.ordinal == b.ordinal && a.slotRva == b.slotRva, "imports");
+    }
+    check(file.Exports().size() == mapped.Exports().size(), "export counts");
+    for (size_t i = 0; i < std::min(file.Exports().size(), mapped.Exports().size()); i++) {
+        const auto& a = file.Exports()[i];
+        const auto& b = mapped.Exports()[i];
+        check(a.name == b.name && a.ordinal == b.ordinal && a.rva == b.rva && a.forwarder == b.forwarder, "exports");
+    }
+    check(file.Relocations() == mapped.Relocations(), "relocations");
+    return failures;
+}
+
+// First match range by range, the reference FindParallel has to agree with
+static const uint8_t* FindSerial(const std::vector<PE::Range>& ranges, const Signature::Compiled& pattern) {
+    for (const auto& [begin, end] : ranges) {
+        if (const uint8_t* at = Signature::Find(begin, end, pattern)) return at;
+    }
+    return nullptr;
+}
+
+static int CheckScans(const PE::Image& image, uint32_t patternCount, double seconds, std::mt19937& rng) {
+    const std::vector<PE::Range> ranges = image.CodeRanges();
+    size_t codeBytes = 0;
+    for (const auto& [begin, end] : ranges) codeBytes += end - begin;
+    if (codeBytes < 64) {
+        std::printf("  no code to scan\n");
+        return 0;
+    }
+
+    std::vector<Signature::Compiled> patterns;
+    while (patterns.size() < patternCount) {
+        const auto& [begin, end] = ranges[rng() % ranges.size()];
+        size_t length = 6 + rng() % 27;
+        if (static_cast<size_t>(end - begin) <= length) continue;
+        const uint8_t* at = begin + rng() % (end - begin - length);
+        std::string text;
+        for (size_t j = 0; j < length; j++) {
+            char piece[4];
+            std::snprintf(piece, sizeof(piece), rng() % 5 ? "%02X" : "??", at[j]);
+            text += (j ? " " : "") + std::string(piece);
+        }
+        Signature::Compiled compiled;
+        if (Signature::Compile(text.c_str(), compiled) && !compiled.wildcardOnly) patterns.push_back(std::move(compiled));
+    }
+
+    int failures = 0;
+    const Signature::ScanSplit smallChunks[] = {{1, 4096}, {3, 4096}, {8, 1000}};
+    for (size_t i = 0; i < patterns.size(); i++) {
+        const uint8_t* expected = FindSerial(ranges, patterns[i]);
+        for (const auto& split : smallChunks) {
+            const uint8_t* got = Signature::FindParallel(ranges, patterns[i], split);
+            if (got != expected) {
+                std::printf("  FIND MISMATCH on pattern %zu (%u threads, %zu byte chunks): %p, serial %p\n", i, split.threads, split.minChunk, (const void*)got, (const void*)expected);
+                failures++;
+            }
+        }
+    }
+
+    Signature::MultiPattern multi;
+    for (const auto& pattern : patterns) multi.Add(pattern);
+    multi.Build();
+    std::vector<std::vector<const uint8_t*>> serial(patterns.size());
+    for (const auto& [begin, end] : ranges) multi.Scan(begin, end, [&](size_t index, const uint8_t* at) { serial[index].push_back(at); });
+    for (const auto& split : smallChunks) {
+        std::vector<std::vector<const uint8_t*>> parallel(patterns.size());
+        Signature::ScanParallel(multi, ranges, [&](size_t index, const uint8_t* at) { parallel[index].push_back(at); }, split);
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (parallel[i] != serial[i]) {
+                std::printf("  MULTI MISMATCH on pattern %zu (%u threads, %zu byte chunks): %zu matches, serial %zu\n", i, split.threads, split.minChunk, parallel[i].size(), serial[i].size());
+                failures++;
+            }
+        }
+    }
+
+    double serialFind = Measure([&] {
+        for (const auto& pattern : patterns) FindSerial(ranges, pattern);
+    }, seconds);
+    double parallelFind = Measure([&] {
+        for (const auto& pattern : patterns) Signature::FindParallel(ranges, pattern);
+    }, seconds);
+    double serialMulti = Measure([&] {
+        for (const auto& [begin, end] : ranges) multi.Scan(begin, end, [](size_t, const uint8_t*) {});
+    }, seconds);
+    double parallelMulti = Measure([&] { Signature::ScanParallel(multi, ranges, [](size_t, const uint8_t*) {}); }, seconds);
+    std::printf("  %zu patterns over %.1f MB of code, %u threads: Find each %.2f ms -> %.2f ms, one pass %.2f ms -> %.2f ms\n", patterns.size(), codeBytes / 1048576.0,
+        Signature::DefaultScanThreads(), serialFind * 1e3, parallelFind * 1e3, serialMulti * 1e3, parallelMulti * 1e3);
+    return failures;
+}
+
+// Where code references rva, the way VTableManager used to look: every offset of every code section, no relocations
+static std::vector<uint32_t> ReferencesBruteForce(const PE::Image& image, uint32_t rva) {
+    std::vector<uint32_t> found;
+    for (const auto& [begin, end] : image.CodeRanges()) {
+        const uint32_t codeRva = image.RvaOf(begin);
+        for (const uint8_t* at = begin; end - at >= 4; at++) {
+            uint32_t value;
+            std::memcpy(&value, at, 4);
+            const uint32_t source = codeRva + static_cast<uint32_t>(at - begin);
+            if (image.Is64Bit() ? source + 4 + value == rva : value == static_cast<uint32_t>(image.ImageBase()) + rva) found.push_back(source);
+        }
+    }
+    return found;
+}
+
+static int CheckStrings(const PE::Image& file, const PE::Image& mapped, uint32_t sampleCount, double seconds, std::mt19937& rng) {
+    int failures = 0;
+    PE::StringIndex fromFile, index;
+    fromFile.Build(file);
+    double build = Measure([&] { index.Build(mapped); }, seconds);
+    if (fromFile.StringCount() != index.StringCount() || fromFile.ReferenceCount() != index.ReferenceCount()) {
+        std::printf("  STRING INDEX MISMATCH: %zu strings / %zu references from the file, %zu / %zu from the mapped copy\n", fromFile.StringCount(), fromFile.ReferenceCount(),
+            index.StringCount(), index.ReferenceCount());
+        failures++;
+    }
+
+    // Strings found without the index: NUL before and after, printable in between
+    std::vector<std::string> strings;
+    for (const auto& [begin, end] : mapped.ReadOnlyDataRanges()) {
+        for (const uint8_t* at = begin; at < end; at++) {
+            if (at != begin && at[-1] != 0) continue;
+            const uint8_t* stop = at;
+            while (stop < end && *stop >= 0x20 && *stop < 0x7F) stop++;
+            if (stop < end && *stop == 0 && stop - at >= static_cast<ptrdiff_t>(PE::StringIndex::MIN_LENGTH)) strings.emplace_back(reinterpret_cast<const char*>(at), stop - at);
+        }
+    }
+    if (strings.empty()) {
+        std::printf("  no strings to look up\n");
+        return failures;
+    }
+
+    std::vector<std::string> sample;
+    for (uint32_t i = 0; i < sampleCount; i++) sample.push_back(strings[rng() % strings.size()]);
+    size_t referenced = 0, extra = 0;
+    for (const auto& text : sample) {
+        std::vector<uint32_t> copies = index.FindAscii(text);
+        if (copies.empty()) {
+            std::printf("  STRING MISSING: \"%s\"\n", text.c_str());
+            failures++;
+            continue;
+        }
+        for (uint32_t rva : copies) {
+            const uint8_t* at = mapped.AtRva(rva, text.size() + 1);
+            if (!at || std::memcmp(at, text.data(), text.size()) || at[text.size()]) {
+                std::printf("  STRING WRONG: \"%s\" at %08X\n", text.c_str(), rva);
+                failures++;
+            }
+            // From relocations every reference is a real one, so it's a subset of what brute force finds, without them it's the same list
+            std::vector<uint32_t> expected = ReferencesBruteForce(mapped, rva);
+            std::span<const uint32_t> got = index.ReferencesTo(rva);
+            bool same = index.FromRelocations() ? std::includes(expected.begin(), expected.end(), got.begin(), got.end()) : std::equal(expected.begin(), expected.end(), got.begin(), got.end());
+            if (!same) {
+                std::printf("  REFERENCE MISMATCH: \"%s\" at %08X, %zu references, brute force %zu\n", text.c_str(), rva, got.size(), expected.size());
+                failures++;
+            }
+            referenced += !got.empty();
+            extra += expected.size() - got.size();
+        }
+    }
+
+    double indexed = Measure([&] {
+        for (const auto& text : sample) index.ReferencesToAscii(text);
+    }, seconds);
+    double bruteForce = Measure([&] {
+        for (const auto& text : sample) {
+            for (uint32_t rva : index.FindAscii(text)) ReferencesBruteForce(mapped, rva);
+        }
+    }, seconds);
+    std::printf("  %zu strings, %zu code references (%s), %zu of %zu sampled strings referenced%s. Build %.2f ms, lookups %.4f ms vs %.2f ms scanning each time\n",
+        index.StringCount(), index.ReferenceCount(), index.FromRelocations() ? "relocations" : "every 4 bytes", referenced, sample.size(),
+        extra ? (", brute force also matched " + std::to_string(extra) + " bytes that only look like one").c_str() : "", build * 1e3, indexed * 1e3, bruteForce * 1e3);
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    uint32_t patternCount = 64;
+    double seconds = 0.5;
+    uint32_t seed = 1;
+    bool list = false;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--patterns") && i + 1 < argc) patternCount = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc) seed = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--list")) list = true;
+        else files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+        std::printf("usage: pe_scan_check <file.exe|file.dll>... [--patterns N] [--seconds N] [--seed N] [--list]\n");
+        return 2;
+    }
+
+    std::mt19937 rng(seed);
+    int failures = 0;
+    for (const char* path : files) {
+        PE::Image file;
+        if (!file.Open(path)) {
+            std::printf("%s: %s\n", path, file.GetError().c_str());
+            failures++;
+            continue;
+        }
+        std::printf("%s: machine %04X%s, timestamp %08X, image %u KB, %zu sections, %zu imports, %zu exports, %zu relocations\n", path, file.Machine(), file.Is64Bit() ? " (PE32+)" : "",
+            file.TimeDateStamp(), file.SizeOfImage() / 1024, file.Sections().size(), file.Imports().size(), file.Exports().size(), file.Relocations().size());
+        for (const auto& section : file.Sections()) {
+            std::printf("  %-8s rva %08X size %08X raw %08X %s%s%s\n", section.name.c_str(), section.rva, section.virtualSize, section.rawSize, section.IsExecutable() ? "x" : "-",
+                section.IsWritable() ? "w" : "-", section.IsDiscardable() ? "d" : "-");
+        }
+        if (list) {
+            for (const auto& entry : file.Imports()) std::printf("  import %s!%s (slot %08X)\n", entry.module.c_str(), entry.name.empty() ? ("#" + std::to_string(entry.ordinal)).c_str() : entry.name.c_str(), entry.slotRva);
+            for (const auto& entry : file.Exports()) std::printf("  export #%u %s rva %08X%s%s\n", entry.ordinal, entry.name.c_str(), entry.rva, entry.forwarder.empty() ? "" : " -> ", entry.forwarder.c_str());
+        }
+
+        std::vector<uint8_t> mappedBytes = MapLikeLoader(file);
+        PE::Image mapped;
+        if (!mapped.Parse(mappedBytes.data(), mappedBytes.size(), PE::Image::Layout::Mapped)) {
+            std::printf("  mapped copy: %s\n", mapped.GetError().c_str());
+            failures++;
+            continue;
+        }
+        failures += CompareParses(file, mapped);
+        failures += CheckScans(mapped, patternCount, seconds, rng);
+        failures += CheckStrings(file, mapped, patternCount, seconds, rng);
+    }
+    std::printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
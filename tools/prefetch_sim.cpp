@@ -0,0 +1,255 @@
+// Replays an I/O trace against a simulated disk, with and without the Package Read-Ahead scheduler, to see what a plan would buy
+// The plan comes from a trace (S3SS\io_trace_*.s3io, built the same way the patch builds it) or a saved S3SS\prefetch_plan.bin,
+// the workload is a second trace (default: the same one, the best case) replayed read by read with its original think times
+// Build (Linux): g++ -O2 -std=c++20 -I.. prefetch_sim.cpp ../io/prefetch.cpp ../io/io_trace.cpp -o prefetch_sim
+// Usage:         prefetch_sim <plan.s3io|prefetch_plan.bin> [workload.s3io] [--seek-ms N] [--mbps N] [--ssd] [--lookahead MB] [--save-plan out.bin]
+#include "io/io_trace.h"
+#include "io/prefetch.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using IOTrace::Record;
+
+struct Disk {
+    double seekMs = 8.0;   // Anything that isn't a continuation of the previous request, spinning disk default
+    double mbPerSec = 120.0;
+};
+
+// One game read in workload order, think is CPU time the game spent since its previous read finished
+struct GameRead {
+    uint32_t path;
+    uint32_t size;
+    uint64_t offset;
+    double thinkMs;
+};
+
+struct Workload {
+    std::vector<std::string> paths;
+    std::vector<GameRead> reads;
+};
+
+struct Result {
+    double blockedMs = 0;
+    double totalMs = 0;
+    uint64_t hits = 0;    // Reads served entirely from cache without waiting
+    uint64_t partial = 0; // Reads that waited on a prefetch already in progress or found part of their blocks cached
+    uint64_t prefetchedBytes = 0;
+    uint64_t wastedBytes = 0; // Prefetched blocks the game never read
+    Prefetch::Scheduler::Stats scheduler;
+};
+
+static constexpr uint32_t BLOCK_SHIFT = Prefetch::Plan::BLOCK_SHIFT;
+
+// Reads in a trace as (path index, offset, size) in call order, with think times between them
+static Workload LoadWorkload(const IOTrace::Trace& trace) {
+    Workload workload;
+    std::unordered_map<std::string, uint32_t> pathIndex;
+    std::unordered_map<uint32_t, uint32_t> idToPath;
+    for (const auto& [id, file] : trace.files) {
+        std::string key = file.path;
+        for (char& c : key) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        auto [it, inserted] = pathIndex.emplace(key, static_cast<uint32_t>(workload.paths.size()));
+        if (inserted) workload.paths.push_back(file.path);
+        idToPath[id] = it->second;
+    }
+
+    std::vector<Record> records = trace.records;
+    std::stable_sort(records.begin(), records.end(), [](const Record& a, const Record& b) { return a.timestamp < b.timestamp; });
+
+    const double frequency = trace.header.qpcFrequency ? static_cast<double>(trace.header.qpcFrequency) : 1.0;
+    uint64_t busyUntil = 0;
+    bool first = true;
+    for (const Record& r : records) {
+        if (r.kind != IOTrace::Kind::Read || (r.flags & IOTrace::RECORD_FAILED)) continue;
+        auto path = idToPath.find(r.fileId);
+        if (path == idToPath.end()) continue;
+        uint32_t size = (r.flags & IOTrace::RECORD_PENDING) ? r.requested : r.transferred;
+        if (!size) continue;
+
+        double think = first || r.timestamp <= busyUntil ? 0.0 : (r.timestamp - busyUntil) * 1000.0 / frequency;
+        workload.reads.push_back({path->second, size, r.offset, think});
+        busyUntil = std::max<uint64_t>(busyUntil, r.timestamp + r.duration);
+        first = false;
+    }
+    return workload;
+}
+
+// Single-queue device in front of a 64 KB block page cache. The game is one serialized reader, prefetch only starts a request
+// while the device would otherwise sit idle before the game's next read but can't be preempted once it has started
+static Result Simulate(const Workload& workload, const Prefetch::Plan* plan, const Prefetch::Scheduler::Config& config, const Disk& disk) {
+    Result result;
+    Prefetch::Scheduler scheduler;
+    if (plan) scheduler.Start(*plan, config);
+
+    // Plan file per workload path
+    std::vector<int> planFile(workload.paths.size(), -1);
+    if (plan) {
+        for (size_t i = 0; i < workload.paths.size(); i++) planFile[i] = plan->FindFile(workload.paths[i]);
+    }
+
+    // Cache keys are per plan file when the path is in the plan (so prefetched and game blocks line up), workload path otherwise
+    auto key = [&](uint32_t path, uint64_t block) {
+        uint64_t file = planFile[path] >= 0 ? static_cast<uint64_t>(planFile[path]) : (uint64_t(1) << 23) + path;
+        return (file << 40) | block;
+    };
+    std::unordered_map<uint64_t, double> cachedAt; // Block -> time it lands in the cache
+    std::unordered_set<uint64_t> prefetched, touched;
+
+    double now = 0, deviceFree = 0;
+    uint64_t deviceFile = UINT64_MAX, deviceNext = 0;
+    auto service = [&](uint64_t file, uint64_t offset, uint64_t bytes) {
+        double ms = bytes * 1000.0 / (disk.mbPerSec * 1048576.0);
+        if (file != deviceFile || offset != deviceNext) ms += disk.seekMs;
+        deviceFile = file;
+        deviceNext = offset + bytes;
+        return ms;
+    };
+
+    for (const GameRead& read : workload.reads) {
+        now += read.thinkMs;
+
+        // Idle device time before this read, hand it to the prefetcher
+        Prefetch::Scheduler::Request request;
+        while (plan && deviceFree < now && scheduler.Next(request)) {
+            uint64_t firstBlock = request.offset >> BLOCK_SHIFT, lastBlock = (request.offset + request.size - 1) >> BLOCK_SHIFT;
+            uint64_t fileKey = (static_cast<uint64_t>(request.file) << 40);
+            uint64_t uncached = 0;
+            for (uint64_t b = firstBlock; b <= lastBlock; b++) uncached += !cachedAt.count(fileKey | b);
+            if (uncached) {
+                deviceFree += service(request.file, request.offset, request.size);
+                for (uint64_t b = firstBlock; b <= lastBlock; b++) {
+                    if (cachedAt.emplace(fileKey | b, deviceFree).second) prefetched.insert(fileKey | b);
+                }
+                result.prefetchedBytes += request.size;
+            }
+            scheduler.Complete(request);
+        }
+        deviceFree = std::max(deviceFree, now);
+
+        // The game's read: blocks already cached (or on their way) cost nothing but the wait, the rest go to the device as one span
+        uint64_t firstBlock = read.offset >> BLOCK_SHIFT, lastBlock = (read.offset + read.size - 1) >> BLOCK_SHIFT;
+        double ready = now;
+        uint64_t missFirst = UINT64_MAX, missLast = 0, cached = 0;
+        for (uint64_t b = firstBlock; b <= lastBlock; b++) {
+            uint64_t k = key(read.path, b);
+            touched.insert(k);
+            auto it = cachedAt.find(k);
+            if (it != cachedAt.end()) {
+                ready = std::max(ready, it->second);
+                cached++;
+            } else {
+                missFirst = std::min(missFirst, b);
+                missLast = b;
+            }
+        }
+        if (missFirst != UINT64_MAX) {
+            uint64_t file = key(read.path, 0) >> 40;
+            deviceFree += service(file, missFirst << BLOCK_SHIFT, (missLast - missFirst + 1) << BLOCK_SHIFT);
+            for (uint64_t b = missFirst; b <= missLast; b++) cachedAt.emplace(key(read.path, b), deviceFree);
+            ready = std::max(ready, deviceFree);
+        }
+
+        if (missFirst == UINT64_MAX && ready <= now) result.hits++;
+        else if (cached) result.partial++;
+        result.blockedMs += ready - now;
+        now = ready;
+
+        if (plan && planFile[read.path] >= 0) scheduler.OnGameRead(static_cast<uint32_t>(planFile[read.path]), read.offset, read.size);
+    }
+
+    result.totalMs = now;
+    for (uint64_t k : prefetched) {
+        if (!touched.count(k)) result.wastedBytes += uint64_t(1) << BLOCK_SHIFT;
+    }
+    result.scheduler = scheduler.GetStats();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    std::vector<const char*> inputs;
+    Disk disk;
+    Prefetch::Scheduler::Config config;
+    const char* savePlan = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--seek-ms") == 0 && i + 1 < argc) {
+            disk.seekMs = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--mbps") == 0 && i + 1 < argc) {
+            disk.mbPerSec = std::max(1.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--ssd") == 0) {
+            disk.seekMs = 0.1;
+            disk.mbPerSec = 500.0;
+        } else if (std::strcmp(argv[i], "--lookahead") == 0 && i + 1 < argc) {
+            config.lookaheadBytes = static_cast<uint64_t>(std::max(1, std::atoi(argv[++i]))) << 20;
+        } else if (std::strcmp(argv[i], "--save-plan") == 0 && i + 1 < argc) {
+            savePlan = argv[++i];
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty() || inputs.size() > 2) {
+        std::printf("usage: prefetch_sim <plan.s3io|prefetch_plan.bin> [workload.s3io] [--seek-ms N] [--mbps N] [--ssd] [--lookahead MB] [--save-plan out.bin]\n");
+        return 2;
+    }
+
+    Prefetch::Plan plan;
+    IOTrace::Trace planTrace;
+    std::string error;
+    bool planFromTrace = false;
+    if (!plan.Load(inputs[0])) {
+        if (!IOTrace::ReadTrace(inputs[0], planTrace, error)) {
+            std::printf("%s: not a prefetch plan, and as a trace: %s\n", inputs[0], error.c_str());
+            return 1;
+        }
+        Workload recorded = LoadWorkload(planTrace);
+        std::vector<Prefetch::ObservedRead> reads;
+        reads.reserve(recorded.reads.size());
+        for (const GameRead& read : recorded.reads) reads.push_back({read.path, read.size, read.offset});
+        plan = Prefetch::Plan::Build(recorded.paths, reads);
+        planFromTrace = true;
+    }
+    std::printf("plan: %zu files, %zu ranges, %.1f MB\n", plan.Files().size(), plan.Ranges().size(), plan.TotalBytes() / 1048576.0);
+    if (savePlan) std::printf("plan %s %s\n", plan.Save(savePlan) ? "saved to" : "could not be saved to", savePlan);
+
+    IOTrace::Trace workloadTrace;
+    const IOTrace::Trace* trace = &planTrace;
+    if (inputs.size() == 2 || !planFromTrace) {
+        if (inputs.size() < 2) {
+            std::printf("a saved plan needs a workload trace to replay\n");
+            return 2;
+        }
+        if (!IOTrace::ReadTrace(inputs[1], workloadTrace, error)) {
+            std::printf("%s: %s\n", inputs[1], error.c_str());
+            return 1;
+        }
+        trace = &workloadTrace;
+    }
+    Workload workload = LoadWorkload(*trace);
+    uint64_t workloadBytes = 0;
+    for (const GameRead& read : workload.reads) workloadBytes += read.size;
+    std::printf("workload: %zu reads, %.1f MB, disk: %.2f ms seek, %.0f MB/s, lookahead %llu MB\n\n", workload.reads.size(), workloadBytes / 1048576.0, disk.seekMs, disk.mbPerSec,
+        static_cast<unsigned long long>(config.lookaheadBytes >> 20));
+
+    Result cold = Simulate(workload, nullptr, config, disk);
+    Result warm = Simulate(workload, &plan, config, disk);
+
+    std::printf("%-12s %12s %12s %10s %10s %14s %12s\n", "", "blocked ms", "total ms", "hits", "partial", "prefetched MB", "wasted MB");
+    for (const auto& [name, r] : {std::pair<const char*, const Result&>{"no prefetch", cold}, {"prefetch", warm}}) {
+        std::printf("%-12s %12.1f %12.1f %10llu %10llu %14.1f %12.1f\n", name, r.blockedMs, r.totalMs, static_cast<unsigned long long>(r.hits), static_cast<unsigned long long>(r.partial),
+            r.prefetchedBytes / 1048576.0, r.wastedBytes / 1048576.0);
+    }
+
+    const auto& s = warm.scheduler;
+    std::printf("\nscheduler: game reached range %u of %u, %llu ranges skipped (game got there first), %llu/%llu plan reads already prefetched, %llu in flight, %llu reads off-plan\n", s.position,
+        s.rangeCount, static_cast<unsigned long long>(s.skippedRanges), static_cast<unsigned long long>(s.gameHits), static_cast<unsigned long long>(s.gameReads),
+        static_cast<unsigned long long>(s.gameInFlight), static_cast<unsigned long long>(s.gameOffPlan));
+    if (s.abandoned) std::printf("prefetching was abandoned, most reads on plan files weren't in the plan\n");
+    if (cold.blockedMs > 0) std::printf("blocked time saved: %.1f ms (%.1f%%)\n", cold.blockedMs - warm.blockedMs, 100.0 * (cold.blockedMs - warm.blockedMs) / cold.blockedMs);
+    return 0;
+}
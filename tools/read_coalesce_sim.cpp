@@ -0,0 +1,232 @@
+// Runs ReadCoalescing::HandleCache against fake in-memory files: the synchronous reads from an I/O trace, or a random synthetic
+// workload with writes mixed in. Every byte handed back is checked against the fake file, and the ReadFile calls saved are counted
+// Build (Linux): g++ -O2 -std=c++20 -I.. read_coalesce_sim.cpp ../io/read_coalescer.cpp ../io/io_trace.cpp -o read_coalesce_sim
+// Usage:         read_coalesce_sim <trace.s3io> | --synthetic [seed]   [--block KB] [--max-read KB] [--blocks N] [--budget MB]
+#include "io/io_trace.h"
+#include "io/read_coalescer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using ReadCoalescing::Result;
+
+// File contents generated from (seed, offset) so traces with multi-GB packages don't need the memory, writes are kept as overlays
+class FakeFile : public ReadCoalescing::Backend {
+  public:
+    FakeFile(uint32_t seed, uint64_t size) : seed(seed), size(size), baseSize(size) {}
+
+    // What the real ReadFile would return
+    uint32_t Read(uint64_t offset, uint8_t* buffer, uint32_t length) const {
+        uint32_t n = offset < size ? static_cast<uint32_t>(std::min<uint64_t>(length, size - offset)) : 0;
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t x = ((offset + i) ^ (static_cast<uint64_t>(seed) << 40)) * 0x9E3779B97F4A7C15ull;
+            buffer[i] = static_cast<uint8_t>(x >> 56);
+        }
+        // Later writes land on top of earlier ones, and anything past the original size that no write covered reads as zero
+        if (offset + n > baseSize) memset(buffer + (offset < baseSize ? baseSize - offset : 0), 0, offset + n - std::max(offset, baseSize));
+        for (const Overlay& write : writes) {
+            uint64_t begin = std::max(offset, write.offset), end = std::min(offset + n, write.offset + write.data.size());
+            if (begin < end) memcpy(buffer + (begin - offset), write.data.data() + (begin - write.offset), end - begin);
+        }
+        return n;
+    }
+
+    bool ReadAt(uint64_t offset, void* buffer, uint32_t length, uint32_t& transferred) override {
+        fills++;
+        fetched += length;
+        transferred = Read(offset, static_cast<uint8_t*>(buffer), length);
+        return true;
+    }
+
+    void Write(uint64_t offset, const std::vector<uint8_t>& data) {
+        writes.push_back({offset, data});
+        size = std::max<uint64_t>(size, offset + data.size());
+    }
+
+    uint64_t Size() const { return size; }
+
+    uint64_t fills = 0;
+    uint64_t fetched = 0;
+
+  private:
+    struct Overlay {
+        uint64_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    uint32_t seed;
+    uint64_t size;
+    uint64_t baseSize;
+    std::vector<Overlay> writes;
+};
+
+struct Totals {
+    uint64_t reads = 0;
+    uint64_t served = 0;
+    uint64_t filled = 0;
+    uint64_t passed = 0;
+    uint64_t bytesRead = 0;
+    uint64_t fills = 0;
+    uint64_t fetched = 0;
+    uint64_t writes = 0;
+    uint64_t mismatches = 0;
+    uint64_t peakMemory = 0;
+};
+
+struct Handle {
+    std::unique_ptr<FakeFile> file;
+    std::unique_ptr<ReadCoalescing::HandleCache> cache;
+};
+
+// One game read through the cache, checked against what the fake file says the real call would have returned
+static void DoRead(Handle& handle, uint64_t offset, uint32_t size, Totals& totals, ReadCoalescing::MemoryBudget& budget, std::vector<uint8_t>& buffer, std::vector<uint8_t>& expected) {
+    buffer.resize(size);
+    expected.resize(size);
+    uint32_t want = handle.file->Read(offset, expected.data(), size);
+
+    uint32_t transferred = 0;
+    Result result = handle.cache->Read(*handle.file, offset, buffer.data(), size, transferred);
+    totals.reads++;
+    totals.bytesRead += want;
+    if (result == Result::PassThrough) {
+        totals.passed++;
+        return;
+    }
+    (result == Result::Served ? totals.served : totals.filled)++;
+    if (transferred != want || memcmp(buffer.data(), expected.data(), want) != 0) {
+        if (totals.mismatches++ < 10) std::printf("MISMATCH at offset %llu size %u: got %u bytes, expected %u\n", static_cast<unsigned long long>(offset), size, transferred, want);
+    }
+    totals.peakMemory = std::max(totals.peakMemory, budget.InUse());
+}
+
+static void Finish(std::unordered_map<uint32_t, Handle>& handles, Totals& totals) {
+    for (auto& [id, handle] : handles) {
+        totals.fills += handle.file->fills;
+        totals.fetched += handle.file->fetched;
+    }
+}
+
+static bool RunTrace(const char* path, const ReadCoalescing::Config& config, ReadCoalescing::MemoryBudget& budget, Totals& totals) {
+    IOTrace::Trace trace;
+    std::string error;
+    if (!IOTrace::ReadTrace(path, trace, error)) {
+        std::printf("%s: %s\n", path, error.c_str());
+        return false;
+    }
+    std::stable_sort(trace.records.begin(), trace.records.end(), [](const IOTrace::Record& a, const IOTrace::Record& b) { return a.timestamp < b.timestamp; });
+
+    std::unordered_map<uint32_t, Handle> handles;
+    std::vector<uint8_t> buffer, expected;
+    for (const IOTrace::Record& r : trace.records) {
+        if (r.kind == IOTrace::Kind::Close) {
+            handles.erase(r.fileId);
+            continue;
+        }
+        // The game only gets coalescing on plain synchronous reads
+        if (r.kind != IOTrace::Kind::Read || (r.flags & (IOTrace::RECORD_FAILED | IOTrace::RECORD_OVERLAPPED))) continue;
+
+        Handle& handle = handles[r.fileId];
+        if (!handle.file) {
+            auto known = trace.files.find(r.fileId);
+            uint64_t size = known != trace.files.end() && known->second.size ? known->second.size : r.offset + r.requested;
+            handle.file = std::make_unique<FakeFile>(r.fileId, size);
+            handle.cache = std::make_unique<ReadCoalescing::HandleCache>(config, &budget);
+        }
+        DoRead(handle, r.offset, r.requested, totals, budget, buffer, expected);
+    }
+    Finish(handles, totals);
+    return true;
+}
+
+// DBPF-ish access: a handful of files, runs of small adjacent reads at random places, the odd big read, seek backwards, write and read near EOF
+static void RunSynthetic(uint32_t seed, const ReadCoalescing::Config& config, ReadCoalescing::MemoryBudget& budget, Totals& totals) {
+    std::mt19937 rng(seed);
+    std::unordered_map<uint32_t, Handle> handles;
+    for (uint32_t id = 1; id <= 8; id++) {
+        Handle& handle = handles[id];
+        handle.file = std::make_unique<FakeFile>(id, 4096 + rng() % (4 << 20));
+        handle.cache = std::make_unique<ReadCoalescing::HandleCache>(config, &budget);
+    }
+
+    std::vector<uint8_t> buffer, expected;
+    for (int op = 0; op < 200000; op++) {
+        uint32_t id = 1 + rng() % 8;
+        Handle& handle = handles[id];
+        uint64_t size = handle.file->Size();
+        uint32_t kind = rng() % 100;
+
+        if (kind < 2) {
+            // A write through another handle on the same file, sometimes past the end
+            uint64_t offset = rng() % (size + 8192);
+            std::vector<uint8_t> data(1 + rng() % 9000);
+            for (auto& b : data) b = static_cast<uint8_t>(rng());
+            handle.file->Write(offset, data);
+            handle.cache->Invalidate(offset, data.size());
+            totals.writes++;
+        } else if (kind < 5) {
+            DoRead(handle, rng() % size, 16384 + rng() % 200000, totals, budget, buffer, expected);
+        } else {
+            // A run of small adjacent reads, some ending at or running off the end of the file
+            uint64_t offset = kind < 10 ? (size > 20000 ? size - rng() % 20000 : 0) : rng() % size;
+            int run = 1 + rng() % 12;
+            for (int i = 0; i < run; i++) {
+                uint32_t length = 1 + rng() % 6000;
+                DoRead(handle, offset, length, totals, budget, buffer, expected);
+                offset += length + (rng() % 4 == 0 ? rng() % 3000 : 0);
+            }
+        }
+    }
+    Finish(handles, totals);
+}
+
+int main(int argc, char** argv) {
+    ReadCoalescing::Config config;
+    uint64_t budgetMB = 16;
+    const char* tracePath = nullptr;
+    bool synthetic = false;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--synthetic") == 0) {
+            synthetic = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') seed = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+            config.blockSize = static_cast<uint32_t>(std::max(8, std::atoi(argv[++i]))) << 10;
+        } else if (std::strcmp(argv[i], "--max-read") == 0 && i + 1 < argc) {
+            config.maxReadSize = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i]))) << 10;
+        } else if (std::strcmp(argv[i], "--blocks") == 0 && i + 1 < argc) {
+            config.maxBlocks = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            budgetMB = static_cast<uint64_t>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            tracePath = argv[i];
+        }
+    }
+    if (!synthetic && !tracePath) {
+        std::printf("usage: read_coalesce_sim <trace.s3io> | --synthetic [seed]   [--block KB] [--max-read KB] [--blocks N] [--budget MB]\n");
+        return 2;
+    }
+
+    ReadCoalescing::MemoryBudget budget(budgetMB << 20);
+    Totals totals;
+    if (synthetic) {
+        RunSynthetic(seed, config, budget, totals);
+    } else if (!RunTrace(tracePath, config, budget, totals)) {
+        return 1;
+    }
+
+    uint64_t syscalls = totals.passed + totals.fills;
+    std::printf("block %u KB, reads up to %u KB, %u blocks per handle, budget %llu MB\n", config.blockSize >> 10, config.maxReadSize >> 10, config.maxBlocks, static_cast<unsigned long long>(budgetMB));
+    std::printf("reads: %llu  served from a block: %llu  filled a block: %llu  passed through: %llu\n", static_cast<unsigned long long>(totals.reads), static_cast<unsigned long long>(totals.served),
+        static_cast<unsigned long long>(totals.filled), static_cast<unsigned long long>(totals.passed));
+    std::printf("ReadFile calls: %llu -> %llu (%.1f%% saved)\n", static_cast<unsigned long long>(totals.reads), static_cast<unsigned long long>(syscalls),
+        totals.reads ? 100.0 * (static_cast<double>(totals.reads) - syscalls) / totals.reads : 0.0);
+    std::printf("bytes fetched by fills: %.1f MB for %.1f MB the game read, peak block memory %.1f MB\n", totals.fetched / 1048576.0, totals.bytesRead / 1048576.0, totals.peakMemory / 1048576.0);
+    if (totals.writes) std::printf("writes (invalidations): %llu\n", static_cast<unsigned long long>(totals.writes));
+    std::printf("%s\n", totals.mismatches ? "FAILED: data mismatches" : "all served data matched the file");
+    return totals.mismatches ? 1 : 0;
+}
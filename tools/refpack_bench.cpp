@@ -0,0 +1,370 @@
+// RefPack decode benchmark, runs off the game so decoder changes can be measured instead of guessed
+// Build (Linux): g++ -O2 -std=c++20 -mavx2 -I.. refpack_bench.cpp ../refpack/refpack_encoder.cpp ../refpack/refpack_stream.cpp ../refpack/refpack_cache.cpp
+//                    ../refpack/refpack_disk_cache.cpp ../mapped_file.cpp -o refpack_bench
+// Usage:         refpack_bench [corpus dir]... [--seconds N] [--fuzz N]
+// --fuzz N mutates every corpus stream N times and checks StreamDecoder against DecompressImpl on each, at random chunk sizes
+// Every item also goes through a DiskCache file to compare a disk cache hit against decoding it. The file was just written so its pages
+// are in the OS cache, this is the warm case; the patch's telemetry (cycles per byte by source) has what the game actually sees
+// Corpus dirs hold raw RefPack streams, e.g. the ones RefPackDecompressorPatch dumps with captureCorpus enabled
+#include "refpack/refpack_decoder.h"
+#include "refpack/refpack_disk_cache.h"
+#include "refpack/refpack_encoder.h"
+#include "refpack/refpack_stream.h"
+#include "fast_hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static bool CpuHasAVX2() {
+#ifdef _MSC_VER
+    int leaves[4] = {0};
+    __cpuidex(leaves, 7, 0);
+    return (leaves[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+struct CorpusItem {
+    std::string name;
+    bool captured = false;
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> original; // Empty for captured items, those are verified by decoding cleanly instead
+    uint32_t decompressedSize = 0;
+    RefPack::CommandStats stats;
+    double decodeCyclesPerByte = 0.0; // Best strategy, what a disk cache hit has to beat
+};
+
+struct Timing {
+    double bytesPerSecond = 0.0;
+    double cyclesPerByte = 0.0;
+};
+
+// Synthetic inputs roughly shaped like what the game streams in
+static std::vector<uint8_t> Generate(const std::string& kind, uint32_t size, std::mt19937& rng) {
+    std::vector<uint8_t> data(size);
+    if (kind == "random") {
+        for (auto& b : data) b = static_cast<uint8_t>(rng());
+    } else if (kind == "text") {
+        static const char* words[] = {"Sim", "lot", "household", "career", "moodlet", "interaction", "the", "and", "Object", "Buy", "Build", "CAS", "<xml>", "</xml>", " ", "\n"};
+        for (uint32_t i = 0; i < size;) {
+            const char* w = words[rng() % std::size(words)];
+            for (; *w && i < size; ++w) data[i++] = static_cast<uint8_t>(*w);
+        }
+    } else if (kind == "texture") {
+        // DXT-ish, short-period block repeats with occasional fresh blocks -> lots of offsets under 16
+        for (uint32_t i = 0; i < size; i += 8) {
+            uint32_t period = 1 + rng() % 15;
+            bool fresh = i < 16 || (rng() % 4) == 0;
+            for (uint32_t j = 0; j < 8 && i + j < size; j++) data[i + j] = fresh ? static_cast<uint8_t>(rng()) : data[i + j - std::min<uint32_t>(period, i + j)];
+        }
+    } else if (kind == "mesh") {
+        // Interleaved float vertices with smooth positions and repeated normals/uvs
+        float x = 0.0f;
+        for (uint32_t i = 0; i + 32 <= size; i += 32) {
+            float v[8] = {x, x * 0.5f, 1.0f, 0.0f, 1.0f, 0.0f, static_cast<float>(i & 0xFF) / 255.0f, 0.5f};
+            std::memcpy(&data[i], v, sizeof(v));
+            x += 0.125f * static_cast<float>(rng() % 3);
+        }
+    } else { // "longrange", 32 byte runs copied from far back in the window so long backrefs show up
+        for (uint32_t i = 0; i < size; i += 32) {
+            uint32_t distance = 16384 + rng() % 98304;
+            bool repeat = i >= distance && (rng() % 8) != 0;
+            for (uint32_t j = i; j < i + 32 && j < size; j++) data[j] = repeat ? data[j - distance] : static_cast<uint8_t>(rng());
+        }
+    }
+    return data;
+}
+
+static void BuildSynthetic(std::vector<CorpusItem>& corpus) {
+    std::mt19937 rng(0x53335353);
+    const struct {
+        const char* kind;
+        uint32_t size;
+    } specs[] = {{"random", 1 << 20}, {"text", 1 << 20}, {"texture", 4 << 20}, {"mesh", 2 << 20}, {"longrange", 4 << 20}, {"texture", 64 << 10}, {"text", 16 << 10}};
+
+    for (const auto& spec : specs) {
+        CorpusItem item;
+        item.name = std::string("synthetic/") + spec.kind + "-" + std::to_string(spec.size >> 10) + "k";
+        item.original = Generate(spec.kind, spec.size, rng);
+        RefPack::Compress(item.original.data(), spec.size, item.compressed, RefPack::CompressionLevel::Normal);
+        item.decompressedSize = spec.size;
+        corpus.push_back(std::move(item));
+    }
+}
+
+static void LoadCaptured(const fs::path& dir, std::vector<CorpusItem>& corpus) {
+    std::error_code ec;
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file()) files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        CorpusItem item;
+        item.name = "captured/" + file.filename().string();
+        item.captured = true;
+        item.compressed.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        item.decompressedSize = RefPack::ReadDecompressedSize(item.compressed.data(), static_cast<uint32_t>(item.compressed.size()));
+        if (item.decompressedSize == 0) {
+            std::printf("skipping %s: not a RefPack stream\n", item.name.c_str());
+            continue;
+        }
+        corpus.push_back(std::move(item));
+    }
+}
+
+template <typename Strategy> static bool Verify(CorpusItem& item, std::vector<uint8_t>& out) {
+    int result = RefPack::DecompressImpl<Strategy>(out.data(), item.decompressedSize, item.compressed.data(), static_cast<uint32_t>(item.compressed.size()));
+    if (result != static_cast<int>(item.decompressedSize)) return false;
+    return item.original.empty() || std::memcmp(out.data(), item.original.data(), item.decompressedSize) == 0;
+}
+
+template <typename Strategy> static Timing Measure(CorpusItem& item, std::vector<uint8_t>& out, double seconds) {
+    using Clock = std::chrono::steady_clock;
+    uint64_t bytes = 0;
+    uint64_t cycles = 0;
+    auto start = Clock::now();
+    do {
+        uint64_t tsc = __rdtsc();
+        RefPack::DecompressImpl<Strategy>(out.data(), item.decompressedSize, item.compressed.data(), static_cast<uint32_t>(item.compressed.size()));
+        cycles += __rdtsc() - tsc;
+        bytes += item.decompressedSize;
+    } while (std::chrono::duration<double>(Clock::now() - start).count() < seconds);
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    return {bytes / elapsed, static_cast<double>(cycles) / static_cast<double>(bytes)};
+}
+
+// Feeds the stream in chunks of chunkSize (0 = random 1-64 KB chunks), returns the decoder's result
+static int DecodeStreaming(const std::vector<uint8_t>& stream, uint8_t* out, uint32_t outSize, size_t chunkSize, std::mt19937& rng, uint32_t* produced = nullptr) {
+    RefPack::StreamDecoder decoder;
+    decoder.Begin(out, outSize);
+    for (size_t pos = 0; pos < stream.size();) {
+        size_t chunk = std::min(chunkSize ? chunkSize : 1 + rng() % 65536, stream.size() - pos);
+        if (decoder.Feed(stream.data() + pos, chunk) != RefPack::StreamDecoder::Status::NeedInput) break;
+        pos += chunk;
+    }
+    if (produced) *produced = decoder.Produced();
+    return decoder.Result();
+}
+
+// Streaming has to match the one-shot decoder byte for byte at any chunking
+static bool VerifyStreaming(const CorpusItem& item, const std::vector<uint8_t>& reference, std::mt19937& rng) {
+    std::vector<uint8_t> out(item.decompressedSize);
+    for (size_t chunkSize : {size_t(1), size_t(3), size_t(7), size_t(4096), size_t(0), item.compressed.size()}) {
+        // Byte-at-a-time on big items takes a while and proves nothing extra
+        if (chunkSize < 8 && item.compressed.size() > (256 << 10)) continue;
+        std::fill(out.begin(), out.end(), 0);
+        int result = DecodeStreaming(item.compressed, out.data(), item.decompressedSize, chunkSize, rng);
+        if (result != static_cast<int>(item.decompressedSize) || out != reference) return false;
+    }
+    return true;
+}
+
+static double MeasureStreaming(const CorpusItem& item, std::vector<uint8_t>& out, size_t chunkSize, double seconds) {
+    using Clock = std::chrono::steady_clock;
+    std::mt19937 rng(1);
+    uint64_t bytes = 0;
+    auto start = Clock::now();
+    do {
+        DecodeStreaming(item.compressed, out.data(), item.decompressedSize, chunkSize, rng);
+        bytes += item.decompressedSize;
+    } while (std::chrono::duration<double>(Clock::now() - start).count() < seconds);
+    return bytes / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static RefPack::CacheKey KeyOf(const CorpusItem& item) {
+    return {FastHash::Hash32(item.compressed.data(), item.compressed.size()), static_cast<uint32_t>(item.compressed.size()), item.decompressedSize};
+}
+
+// Cycles per byte of DiskCache::Lookup for the item, 0 if it missed or came back different from the decode
+static double MeasureDiskHit(RefPack::DiskCache& cache, const CorpusItem& item, const std::vector<uint8_t>& reference, double seconds) {
+    using Clock = std::chrono::steady_clock;
+    const RefPack::CacheKey key = KeyOf(item);
+    std::vector<uint8_t> out(item.decompressedSize);
+    if (!cache.Lookup(key, out.data(), item.decompressedSize) || out != reference) return 0.0;
+
+    uint64_t bytes = 0;
+    uint64_t cycles = 0;
+    auto start = Clock::now();
+    do {
+        uint64_t tsc = __rdtsc();
+        cache.Lookup(key, out.data(), item.decompressedSize);
+        cycles += __rdtsc() - tsc;
+        bytes += item.decompressedSize;
+    } while (std::chrono::duration<double>(Clock::now() - start).count() < seconds);
+    return static_cast<double>(cycles) / static_cast<double>(bytes);
+}
+
+// Random corruption of every stream, both decoders must agree on the result and on every byte the stream decoder reports as produced
+static bool Fuzz(const std::vector<CorpusItem>& corpus, uint32_t iterations) {
+    std::mt19937 rng(0xF022);
+    uint64_t runs = 0, mismatches = 0, accepted = 0;
+    for (const auto& item : corpus) {
+        if (item.compressed.size() > (1 << 20)) continue; // Keep it quick, the small items cover every command type
+        std::vector<uint8_t> oneShot(item.decompressedSize + 64), streamed(item.decompressedSize + 64);
+        for (uint32_t i = 0; i < iterations; i++) {
+            std::vector<uint8_t> mutated = item.compressed;
+            uint32_t edits = 1 + rng() % 4;
+            for (uint32_t e = 0; e < edits; e++) {
+                switch (rng() % 3) {
+                case 0: mutated[rng() % mutated.size()] = static_cast<uint8_t>(rng()); break;
+                case 1: mutated.resize(rng() % (mutated.size() + 1)); break;
+                default: mutated.insert(mutated.begin() + rng() % (mutated.size() + 1), static_cast<uint8_t>(rng())); break;
+                }
+                if (mutated.empty()) mutated.push_back(0);
+            }
+
+            uint32_t outSize = static_cast<uint32_t>(oneShot.size());
+            int a = RefPack::DecompressImpl<RefPack::StrategySSE2>(oneShot.data(), outSize, mutated.data(), static_cast<uint32_t>(mutated.size()));
+            uint32_t produced = 0;
+            int b = DecodeStreaming(mutated, streamed.data(), outSize, 0, rng, &produced);
+            // Only the streamed prefix is comparable, the one-shot fast loop may spill past what a bad stream finally produced
+            bool same = a == b && (a <= 0 || std::memcmp(oneShot.data(), streamed.data(), std::min<uint32_t>(produced, static_cast<uint32_t>(a))) == 0);
+            mismatches += !same;
+            accepted += a > 0;
+            runs++;
+        }
+    }
+    std::printf("fuzz: %llu runs, %llu decoded without error, %llu mismatches\n", static_cast<unsigned long long>(runs), static_cast<unsigned long long>(accepted), static_cast<unsigned long long>(mismatches));
+    return mismatches == 0;
+}
+
+static void PrintHistogram(const char* label, const RefPack::CommandStats& s) {
+    uint64_t commands = s.shortBackrefs + s.mediumBackrefs + s.longBackrefs + s.literalRuns;
+    if (commands == 0) return;
+    auto pct = [&](uint64_t n) { return 100.0 * static_cast<double>(n) / static_cast<double>(commands); };
+    uint64_t produced = s.literalBytes + s.matchBytes;
+    std::printf("%-10s commands %10llu | short %5.1f%%  medium %5.1f%%  long %5.1f%%  literal run %5.1f%% | bytes from backrefs %5.1f%%\n", label, static_cast<unsigned long long>(commands), pct(s.shortBackrefs),
+        pct(s.mediumBackrefs), pct(s.longBackrefs), pct(s.literalRuns), produced ? 100.0 * static_cast<double>(s.matchBytes) / static_cast<double>(produced) : 0.0);
+}
+
+int main(int argc, char** argv) {
+    double seconds = 0.25;
+    uint32_t fuzzIterations = 0;
+    std::vector<CorpusItem> corpus;
+    BuildSynthetic(corpus);
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+            fuzzIterations = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else {
+            LoadCaptured(argv[i], corpus);
+        }
+    }
+
+    const bool hasAVX2 = CpuHasAVX2();
+    std::printf("%-34s %9s %9s %6s | %9s %7s | %9s %7s | %11s\n", "item", "in KB", "out KB", "ratio", "SSE2 GB/s", "cyc/B", "AVX2 GB/s", "cyc/B", "stream GB/s");
+    std::mt19937 streamRng(7);
+
+    RefPack::CommandStats syntheticStats, capturedStats;
+    double totalBytes[2] = {}, totalSeconds[2][2] = {};
+    uint64_t totalIn[2] = {}, totalOut[2] = {};
+    bool failed = false;
+    std::vector<RefPack::CachedResource> decoded; // Everything that verified, written to a disk cache afterwards
+
+    for (auto& item : corpus) {
+        std::vector<uint8_t> out(item.decompressedSize);
+        if (!Verify<RefPack::StrategySSE2>(item, out) || (hasAVX2 && !Verify<RefPack::StrategyAVX2>(item, out))) {
+            std::printf("%-34s FAILED to decode/verify\n", item.name.c_str());
+            failed = true;
+            continue;
+        }
+        if (!VerifyStreaming(item, out, streamRng)) {
+            std::printf("%-34s FAILED streaming decode, output differs from one-shot\n", item.name.c_str());
+            failed = true;
+            continue;
+        }
+        RefPack::AnalyzeStream(item.compressed.data(), static_cast<uint32_t>(item.compressed.size()), item.stats);
+        (item.captured ? capturedStats : syntheticStats) += item.stats;
+
+        Timing sse2 = Measure<RefPack::StrategySSE2>(item, out, seconds);
+        Timing avx2 = hasAVX2 ? Measure<RefPack::StrategyAVX2>(item, out, seconds) : Timing{};
+        item.decodeCyclesPerByte = hasAVX2 ? std::min(sse2.cyclesPerByte, avx2.cyclesPerByte) : sse2.cyclesPerByte;
+        decoded.push_back({KeyOf(item), 2, std::make_shared<const std::vector<uint8_t>>(out)});
+        double streamed = MeasureStreaming(item, out, 64 << 10, seconds); // 64 KB, a typical read size
+
+        int group = item.captured ? 1 : 0;
+        totalBytes[group] += item.decompressedSize;
+        totalSeconds[group][0] += item.decompressedSize / sse2.bytesPerSecond;
+        if (hasAVX2) totalSeconds[group][1] += item.decompressedSize / avx2.bytesPerSecond;
+        totalIn[group] += item.compressed.size();
+        totalOut[group] += item.decompressedSize;
+
+        std::printf("%-34s %9.1f %9.1f %6.3f | %9.3f %7.3f | %9.3f %7.3f | %11.3f\n", item.name.c_str(), item.compressed.size() / 1024.0, item.decompressedSize / 1024.0,
+            static_cast<double>(item.compressed.size()) / item.decompressedSize, sse2.bytesPerSecond / 1e9, sse2.cyclesPerByte, avx2.bytesPerSecond / 1e9, avx2.cyclesPerByte, streamed / 1e9);
+    }
+
+    // Aggregate throughput weights every item by its size, i.e. "how fast would a load of exactly this corpus go"
+    std::printf("\n");
+    const char* groupNames[2] = {"synthetic", "captured"};
+    for (int group = 0; group < 2; group++) {
+        if (totalBytes[group] == 0) continue;
+        std::printf("%-10s %8.1f MB -> %8.1f MB | SSE2 %7.3f GB/s", groupNames[group], totalIn[group] / 1048576.0, totalOut[group] / 1048576.0, totalBytes[group] / totalSeconds[group][0] / 1e9);
+        if (hasAVX2) std::printf(" | AVX2 %7.3f GB/s", totalBytes[group] / totalSeconds[group][1] / 1e9);
+        std::printf("\n");
+    }
+
+    // Same items through the disk cache, a hit is worth having only where it comes in under the decode
+    const fs::path cachePath = fs::temp_directory_path() / "refpack_bench_cache.bin";
+    std::error_code ec;
+    fs::remove(cachePath, ec);
+    RefPack::DiskCache diskCache;
+    diskCache.Open(cachePath); // No file yet, this just sets where Rewrite puts it
+    if (diskCache.Rewrite(decoded, SIZE_MAX)) {
+        std::printf("\n%-34s %12s %12s %8s\n", "item", "decode cyc/B", "disk cyc/B", "speedup");
+        double decodeCycles[2] = {}, diskCycles[2] = {};
+        for (size_t i = 0, next = 0; i < corpus.size() && next < decoded.size(); i++) {
+            const CorpusItem& item = corpus[i];
+            if (!(decoded[next].key == KeyOf(item))) continue; // Failed to verify, never made it into decoded
+            double disk = MeasureDiskHit(diskCache, item, *decoded[next++].data, seconds);
+            if (disk == 0.0) {
+                std::printf("%-34s FAILED disk cache lookup\n", item.name.c_str());
+                failed = true;
+                continue;
+            }
+            int group = item.captured ? 1 : 0;
+            decodeCycles[group] += item.decodeCyclesPerByte * item.decompressedSize;
+            diskCycles[group] += disk * item.decompressedSize;
+            std::printf("%-34s %12.3f %12.3f %7.2fx\n", item.name.c_str(), item.decodeCyclesPerByte, disk, item.decodeCyclesPerByte / disk);
+        }
+        for (int group = 0; group < 2; group++) {
+            if (diskCycles[group] == 0.0) continue;
+            std::printf("%-10s disk cache hit %.2fx the speed of decoding\n", groupNames[group], decodeCycles[group] / diskCycles[group]);
+        }
+        diskCache.Close();
+    } else {
+        std::printf("\ncouldn't write %s, disk cache comparison skipped\n", cachePath.string().c_str());
+    }
+    fs::remove(cachePath, ec);
+
+    std::printf("\n");
+    PrintHistogram("synthetic", syntheticStats);
+    PrintHistogram("captured", capturedStats);
+
+    if (fuzzIterations) {
+        std::printf("\n");
+        if (!Fuzz(corpus, fuzzIterations)) failed = true;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+// Round trip check for RefPack::Compress, every CompressionLevel's output decoded with the game's decoder (DecompressImpl) and StreamDecoder
+// Covers the edges the match finders have to get right: empty and sub-4 byte inputs (stop code only), long runs (offset 1, longest match),
+// a match exactly MAX_OFFSET back and exactly MAX_MATCH long, the 4 byte size header, and a few thousand small random mixes
+// Build (Linux): g++ -O2 -std=c++20 -I.. refpack_roundtrip_check.cpp ../refpack/refpack_encoder.cpp ../refpack/refpack_stream.cpp -o refpack_roundtrip_check
+// Usage:         refpack_roundtrip_check [--random N] [--seed N]
+#include "refpack/refpack_decoder.h"
+#include "refpack/refpack_encoder.h"
+#include "refpack/refpack_stream.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using RefPack::CompressionLevel;
+
+constexpr uint32_t MAX_OFFSET = 131072;
+constexpr uint32_t MAX_MATCH = 1028;
+constexpr CompressionLevel LEVELS[] = {CompressionLevel::Fast, CompressionLevel::Normal, CompressionLevel::Max};
+constexpr const char* LEVEL_NAMES[] = {"Fast", "Normal", "Max"};
+
+// Longest match and farthest offset a stream uses, to show the edge cases really hit the command limits
+struct Reach {
+    uint32_t longestMatch = 0;
+    uint32_t farthestOffset = 0;
+};
+
+static bool Walk(const std::vector<uint8_t>& stream, Reach& reach) {
+    if (stream.size() < 2) return false;
+    size_t at = (stream[0] & 0x80) ? 6 : 5;
+    while (at < stream.size()) {
+        const uint8_t* c = stream.data() + at;
+        const size_t left = stream.size() - at;
+        uint32_t length = 0, offset = 0, literals, bytes;
+        if (c[0] < 0x80) {
+            if (left < 2) return false;
+            length = ((c[0] >> 2) & 0x7) + 3;
+            offset = ((c[0] & 0x60) << 3) + c[1] + 1;
+            literals = c[0] & 0x3;
+            bytes = 2;
+        } else if (c[0] < 0xC0) {
+            if (left < 3) return false;
+            length = (c[0] & 0x3F) + 4;
+            offset = ((c[1] & 0x3F) << 8) + c[2] + 1;
+            literals = c[1] >> 6;
+            bytes = 3;
+        } else if (c[0] < 0xE0) {
+            if (left < 4) return false;
+            length = ((c[0] & 0x0C) << 6) + c[3] + 5;
+            offset = ((c[0] & 0x10) << 12) + (c[1] << 8) + c[2] + 1;
+            literals = c[0] & 0x3;
+            bytes = 4;
+        } else if (c[0] < 0xFC) {
+            literals = ((c[0] & 0x1F) + 1) * 4;
+            bytes = 1;
+        } else {
+            return at + 1 + (c[0] & 0x3) == stream.size(); // Stop code has to end the stream
+        }
+        reach.longestMatch = std::max(reach.longestMatch, length);
+        reach.farthestOffset = std::max(reach.farthestOffset, offset);
+        at += bytes + literals;
+    }
+    return false;
+}
+
+// Compress at level, then decode with both decoders and compare. Returns an empty string on success, what went wrong otherwise
+static std::string RoundTrip(const std::vector<uint8_t>& input, CompressionLevel level, Reach& reach) {
+    std::vector<uint8_t> stream;
+    if (!RefPack::Compress(input.data(), static_cast<uint32_t>(input.size()), stream, level)) return "Compress failed";
+    if (stream.size() > RefPack::CompressBound(static_cast<uint32_t>(input.size()))) return "output larger than CompressBound";
+    if (RefPack::ReadDecompressedSize(stream.data(), static_cast<uint32_t>(stream.size())) != input.size()) return "header size wrong";
+    if (!Walk(stream, reach)) return "malformed command stream";
+
+    // DecompressImpl treats 0 as failure too, an empty input only has its header and stop code checked above
+    if (input.empty()) return "";
+    std::vector<uint8_t> out(input.size());
+    int result = RefPack::DecompressImpl<RefPack::StrategySSE2>(out.data(), static_cast<uint32_t>(out.size()), stream.data(), static_cast<uint32_t>(stream.size()));
+    if (result != static_cast<int>(input.size())) return "DecompressImpl returned " + std::to_string(result);
+    if (out != input) return "DecompressImpl output differs";
+
+    std::fill(out.begin(), out.end(), 0);
+    RefPack::StreamDecoder decoder;
+    decoder.Begin(out.data(), static_cast<uint32_t>(out.size()));
+    decoder.Feed(stream.data(), stream.size());
+    if (decoder.Result() != static_cast<int>(input.size()) || out != input) return "StreamDecoder output differs";
+    return "";
+}
+
+static std::vector<uint8_t> Random(size_t size, std::mt19937& rng) {
+    std::vector<uint8_t> data(size);
+    for (auto& b : data) b = static_cast<uint8_t>(rng());
+    return data;
+}
+
+struct Case {
+    std::string name;
+    std::vector<uint8_t> data;
+    uint32_t needOffset = 0; // Each level has to reach at least this far / this long, 0 = don't care
+    uint32_t needLength = 0;
+};
+
+static std::vector<Case> EdgeCases(std::mt19937& rng) {
+    std::vector<Case> cases;
+    cases.push_back({"empty", {}});
+    for (size_t size = 1; size <= 7; size++) cases.push_back({"random-" + std::to_string(size), Random(size, rng)});
+    cases.push_back({"run-3", std::vector<uint8_t>(3, 0xAA)});
+    cases.push_back({"run-4", std::vector<uint8_t>(4, 0xAA)});
+    cases.push_back({"run-1029", std::vector<uint8_t>(MAX_MATCH + 1, 0x00), 1, MAX_MATCH});
+    cases.push_back({"run-1M", std::vector<uint8_t>(1 << 20, 0x5A), 0, MAX_MATCH});
+    {
+        // Runs of every length 1-40 back to back, lots of short matches with literals carried in between
+        std::vector<uint8_t> runs;
+        for (uint32_t length = 1; length <= 40; length++) runs.insert(runs.end(), length, static_cast<uint8_t>(length * 37));
+        cases.push_back({"short-runs", runs});
+    }
+    {
+        // A random block repeated exactly MAX_OFFSET later, only reachable as long commands at the farthest offset
+        std::vector<uint8_t> data = Random(MAX_OFFSET + 2 * MAX_MATCH, rng);
+        std::copy(data.begin(), data.begin() + 2 * MAX_MATCH, data.begin() + MAX_OFFSET);
+        cases.push_back({"max-offset", data, MAX_OFFSET, MAX_MATCH});
+    }
+    {
+        // One past the farthest offset, must not be used
+        std::vector<uint8_t> data = Random(MAX_OFFSET + 1 + 64, rng);
+        std::copy(data.begin(), data.begin() + 64, data.begin() + MAX_OFFSET + 1);
+        cases.push_back({"past-max-offset", data});
+    }
+    {
+        // 16 MB and up switches to the 4 byte size header
+        std::vector<uint8_t> data((1 << 24) + 1, 0x11);
+        std::copy_n(Random(4096, rng).begin(), 4096, data.begin() + (1 << 23));
+        cases.push_back({"large-header", data, 0, MAX_MATCH});
+    }
+    return cases;
+}
+
+int main(int argc, char** argv) {
+    uint32_t randomCount = 2000;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--random") && i + 1 < argc) randomCount = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc) seed = std::strtoul(argv[++i], nullptr, 10);
+    }
+
+    std::mt19937 rng(seed);
+    int failures = 0;
+    for (const auto& c : EdgeCases(rng)) {
+        for (size_t level = 0; level < std::size(LEVELS); level++) {
+            Reach reach;
+            std::string error = RoundTrip(c.data, LEVELS[level], reach);
+            if (error.empty() && reach.farthestOffset < c.needOffset) error = "farthest offset " + std::to_string(reach.farthestOffset) + ", wanted " + std::to_string(c.needOffset);
+            if (error.empty() && reach.longestMatch < c.needLength) error = "longest match " + std::to_string(reach.longestMatch) + ", wanted " + std::to_string(c.needLength);
+            if (error.empty() && reach.farthestOffset > MAX_OFFSET) error = "offset past the window";
+            if (!error.empty()) {
+                std::printf("FAIL %-16s %-6s %s\n", c.name.c_str(), LEVEL_NAMES[level], error.c_str());
+                failures++;
+            }
+        }
+    }
+
+    // Small mixes of random bytes, runs and copies of earlier bytes, where the literal/match boundaries land everywhere
+    for (uint32_t i = 0; i < randomCount; i++) {
+        std::vector<uint8_t> data;
+        const size_t target = rng() % 600;
+        while (data.size() < target) {
+            size_t length = 1 + rng() % 40;
+            switch (rng() % 3) {
+            case 0:
+                for (size_t j = 0; j < length; j++) data.push_back(static_cast<uint8_t>(rng()));
+                break;
+            case 1: data.insert(data.end(), length, static_cast<uint8_t>(rng())); break;
+            default:
+                if (data.empty()) break;
+                for (size_t j = 0, from = rng() % data.size(); j < length; j++) data.push_back(data[from + j]);
+                break;
+            }
+        }
+        for (size_t level = 0; level < std::size(LEVELS); level++) {
+            Reach reach;
+            std::string error = RoundTrip(data, LEVELS[level], reach);
+            if (!error.empty()) {
+                std::printf("FAIL random #%u (%zu bytes) %-6s %s\n", i, data.size(), LEVEL_NAMES[level], error.c_str());
+                failures++;
+            }
+        }
+    }
+
+    std::printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -1,33 +1,25 @@
 #include "vtable_manager.h"
-#include <Psapi.h>
+#include "scan/parallel_scan.h"
+#include "scan/pe_image.h"
 #include "utils.h"
 #include "logger.h"
 
 //need to make this less specific to debug since I'll probably want to use this for other things
 static bool IsWithinModule(uintptr_t address, HMODULE module) {
-    MODULEINFO moduleInfo{};
-    if (!GetModuleInformation(GetCurrentProcess(), module, &moduleInfo, sizeof(moduleInfo))) { return false; }
-
-    uintptr_t base = reinterpret_cast<uintptr_t>(moduleInfo.lpBaseOfDll);
-    uintptr_t size = static_cast<uintptr_t>(moduleInfo.SizeOfImage);
-    return address >= base && address < (base + size);
+    const PE::Image* image = PE::Image::ForModule(module);
+    return image && image->Contains(address);
 }
 
-// Find an ASCII string's address within the main module
+// Find an ASCII string's address within the main module, literals live in .rdata so that's searched first, then the rest of the image like before
 static uintptr_t FindAsciiStringAddress(const char* literal) {
-    HMODULE module = GetModuleHandle(nullptr);
-    MODULEINFO moduleInfo{};
-    if (!GetModuleInformation(GetCurrentProcess(), module, &moduleInfo, sizeof(moduleInfo))) { return 0; }
-
-    const char* base = reinterpret_cast<const char*>(moduleInfo.lpBaseOfDll);
-    const size_t size = static_cast<size_t>(moduleInfo.SizeOfImage);
+    const PE::Image& image = PE::Image::Main();
     const size_t len = strlen(literal);
-    if (len == 0 || len > size) return 0;
+    if (len == 0 || !image.Data()) return 0;
 
-    for (size_t i = 0; i + len <= size; ++i) {
-        if (memcmp(base + i, literal, len) == 0) { return reinterpret_cast<uintptr_t>(base + i); }
-    }
-    return 0;
+    std::string mask(len, 'x');
+    Signature::Compiled compiled = Signature::CompileMasked(reinterpret_cast<const uint8_t*>(literal), mask.c_str());
+    if (const uint8_t* found = Signature::FindParallel(image.ReadOnlyDataRanges(), compiled)) return reinterpret_cast<uintptr_t>(found);
+    return reinterpret_cast<uintptr_t>(Signature::Find(image.Data(), image.Data() + image.SizeOfImage(), compiled));
 }
 
 // Check if the function's first bytes contain an immediate pointer to target
@@ -1,6 +1,7 @@
 #pragma once
 #include <Windows.h>
 #include <string>
+#include <vector>
 #include "pattern_scan.h"
 
 class VTableManager {
@@ -9,7 +10,7 @@ class VTableManager {
     bool validated = false;
 
     // Pattern for constructor: MOV [ESI],vtable; XOR ECX,ECX; MOV [ESI+0C],ECX
-    const char* constructorPattern = "56 8B F1 C7 06 ?? ?? ?? ?? 33 C9 89 4E 0C";
+    static constexpr Signature::PatternLiteral constructorPattern = "56 8B F1 C7 06 ?? ?? ?? ?? 33 C9 89 4E 0C";
 
     //would not believe...
     const char* vfuncPattern = "83 EC 18 53 56 8B F1 8D ?? 38 68 ?? ?? ?? ?? 89 4C 24 ?? E8 ?? ?? ?? ?? "
@@ -19,6 +20,9 @@ class VTableManager {
     bool IsExecutableAddress(uintptr_t addr);
 
   public:
+    // What Initialize scans for, so the startup prefetch can take it along
+    static std::vector<const Signature::PatternLiteral*> Patterns() { return {&constructorPattern}; }
+
     bool Initialize();
     void* GetFunctionAddress(const char* debugStr, uintptr_t offset);
 };
\ No newline at end of file